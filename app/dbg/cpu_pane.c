@@ -7,6 +7,7 @@
 #include <lib/6502/include/instruction.h>
 #include <lib/std/include/util.h>
 
+#include <inttypes.h>
 #include <notcurses/notcurses.h>
 
 /*
@@ -45,5 +46,5 @@ void cpu_pane_update(struct CpuPane *pane, struct Cpu *cpu)
       flags[((cpu->P & FLAGS_BIT_4) >> 4) * 5], flags[((cpu->P & FLAGS_DECIMAL) >> 3) * 4],
       flags[((cpu->P & FLAGS_INTERRUPT_DISABLE) >> 2) * 3], flags[(cpu->P & FLAGS_ZERO)],
       flags[(cpu->P & FLAGS_CARRY)]);
-  ncplane_printf_yx(plane, 6, 1, " CYC:  %d", cpu->cycle);
+  ncplane_printf_yx(plane, 6, 1, " CYC:  %" PRIu64, cpu->cycle);
 }
@@ -7,10 +7,14 @@
 
 #include <lib/6502/include/cpu.h>
 #include <lib/6502/include/instruction.h>
+#include <lib/6502/include/profiler.h>
+#include <lib/6502/include/trace.h>
 #include <lib/nes/include/rom.h>
 #include <lib/std/include/flat_set.h>
 #include <lib/std/include/io.h>
+#include <lib/std/include/metrics.h>
 #include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
 
 #include <assert.h>
 #include <locale.h>
@@ -21,41 +25,27 @@
 #include <time.h>
 
 /*
- * Logs the current CPU instruction to the given file, in Nintendulator format
- * so that it can be easily diffed with some verified output.
+ * Writes the profiler report to the given file, and the folded call stacks to
+ * the same file name with a '.folded' suffix.
  */
-static void log_current_cpu_instruction(FILE *log_file, struct Cpu *cpu)
+static void write_profile(const char *file_name, struct Profiler *profiler, struct Cpu *cpu)
 {
-  uint8_t *pc = cpu->ram + cpu->PC;
-  struct Instruction ins = make_instruction(*pc);
-
-  /* TODO(ton): check whether we go out-of-bounds while indexing the program
-   * counter below. */
-  char encoding_buf[9];
-  switch (ins.bytes)
+  FILE *fp;
+  if ((fp = fopen(file_name, "w")) == NULL)
   {
-    case 1:
-      sprintf(encoding_buf, "%02X      ", *pc);
-      break;
-    case 2:
-      sprintf(encoding_buf, "%02X %02X   ", *pc, *(pc + 1));
-      break;
-    case 3:
-      sprintf(encoding_buf, "%02X %02X %02X", *pc, *(pc + 1), *(pc + 2));
-      break;
+    nn_quit_strerror("Could not create profile '%s'", file_name);
   }
+  profiler_write_report(profiler, fp, cpu, 0);
+  fclose(fp);
 
-  const Encoding encoding = instruction_read_encoding(pc, ins.bytes);
-
-  /* TODO(ton): Nintendulator specific knowledge is present in this function as
-   * well as `instruction_print_layout`. We should merge this function and the
-   * Nintendulator specific code factored out from `instruction_print_layout`.
-   */
-  fprintf(log_file, "%04X  %s %c%-31s A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%d\n", cpu->PC,
-          encoding_buf, ins.is_supported ? ' ' : '*',
-          instruction_print_layout(&ins, encoding, IL_NINTENDULATOR, cpu), cpu->A, cpu->X, cpu->Y,
-          cpu->P, cpu->S, cpu->cycle);
-  fflush(log_file);
+  char *folded_file_name = nn_strcat(file_name, ".folded");
+  if ((fp = fopen(folded_file_name, "w")) == NULL)
+  {
+    nn_quit_strerror("Could not create profile '%s'", folded_file_name);
+  }
+  profiler_write_folded(profiler, fp);
+  fclose(fp);
+  free(folded_file_name);
 }
 
 /*
@@ -151,26 +141,24 @@ static int user_query_address(struct notcurses *nc, struct ncplane *plane, const
   return is_success;
 }
 
-int main(int argc, char **argv)
+/*
+ * Loads the given ROM file into the memory of the given CPU. Binaries that are
+ * not a NES ROM are copied into memory as is. Returns the size of the PRG ROM.
+ */
+static size_t load_rom(const char *file_name, struct Cpu *cpu)
 {
-  setlocale(LC_ALL, "");
-
-  struct Options options;
-  options_init(&options);
-  options_parse(&options, argc, argv);
+  NN_ZONE("ROM load");
 
   unsigned char *binary_data = NULL;
   size_t binary_size = 0;
-  if (nn_read_all(options.binary_file_name, &binary_data, &binary_size) == -1)
+  if (nn_read_all(file_name, &binary_data, &binary_size) == -1)
   {
-    nn_quit_strerror("Could not open the given ROM file '%s' for reading",
-                     options.binary_file_name);
+    nn_quit_strerror("Could not open the given ROM file '%s' for reading", file_name);
   }
 
   printf("Binary size: %lu bytes\n", binary_size);
 
   size_t prg_size = 0;
-  struct Cpu cpu = {0};
 
   /* Load the cartridge into memory. */
   struct RomHeader header = rom_make_header(binary_data);
@@ -180,7 +168,7 @@ int main(int argc, char **argv)
             "Warning, input binary is not a NES ROM file. Loading binary data "
             "as is into memory.\n");
 
-    memcpy(cpu.ram, binary_data, binary_size);
+    memcpy(cpu->ram, binary_data, binary_size);
   }
   else
   {
@@ -191,7 +179,7 @@ int main(int argc, char **argv)
     printf("PRG offset in ROM data: %lu\n", (prg_data - binary_data));
     printf("\n");
 
-    int error_code = mapper_initialize_cpu(header.mapper, &cpu, prg_data, prg_size);
+    int error_code = mapper_initialize_cpu(header.mapper, cpu, prg_data, prg_size);
     if (error_code == MAPPER_ERR_UNSUPPORTED)
     {
       nn_quit("Mapper '%s' not supported.", mapper_to_string(header.mapper));
@@ -203,6 +191,33 @@ int main(int argc, char **argv)
     }
   }
 
+  return prg_size;
+}
+
+int main(int argc, char **argv)
+{
+  setlocale(LC_ALL, "");
+
+  struct Options options;
+  options_init(&options);
+  options_parse(&options, argc, argv);
+
+  /* Record timing zones in case the user asked for them. */
+  struct zone_writer zone_writer;
+  struct zone_writer *zones = NULL;
+  if (options.zones_file_name)
+  {
+    if (zone_writer_open(&zone_writer, options.zones_file_name) != 0)
+    {
+      nn_quit_strerror("Could not create zones file '%s'", options.zones_file_name);
+    }
+    zones = &zone_writer;
+  }
+  NN_ZONE_THREAD_NAME("emulation");
+
+  struct Cpu cpu = {0};
+  const size_t prg_size = load_rom(options.binary_file_name, &cpu);
+
   /* Power on the CPU, that is, initiate the RESET cycle. This will initialize
    * PC from the RESET vector for example. */
   cpu_power_on(&cpu);
@@ -213,6 +228,14 @@ int main(int argc, char **argv)
     cpu.PC = options.address;
   }
 
+  /* Collect execution statistics in case the user asked for a profile. */
+  struct Profiler profiler = {0};
+  if (options.profile_file_name)
+  {
+    profiler = make_profiler(1);
+    cpu.profiler = &profiler;
+  }
+
   /* Initialize the debugger state. */
   /* TODO(ton): NROM mapper PRG segment hardcoded; need mapper knowledge here */
   struct Debugger debugger = make_debugger(0xc000, prg_size);
@@ -226,14 +249,17 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
-  /* Create log file if specified. */
-  FILE *log_file = NULL;
+  /* Create the binary instruction trace if specified. Use `tracefmt` to
+   * convert it to Nintendulator format. */
+  struct TraceWriter trace_writer;
+  struct TraceWriter *trace = NULL;
   if (options.log_file_name)
   {
-    if ((log_file = fopen(options.log_file_name, "w")) == NULL)
+    if (trace_writer_open(&trace_writer, options.log_file_name) != 0)
     {
       nn_quit_strerror("Could not create log file '%s'", options.log_file_name);
     }
+    trace = &trace_writer;
   }
 
   unsigned term_rows;
@@ -269,6 +295,24 @@ int main(int argc, char **argv)
   /* Status line is always on top. */
   ncplane_move_top(status_pane.plane);
 
+  /* Publish runtime metrics in case the user asked for them. The frame time
+   * only covers frames that did not wait for user input. */
+  struct metrics_writer metrics_writer;
+  struct metrics_writer *metrics = NULL;
+  if (options.metrics_file_name)
+  {
+    if (metrics_writer_open(&metrics_writer, options.metrics_file_name, 1000) != 0)
+    {
+      nn_quit_strerror("Could not create metrics file '%s'", options.metrics_file_name);
+    }
+    metrics = &metrics_writer;
+  }
+  const metric_t cpu_cycles = metrics_register("cpu_cycles", METRIC_COUNTER);
+  const metric_t frames = metrics_register("frames", METRIC_COUNTER);
+  const metric_t frame_time = metrics_register("frame_time_ns", METRIC_HISTOGRAM);
+  const metric_t trace_backlog = metrics_register("trace_backlog", METRIC_GAUGE);
+  uint64_t last_cycle = cpu.cycle;
+
   /* Event loop; wait for user input. */
   struct ncinput input = {0};
   bool quit = false;
@@ -276,6 +320,10 @@ int main(int argc, char **argv)
 
   while (!quit)
   {
+    NN_ZONE("frame loop");
+    const timestamp_t frame_start = nn_timestamp();
+    const bool waits_for_input = interactive_mode;
+
     /* TODO(ton): the following planes do not need to be printed every frame?
      * Check out how notcurses handles this in their demos. */
 
@@ -285,7 +333,10 @@ int main(int argc, char **argv)
     status_pane_update(&status_pane);
 
     /* Flip! */
-    notcurses_render(nc);
+    {
+      NN_ZONE("render");
+      notcurses_render(nc);
+    }
 
     if (interactive_mode)
     {
@@ -342,9 +393,10 @@ int main(int argc, char **argv)
         }
         break;
         case 'n': /* next instruction (step) */
-          if (log_file)
+          if (trace)
           {
-            log_current_cpu_instruction(log_file, &cpu);
+            const struct TraceRecord record = make_trace_record(&cpu);
+            trace_writer_push(trace, &record);
           }
           cpu_execute_next_instruction(&cpu);
           assembly_pane_scroll_to_pc(&assembly_pane, &debugger, &cpu);
@@ -464,17 +516,72 @@ int main(int argc, char **argv)
     }
     else /* !interactive_mode */
     {
-      if (log_file)
+      NN_ZONE("CPU batch");
+
+      if (trace)
       {
-        log_current_cpu_instruction(log_file, &cpu);
+        const struct TraceRecord record = make_trace_record(&cpu);
+        trace_writer_push(trace, &record);
       }
 
       cpu_execute_next_instruction(&cpu);
       assembly_pane_scroll_to_pc(&assembly_pane, &debugger, &cpu);
       interactive_mode = debugger_has_breakpoint_at(&debugger, cpu.PC);
     }
+
+    if (metrics)
+    {
+      if (!waits_for_input)
+      {
+        metrics_add(frames, 1);
+        metrics_record(frame_time, nn_timestamp() - frame_start);
+      }
+      metrics_add(cpu_cycles, cpu.cycle - last_cycle);
+      last_cycle = cpu.cycle;
+      if (trace)
+      {
+        metrics_set(trace_backlog, trace_writer_backlog(trace));
+      }
+
+      if (metrics_writer_poll(metrics) != 0)
+      {
+        nn_quit_strerror("Could not write metrics file '%s'", options.metrics_file_name);
+      }
+    }
+
+    /* Keep the per-thread zone buffers from overflowing. */
+    if (zones && zone_writer_flush(zones) != 0)
+    {
+      nn_quit_strerror("Could not write zones file '%s'", options.zones_file_name);
+    }
   }
 
   notcurses_stop(nc);
+
+  if (trace && trace_writer_close(trace) != 0)
+  {
+    nn_quit_strerror("Could not write log file '%s'", options.log_file_name);
+  }
+
+  if (metrics)
+  {
+    if (metrics_writer_write(metrics) != 0)
+    {
+      nn_quit_strerror("Could not write metrics file '%s'", options.metrics_file_name);
+    }
+    metrics_writer_close(metrics);
+  }
+
+  if (zones && zone_writer_close(zones) != 0)
+  {
+    nn_quit_strerror("Could not write zones file '%s'", options.zones_file_name);
+  }
+
+  if (cpu.profiler)
+  {
+    write_profile(options.profile_file_name, &profiler, &cpu);
+    destroy_profiler(&profiler);
+  }
+
   destroy_debugger(&debugger);
 }
@@ -11,7 +11,9 @@
 
 static void print_usage()
 {
-  printf("Usage: dbg -i|--input BINARY [-a|--address ADDRESS] [-h|--help]\n");
+  printf(
+      "Usage: dbg -i|--input BINARY [-a|--address ADDRESS] [-l|--log LOGFILE] "
+      "[-p|--profile PROFILE] [-m|--metrics METRICS] [-z|--zones ZONES] [-h|--help]\n");
 }
 
 static void print_help()
@@ -24,8 +26,17 @@ static void print_help()
       "\t-a ADDRESS    : hexadecimal ADDRESS in memory where to load the "
       "contents of a BINARY file\n");
   printf(
-      "\t-l LOGFILE    : Outputs CPU state to the given log file for every "
-      "instruction\n");
+      "\t-l LOGFILE    : Outputs CPU state to the given binary trace file for every "
+      "instruction, use tracefmt to convert it to text\n");
+  printf(
+      "\t-p PROFILE    : Profiles executed instructions, writes a report to PROFILE and "
+      "folded call stacks to PROFILE.folded on exit\n");
+  printf(
+      "\t-m METRICS    : Rewrites METRICS every second with runtime metrics, in Prometheus "
+      "text format\n");
+  printf(
+      "\t-z ZONES      : Writes timing zones to ZONES in Chrome trace event format, requires "
+      "a build with NEPNES_ZONES enabled\n");
   printf("\t-h | --help   : shows this help message\n");
 }
 
@@ -37,6 +48,9 @@ void options_init(struct Options *options)
 {
   options->binary_file_name = NULL;
   options->log_file_name = NULL;
+  options->profile_file_name = NULL;
+  options->metrics_file_name = NULL;
+  options->zones_file_name = NULL;
   options->print_help = false;
   options->address = CPU_ADDRESS_MAX;
 }
@@ -48,6 +62,10 @@ void options_parse(struct Options *options, int argc, char **argv)
       {"input", required_argument, NULL, 'i'},
       {"address", required_argument, NULL, 'a'},
       {"log", optional_argument, NULL, 'l'},
+      {"profile", required_argument, NULL, 'p'},
+      {"metrics", required_argument, NULL, 'm'},
+      {"zones", required_argument, NULL, 'z'},
+      {0, 0, 0, 0},
   };
 
   if (argc == 1)
@@ -58,7 +76,7 @@ void options_parse(struct Options *options, int argc, char **argv)
 
   int option_index = 0;
   char ch;
-  while ((ch = getopt_long(argc, argv, "hi:a:l:", opts, &option_index)) != -1)
+  while ((ch = getopt_long(argc, argv, "hi:a:l:p:m:z:", opts, &option_index)) != -1)
   {
     switch (ch)
     {
@@ -75,6 +93,15 @@ void options_parse(struct Options *options, int argc, char **argv)
       case 'l':
         options->log_file_name = strdup(optarg);
         break;
+      case 'p':
+        options->profile_file_name = strdup(optarg);
+        break;
+      case 'm':
+        options->metrics_file_name = strdup(optarg);
+        break;
+      case 'z':
+        options->zones_file_name = strdup(optarg);
+        break;
     }
   }
 
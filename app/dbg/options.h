@@ -10,6 +10,9 @@ struct Options
   Address address;
   char *binary_file_name;
   char *log_file_name;
+  char *profile_file_name;
+  char *metrics_file_name;
+  char *zones_file_name;
   bool print_help;
 };
 
@@ -2,9 +2,25 @@
 
 #include "app_window.h"
 
+#include <lib/std/include/metrics.h>
+#include <lib/std/include/zone.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+
 struct _NepnesApp
 {
   GtkApplication parent;
+
+  struct metrics_writer metrics_writer;
+  struct metrics_writer *metrics; /* NULL unless --metrics is given */
+  enum VideoFilter video_filter;
+  enum scaler scaler;
+  bool has_scaler;       /* whether --scaler is given */
+  char *audio_file_name; /* NULL unless --audio is given */
+  struct zone_writer zone_writer;
+  struct zone_writer *zones; /* NULL unless --zones is given */
+  char *zones_file_name;
 };
 
 /* will create nepnes_app_get_type and set nepnes_app_parent_class */
@@ -12,6 +28,101 @@ G_DEFINE_TYPE(NepnesApp, nepnes_app, GTK_TYPE_APPLICATION)
 
 static void nepnes_app_init(NepnesApp *app)
 {
+  g_application_add_main_option(G_APPLICATION(app), "audio", 'a', G_OPTION_FLAG_NONE,
+                                G_OPTION_ARG_FILENAME,
+                                "Records the audio to FILE as a WAV file, as it is played", "FILE");
+  g_application_add_main_option(G_APPLICATION(app), "metrics", 'm', G_OPTION_FLAG_NONE,
+                                G_OPTION_ARG_FILENAME,
+                                "Rewrites FILE every second with runtime metrics", "FILE");
+  g_application_add_main_option(G_APPLICATION(app), "ntsc", 'n', G_OPTION_FLAG_NONE,
+                                G_OPTION_ARG_NONE,
+                                "Emulates the composite video signal of the NES", NULL);
+  g_application_add_main_option(
+      G_APPLICATION(app), "scaler", 's', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING,
+      "Scales frames up on the CPU with NAME; one of none, nearest2x, nearest3x, nearest4x, "
+      "scale2x, scale3x or hq2x. By default, frames are only scaled on the CPU in case the GPU "
+      "can not scale them",
+      "NAME");
+  g_application_add_main_option(
+      G_APPLICATION(app), "zones", 'z', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME,
+      "Writes timing zones to FILE in Chrome trace event format, requires a build with "
+      "NEPNES_ZONES enabled",
+      "FILE");
+}
+
+static gboolean nepnes_app_write_metrics(gpointer user_data)
+{
+  NepnesApp *app = user_data;
+  if (metrics_writer_write(app->metrics) != 0)
+  {
+    g_printerr("Could not write metrics file '%s'\n", app->metrics->file_name);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean nepnes_app_write_zones(gpointer user_data)
+{
+  NepnesApp *app = user_data;
+  if (zone_writer_flush(app->zones) != 0)
+  {
+    g_printerr("Could not write zones file '%s'\n", app->zones_file_name);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gint nepnes_app_handle_local_options(GApplication *application, GVariantDict *options)
+{
+  NepnesApp *app = NEPNES_APP(application);
+
+  const char *file_name;
+  if (g_variant_dict_lookup(options, "audio", "^&ay", &file_name))
+  {
+    app->audio_file_name = g_strdup(file_name);
+  }
+
+  if (g_variant_dict_lookup(options, "metrics", "^&ay", &file_name))
+  {
+    if (metrics_writer_open(&app->metrics_writer, file_name, 1000) != 0)
+    {
+      g_printerr("Could not create metrics file '%s'\n", file_name);
+      return EXIT_FAILURE;
+    }
+    app->metrics = &app->metrics_writer;
+    g_timeout_add_seconds(1, nepnes_app_write_metrics, app);
+  }
+
+  if (g_variant_dict_contains(options, "ntsc"))
+  {
+    app->video_filter = VIDEO_FILTER_NTSC;
+  }
+
+  const char *scaler;
+  if (g_variant_dict_lookup(options, "scaler", "&s", &scaler))
+  {
+    if (scaler_from_string(scaler, &app->scaler) != 0)
+    {
+      g_printerr("Unknown scaler '%s'\n", scaler);
+      return EXIT_FAILURE;
+    }
+    app->has_scaler = true;
+  }
+
+  if (g_variant_dict_lookup(options, "zones", "^&ay", &file_name))
+  {
+    if (zone_writer_open(&app->zone_writer, file_name) != 0)
+    {
+      g_printerr("Could not create zones file '%s'\n", file_name);
+      return EXIT_FAILURE;
+    }
+    app->zones = &app->zone_writer;
+    app->zones_file_name = g_strdup(file_name);
+    NN_ZONE_THREAD_NAME("emulation");
+    /* Flushed every second, well before the buffers of the threads fill up. */
+    g_timeout_add_seconds(1, nepnes_app_write_zones, app);
+  }
+
+  /* Continue with the default processing. */
+  return -1;
 }
 
 static void nepnes_app_activate(GApplication *app)
@@ -31,10 +142,35 @@ static void nepnes_app_open(GApplication *app, GFile **files, int n_files, const
   gtk_window_present(GTK_WINDOW(win));
 }
 
+static void nepnes_app_shutdown(GApplication *application)
+{
+  NepnesApp *app = NEPNES_APP(application);
+  if (app->metrics)
+  {
+    nepnes_app_write_metrics(app);
+    metrics_writer_close(app->metrics);
+    app->metrics = NULL;
+  }
+  if (app->zones)
+  {
+    if (zone_writer_close(app->zones) != 0)
+    {
+      g_printerr("Could not write zones file '%s'\n", app->zones_file_name);
+    }
+    app->zones = NULL;
+  }
+  g_clear_pointer(&app->audio_file_name, g_free);
+  g_clear_pointer(&app->zones_file_name, g_free);
+
+  G_APPLICATION_CLASS(nepnes_app_parent_class)->shutdown(application);
+}
+
 static void nepnes_app_class_init(NepnesAppClass *class)
 {
   G_APPLICATION_CLASS(class)->activate = nepnes_app_activate;
   G_APPLICATION_CLASS(class)->open = nepnes_app_open;
+  G_APPLICATION_CLASS(class)->handle_local_options = nepnes_app_handle_local_options;
+  G_APPLICATION_CLASS(class)->shutdown = nepnes_app_shutdown;
 }
 
 NepnesApp *nepnes_app_new(void)
@@ -43,3 +179,30 @@ NepnesApp *nepnes_app_new(void)
   return g_object_new(
       NEPNES_APP_TYPE, "application-id", "com.tonvandenheuvel.nepnes", "flags", flags, NULL);
 }
+
+/*
+ * Returns the filter windows convert frames with, as given on the command line.
+ */
+enum VideoFilter nepnes_app_get_video_filter(NepnesApp *app)
+{
+  return app->video_filter;
+}
+
+/*
+ * Sets the scaler given on the command line, and returns whether one was
+ * given at all.
+ */
+gboolean nepnes_app_get_scaler(NepnesApp *app, enum scaler *scaler)
+{
+  *scaler = app->scaler;
+  return app->has_scaler;
+}
+
+/*
+ * Returns the file to record the audio to, as given on the command line, or
+ * NULL.
+ */
+const char *nepnes_app_get_audio_file_name(NepnesApp *app)
+{
+  return app->audio_file_name;
+}
@@ -1,11 +1,17 @@
 #ifndef NEPNES_APP_NEPNES_APP_H
 #define NEPNES_APP_NEPNES_APP_H
 
+#include <lib/nes/include/video.h>
+#include <lib/std/include/scaler.h>
+
 #include <gtk/gtk.h>
 
 #define NEPNES_APP_TYPE (nepnes_app_get_type())
 G_DECLARE_FINAL_TYPE(NepnesApp, nepnes_app, NEPNES, APP, GtkApplication)
 
 NepnesApp *nepnes_app_new(void);
+enum VideoFilter nepnes_app_get_video_filter(NepnesApp *app);
+gboolean nepnes_app_get_scaler(NepnesApp *app, enum scaler *scaler);
+const char *nepnes_app_get_audio_file_name(NepnesApp *app);
 
 #endif
@@ -2,29 +2,355 @@
 
 #include "app.h"
 
+#include <lib/nes/include/apu.h>
+#include <lib/nes/include/audio.h>
+#include <lib/nes/include/mapper.h>
+#include <lib/nes/include/nes.h>
+#include <lib/nes/include/video.h>
+#include <lib/std/include/metrics.h>
+#include <lib/std/include/scaler.h>
+#include <lib/std/include/thread_pool.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Most frames emulated per frame of the display, such that the emulation
+ * catches up after a stall, but never spirals. */
+#define NEPNES_MAX_FRAMES_PER_TICK 4
+
 struct _NepnesAppWindow
 {
   GtkApplicationWindow parent;
+
+  GtkWidget *picture;
+  struct Nes *nes; /* NULL until a ROM is opened */
+  guint tick_id;
+  uint8_t buttons; /* buttons of controller 1 currently held */
+
+  struct VideoOutput output;
+  struct thread_pool pool; /* workers of the NTSC filter and the scaler */
+  uint32_t pixels[PPU_HEIGHT * PPU_WIDTH];
+
+  enum scaler scaler;
+  bool has_scaler;  /* whether the scaler is given, rather than picked on realize */
+  uint32_t *scaled; /* NULL unless frames are scaled */
+
+  struct blip_buffer blip; /* receives the output of the APU */
+  struct AudioSink *audio; /* NULL in case no sink could be opened */
+
+  metric_t cpu_cycles;
+  metric_t frames;
+  metric_t frame_time;
+  metric_t present_time;
 };
 
 G_DEFINE_TYPE(NepnesAppWindow, nepnes_app_window, GTK_TYPE_APPLICATION_WINDOW)
 
+/*
+ * Returns the controller button mapped to the given key, or 0.
+ */
+static uint8_t key_to_button(guint keyval)
+{
+  switch (keyval)
+  {
+    case GDK_KEY_x:
+      return BUTTON_A;
+    case GDK_KEY_z:
+      return BUTTON_B;
+    case GDK_KEY_Shift_R:
+      return BUTTON_SELECT;
+    case GDK_KEY_Return:
+      return BUTTON_START;
+    case GDK_KEY_Up:
+      return BUTTON_UP;
+    case GDK_KEY_Down:
+      return BUTTON_DOWN;
+    case GDK_KEY_Left:
+      return BUTTON_LEFT;
+    case GDK_KEY_Right:
+      return BUTTON_RIGHT;
+    default:
+      return 0;
+  }
+}
+
+static gboolean on_key_pressed(GtkEventControllerKey *controller, guint keyval, guint keycode,
+                               GdkModifierType state, gpointer user_data)
+{
+  NepnesAppWindow *win = user_data;
+  const uint8_t button = key_to_button(keyval);
+  win->buttons |= button;
+  return button != 0;
+}
+
+static void on_key_released(GtkEventControllerKey *controller, guint keyval, guint keycode,
+                            GdkModifierType state, gpointer user_data)
+{
+  NepnesAppWindow *win = user_data;
+  win->buttons &= ~key_to_button(keyval);
+}
+
+/*
+ * Converts the framebuffer to RGBA with the video filter of the window, scales
+ * it up in case the window has a scaler, and shows it. Only frames that are
+ * presented pay for the conversion.
+ */
+static void nepnes_app_window_present(NepnesAppWindow *win)
+{
+  NN_ZONE("render");
+
+  const timestamp_t start = nn_timestamp();
+
+  video_output_convert(&win->output, &win->nes->ppu, win->pixels);
+
+  const uint32_t *pixels = win->pixels;
+  const int factor = scaler_factor(win->scaler);
+  if (win->scaler != SCALER_NONE)
+  {
+    scaler_run(win->scaler, win->pixels, PPU_WIDTH, PPU_WIDTH, PPU_HEIGHT, win->scaled,
+               factor * PPU_WIDTH, &win->pool);
+    pixels = win->scaled;
+  }
+
+  const int width = factor * PPU_WIDTH;
+  const int height = factor * PPU_HEIGHT;
+  GBytes *bytes = g_bytes_new(pixels, (gsize)width * height * sizeof *pixels);
+  GdkTexture *texture = gdk_memory_texture_new(width, height, GDK_MEMORY_R8G8B8A8, bytes,
+                                               width * sizeof *pixels);
+  gtk_picture_set_paintable(GTK_PICTURE(win->picture), GDK_PAINTABLE(texture));
+  g_object_unref(texture);
+  g_bytes_unref(bytes);
+
+  metrics_record(win->present_time, nn_timestamp() - start);
+}
+
+/*
+ * Runs one frame of emulation, and hands its audio over to the sink.
+ */
+static void nepnes_app_window_run_frame(NepnesAppWindow *win)
+{
+  struct Nes *nes = win->nes;
+
+  const timestamp_t start = nn_timestamp();
+  const uint64_t cycle = nes->cpu.cycle;
+  nes->controllers[0].buttons = win->buttons;
+  nes_run_frame(nes);
+  if (win->audio)
+  {
+    audio_sink_push_blip(win->audio, &win->blip, APU_CLOCK_RATE);
+  }
+  metrics_add(win->cpu_cycles, nes->cpu.cycle - cycle);
+  metrics_add(win->frames, 1);
+  metrics_record(win->frame_time, nn_timestamp() - start);
+}
+
+/*
+ * Runs frames of emulation until the audio sink is half full again, and
+ * presents the last one, if any. The sink plays in real time, hence audio
+ * paces the console at the speed of the NES, whatever the refresh rate of the
+ * display, and the sink never runs dry nor overflows. Without a sink, runs
+ * one frame per frame of the display.
+ */
+static gboolean nepnes_app_window_tick(GtkWidget *widget, GdkFrameClock *frame_clock,
+                                       gpointer user_data)
+{
+  NepnesAppWindow *win = NEPNES_APP_WINDOW(widget);
+
+  NN_ZONE("frame loop");
+
+  if (win->audio == NULL)
+  {
+    nepnes_app_window_run_frame(win);
+    nepnes_app_window_present(win);
+    return G_SOURCE_CONTINUE;
+  }
+
+  int frames = 0;
+  while (audio_sink_fill(win->audio) < 0.5 && frames < NEPNES_MAX_FRAMES_PER_TICK)
+  {
+    nepnes_app_window_run_frame(win);
+    ++frames;
+  }
+
+  if (frames > 0)
+  {
+    nepnes_app_window_present(win);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Stops emulation, and removes the cartridge, if any.
+ */
+static void nepnes_app_window_unload(NepnesAppWindow *win)
+{
+  if (win->tick_id)
+  {
+    gtk_widget_remove_tick_callback(GTK_WIDGET(win), win->tick_id);
+    win->tick_id = 0;
+  }
+
+  if (win->nes)
+  {
+    nes_unload(win->nes);
+    g_free(win->nes);
+    win->nes = NULL;
+  }
+}
+
 static void nepnes_app_window_init(NepnesAppWindow *win)
 {
   gtk_window_set_title(GTK_WINDOW(win), "nepnes");
-  /* TODO(ton): sane default size; depends on NTSC/PAL resolution? */
-  gtk_window_set_default_size(GTK_WINDOW(win), 400, 400);
+  gtk_window_set_default_size(GTK_WINDOW(win), 2 * PPU_WIDTH, 2 * PPU_HEIGHT);
+
+  win->picture = gtk_picture_new();
+  gtk_picture_set_can_shrink(GTK_PICTURE(win->picture), TRUE);
+  gtk_window_set_child(GTK_WINDOW(win), win->picture);
+
+  GtkEventController *keys = gtk_event_controller_key_new();
+  g_signal_connect(keys, "key-pressed", G_CALLBACK(on_key_pressed), win);
+  g_signal_connect(keys, "key-released", G_CALLBACK(on_key_released), win);
+  gtk_widget_add_controller(GTK_WIDGET(win), keys);
+
+  /* Written to the file given with --metrics, see app.c. */
+  win->cpu_cycles = metrics_register("cpu_cycles", METRIC_COUNTER);
+  win->frames = metrics_register("frames", METRIC_COUNTER);
+  win->frame_time = metrics_register("frame_time_ns", METRIC_HISTOGRAM);
+  win->present_time = metrics_register("present_time_ns", METRIC_HISTOGRAM);
+}
+
+/*
+ * Picks a scaler unless one was given; renderers on the GPU scale textures up
+ * for free, but the Cairo renderer scales on the CPU, and blurs. Giving it a
+ * texture scaled up twice on all CPUs is cheaper, and sharper.
+ */
+static void nepnes_app_window_realize(GtkWidget *widget)
+{
+  GTK_WIDGET_CLASS(nepnes_app_window_parent_class)->realize(widget);
+
+  NepnesAppWindow *win = NEPNES_APP_WINDOW(widget);
+  if (!win->has_scaler)
+  {
+    GskRenderer *renderer = gtk_native_get_renderer(GTK_NATIVE(win));
+    win->scaler = GSK_IS_CAIRO_RENDERER(renderer) ? SCALER_NEAREST2X : SCALER_NONE;
+  }
+
+  if (win->scaler != SCALER_NONE && win->scaled == NULL)
+  {
+    const int factor = scaler_factor(win->scaler);
+    win->scaled = g_new(uint32_t, (gsize)factor * factor * PPU_WIDTH * PPU_HEIGHT);
+  }
+}
+
+static void nepnes_app_window_dispose(GObject *object)
+{
+  nepnes_app_window_unload(NEPNES_APP_WINDOW(object));
+  G_OBJECT_CLASS(nepnes_app_window_parent_class)->dispose(object);
+}
+
+static void nepnes_app_window_finalize(GObject *object)
+{
+  NepnesAppWindow *win = NEPNES_APP_WINDOW(object);
+  if (win->audio)
+  {
+    if (audio_sink_close(win->audio) != 0)
+    {
+      g_printerr("Could not record the audio: %s\n", strerror(errno));
+    }
+    free(win->audio);
+  }
+  destroy_blip_buffer(&win->blip);
+  video_output_destroy(&win->output);
+  thread_pool_destroy(&win->pool);
+  g_free(win->scaled);
+  G_OBJECT_CLASS(nepnes_app_window_parent_class)->finalize(object);
 }
 
 static void nepnes_app_window_class_init(NepnesAppWindowClass *class)
 {
+  G_OBJECT_CLASS(class)->dispose = nepnes_app_window_dispose;
+  G_OBJECT_CLASS(class)->finalize = nepnes_app_window_finalize;
+  GTK_WIDGET_CLASS(class)->realize = nepnes_app_window_realize;
 }
 
+/*
+ * Creates a window that converts and scales frames with the video filter and
+ * the scaler of the given application. The NTSC filter and the scalers spread
+ * bands of rows over worker threads.
+ */
 NepnesAppWindow *nepnes_app_window_new(NepnesApp *app)
 {
-  return g_object_new(NEPNES_APP_WINDOW_TYPE, "application", app, NULL);
+  NepnesAppWindow *win = g_object_new(NEPNES_APP_WINDOW_TYPE, "application", app, NULL);
+  win->has_scaler = nepnes_app_get_scaler(app, &win->scaler);
+
+  const enum VideoFilter filter = nepnes_app_get_video_filter(app);
+  if (thread_pool_init(&win->pool, thread_pool_default_size()) != 0)
+  {
+    g_printerr("Could not start worker threads: %s\n", strerror(errno));
+    thread_pool_init(&win->pool, 0);
+  }
+  video_output_init(&win->output, filter, PIXEL_FORMAT_RGBA, &win->pool);
+
+  /* Audio is played by a null sink, unless it is recorded; either way, the
+   * sink paces the emulation. */
+  win->blip = make_blip_buffer(AUDIO_SYNTHESIS_RATE / 10, APU_CLOCK_RATE, AUDIO_SYNTHESIS_RATE);
+  const char *audio_file_name = nepnes_app_get_audio_file_name(app);
+  if ((win->audio = aligned_alloc(64, sizeof *win->audio)) == NULL)
+  {
+    nn_quit("Could not allocate an audio sink");
+  }
+  if (audio_file_name &&
+      audio_sink_open(win->audio, AUDIO_SINK_WAV, audio_file_name, AUDIO_SAMPLE_RATE, true) != 0)
+  {
+    g_printerr("Could not create audio file '%s': %s\n", audio_file_name, strerror(errno));
+    audio_file_name = NULL;
+  }
+  if (audio_file_name == NULL &&
+      audio_sink_open(win->audio, AUDIO_SINK_NULL, NULL, AUDIO_SAMPLE_RATE, true) != 0)
+  {
+    g_printerr("Could not start the audio thread: %s\n", strerror(errno));
+    g_clear_pointer(&win->audio, free);
+  }
+
+  return win;
 }
 
+/*
+ * Inserts the given ROM, and starts emulation.
+ */
 void nepnes_app_window_open(NepnesAppWindow *win, GFile *file)
 {
+  NN_ZONE("ROM load");
+
+  nepnes_app_window_unload(win);
+
+  char *rom_data;
+  gsize rom_size;
+  GError *error = NULL;
+  if (!g_file_load_contents(file, NULL, &rom_data, &rom_size, NULL, &error))
+  {
+    g_printerr("Could not open the given ROM file: %s\n", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  /* The console must not move in memory once loaded. */
+  win->nes = g_new0(struct Nes, 1);
+  const int error_code = nes_load(win->nes, (uint8_t *)rom_data, rom_size);
+  g_free(rom_data);
+  if (error_code != 0)
+  {
+    g_printerr("Could not load the given ROM file (error %d)\n", error_code);
+    g_free(win->nes);
+    win->nes = NULL;
+    return;
+  }
+
+  blip_clear(&win->blip);
+  win->nes->apu.blip = &win->blip;
+  win->tick_id = gtk_widget_add_tick_callback(GTK_WIDGET(win), nepnes_app_window_tick, NULL, NULL);
 }
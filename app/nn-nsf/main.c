@@ -0,0 +1,202 @@
+#include "options.h"
+
+#include <lib/nes/include/audio.h>
+#include <lib/nes/include/nsf.h>
+#include <lib/std/include/io.h>
+#include <lib/std/include/thread_pool.h>
+#include <lib/std/include/util.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Outcome of rendering a track; `error` is zero on success, or the errno of
+ * the step that failed.
+ */
+struct Track
+{
+  char *file_name;
+  int error;
+  const char *step;
+};
+
+/*
+ * A job of rendering tracks; every task renders one track.
+ */
+struct Render
+{
+  const struct Options *options;
+  const uint8_t *data;
+  size_t size;
+  int first_song; /* 0-based song of the first track */
+  struct Track *tracks;
+};
+
+/*
+ * Renders a track on its own player, and writes it to its own file, hence
+ * tracks render independently of each other.
+ */
+static void render_track(void *arg, int index)
+{
+  const struct Render *render = arg;
+  struct Track *track = &render->tracks[index];
+
+  /* The player is too large for the stack of a worker, and the sink embeds a
+   * ring buffer aligned to cache lines. */
+  struct NsfPlayer *player = malloc(sizeof *player);
+  struct AudioSink *sink = aligned_alloc(64, sizeof *sink);
+  if (player == NULL || sink == NULL)
+  {
+    nn_quit("Could not allocate a player");
+  }
+
+  nsf_load(player, render->data, render->size);
+  struct blip_buffer blip =
+      make_blip_buffer(AUDIO_SYNTHESIS_RATE / 10, APU_CLOCK_RATE, AUDIO_SYNTHESIS_RATE);
+  player->apu.blip = &blip;
+
+  if (nsf_start_song(player, render->first_song + index) != 0)
+  {
+    track->error = errno;
+    track->step = "initialize";
+  }
+  else if (audio_sink_open(sink, AUDIO_SINK_WAV, track->file_name, render->options->sample_rate,
+                           false) != 0)
+  {
+    track->error = errno;
+    track->step = "create";
+  }
+  else
+  {
+    /* A track that jams the CPU is cut short, and reported broken. */
+    const uint64_t frames = llround(render->options->seconds * nsf_frame_rate(player));
+    for (uint64_t frame = 0; frame < frames && track->error == 0; ++frame)
+    {
+      if (nsf_run_frame(player) != 0)
+      {
+        track->error = errno;
+        track->step = "play";
+      }
+      audio_sink_push_blip(sink, &blip, APU_CLOCK_RATE);
+    }
+
+    if (audio_sink_close(sink) != 0 && track->error == 0)
+    {
+      track->error = errno;
+      track->step = "write";
+    }
+  }
+
+  destroy_blip_buffer(&blip);
+  free(sink);
+  free(player);
+}
+
+/*
+ * Returns the reason a track failed; the errors of broken songs in words of
+ * their own.
+ */
+static const char *track_error_string(const struct Track *track)
+{
+  switch (track->error)
+  {
+    case EILSEQ:
+      return "the CPU jammed";
+    case ETIMEDOUT:
+      return "the init routine did not return";
+    default:
+      return strerror(track->error);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  struct Options options;
+  parse_options(&options, argc, argv);
+
+  uint8_t *data;
+  size_t size;
+  if (nn_read_all(options.nsf_file_name, &data, &size) == -1)
+  {
+    nn_quit_strerror("Could not open the given NSF file '%s' for reading", options.nsf_file_name);
+  }
+
+  struct NsfHeader header;
+  if (nsf_parse_header(&header, data, size) != 0)
+  {
+    nn_quit("Unknown format of NSF file '%s'", options.nsf_file_name);
+  }
+
+  printf("name: %s\n", header.name);
+  printf("artist: %s\n", header.artist);
+  printf("copyright: %s\n", header.copyright);
+  printf("songs: %d\n", header.songs);
+  if (header.chips != 0)
+  {
+    fprintf(stderr, "Expansion audio is not emulated, its channels are missing\n");
+  }
+
+  if (options.first_track == 0)
+  {
+    options.first_track = 1;
+    options.last_track = header.songs;
+  }
+  if (options.last_track > header.songs)
+  {
+    nn_quit("The NSF file has %d tracks", header.songs);
+  }
+
+  const int count = options.last_track - options.first_track + 1;
+  struct Render render = {&options, data, size, options.first_track - 1, NULL};
+  if ((render.tracks = calloc(count, sizeof *render.tracks)) == NULL)
+  {
+    nn_quit("Could not allocate %d tracks", count);
+  }
+  for (int i = 0; i < count; ++i)
+  {
+    const size_t length = strlen(options.output_prefix) + 16;
+    render.tracks[i].file_name = malloc(length);
+    snprintf(render.tracks[i].file_name, length, "%s-%02d.wav", options.output_prefix,
+             options.first_track + i);
+  }
+
+  /* The main thread takes part in the job, hence the pool needs one thread
+   * less than asked for. */
+  struct thread_pool pool;
+  const int workers = options.threads ? options.threads - 1 : thread_pool_default_size();
+  if (thread_pool_init(&pool, MIN(workers, count - 1)) != 0)
+  {
+    nn_quit_strerror("Could not start the render threads");
+  }
+
+  const timestamp_t start = nn_timestamp();
+  thread_pool_run(&pool, render_track, &render, count);
+  const double seconds = (nn_timestamp() - start) / 1e9;
+  thread_pool_destroy(&pool);
+
+  int failed = 0;
+  for (int i = 0; i < count; ++i)
+  {
+    const struct Track *track = &render.tracks[i];
+    if (track->error != 0)
+    {
+      fprintf(stderr, "Could not %s track %d '%s': %s\n", track->step, options.first_track + i,
+              track->file_name, track_error_string(track));
+      ++failed;
+    }
+    free(track->file_name);
+  }
+
+  const double audio_seconds = (count - failed) * options.seconds;
+  printf("tracks: %d\n", count - failed);
+  printf("audio_seconds: %.1f\n", audio_seconds);
+  printf("seconds: %.6f\n", seconds);
+  printf("realtime: %.1f\n", seconds > 0 ? audio_seconds / seconds : 0.0);
+
+  free(render.tracks);
+  free(data);
+  exit(failed == 0 ? 0 : 1);
+}
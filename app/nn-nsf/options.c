@@ -0,0 +1,130 @@
+#include "options.h"
+
+#include <lib/nes/include/audio.h>
+#include <lib/std/include/util.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static void print_usage()
+{
+  printf(
+      "Usage: nn-nsf -i|--input NSF [-o|--output PREFIX] [-t|--tracks N[-M]] [-l|--length "
+      "SECONDS] [-r|--rate HZ] [-j|--threads N] [-h|--help]\n");
+}
+
+static void print_help()
+{
+  printf(
+      "nn-nsf - renders the tracks of an NSF tune to WAV files as fast as possible, one track "
+      "per thread\n\n");
+  print_usage();
+  printf("\n");
+  printf("\t-i NSF         : NSF file to render\n");
+  printf(
+      "\t-o PREFIX      : writes track N to PREFIX-NN.wav, default the NSF file name without "
+      "its extension\n");
+  printf("\t-t N[-M]       : renders track N, or tracks N to M, default all tracks\n");
+  printf("\t-l SECONDS     : length of every track, default 120\n");
+  printf("\t-r HZ          : sample rate of the audio, %d-%d, default %d\n", AUDIO_MIN_SAMPLE_RATE,
+         AUDIO_MAX_SAMPLE_RATE, AUDIO_SAMPLE_RATE);
+  printf("\t-j N           : number of threads, default one per CPU\n");
+  printf("\t-h | --help    : shows this help message\n");
+}
+
+void parse_options(struct Options *options, int argc, char **argv)
+{
+  struct option opts[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"input", required_argument, NULL, 'i'},
+      {"output", required_argument, NULL, 'o'},
+      {"tracks", required_argument, NULL, 't'},
+      {"length", required_argument, NULL, 'l'},
+      {"rate", required_argument, NULL, 'r'},
+      {"threads", required_argument, NULL, 'j'},
+      {0, 0, 0, 0},
+  };
+
+  if (argc == 1)
+  {
+    print_usage();
+    exit(1);
+  }
+
+  memset(options, 0, sizeof *options);
+  options->seconds = 120;
+  options->sample_rate = AUDIO_SAMPLE_RATE;
+
+  int option_index = 0;
+  char ch;
+  while ((ch = getopt_long(argc, argv, "hi:o:t:l:r:j:", opts, &option_index)) != -1)
+  {
+    switch (ch)
+    {
+      case 'h':
+        print_help();
+        exit(1);
+        break;
+      case 'i':
+        options->nsf_file_name = strdup(optarg);
+        break;
+      case 'o':
+        options->output_prefix = strdup(optarg);
+        break;
+      case 't':
+      {
+        const int n = sscanf(optarg, "%d-%d", &options->first_track, &options->last_track);
+        if (n == 1)
+        {
+          options->last_track = options->first_track;
+        }
+        if (n < 1 || options->first_track < 1 || options->last_track < options->first_track)
+        {
+          nn_quit("Invalid tracks '%s', expected N or N-M", optarg);
+        }
+        break;
+      }
+      case 'l':
+        options->seconds = strtod(optarg, NULL);
+        if (options->seconds <= 0)
+        {
+          nn_quit("Invalid length '%s'", optarg);
+        }
+        break;
+      case 'r':
+        options->sample_rate = strtol(optarg, NULL, 10);
+        if (options->sample_rate < AUDIO_MIN_SAMPLE_RATE ||
+            options->sample_rate > AUDIO_MAX_SAMPLE_RATE)
+        {
+          nn_quit("The sample rate must lie within %d-%d Hz", AUDIO_MIN_SAMPLE_RATE,
+                  AUDIO_MAX_SAMPLE_RATE);
+        }
+        break;
+      case 'j':
+        options->threads = strtol(optarg, NULL, 10);
+        if (options->threads < 1)
+        {
+          nn_quit("Invalid number of threads '%s'", optarg);
+        }
+        break;
+    }
+  }
+
+  if (options->nsf_file_name == NULL)
+  {
+    nn_quit("Missing required argument: -i NSF");
+  }
+
+  if (options->output_prefix == NULL)
+  {
+    options->output_prefix = strdup(options->nsf_file_name);
+    const size_t length = strlen(options->output_prefix);
+    if (length > 4 && strcasecmp(options->output_prefix + length - 4, ".nsf") == 0)
+    {
+      options->output_prefix[length - 4] = '\0';
+    }
+  }
+}
@@ -0,0 +1,17 @@
+#ifndef NEPNES_APP_NN_NSF_OPTIONS_H
+#define NEPNES_APP_NN_NSF_OPTIONS_H
+
+struct Options
+{
+  char *nsf_file_name;
+  char *output_prefix; /* tracks are written to PREFIX-NN.wav */
+  int first_track;     /* 1-based, 0 for all tracks */
+  int last_track;
+  double seconds; /* length of every track */
+  int sample_rate;
+  int threads; /* 0 for one per CPU */
+};
+
+void parse_options(struct Options *options, int argc, char **argv);
+
+#endif
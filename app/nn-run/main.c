@@ -0,0 +1,278 @@
+#include "options.h"
+
+#include <lib/6502/include/trace.h>
+#include <lib/nes/include/audio.h>
+#include <lib/nes/include/input.h>
+#include <lib/nes/include/mapper.h>
+#include <lib/nes/include/nes.h>
+#include <lib/nes/include/video.h>
+#include <lib/std/include/io.h>
+#include <lib/std/include/metrics.h>
+#include <lib/std/include/perf.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Reads the given ROM file, and inserts it into the console.
+ */
+static void load_rom(struct Nes *nes, const char *file_name)
+{
+  NN_ZONE("ROM load");
+
+  uint8_t *rom_data;
+  size_t rom_size;
+  if (nn_read_all(file_name, &rom_data, &rom_size) == -1)
+  {
+    nn_quit_strerror("Could not open the given ROM file '%s' for reading", file_name);
+  }
+
+  const int error_code = nes_load(nes, rom_data, rom_size);
+  if (error_code == -1)
+  {
+    nn_quit("Unknown ROM format of ROM file '%s'", file_name);
+  }
+  else if (error_code == MAPPER_ERR_UNSUPPORTED)
+  {
+    nn_quit("Mapper '%s' not supported.", mapper_to_string(nes->header.mapper));
+  }
+  else if (error_code == MAPPER_ERR_NROM_UNEXPECTED_CHR_SIZE)
+  {
+    nn_quit("Unexpected CHR size for mapper '%s'", mapper_to_string(nes->header.mapper));
+  }
+  else if (error_code != 0)
+  {
+    nn_quit("Unexpected PRG size for mapper '%s'", mapper_to_string(nes->header.mapper));
+  }
+
+  free(rom_data);
+}
+
+int main(int argc, char **argv)
+{
+  struct Options options;
+  parse_options(&options, argc, argv);
+
+  struct zone_writer zone_writer;
+  struct zone_writer *zones = NULL;
+  if (options.zones_file_name)
+  {
+    if (zone_writer_open(&zone_writer, options.zones_file_name) != 0)
+    {
+      nn_quit_strerror("Could not create zones file '%s'", options.zones_file_name);
+    }
+    zones = &zone_writer;
+  }
+  NN_ZONE_THREAD_NAME("emulation");
+
+  static struct Nes nes;
+  load_rom(&nes, options.rom_file_name);
+  if (options.dot_accurate)
+  {
+    ppu_set_accuracy(&nes.ppu, PPU_ACCURACY_DOT);
+  }
+
+  struct InputScript script = {0};
+  if (options.script_file_name && input_script_read(&script, options.script_file_name) != 0)
+  {
+    if (errno == EINVAL)
+    {
+      nn_quit("Could not parse line %zu of the input script '%s'", script.error_line,
+              options.script_file_name);
+    }
+    nn_quit_strerror("Could not read the input script '%s'", options.script_file_name);
+  }
+
+  /* Create the binary instruction trace if specified. Use `tracefmt` to
+   * convert it to Nintendulator format. */
+  struct TraceWriter trace_writer;
+  if (options.log_file_name)
+  {
+    if (trace_writer_open(&trace_writer, options.log_file_name) != 0)
+    {
+      nn_quit_strerror("Could not create log file '%s'", options.log_file_name);
+    }
+    nes.trace = &trace_writer;
+  }
+
+  struct metrics_writer metrics_writer;
+  struct metrics_writer *metrics = NULL;
+  if (options.metrics_file_name)
+  {
+    if (metrics_writer_open(&metrics_writer, options.metrics_file_name, 1000) != 0)
+    {
+      nn_quit_strerror("Could not create metrics file '%s'", options.metrics_file_name);
+    }
+    metrics = &metrics_writer;
+  }
+  const metric_t cpu_cycles = metrics_register("cpu_cycles", METRIC_COUNTER);
+  const metric_t frames = metrics_register("frames", METRIC_COUNTER);
+  const metric_t frame_time = metrics_register("frame_time_ns", METRIC_HISTOGRAM);
+
+  /* Frames are converted and written by the writer thread. */
+  struct VideoWriter video_writer;
+  struct VideoWriter *video = NULL;
+  if (options.video_file_name)
+  {
+    if (video_writer_open(&video_writer, options.video_file_name, options.video_format,
+                          &options.video_layout) != 0)
+    {
+      nn_quit_strerror("Could not create video file '%s'", options.video_file_name);
+    }
+    video = &video_writer;
+  }
+
+  /* The APU synthesizes audio into a blip buffer, of which every frame is
+   * resampled and handed over to the sink thread. */
+  struct blip_buffer blip;
+  struct AudioSink audio_sink;
+  struct AudioSink *audio = NULL;
+  if (options.audio_file_name)
+  {
+    if (audio_sink_open(&audio_sink, AUDIO_SINK_WAV, options.audio_file_name,
+                        options.audio_sample_rate, false) != 0)
+    {
+      nn_quit_strerror("Could not create audio file '%s'", options.audio_file_name);
+    }
+    audio = &audio_sink;
+    blip = make_blip_buffer(AUDIO_SYNTHESIS_RATE / 10, APU_CLOCK_RATE, AUDIO_SYNTHESIS_RATE);
+    nes.apu.blip = &blip;
+  }
+
+  /* The report, and the hashes of every frame, go to standard error in case the
+   * video or the audio goes to standard output. */
+  FILE *report = (video && video->fp == stdout) || (audio && audio->fp == stdout) ? stderr : stdout;
+
+  /* Hardware events are counted per part of the emulation, and reported per
+   * emulated instruction. */
+  struct perf_counters perf_counters;
+  struct NesPerf perf;
+  if (options.count_events)
+  {
+    if (perf_open(&perf_counters) != 0)
+    {
+      nn_quit_strerror("Could not open hardware performance counters");
+    }
+    perf = make_nes_perf(&perf_counters);
+    nes.perf = &perf;
+  }
+
+  /* In case a number of cycles is given, frames are not counted; the last
+   * frame may be partial. */
+  const uint64_t end_cycle = options.cycles ? nes.first_cycle + options.cycles : UINT64_MAX;
+
+  const timestamp_t start = nn_timestamp();
+
+  while (nes.cpu.cycle < end_cycle && (options.cycles || nes.ppu.frame < options.frames))
+  {
+    NN_ZONE("frame loop");
+    const timestamp_t frame_start = nn_timestamp();
+    const uint64_t frame = nes.ppu.frame;
+    const uint64_t cycle = nes.cpu.cycle;
+
+    input_script_apply(&script, nes.ppu.frame, nes.controllers);
+    nes.ppu.skip_render =
+        options.skip_render && !video && (options.cycles || frame + 1 < options.frames);
+    nes_run_until(&nes, end_cycle);
+
+    if (metrics)
+    {
+      metrics_add(cpu_cycles, nes.cpu.cycle - cycle);
+      if (nes.ppu.frame != frame)
+      {
+        metrics_add(frames, 1);
+        metrics_record(frame_time, nn_timestamp() - frame_start);
+      }
+
+      if (metrics_writer_poll(metrics) != 0)
+      {
+        nn_quit_strerror("Could not write metrics file '%s'", options.metrics_file_name);
+      }
+    }
+
+    if (video && nes.ppu.frame != frame)
+    {
+      video_writer_push(video, nes.ppu.framebuffer);
+    }
+
+    if (audio && nes.ppu.frame != frame)
+    {
+      audio_sink_push_blip(audio, &blip, APU_CLOCK_RATE);
+    }
+
+    if (options.print_frame_hashes && nes.ppu.frame != frame)
+    {
+      fprintf(report, "frame %" PRIu64 " %016" PRIx64 " %016" PRIx64 "\n", frame,
+              nes_frame_hash(&nes), nes_ram_hash(&nes));
+    }
+
+    if (zones && zone_writer_flush(zones) != 0)
+    {
+      nn_quit_strerror("Could not write zones file '%s'", options.zones_file_name);
+    }
+  }
+
+  const double seconds = (nn_timestamp() - start) / 1e9;
+  const uint64_t cycles = nes.cpu.cycle - nes.first_cycle;
+
+  fprintf(report, "frames: %" PRIu64 "\n", nes.ppu.frame);
+  fprintf(report, "cycles: %" PRIu64 "\n", cycles);
+  fprintf(report, "frame_hash: %016" PRIx64 "\n", nes_frame_hash(&nes));
+  fprintf(report, "ram_hash: %016" PRIx64 "\n", nes_ram_hash(&nes));
+  fprintf(report, "seconds: %.6f\n", seconds);
+  fprintf(report, "emulated_mhz: %.3f\n", seconds > 0 ? cycles / seconds / 1e6 : 0.0);
+  fprintf(report, "fps: %.1f\n", seconds > 0 ? nes.ppu.frame / seconds : 0.0);
+  if (nes.cpu.jammed)
+  {
+    fprintf(stderr, "The CPU jammed at $%04X\n", nes.cpu.PC);
+  }
+  if (nes.perf)
+  {
+    perf_region_print(report, &perf_counters, &perf.cpu, "instruction");
+    perf_region_print(report, &perf_counters, &perf.ppu, "instruction");
+    perf_region_print(report, &perf_counters, &perf.apu, "instruction");
+    perf_close(&perf_counters);
+  }
+
+  if (video && video_writer_close(video) != 0)
+  {
+    nn_quit_strerror("Could not write video file '%s'", options.video_file_name);
+  }
+
+  if (audio)
+  {
+    if (audio_sink_close(audio) != 0)
+    {
+      nn_quit_strerror("Could not write audio file '%s'", options.audio_file_name);
+    }
+    destroy_blip_buffer(&blip);
+  }
+
+  if (nes.trace && trace_writer_close(nes.trace) != 0)
+  {
+    nn_quit_strerror("Could not write log file '%s'", options.log_file_name);
+  }
+
+  if (metrics)
+  {
+    if (metrics_writer_write(metrics) != 0)
+    {
+      nn_quit_strerror("Could not write metrics file '%s'", options.metrics_file_name);
+    }
+    metrics_writer_close(metrics);
+  }
+
+  if (zones && zone_writer_close(zones) != 0)
+  {
+    nn_quit_strerror("Could not write zones file '%s'", options.zones_file_name);
+  }
+
+  destroy_input_script(&script);
+  nes_unload(&nes);
+
+  return EXIT_SUCCESS;
+}
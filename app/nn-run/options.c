@@ -0,0 +1,199 @@
+#include "options.h"
+
+#include <lib/std/include/util.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_usage()
+{
+  printf(
+      "Usage: nn-run -i|--input ROM [-f|--frames N] [-c|--cycles N] [-s|--script FILE] "
+      "[-a|--accurate] [-k|--skip-render] [-H|--frame-hashes] [-l|--log FILE] "
+      "[-m|--metrics FILE] [-z|--zones FILE] [-v|--video FILE] [-C|--crop X,Y,W,H] "
+      "[-S|--scale SCALER] [-w|--wav FILE] [-r|--rate HZ] [-p|--perf] [-h|--help]\n");
+}
+
+static void print_help()
+{
+  printf("nn-run - runs a ROM headless as fast as possible, and reports its final state\n\n");
+  print_usage();
+  printf("\n");
+  printf("\t-i ROM         : ROM file to run\n");
+  printf("\t-f N           : number of frames to run, default 60\n");
+  printf("\t-c N           : number of CPU cycles to run, instead of a number of frames\n");
+  printf("\t-s FILE        : replays the controller input scripted in FILE\n");
+  printf("\t-a             : renders dot by dot, for mid-scanline effects and A12 timing\n");
+  printf(
+      "\t-k             : only draws the last frame, unless streaming video; timing and side "
+      "effects of the PPU are kept\n");
+  printf(
+      "\t-H             : prints the hashes of the picture and the work RAM at the end of every "
+      "frame\n");
+  printf("\t-l FILE        : writes a binary instruction trace to FILE\n");
+  printf("\t-m FILE        : rewrites FILE every second with runtime metrics\n");
+  printf(
+      "\t-z FILE        : writes timing zones to FILE in Chrome trace event format, requires "
+      "a build with NEPNES_ZONES enabled\n");
+  printf(
+      "\t-v FILE        : streams the picture of every frame to FILE, or to standard output in "
+      "case FILE is -; as a PPM sequence in case FILE ends in .ppm, or as Y4M otherwise\n");
+  printf(
+      "\t-C X,Y,W,H     : only streams the given rectangle of the picture, default "
+      "0,0,256,240\n");
+  printf(
+      "\t-S SCALER      : scales the streamed picture up with SCALER; one of none, nearest2x, "
+      "nearest3x, nearest4x, scale2x, scale3x or hq2x, or a factor 1-4 for nearest neighbor "
+      "scaling, default none\n");
+  printf(
+      "\t-w FILE        : writes the audio to FILE as a 16-bit mono WAV file at the rate given by "
+      "-r, or to standard output in case FILE is -\n");
+  printf("\t-r HZ          : sample rate of the audio, %d-%d, default %d\n", AUDIO_MIN_SAMPLE_RATE,
+         AUDIO_MAX_SAMPLE_RATE, AUDIO_SAMPLE_RATE);
+  printf(
+      "\t-p | --perf    : counts hardware events of the CPU, the PPU and the APU apart, and "
+      "reports IPC, branch and cache misses per emulated instruction\n");
+  printf("\t-h | --help    : shows this help message\n");
+}
+
+void parse_options(struct Options *options, int argc, char **argv)
+{
+  struct option opts[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"input", required_argument, NULL, 'i'},
+      {"frames", required_argument, NULL, 'f'},
+      {"cycles", required_argument, NULL, 'c'},
+      {"script", required_argument, NULL, 's'},
+      {"accurate", no_argument, NULL, 'a'},
+      {"skip-render", no_argument, NULL, 'k'},
+      {"frame-hashes", no_argument, NULL, 'H'},
+      {"log", required_argument, NULL, 'l'},
+      {"metrics", required_argument, NULL, 'm'},
+      {"zones", required_argument, NULL, 'z'},
+      {"video", required_argument, NULL, 'v'},
+      {"crop", required_argument, NULL, 'C'},
+      {"scale", required_argument, NULL, 'S'},
+      {"wav", required_argument, NULL, 'w'},
+      {"rate", required_argument, NULL, 'r'},
+      {"perf", no_argument, NULL, 'p'},
+      {0, 0, 0, 0},
+  };
+
+  if (argc == 1)
+  {
+    print_usage();
+    exit(1);
+  }
+
+  memset(options, 0, sizeof *options);
+  options->frames = 60;
+  options->video_layout = (struct VideoLayout){0, 0, PPU_WIDTH, PPU_HEIGHT, SCALER_NONE};
+  options->audio_sample_rate = AUDIO_SAMPLE_RATE;
+
+  int option_index = 0;
+  char ch;
+  while ((ch = getopt_long(argc, argv, "hi:f:c:s:akHl:m:z:v:C:S:w:r:p", opts, &option_index)) != -1)
+  {
+    switch (ch)
+    {
+      case 'h':
+        print_help();
+        exit(1);
+        break;
+      case 'i':
+        options->rom_file_name = strdup(optarg);
+        break;
+      case 'f':
+        options->frames = strtoull(optarg, NULL, 10);
+        break;
+      case 'c':
+        options->cycles = strtoull(optarg, NULL, 10);
+        break;
+      case 's':
+        options->script_file_name = strdup(optarg);
+        break;
+      case 'a':
+        options->dot_accurate = true;
+        break;
+      case 'k':
+        options->skip_render = true;
+        break;
+      case 'H':
+        options->print_frame_hashes = true;
+        break;
+      case 'l':
+        options->log_file_name = strdup(optarg);
+        break;
+      case 'm':
+        options->metrics_file_name = strdup(optarg);
+        break;
+      case 'z':
+        options->zones_file_name = strdup(optarg);
+        break;
+      case 'v':
+        options->video_file_name = strdup(optarg);
+        break;
+      case 'C':
+      {
+        struct VideoLayout *layout = &options->video_layout;
+        if (sscanf(optarg, "%d,%d,%d,%d", &layout->x, &layout->y, &layout->width,
+                   &layout->height) != 4)
+        {
+          nn_quit("Invalid crop rectangle '%s', expected X,Y,W,H", optarg);
+        }
+        break;
+      }
+      case 'S':
+        if (scaler_from_string(optarg, &options->video_layout.scaler) != 0)
+        {
+          nn_quit("Unknown scaler '%s'", optarg);
+        }
+        break;
+      case 'w':
+        options->audio_file_name = strdup(optarg);
+        break;
+      case 'r':
+        options->audio_sample_rate = strtol(optarg, NULL, 10);
+        if (options->audio_sample_rate < AUDIO_MIN_SAMPLE_RATE ||
+            options->audio_sample_rate > AUDIO_MAX_SAMPLE_RATE)
+        {
+          nn_quit("The sample rate must lie within %d-%d Hz", AUDIO_MIN_SAMPLE_RATE,
+                  AUDIO_MAX_SAMPLE_RATE);
+        }
+        break;
+      case 'p':
+        options->count_events = true;
+        break;
+    }
+  }
+
+  if (options->rom_file_name == NULL)
+  {
+    nn_quit("Missing required argument: -i ROM");
+  }
+
+  if (!video_layout_valid(&options->video_layout))
+  {
+    nn_quit("The crop rectangle must lie within the %dx%d picture", PPU_WIDTH, PPU_HEIGHT);
+  }
+
+  const char *file_name = options->video_file_name;
+  const size_t length = file_name ? strlen(file_name) : 0;
+  options->video_format = length >= 4 && strcmp(file_name + length - 4, ".ppm") == 0
+                              ? VIDEO_FORMAT_PPM
+                              : VIDEO_FORMAT_Y4M;
+  const char *audio_file_name = options->audio_file_name;
+  const bool video_to_stdout = file_name && strcmp(file_name, "-") == 0;
+  const bool audio_to_stdout = audio_file_name && strcmp(audio_file_name, "-") == 0;
+  /* Frames that are not drawn have no picture to hash. */
+  if (options->print_frame_hashes && options->skip_render)
+  {
+    nn_quit("Frame hashes can not be printed while skipping the rendering of frames");
+  }
+  if (video_to_stdout && audio_to_stdout)
+  {
+    nn_quit("Video and audio can not both be streamed to standard output");
+  }
+}
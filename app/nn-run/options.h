@@ -0,0 +1,32 @@
+#ifndef NEPNES_APP_NN_RUN_OPTIONS_H
+#define NEPNES_APP_NN_RUN_OPTIONS_H
+
+#include <lib/nes/include/audio.h>
+#include <lib/nes/include/video.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Options
+{
+  char *rom_file_name;
+  char *script_file_name;
+  char *log_file_name;
+  char *metrics_file_name;
+  char *zones_file_name;
+  char *video_file_name; /* "-" for stdout */
+  enum VideoFormat video_format;
+  struct VideoLayout video_layout;
+  char *audio_file_name; /* "-" for stdout */
+  int audio_sample_rate;
+  uint64_t frames;
+  uint64_t cycles; /* in case non-zero, run this many CPU cycles instead of frames */
+  bool print_frame_hashes;
+  bool count_events;
+  bool dot_accurate; /* render dot by dot rather than scanline by scanline */
+  bool skip_render;  /* only draw the last frame */
+};
+
+void parse_options(struct Options *options, int argc, char **argv);
+
+#endif
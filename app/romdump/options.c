@@ -32,6 +32,7 @@ void parse_options(struct Options *options, int argc, char **argv)
   struct option opts[] = {
       {"help", no_argument, NULL, 'h'},
       {"input", required_argument, NULL, 'i'},
+      {0, 0, 0, 0},
   };
 
   if (argc == 1)
@@ -0,0 +1,233 @@
+#include "options.h"
+
+#include <lib/6502/include/cpu.h>
+#include <lib/6502/include/trace.h>
+#include <lib/nes/include/mapper.h>
+#include <lib/nes/include/rom.h>
+#include <lib/std/include/io.h>
+#include <lib/std/include/util.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * A reference log to compare against, either a text log in Nintendulator
+ * format, or a binary trace file.
+ */
+struct Reference
+{
+  bool is_binary;
+  FILE *fp;
+  struct TraceReader reader;
+  char line[256];
+  size_t line_number;
+};
+
+/*
+ * Opens the given reference log, and detects its format. Returns 0 on
+ * success, or -1 otherwise, in which case `errno` is set.
+ */
+static int reference_open(struct Reference *reference, const char *file_name)
+{
+  memset(reference, 0, sizeof *reference);
+
+  FILE *fp;
+  if ((fp = fopen(file_name, "rb")) == NULL)
+  {
+    return -1;
+  }
+
+  char magic[sizeof TRACE_FILE_MAGIC];
+  reference->is_binary = fread(magic, sizeof magic, 1, fp) == 1 &&
+                         memcmp(magic, TRACE_FILE_MAGIC, sizeof magic) == 0;
+
+  if (reference->is_binary)
+  {
+    fclose(fp);
+    return trace_reader_open(&reference->reader, file_name);
+  }
+
+  rewind(fp);
+  reference->fp = fp;
+  return 0;
+}
+
+static void reference_close(struct Reference *reference)
+{
+  if (reference->is_binary)
+  {
+    trace_reader_close(&reference->reader);
+  }
+  else
+  {
+    fclose(reference->fp);
+  }
+}
+
+/*
+ * Reads the next record from the reference log. Returns 1 in case a record
+ * was read, 0 at the end of the log, or -1 in case the log could not be read
+ * or parsed.
+ */
+static int reference_next(struct Reference *reference, struct TraceRecord *record)
+{
+  if (reference->is_binary)
+  {
+    ++reference->line_number;
+    if (trace_reader_read(&reference->reader, record, 1) == 1)
+    {
+      return 1;
+    }
+    return reference->reader.chunk < reference->reader.chunk_count ? -1 : 0;
+  }
+
+  for (;;)
+  {
+    if (fgets(reference->line, sizeof reference->line, reference->fp) == NULL)
+    {
+      return ferror(reference->fp) ? -1 : 0;
+    }
+    ++reference->line_number;
+
+    reference->line[strcspn(reference->line, "\r\n")] = '\0';
+    if (reference->line[0] != '\0')
+    {
+      break;
+    }
+  }
+
+  return trace_parse_nintendulator(reference->line, record) == 0 ? 1 : -1;
+}
+
+/*
+ * Prints the current reference record as it appears in the reference log.
+ */
+static void reference_print(struct Reference *reference, const struct TraceRecord *record, FILE *fp)
+{
+  if (reference->is_binary)
+  {
+    trace_print_nintendulator(fp, record);
+  }
+  else
+  {
+    fprintf(fp, "%s\n", reference->line);
+  }
+}
+
+static double elapsed_seconds(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+  struct Options options = {0};
+  parse_options(&options, argc, argv);
+
+  unsigned char *rom_data = NULL;
+  size_t rom_size = 0;
+  if (nn_read_all(options.rom_file_name, &rom_data, &rom_size) == -1)
+  {
+    nn_quit_strerror("Could not open the given ROM file '%s' for reading", options.rom_file_name);
+  }
+
+  struct RomHeader header = rom_make_header(rom_data);
+  if (header.rom_format == RF_UNKNOWN)
+  {
+    nn_quit("Unknown ROM format of ROM file '%s'", options.rom_file_name);
+  }
+
+  uint8_t *prg_data;
+  size_t prg_size;
+  rom_prg_data(&header, rom_data, &prg_data, &prg_size);
+
+  static struct Cpu cpu;
+  if (mapper_initialize_cpu(header.mapper, &cpu, prg_data, prg_size) != 0)
+  {
+    nn_quit("Mapper '%s' not supported.", mapper_to_string(header.mapper));
+  }
+
+  cpu_power_on(&cpu);
+  if (options.address != CPU_ADDRESS_MAX)
+  {
+    cpu.PC = options.address;
+  }
+
+  struct Reference reference;
+  if (reference_open(&reference, options.reference_file_name) != 0)
+  {
+    nn_quit_strerror("Could not open the given reference log '%s' for reading",
+                     options.reference_file_name);
+  }
+
+  /* The last `context` instructions that matched the reference. */
+  struct TraceRecord *history = NULL;
+  if (options.context > 0 && (history = calloc(options.context, sizeof *history)) == NULL)
+  {
+    nn_quit("Could not allocate the instruction history");
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  size_t instructions = 0;
+  struct TraceRecord expected;
+  int status;
+  while ((status = reference_next(&reference, &expected)) == 1)
+  {
+    const struct TraceRecord actual = make_trace_record(&cpu);
+
+    const char *field = trace_record_compare(&expected, &actual, reference.is_binary);
+    if (field != NULL)
+    {
+      printf("Divergence at instruction %zu (reference line %zu), %s differs:\n", instructions + 1,
+             reference.line_number, field);
+
+      const size_t context = MIN(options.context, instructions);
+      for (size_t i = instructions - context; i < instructions; ++i)
+      {
+        printf("  ");
+        trace_print_nintendulator(stdout, &history[i % options.context]);
+      }
+      printf("- ");
+      reference_print(&reference, &expected, stdout);
+      printf("+ ");
+      trace_print_nintendulator(stdout, &actual);
+
+      exit(1);
+    }
+
+    if (history)
+    {
+      history[instructions % options.context] = actual;
+    }
+    ++instructions;
+
+    cpu_execute_next_instruction(&cpu);
+  }
+
+  if (status == -1)
+  {
+    if (reference.is_binary)
+    {
+      nn_quit_strerror("Could not read the reference log '%s'", options.reference_file_name);
+    }
+    nn_quit("Could not parse line %zu of the reference log '%s'", reference.line_number,
+            options.reference_file_name);
+  }
+
+  const double seconds = elapsed_seconds(&start);
+  printf("No differences found in %zu instructions (%.3f ms, %.1f M instructions/s)\n",
+         instructions, 1e3 * seconds, seconds > 0 ? instructions / seconds / 1e6 : 0.0);
+
+  reference_close(&reference);
+  free(history);
+
+  exit(0);
+}
@@ -0,0 +1,85 @@
+#include "options.h"
+
+#include <lib/std/include/util.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_usage()
+{
+  printf(
+      "Usage: tracediff -i|--input ROM -r|--reference LOGFILE [-a|--address ADDRESS] "
+      "[-c|--context N] [-h|--help]\n");
+}
+
+static void print_help()
+{
+  printf("tracediff - runs a ROM and compares the CPU state against a reference log\n\n");
+  print_usage();
+  printf("\n");
+  printf("\t-i ROM         : ROM file to run\n");
+  printf(
+      "\t-r LOGFILE     : reference log, either in Nintendulator format, or a binary trace "
+      "file as written by dbg -l\n");
+  printf("\t-a ADDRESS     : hexadecimal ADDRESS to start execution at, instead of RESET\n");
+  printf("\t-c N           : number of instructions to print before a divergence, default 8\n");
+  printf("\t-h | --help    : shows this help message\n");
+}
+
+void parse_options(struct Options *options, int argc, char **argv)
+{
+  struct option opts[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"input", required_argument, NULL, 'i'},
+      {"reference", required_argument, NULL, 'r'},
+      {"address", required_argument, NULL, 'a'},
+      {"context", required_argument, NULL, 'c'},
+      {0, 0, 0, 0},
+  };
+
+  if (argc == 1)
+  {
+    print_usage();
+    exit(1);
+  }
+
+  options->address = CPU_ADDRESS_MAX;
+  options->context = 8;
+
+  int option_index = 0;
+  char ch;
+  while ((ch = getopt_long(argc, argv, "hi:r:a:c:", opts, &option_index)) != -1)
+  {
+    switch (ch)
+    {
+      case 'h':
+        print_help();
+        exit(1);
+        break;
+      case 'i':
+        options->rom_file_name = strdup(optarg);
+        break;
+      case 'r':
+        options->reference_file_name = strdup(optarg);
+        break;
+      case 'a':
+        sscanf(optarg, "%" SCNx16, &options->address);
+        break;
+      case 'c':
+        options->context = strtoul(optarg, NULL, 10);
+        break;
+    }
+  }
+
+  if (options->rom_file_name == NULL)
+  {
+    nn_quit("Missing required argument: -i ROM");
+  }
+  if (options->reference_file_name == NULL)
+  {
+    nn_quit("Missing required argument: -r LOGFILE");
+  }
+}
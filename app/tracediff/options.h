@@ -0,0 +1,18 @@
+#ifndef NEPNES_APP_TRACEDIFF_OPTIONS_H
+#define NEPNES_APP_TRACEDIFF_OPTIONS_H
+
+#include <lib/6502/include/cpu.h>
+
+#include <stddef.h>
+
+struct Options
+{
+  char *rom_file_name;
+  char *reference_file_name;
+  Address address;
+  size_t context;
+};
+
+void parse_options(struct Options *options, int argc, char **argv);
+
+#endif
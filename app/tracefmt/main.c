@@ -0,0 +1,54 @@
+#include "options.h"
+
+#include <lib/6502/include/trace.h>
+#include <lib/std/include/util.h>
+
+#include <stdlib.h>
+
+int main(int argc, char **argv)
+{
+  struct Options options = {0};
+  parse_options(&options, argc, argv);
+
+  struct TraceReader reader;
+  if (trace_reader_open(&reader, options.trace_file_name) != 0)
+  {
+    nn_quit_strerror("Could not open the given trace file '%s' for reading",
+                     options.trace_file_name);
+  }
+
+  FILE *fp = stdout;
+  if (options.output_file_name && (fp = fopen(options.output_file_name, "w")) == NULL)
+  {
+    nn_quit_strerror("Could not create output file '%s'", options.output_file_name);
+  }
+
+  static char output_buffer[1 << 20];
+  setvbuf(fp, output_buffer, _IOFBF, sizeof output_buffer);
+
+  static struct TraceRecord records[4096];
+  size_t n;
+  while ((n = trace_reader_read(&reader, records, sizeof records / sizeof records[0])) > 0)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      trace_print_nintendulator(fp, &records[i]);
+    }
+  }
+
+  if (reader.chunk < reader.chunk_count)
+  {
+    nn_quit_strerror("Could not read chunk %zu of trace file '%s'", reader.chunk,
+                     options.trace_file_name);
+  }
+
+  trace_reader_close(&reader);
+
+  if (fclose(fp) != 0)
+  {
+    nn_quit_strerror("Could not write output file '%s'",
+                     options.output_file_name ? options.output_file_name : "stdout");
+  }
+
+  exit(0);
+}
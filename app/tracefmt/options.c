@@ -0,0 +1,63 @@
+#include "options.h"
+
+#include <lib/std/include/util.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_usage()
+{
+  printf("Usage: tracefmt -i|--input TRACEFILE [-o|--output LOGFILE] [-h|--help]\n");
+}
+
+static void print_help()
+{
+  printf("tracefmt - converts binary instruction traces to Nintendulator log format\n\n");
+  print_usage();
+  printf("\n");
+  printf("\t-i TRACEFILE   : binary trace file, as written by dbg -l\n");
+  printf("\t-o LOGFILE     : output file, by default writes to standard output\n");
+  printf("\t-h | --help    : shows this help message\n");
+}
+
+void parse_options(struct Options *options, int argc, char **argv)
+{
+  struct option opts[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"input", required_argument, NULL, 'i'},
+      {"output", required_argument, NULL, 'o'},
+      {0, 0, 0, 0},
+  };
+
+  if (argc == 1)
+  {
+    print_usage();
+    exit(1);
+  }
+
+  int option_index = 0;
+  char ch;
+  while ((ch = getopt_long(argc, argv, "hi:o:", opts, &option_index)) != -1)
+  {
+    switch (ch)
+    {
+      case 'h':
+        print_help();
+        exit(1);
+        break;
+      case 'i':
+        options->trace_file_name = strdup(optarg);
+        break;
+      case 'o':
+        options->output_file_name = strdup(optarg);
+        break;
+    }
+  }
+
+  if (options->trace_file_name == NULL)
+  {
+    nn_quit("Missing required argument: -i TRACEFILE");
+  }
+}
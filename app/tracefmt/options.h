@@ -0,0 +1,13 @@
+#ifndef NEPNES_APP_TRACEFMT_OPTIONS_H
+#define NEPNES_APP_TRACEFMT_OPTIONS_H
+
+struct Options
+{
+  char *trace_file_name;
+  char *output_file_name;
+  int print_help;
+};
+
+void parse_options(struct Options *options, int argc, char **argv);
+
+#endif
@@ -0,0 +1,73 @@
+#include "options.h"
+
+#include <lib/6502/include/trace.h>
+#include <lib/std/include/util.h>
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv)
+{
+  struct Options options = {0};
+  parse_options(&options, argc, argv);
+
+  struct TraceReader reader;
+  if (trace_reader_open(&reader, options.trace_file_name) != 0)
+  {
+    nn_quit_strerror("Could not open the given trace file '%s' for reading",
+                     options.trace_file_name);
+  }
+
+  struct TraceRecord record;
+  size_t results = 0;
+  int found;
+
+  switch (options.query)
+  {
+    case QUERY_PC:
+    case QUERY_WRITE:
+      while ((options.max_results == 0 || results < options.max_results) &&
+             (found = options.query == QUERY_PC
+                          ? trace_reader_next_pc(&reader, options.address, &record)
+                          : trace_reader_next_write(&reader, options.address, &record)) == 1)
+      {
+        trace_print_nintendulator(stdout, &record);
+        ++results;
+      }
+      break;
+    case QUERY_CYCLE:
+      if ((found = trace_reader_find_cycle(&reader, options.cycle, &record)) == 1)
+      {
+        trace_print_nintendulator(stdout, &record);
+        ++results;
+      }
+      break;
+    case QUERY_FRAME:
+      if ((found = trace_reader_find_frame(&reader, options.frame, &record)) == 1)
+      {
+        trace_print_nintendulator(stdout, &record);
+        ++results;
+      }
+      break;
+    default:
+      found = 0;
+      break;
+  }
+
+  if (found == -1)
+  {
+    nn_quit_strerror("Could not read chunk %zu of trace file '%s'", reader.chunk,
+                     options.trace_file_name);
+  }
+
+  if (options.print_stats)
+  {
+    fprintf(stderr, "%zu result(s), decompressed %zu of %zu chunk(s), %" PRIu64 " record(s)\n",
+            results, reader.chunks_loaded, reader.chunk_count,
+            trace_reader_record_count(&reader));
+  }
+
+  trace_reader_close(&reader);
+
+  exit(results > 0 ? 0 : 1);
+}
@@ -0,0 +1,144 @@
+#include "options.h"
+
+#include <lib/std/include/util.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_usage()
+{
+  printf(
+      "Usage: tracequery -i|--input TRACEFILE (-p|--pc ADDRESS | -w|--write ADDRESS | "
+      "-c|--cycle CYCLE | -f|--frame FRAME) [-n|--max-results N] [-s|--stats] [-h|--help]\n");
+}
+
+static void print_help()
+{
+  printf("tracequery - searches binary instruction traces using their index\n\n");
+  print_usage();
+  printf("\n");
+  printf("\t-i TRACEFILE   : binary trace file, as written by dbg -l\n");
+  printf("\t-p ADDRESS     : prints the first instruction executed at hexadecimal ADDRESS\n");
+  printf("\t-w ADDRESS     : prints all instructions that write to hexadecimal ADDRESS\n");
+  printf("\t-c CYCLE       : prints the CPU state at the given CYCLE\n");
+  printf(
+      "\t-f FRAME       : prints the first instruction of the given FRAME, where frame 0 starts "
+      "at power on\n");
+  printf("\t-n N           : prints at most N matching instructions, 0 means no limit\n");
+  printf("\t-s | --stats   : prints the number of chunks that had to be decompressed\n");
+  printf("\t-h | --help    : shows this help message\n");
+}
+
+/*
+ * Parses a hexadecimal address, optionally prefixed with a '$'.
+ */
+static Address parse_address(const char *s)
+{
+  Address address;
+  if (sscanf(s + (*s == '$'), "%" SCNx16, &address) != 1)
+  {
+    nn_quit("Invalid address '%s'", s);
+  }
+  return address;
+}
+
+static uint64_t parse_number(const char *s)
+{
+  uint64_t n;
+  if (sscanf(s, "%" SCNu64, &n) != 1)
+  {
+    nn_quit("Invalid number '%s'", s);
+  }
+  return n;
+}
+
+static void set_query(struct Options *options, enum Query query)
+{
+  if (options->query != QUERY_NONE)
+  {
+    nn_quit("Only one of -p, -w, -c and -f can be given");
+  }
+  options->query = query;
+}
+
+void parse_options(struct Options *options, int argc, char **argv)
+{
+  struct option opts[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"input", required_argument, NULL, 'i'},
+      {"pc", required_argument, NULL, 'p'},
+      {"write", required_argument, NULL, 'w'},
+      {"cycle", required_argument, NULL, 'c'},
+      {"frame", required_argument, NULL, 'f'},
+      {"max-results", required_argument, NULL, 'n'},
+      {"stats", no_argument, NULL, 's'},
+      {0, 0, 0, 0},
+  };
+
+  if (argc == 1)
+  {
+    print_usage();
+    exit(1);
+  }
+
+  bool has_max_results = false;
+
+  int option_index = 0;
+  char ch;
+  while ((ch = getopt_long(argc, argv, "hi:p:w:c:f:n:s", opts, &option_index)) != -1)
+  {
+    switch (ch)
+    {
+      case 'h':
+        print_help();
+        exit(1);
+        break;
+      case 'i':
+        options->trace_file_name = strdup(optarg);
+        break;
+      case 'p':
+        set_query(options, QUERY_PC);
+        options->address = parse_address(optarg);
+        break;
+      case 'w':
+        set_query(options, QUERY_WRITE);
+        options->address = parse_address(optarg);
+        break;
+      case 'c':
+        set_query(options, QUERY_CYCLE);
+        options->cycle = parse_number(optarg);
+        break;
+      case 'f':
+        set_query(options, QUERY_FRAME);
+        options->frame = parse_number(optarg);
+        break;
+      case 'n':
+        options->max_results = parse_number(optarg);
+        has_max_results = true;
+        break;
+      case 's':
+        options->print_stats = true;
+        break;
+    }
+  }
+
+  if (options->trace_file_name == NULL)
+  {
+    nn_quit("Missing required argument: -i TRACEFILE");
+  }
+
+  if (options->query == QUERY_NONE)
+  {
+    nn_quit("Missing query, one of -p, -w, -c or -f is required");
+  }
+
+  /* By default, look for the first execution of an address, but for all writes
+   * to an address. */
+  if (!has_max_results)
+  {
+    options->max_results = options->query == QUERY_PC ? 1 : 0;
+  }
+}
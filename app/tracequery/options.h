@@ -0,0 +1,32 @@
+#ifndef NEPNES_APP_TRACEQUERY_OPTIONS_H
+#define NEPNES_APP_TRACEQUERY_OPTIONS_H
+
+#include <lib/6502/include/cpu.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum Query
+{
+  QUERY_NONE,
+  QUERY_PC,
+  QUERY_WRITE,
+  QUERY_CYCLE,
+  QUERY_FRAME,
+};
+
+struct Options
+{
+  char *trace_file_name;
+  enum Query query;
+  Address address;
+  uint64_t cycle;
+  uint64_t frame;
+  size_t max_results; /* zero means no limit */
+  bool print_stats;
+};
+
+void parse_options(struct Options *options, int argc, char **argv);
+
+#endif
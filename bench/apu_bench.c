@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include <lib/nes/include/apu.h>
+
+#include <string.h>
+
+/* Number of frames synthesized by a single run of the workload. */
+#define APU_FRAMES 600
+
+/* CPU cycles per frame of the NTSC NES, rounded. */
+#define APU_FRAME_CYCLES 29781
+
+/* Sample rate of the output. */
+#define APU_SAMPLE_RATE 48000
+
+static struct Apu apu;
+static struct blip_buffer blip;
+static uint8_t memory[CPU_ADDRESS_MAX + 1];
+static uint64_t cycle;
+
+/*
+ * Powers on the APU with a pseudo random DMC sample at $c000, and a blip
+ * buffer that receives the output.
+ */
+static int apu_frame_setup(void)
+{
+  uint32_t x = 0x9e3779b9;
+  for (int i = 0; i < 0x1000; ++i)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    memory[0xc000 + i] = x >> 24;
+  }
+
+  cycle = 0;
+  apu_power_on(&apu, memory, cycle);
+  blip = make_blip_buffer(APU_SAMPLE_RATE / 10, APU_CLOCK_RATE, APU_SAMPLE_RATE);
+  apu.blip = &blip;
+  return 0;
+}
+
+/*
+ * Plays a new note on every channel four times per frame, with a looping DMC
+ * sample at a high rate, and reads the samples of every frame; about the
+ * busiest a game gets, in terms of transitions.
+ */
+static uint64_t apu_frame_run(void)
+{
+  apu_write(&apu, 0x4010, 0x4e);
+  apu_write(&apu, 0x4012, 0x00);
+  apu_write(&apu, 0x4013, 0xff);
+  apu_write(&apu, 0x4015, 0x1f);
+
+  int16_t samples[APU_SAMPLE_RATE / 10];
+  for (int frame = 0; frame < APU_FRAMES; ++frame)
+  {
+    for (int quarter = 0; quarter < 4; ++quarter)
+    {
+      const int note = frame * 4 + quarter;
+      apu_run_until(&apu, cycle + quarter * APU_FRAME_CYCLES / 4);
+      apu_write(&apu, 0x4000, 0x80 | (note & 0x0f));
+      apu_write(&apu, 0x4002, 0x40 + (note * 37) % 0xc0);
+      apu_write(&apu, 0x4003, 0x08 | (note & 0x01));
+      apu_write(&apu, 0x4004, 0x5f);
+      apu_write(&apu, 0x4006, 0x20 + (note * 53) % 0xe0);
+      apu_write(&apu, 0x4007, 0x08);
+      apu_write(&apu, 0x4008, 0xff);
+      apu_write(&apu, 0x400a, 0x80 + (note * 29) % 0x80);
+      apu_write(&apu, 0x400b, 0x08);
+      apu_write(&apu, 0x400c, 0x3f);
+      apu_write(&apu, 0x400e, note % 0x10);
+      apu_write(&apu, 0x400f, 0x08);
+    }
+
+    cycle += APU_FRAME_CYCLES;
+    apu_end_frame(&apu, cycle);
+    blip_read_samples(&blip, samples, APU_SAMPLE_RATE / 10);
+  }
+
+  return APU_FRAMES;
+}
+
+static void apu_frame_teardown(void)
+{
+  destroy_blip_buffer(&blip);
+  memset(&blip, 0, sizeof blip);
+}
+
+const struct Workload apu_frame_workload = {"apu/frame", "frames", apu_frame_setup, apu_frame_run,
+                                            apu_frame_teardown};
@@ -0,0 +1,258 @@
+#include "baseline.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef NEPNES_GIT_SHA
+#define NEPNES_GIT_SHA "unknown"
+#endif
+
+/* Scale factor that turns a median absolute deviation into an estimate of
+ * the standard deviation, for normally distributed samples. */
+#define MAD_TO_SIGMA 1.4826
+/* Number of standard deviations a workload may be slower than its baseline
+ * before it is considered to have regressed. */
+#define REGRESSION_SIGMAS 3.0
+
+/*
+ * Returns the CPU model name as reported by the kernel, or "unknown".
+ */
+static const char *cpu_model(void)
+{
+  static char model[256] = "unknown";
+
+  FILE *fp;
+  if ((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+  {
+    return model;
+  }
+
+  char line[512];
+  while (fgets(line, sizeof line, fp) != NULL)
+  {
+    if (strncmp(line, "model name", 10) == 0)
+    {
+      const char *value = strchr(line, ':');
+      if (value != NULL)
+      {
+        value += strspn(value + 1, " \t") + 1;
+        snprintf(model, sizeof model, "%.*s", (int)strcspn(value, "\n"), value);
+      }
+      break;
+    }
+  }
+
+  fclose(fp);
+  return model;
+}
+
+/*
+ * Writes the given string as a JSON string literal.
+ */
+static void print_json_string(FILE *fp, const char *s)
+{
+  fputc('"', fp);
+  for (; *s; ++s)
+  {
+    if (*s == '"' || *s == '\\')
+    {
+      fprintf(fp, "\\%c", *s);
+    }
+    else if ((unsigned char)*s < 0x20)
+    {
+      fprintf(fp, "\\u%04x", *s);
+    }
+    else
+    {
+      fputc(*s, fp);
+    }
+  }
+  fputc('"', fp);
+}
+
+/*
+ * Writes the given results as JSON. The same format is used for baselines;
+ * every workload is written on a single line, which keeps `baseline_read`
+ * simple. Hardware counters are included in case `pc` is given.
+ */
+void baseline_print(FILE *fp, const struct Result *results, size_t n,
+                    const struct perf_counters *pc)
+{
+  char timestamp[32];
+  const time_t t = time(NULL);
+  strftime(timestamp, sizeof timestamp, "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+
+  fprintf(fp, "{\n  \"git_sha\": ");
+  print_json_string(fp, NEPNES_GIT_SHA);
+  fprintf(fp, ",\n  \"cpu_model\": ");
+  print_json_string(fp, cpu_model());
+  fprintf(fp, ",\n  \"timestamp\": \"%s\",\n  \"workloads\": [", timestamp);
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    const struct Result *r = &results[i];
+    fprintf(fp, "%s\n    {\"name\": ", i > 0 ? "," : "");
+    print_json_string(fp, r->workload->name);
+    fprintf(fp, ", \"unit\": ");
+    print_json_string(fp, r->workload->unit);
+    fprintf(fp,
+            ", \"operations\": %llu, \"runs\": %d, \"millions_per_second\": %.3f, "
+            "\"ns_per_op\": %.4f, \"mad_ns_per_op\": %.4f, \"samples\": [",
+            (unsigned long long)r->operations, r->runs, 1e3 / r->median, r->median, r->mad);
+    for (int j = 0; j < r->runs; ++j)
+    {
+      fprintf(fp, "%s%.4f", j > 0 ? ", " : "", r->ns_per_op[j]);
+    }
+    fprintf(fp, "]");
+
+    if (pc)
+    {
+      fprintf(fp, ", \"perf\": {\"ipc\": %.3f", perf_region_ipc(&r->perf));
+      for (int j = 0; j < PERF_COUNTER_COUNT; ++j)
+      {
+        if (perf_is_available(pc, j))
+        {
+          fprintf(fp, ", \"%s_per_op\": %.4f", perf_counter_name(j),
+                  perf_region_per_work(&r->perf, j));
+        }
+      }
+      fprintf(fp, "}");
+    }
+
+    fprintf(fp, "}");
+  }
+
+  fprintf(fp, "\n  ]\n}\n");
+}
+
+/*
+ * Reads the string value of the given key from a line of JSON into `value`.
+ * Returns 0 on success, or -1 in case the key is not found.
+ */
+static int read_string(const char *line, const char *key, char *value, size_t size)
+{
+  const char *p = strstr(line, key);
+  if (p == NULL || (p = strchr(p + strlen(key), '"')) == NULL)
+  {
+    return -1;
+  }
+
+  ++p;
+  const size_t length = strcspn(p, "\"");
+  snprintf(value, size, "%.*s", (int)length, p);
+  return 0;
+}
+
+/*
+ * Reads the numeric value of the given key from a line of JSON. Returns 0 on
+ * success, or -1 in case the key is not found.
+ */
+static int read_number(const char *line, const char *key, double *value)
+{
+  const char *p = strstr(line, key);
+  if (p == NULL || (p = strchr(p + strlen(key), ':')) == NULL)
+  {
+    return -1;
+  }
+
+  char *end;
+  *value = strtod(p + 1, &end);
+  return end == p + 1 ? -1 : 0;
+}
+
+/*
+ * Reads a baseline as written by `baseline_print`. Returns 0 on success, or -1
+ * in case the file can not be opened.
+ */
+int baseline_read(struct Baseline *baseline, const char *file_name)
+{
+  memset(baseline, 0, sizeof *baseline);
+
+  FILE *fp;
+  if ((fp = fopen(file_name, "r")) == NULL)
+  {
+    return -1;
+  }
+
+  char line[4096];
+  while (fgets(line, sizeof line, fp) != NULL)
+  {
+    if (strstr(line, "\"git_sha\"") != NULL)
+    {
+      read_string(line, "\"git_sha\"", baseline->git_sha, sizeof baseline->git_sha);
+      continue;
+    }
+
+    struct BaselineEntry entry;
+    if (baseline->size < sizeof baseline->entries / sizeof baseline->entries[0] &&
+        read_string(line, "\"name\"", entry.name, sizeof entry.name) == 0 &&
+        read_number(line, "\"ns_per_op\"", &entry.median) == 0 &&
+        read_number(line, "\"mad_ns_per_op\"", &entry.mad) == 0)
+    {
+      baseline->entries[baseline->size++] = entry;
+    }
+  }
+
+  fclose(fp);
+  return 0;
+}
+
+/*
+ * Compares the given results against a baseline, and prints a report to the
+ * given file pointer. A workload regresses when its median time per operation
+ * exceeds the baseline median by more than the noise of both measurements, but
+ * at least by `min_threshold` (a fraction). Returns whether any workload
+ * regressed.
+ */
+bool baseline_compare(const struct Baseline *baseline, const struct Result *results, size_t n,
+                      double min_threshold, FILE *fp)
+{
+  bool has_regressed = false;
+
+  fprintf(fp, "Comparing against baseline of revision %s\n", baseline->git_sha);
+  fprintf(fp, "%-16s %12s %12s %9s %10s\n", "workload", "baseline", "current", "change",
+          "threshold");
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    const struct Result *r = &results[i];
+
+    const struct BaselineEntry *entry = NULL;
+    for (size_t j = 0; j < baseline->size && entry == NULL; ++j)
+    {
+      if (strcmp(baseline->entries[j].name, r->workload->name) == 0)
+      {
+        entry = &baseline->entries[j];
+      }
+    }
+
+    if (entry == NULL || entry->median <= 0)
+    {
+      fprintf(fp, "%-16s %12s %9.3f ns %9s %10s  new\n", r->workload->name, "-", r->median, "-",
+              "-");
+      continue;
+    }
+
+    const double noise = REGRESSION_SIGMAS * MAD_TO_SIGMA * (entry->mad + r->mad) / entry->median;
+    const double threshold = fmax(min_threshold, noise);
+    const double change = (r->median - entry->median) / entry->median;
+
+    const char *verdict = "ok";
+    if (change > threshold)
+    {
+      verdict = "REGRESSED";
+      has_regressed = true;
+    }
+    else if (change < -threshold)
+    {
+      verdict = "improved";
+    }
+
+    fprintf(fp, "%-16s %9.3f ns %9.3f ns %+8.1f%% %9.1f%%  %s\n", r->workload->name,
+            entry->median, r->median, 100 * change, 100 * threshold, verdict);
+  }
+
+  return has_regressed;
+}
@@ -0,0 +1,33 @@
+#ifndef NEPNES_BENCH_BASELINE_H
+#define NEPNES_BENCH_BASELINE_H
+
+#include "bench.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Statistics of a single workload as stored in a baseline file.
+ */
+struct BaselineEntry
+{
+  char name[64];
+  double median;
+  double mad;
+};
+
+struct Baseline
+{
+  char git_sha[64];
+  struct BaselineEntry entries[64];
+  size_t size;
+};
+
+void baseline_print(FILE *fp, const struct Result *results, size_t n,
+                    const struct perf_counters *pc);
+int baseline_read(struct Baseline *baseline, const char *file_name);
+bool baseline_compare(const struct Baseline *baseline, const struct Result *results, size_t n,
+                      double min_threshold, FILE *fp);
+
+#endif
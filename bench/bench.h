@@ -0,0 +1,69 @@
+#ifndef NEPNES_BENCH_BENCH_H
+#define NEPNES_BENCH_BENCH_H
+
+#include <lib/std/include/perf.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A benchmark workload. Workloads are set up once, and then run one or more
+ * times; every run does the same fixed amount of work, such that results are
+ * comparable between runs and between builds.
+ */
+struct Workload
+{
+  const char *name;
+  /* Unit of the operations counted by `run`, e.g. "instructions". */
+  const char *unit;
+  /* Prepares the workload. Returns 0 on success, or -1 in case the workload
+   * can not run, for example because its input files are missing. */
+  int (*setup)(void);
+  /* Runs the workload once, returns the number of operations performed. */
+  uint64_t (*run)(void);
+  void (*teardown)(void);
+};
+
+/* Maximum number of measured runs per workload. */
+#define BENCH_MAX_RUNS 100
+
+/*
+ * Measurements of a single workload.
+ */
+struct Result
+{
+  const struct Workload *workload;
+  uint64_t operations; /* per run */
+  int runs;
+  double ns_per_op[BENCH_MAX_RUNS];
+  double median; /* ns per operation */
+  double mad;    /* median absolute deviation of ns per operation */
+  struct perf_region perf; /* hardware counters over all measured runs */
+};
+
+extern const struct Workload cpu_nestest_workload;
+extern const struct Workload cpu_alu_workload;
+extern const struct Workload cpu_memory_workload;
+extern const struct Workload cpu_branch_workload;
+extern const struct Workload disassemble_workload;
+extern const struct Workload read_zip_workload;
+extern const struct Workload flat_set_workload;
+extern const struct Workload hash_framebuffer_workload;
+extern const struct Workload ppu_frame_workload;
+extern const struct Workload ppu_frame_dot_workload;
+extern const struct Workload ppu_frame_skip_workload;
+extern const struct Workload palette_convert_workload;
+extern const struct Workload ntsc_frame_workload;
+extern const struct Workload ntsc_frame_threads_workload;
+extern const struct Workload scaler_nearest4x_workload;
+extern const struct Workload scaler_scale2x_workload;
+extern const struct Workload scaler_scale3x_workload;
+extern const struct Workload scaler_hq2x_workload;
+extern const struct Workload apu_frame_workload;
+extern const struct Workload resampler_frame_workload;
+extern const struct Workload resampler_frame_scalar_workload;
+
+/* Directory with test ROMs, relative to the root of the repository. */
+#define BENCH_ROMS_PATH "unittest/input/roms/"
+
+#endif
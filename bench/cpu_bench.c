@@ -0,0 +1,172 @@
+#include "bench.h"
+
+#include <lib/6502/include/cpu.h>
+#include <lib/nes/include/mapper.h>
+#include <lib/nes/include/rom.h>
+#include <lib/std/include/io.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of instructions nestest executes in automation mode before it starts
+ * testing APU registers, see log/nestest_no_ppu.log. */
+#define NESTEST_INSTRUCTIONS 8991
+/* Number of times nestest is run by a single run of the workload. */
+#define NESTEST_RUNS 500
+/* Number of instructions executed by a single run of a synthetic workload. */
+#define SYNTHETIC_INSTRUCTIONS 5000000
+
+static struct Cpu initial_cpu;
+static struct Cpu cpu;
+
+static int nestest_setup(void)
+{
+  uint8_t *rom_data;
+  size_t rom_size;
+  if (nn_read_all(BENCH_ROMS_PATH "nes-test-roms/other/nestest.nes", &rom_data, &rom_size) != 0)
+  {
+    return -1;
+  }
+
+  struct RomHeader header = rom_make_header(rom_data);
+  if (header.rom_format == RF_UNKNOWN)
+  {
+    free(rom_data);
+    return -1;
+  }
+
+  uint8_t *prg_data;
+  size_t prg_size;
+  rom_prg_data(&header, rom_data, &prg_data, &prg_size);
+
+  memset(&initial_cpu, 0, sizeof initial_cpu);
+  const int error = mapper_initialize_cpu(header.mapper, &initial_cpu, prg_data, prg_size);
+  free(rom_data);
+  if (error != 0)
+  {
+    return -1;
+  }
+
+  cpu_power_on(&initial_cpu);
+  initial_cpu.PC = 0xc000;
+
+  return 0;
+}
+
+static uint64_t nestest_run(void)
+{
+  for (int run = 0; run < NESTEST_RUNS; ++run)
+  {
+    cpu = initial_cpu;
+    for (int i = 0; i < NESTEST_INSTRUCTIONS; ++i)
+    {
+      cpu_execute_next_instruction(&cpu);
+    }
+  }
+  return (uint64_t)NESTEST_RUNS * NESTEST_INSTRUCTIONS;
+}
+
+static void cpu_teardown(void)
+{
+}
+
+/*
+ * Loads a synthetic program at $8000, which loops forever, and points the
+ * RESET vector to it.
+ */
+static void load_program(const uint8_t *program, size_t size)
+{
+  memset(&initial_cpu, 0, sizeof initial_cpu);
+  memcpy(initial_cpu.ram + 0x8000, program, size);
+  initial_cpu.ram[0xfffc] = 0x00;
+  initial_cpu.ram[0xfffd] = 0x80;
+  cpu_power_on(&initial_cpu);
+}
+
+static uint64_t synthetic_run(void)
+{
+  cpu = initial_cpu;
+  for (int i = 0; i < SYNTHETIC_INSTRUCTIONS; ++i)
+  {
+    cpu_execute_next_instruction(&cpu);
+  }
+  return SYNTHETIC_INSTRUCTIONS;
+}
+
+/* Arithmetic and logical operations on registers and the zero page. */
+static int alu_setup(void)
+{
+  static const uint8_t program[] = {
+      0x18,              // CLC
+      0xa9, 0x01,        // LDA #$01
+      0x65, 0x10,        // ADC $10
+      0x49, 0x5a,        // EOR #$5A
+      0x25, 0x11,        // AND $11
+      0x09, 0x03,        // ORA #$03
+      0xe9, 0x02,        // SBC #$02
+      0x85, 0x12,        // STA $12
+      0x0a,              // ASL A
+      0x6a,              // ROR A
+      0xe8,              // INX
+      0x88,              // DEY
+      0xc9, 0x40,        // CMP #$40
+      0xaa,              // TAX
+      0x98,              // TYA
+      0x4c, 0x00, 0x80,  // JMP $8000
+  };
+  load_program(program, sizeof program);
+  return 0;
+}
+
+/* Loads, stores and read-modify-write operations using indexed and indirect
+ * addressing. */
+static int memory_setup(void)
+{
+  static const uint8_t program[] = {
+      0xbd, 0x00, 0x02,  // LDA $0200,X
+      0x99, 0x00, 0x03,  // STA $0300,Y
+      0xb1, 0x20,        // LDA ($20),Y
+      0x91, 0x22,        // STA ($22),Y
+      0xe6, 0x30,        // INC $30
+      0xce, 0x00, 0x04,  // DEC $0400
+      0xb6, 0x31,        // LDX $31,Y
+      0xbc, 0x00, 0x05,  // LDY $0500,X
+      0xe8,              // INX
+      0xc8,              // INY
+      0x4c, 0x00, 0x80,  // JMP $8000
+  };
+  load_program(program, sizeof program);
+
+  /* Pointers to $0600 and $0700. */
+  initial_cpu.ram[0x20] = 0x00;
+  initial_cpu.ram[0x21] = 0x06;
+  initial_cpu.ram[0x22] = 0x00;
+  initial_cpu.ram[0x23] = 0x07;
+  return 0;
+}
+
+/* Branches, subroutine calls and stack operations. */
+static int branch_setup(void)
+{
+  static const uint8_t program[] = {
+      0xa2, 0x20,        // $8000: LDX #$20
+      0xca,              // $8002: DEX
+      0xd0, 0xfd,        // $8003: BNE $8002
+      0x20, 0x0b, 0x80,  // $8005: JSR $800B
+      0x4c, 0x00, 0x80,  // $8008: JMP $8000
+      0x48,              // $800B: PHA
+      0x68,              // $800C: PLA
+      0x60,              // $800D: RTS
+  };
+  load_program(program, sizeof program);
+  return 0;
+}
+
+const struct Workload cpu_nestest_workload = {"cpu/nestest", "instructions", nestest_setup,
+                                              nestest_run, cpu_teardown};
+const struct Workload cpu_alu_workload = {"cpu/alu", "instructions", alu_setup, synthetic_run,
+                                          cpu_teardown};
+const struct Workload cpu_memory_workload = {"cpu/memory", "instructions", memory_setup,
+                                             synthetic_run, cpu_teardown};
+const struct Workload cpu_branch_workload = {"cpu/branch", "instructions", branch_setup,
+                                             synthetic_run, cpu_teardown};
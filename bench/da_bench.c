@@ -0,0 +1,114 @@
+/* nftw(3) */
+#define _XOPEN_SOURCE 500
+
+#include "bench.h"
+
+#include <lib/6502/include/da.h>
+#include <lib/nes/include/rom.h>
+#include <lib/std/include/io.h>
+#include <lib/std/include/util.h>
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct Rom
+{
+  uint8_t *data;
+  uint8_t *prg_data;
+  size_t prg_size;
+};
+
+static struct Rom *roms;
+static size_t rom_count;
+static size_t rom_capacity;
+static FILE *null_fp;
+
+/*
+ * Loads every iNES ROM found while walking the ROM directory.
+ */
+static int load_rom(const char *path, const struct stat *sb, int type, struct FTW *ftw)
+{
+  if (type != FTW_F || !nn_ends_with(path, ".nes"))
+  {
+    return 0;
+  }
+
+  uint8_t *data;
+  size_t size;
+  if (nn_read_all(path, &data, &size) != 0)
+  {
+    return 0;
+  }
+
+  struct RomHeader header = rom_make_header(data);
+  if (header.rom_format == RF_UNKNOWN)
+  {
+    free(data);
+    return 0;
+  }
+
+  if (rom_count == rom_capacity)
+  {
+    rom_capacity = MAX(64, 2 * rom_capacity);
+    if ((roms = realloc(roms, rom_capacity * sizeof *roms)) == NULL)
+    {
+      nn_quit("Could not allocate %zu ROMs", rom_capacity);
+    }
+  }
+
+  struct Rom *rom = &roms[rom_count++];
+  rom->data = data;
+  rom_prg_data(&header, data, &rom->prg_data, &rom->prg_size);
+
+  return 0;
+}
+
+static int disassemble_setup(void)
+{
+  if (nftw(BENCH_ROMS_PATH, load_rom, 16, FTW_PHYS) != 0 || rom_count == 0)
+  {
+    return -1;
+  }
+
+  if ((null_fp = fopen("/dev/null", "w")) == NULL)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Disassembles the PRG data of all ROMs in the corpus.
+ */
+static uint64_t disassemble_run(void)
+{
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < rom_count; ++i)
+  {
+    nn_disassemble(null_fp, roms[i].prg_data, roms[i].prg_size);
+    bytes += roms[i].prg_size;
+  }
+  return bytes;
+}
+
+static void disassemble_teardown(void)
+{
+  for (size_t i = 0; i < rom_count; ++i)
+  {
+    free(roms[i].data);
+  }
+  free(roms);
+  roms = NULL;
+  rom_count = rom_capacity = 0;
+
+  if (null_fp)
+  {
+    fclose(null_fp);
+    null_fp = NULL;
+  }
+}
+
+const struct Workload disassemble_workload = {"da/disassemble", "bytes", disassemble_setup,
+                                              disassemble_run, disassemble_teardown};
@@ -0,0 +1,59 @@
+#include "bench.h"
+
+#include <lib/std/include/flat_set.h>
+
+#include <stdlib.h>
+
+/* Number of distinct values in the set. */
+#define FLAT_SET_VALUES 4096
+/* Number of operations performed by a single run of the workload. */
+#define FLAT_SET_OPERATIONS 2000000
+
+static struct flat_set set;
+
+static int flat_set_setup(void)
+{
+  set = make_flat_set(FLAT_SET_VALUES);
+  return 0;
+}
+
+/*
+ * Mixes inserts, lookups and removals of pseudo random values, the way the
+ * debugger manages breakpoints.
+ */
+static uint64_t flat_set_run(void)
+{
+  flat_set_clear(&set);
+
+  uint32_t x = 0x9e3779b9;
+  for (int i = 0; i < FLAT_SET_OPERATIONS; ++i)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    const int value = x % FLAT_SET_VALUES;
+    switch ((x >> 16) % 4)
+    {
+      case 0:
+        flat_set_insert(&set, value);
+        break;
+      case 1:
+        flat_set_remove(&set, value);
+        break;
+      default:
+        flat_set_contains(&set, value);
+        break;
+    }
+  }
+
+  return FLAT_SET_OPERATIONS;
+}
+
+static void flat_set_teardown(void)
+{
+  destroy_flat_set(&set);
+}
+
+const struct Workload flat_set_workload = {"std/flat_set", "operations", flat_set_setup,
+                                           flat_set_run, flat_set_teardown};
@@ -0,0 +1,45 @@
+#include "bench.h"
+
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/hash.h>
+
+/* Number of framebuffers hashed by a single run of the workload. */
+#define HASH_FRAMES 2000
+
+static uint16_t framebuffer[PPU_HEIGHT * PPU_WIDTH];
+
+static int hash_setup(void)
+{
+  uint32_t x = 0x9e3779b9;
+  for (size_t i = 0; i < sizeof framebuffer / sizeof framebuffer[0]; ++i)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    framebuffer[i] = x & 0x3f;
+  }
+  return 0;
+}
+
+/*
+ * Hashes a framebuffer over and over, as the headless runner does at the end
+ * of every frame.
+ */
+static uint64_t hash_run(void)
+{
+  uint64_t hash = 0;
+  for (int frame = 0; frame < HASH_FRAMES; ++frame)
+  {
+    framebuffer[frame % PPU_WIDTH] ^= hash & 1;
+    hash = nn_hash64(framebuffer, sizeof framebuffer);
+  }
+
+  return HASH_FRAMES;
+}
+
+static void hash_teardown(void)
+{
+}
+
+const struct Workload hash_framebuffer_workload = {"std/hash", "frames", hash_setup, hash_run,
+                                                   hash_teardown};
@@ -0,0 +1,92 @@
+#include "bench.h"
+
+#include <lib/std/include/io.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zip.h>
+
+/* Size of the file in the zip archive. */
+#define ZIP_DATA_SIZE (4 << 20)
+/* Number of times the archive is read by a single run of the workload. */
+#define ZIP_READS 8
+
+static char zip_file_name[] = "/tmp/nepnes_bench_XXXXXX.zip";
+
+/*
+ * Creates a zip archive holding a single, fairly compressible file, similar to
+ * a zipped ROM.
+ */
+static int read_zip_setup(void)
+{
+  int fd;
+  if ((fd = mkstemps(zip_file_name, 4)) == -1)
+  {
+    return -1;
+  }
+  close(fd);
+
+  uint8_t *data;
+  if ((data = malloc(ZIP_DATA_SIZE)) == NULL)
+  {
+    return -1;
+  }
+
+  /* Bytes with only a few bits of entropy, mixed with runs of zeroes. */
+  uint32_t x = 0x12345678;
+  for (size_t i = 0; i < ZIP_DATA_SIZE; ++i)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    data[i] = (i & 0x400) ? 0 : (x & 0x0f);
+  }
+
+  zip_t *zip;
+  zip_source_t *source;
+  if ((zip = zip_open(zip_file_name, ZIP_TRUNCATE, NULL)) == NULL)
+  {
+    free(data);
+    return -1;
+  }
+
+  if ((source = zip_source_buffer(zip, data, ZIP_DATA_SIZE, 0)) == NULL ||
+      zip_file_add(zip, "rom.nes", source, ZIP_FL_OVERWRITE) == -1)
+  {
+    zip_source_free(source);
+    zip_discard(zip);
+    free(data);
+    return -1;
+  }
+
+  const int error = zip_close(zip);
+  free(data);
+
+  return error == 0 ? 0 : -1;
+}
+
+static uint64_t read_zip_run(void)
+{
+  uint64_t bytes = 0;
+  for (int i = 0; i < ZIP_READS; ++i)
+  {
+    uint8_t *data;
+    size_t size;
+    if (nn_read_all(zip_file_name, &data, &size) == 0)
+    {
+      bytes += size;
+      free(data);
+    }
+  }
+  return bytes;
+}
+
+static void read_zip_teardown(void)
+{
+  unlink(zip_file_name);
+}
+
+const struct Workload read_zip_workload = {"io/read_zip", "bytes", read_zip_setup, read_zip_run,
+                                           read_zip_teardown};
@@ -0,0 +1,208 @@
+/* sched_setaffinity(2) */
+#define _GNU_SOURCE
+
+#include "baseline.h"
+#include "bench.h"
+#include "options.h"
+#include "stats.h"
+
+#include <lib/std/include/util.h>
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const struct Workload *workloads[] = {
+    &cpu_nestest_workload,        &cpu_alu_workload,                &cpu_memory_workload,
+    &cpu_branch_workload,         &ppu_frame_workload,              &ppu_frame_dot_workload,
+    &ppu_frame_skip_workload,     &palette_convert_workload,        &ntsc_frame_workload,
+    &ntsc_frame_threads_workload, &scaler_nearest4x_workload,       &scaler_scale2x_workload,
+    &scaler_scale3x_workload,     &scaler_hq2x_workload,            &apu_frame_workload,
+    &resampler_frame_workload,    &resampler_frame_scalar_workload, &disassemble_workload,
+    &read_zip_workload,           &flat_set_workload,               &hash_framebuffer_workload,
+};
+
+#define WORKLOAD_COUNT (sizeof workloads / sizeof workloads[0])
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Runs the given workload; first a number of warm up runs, to settle caches,
+ * branch predictors and the CPU frequency, then the measured runs.
+ */
+static void run_workload(const struct Workload *workload, const struct Options *options,
+                         const struct perf_counters *pc, struct Result *result)
+{
+  result->workload = workload;
+  result->runs = options->runs;
+  result->perf = make_perf_region(workload->name);
+
+  for (int i = 0; i < options->warmup_runs; ++i)
+  {
+    workload->run();
+  }
+
+  for (int i = 0; i < options->runs; ++i)
+  {
+    if (pc)
+    {
+      perf_region_begin(pc, &result->perf);
+    }
+
+    const double start = now();
+    result->operations = workload->run();
+    result->ns_per_op[i] = 1e9 * (now() - start) / result->operations;
+
+    if (pc)
+    {
+      perf_region_end(pc, &result->perf, result->operations);
+    }
+  }
+
+  result->median = stats_median(result->ns_per_op, result->runs);
+  result->mad = stats_mad(result->ns_per_op, result->runs, result->median);
+}
+
+static char *baseline_path(const struct Options *options, const char *name)
+{
+  char *dir = nn_strcat(options->baseline_dir, "/");
+  char *file_name = nn_strcat(name, ".json");
+  char *path = nn_strcat(dir, file_name);
+  free(dir);
+  free(file_name);
+  return path;
+}
+
+static void write_results(const char *file_name, const struct Result *results, size_t n,
+                          const struct perf_counters *pc)
+{
+  FILE *fp;
+  if ((fp = fopen(file_name, "w")) == NULL)
+  {
+    nn_quit_strerror("Could not create output file '%s'", file_name);
+  }
+
+  baseline_print(fp, results, n, pc);
+
+  if (fclose(fp) != 0)
+  {
+    nn_quit_strerror("Could not write output file '%s'", file_name);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  struct Options options = {0};
+  parse_options(&options, argc, argv);
+
+  if (options.list_workloads)
+  {
+    for (size_t i = 0; i < WORKLOAD_COUNT; ++i)
+    {
+      printf("%s (%s)\n", workloads[i]->name, workloads[i]->unit);
+    }
+    exit(0);
+  }
+
+  /* Read the baseline up front, so that a typo does not waste a full run. */
+  struct Baseline baseline;
+  if (options.compare_baseline)
+  {
+    char *path = baseline_path(&options, options.compare_baseline);
+    if (baseline_read(&baseline, path) != 0)
+    {
+      nn_quit_strerror("Could not read baseline '%s'", path);
+    }
+    free(path);
+  }
+
+  if (options.cpu >= 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(options.cpu, &set);
+    if (sched_setaffinity(0, sizeof set, &set) != 0)
+    {
+      nn_quit_strerror("Could not pin the benchmark to CPU %d", options.cpu);
+    }
+  }
+
+  /* Counters are opened after pinning, they count the calling thread only. */
+  struct perf_counters perf_counters;
+  struct perf_counters *pc = NULL;
+  if (options.count_events)
+  {
+    if (perf_open(&perf_counters) != 0)
+    {
+      nn_quit_strerror("Could not open hardware performance counters");
+    }
+    pc = &perf_counters;
+  }
+
+  static struct Result results[WORKLOAD_COUNT];
+  size_t n = 0;
+
+  for (size_t i = 0; i < WORKLOAD_COUNT; ++i)
+  {
+    const struct Workload *workload = workloads[i];
+    if (options.filter && strstr(workload->name, options.filter) == NULL)
+    {
+      continue;
+    }
+
+    if (workload->setup() != 0)
+    {
+      fprintf(stderr, "Skipping workload '%s', could not set it up\n", workload->name);
+      continue;
+    }
+
+    struct Result *result = &results[n++];
+    run_workload(workload, &options, pc, result);
+
+    workload->teardown();
+
+    fprintf(stderr, "%-16s %10.3f M %s/s %10.3f ns/op (MAD %.3f)\n", workload->name,
+            1e3 / result->median, workload->unit, result->median, result->mad);
+    if (pc)
+    {
+      perf_region_print(stderr, pc, &result->perf, "op");
+    }
+  }
+
+  if (options.output_file_name)
+  {
+    write_results(options.output_file_name, results, n, pc);
+  }
+  else
+  {
+    baseline_print(stdout, results, n, pc);
+  }
+
+  if (options.save_baseline)
+  {
+    if (nn_mkdirs(options.baseline_dir, 0755) != 0)
+    {
+      nn_quit_strerror("Could not create baseline directory '%s'", options.baseline_dir);
+    }
+
+    char *path = baseline_path(&options, options.save_baseline);
+    write_results(path, results, n, pc);
+    fprintf(stderr, "Stored baseline '%s'\n", path);
+    free(path);
+  }
+
+  if (options.compare_baseline &&
+      baseline_compare(&baseline, results, n, options.threshold, stderr))
+  {
+    exit(1);
+  }
+
+  exit(0);
+}
@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include <lib/nes/include/ntsc.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/thread_pool.h>
+
+#include <stdlib.h>
+
+/* Number of frames filtered by a single run of the workload. */
+#define NTSC_FRAMES 100
+
+static struct NtscFilter ntsc;
+static struct thread_pool pool;
+static uint16_t *pixels;
+static uint32_t *out;
+
+/*
+ * Prepares the filter, and a framebuffer of random pixels. The filter runs on
+ * a thread pool that occupies all CPUs, or on the calling thread only.
+ */
+static int ntsc_setup(int workers)
+{
+  if (thread_pool_init(&pool, workers) != 0)
+  {
+    return -1;
+  }
+  ntsc_init(&ntsc, PIXEL_FORMAT_RGBA, workers > 0 ? &pool : NULL);
+
+  pixels = malloc(PPU_WIDTH * PPU_HEIGHT * sizeof *pixels);
+  out = malloc(PPU_WIDTH * PPU_HEIGHT * sizeof *out);
+  if (pixels == NULL || out == NULL)
+  {
+    return -1;
+  }
+
+  uint32_t x = 0x9e3779b9;
+  for (int i = 0; i < PPU_WIDTH * PPU_HEIGHT; ++i)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pixels[i] = x & PPU_PIXEL_MASK;
+  }
+  return 0;
+}
+
+static int ntsc_frame_setup(void)
+{
+  return ntsc_setup(0);
+}
+
+static int ntsc_frame_threads_setup(void)
+{
+  return ntsc_setup(thread_pool_default_size());
+}
+
+/*
+ * Filters a framebuffer of random pixels, with the widest instruction set the
+ * CPU supports.
+ */
+static uint64_t ntsc_frame_run(void)
+{
+  for (int frame = 0; frame < NTSC_FRAMES; ++frame)
+  {
+    ntsc_filter(&ntsc, pixels, frame, out);
+  }
+
+  return NTSC_FRAMES;
+}
+
+static void ntsc_frame_teardown(void)
+{
+  ntsc_destroy(&ntsc);
+  thread_pool_destroy(&pool);
+  free(pixels);
+  free(out);
+}
+
+const struct Workload ntsc_frame_workload = {"ntsc/frame", "frames", ntsc_frame_setup,
+                                             ntsc_frame_run, ntsc_frame_teardown};
+
+const struct Workload ntsc_frame_threads_workload = {"ntsc/frame_threads", "frames",
+                                                     ntsc_frame_threads_setup, ntsc_frame_run,
+                                                     ntsc_frame_teardown};
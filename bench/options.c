@@ -0,0 +1,127 @@
+#include "options.h"
+#include "bench.h"
+
+#include <lib/std/include/util.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_usage()
+{
+  printf(
+      "Usage: nepnes_bench [-o|--output FILE] [-f|--filter PATTERN] [-l|--list] "
+      "[-r|--runs N] [-w|--warmup N] [-c|--cpu CPU] [-p|--perf] [-d|--baseline-dir DIR] "
+      "[-s|--save NAME] [-b|--compare NAME] [-t|--threshold PERCENT] [-h|--help]\n");
+}
+
+static void print_help()
+{
+  printf("nepnes_bench - runs benchmark workloads, and reports the results as JSON\n\n");
+  print_usage();
+  printf("\n");
+  printf("\t-o FILE        : writes results to FILE, by default writes to standard output\n");
+  printf("\t-f PATTERN     : only runs workloads with PATTERN in their name\n");
+  printf("\t-l | --list    : lists all workloads\n");
+  printf("\t-r N           : number of measured runs per workload, default 5\n");
+  printf("\t-w N           : number of warm up runs per workload, default 1\n");
+  printf("\t-c CPU         : pins the benchmark to the given CPU\n");
+  printf(
+      "\t-p | --perf    : counts hardware events, and reports IPC, branch and cache misses "
+      "per operation\n");
+  printf("\t-d DIR         : directory that holds baselines, default .bench-baselines\n");
+  printf("\t-s NAME        : stores the results as baseline NAME\n");
+  printf(
+      "\t-b NAME        : compares the results against baseline NAME, and exits with a "
+      "non-zero status in case a workload regressed\n");
+  printf(
+      "\t-t PERCENT     : minimum slowdown that counts as a regression, regardless of "
+      "noise, default 2\n");
+  printf("\t-h | --help    : shows this help message\n");
+  printf("\nRun from the root of the repository, such that test ROMs can be found.\n");
+}
+
+void parse_options(struct Options *options, int argc, char **argv)
+{
+  struct option opts[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"output", required_argument, NULL, 'o'},
+      {"filter", required_argument, NULL, 'f'},
+      {"list", no_argument, NULL, 'l'},
+      {"runs", required_argument, NULL, 'r'},
+      {"warmup", required_argument, NULL, 'w'},
+      {"cpu", required_argument, NULL, 'c'},
+      {"perf", no_argument, NULL, 'p'},
+      {"baseline-dir", required_argument, NULL, 'd'},
+      {"save", required_argument, NULL, 's'},
+      {"compare", required_argument, NULL, 'b'},
+      {"threshold", required_argument, NULL, 't'},
+      {0, 0, 0, 0},
+  };
+
+  options->runs = 5;
+  options->warmup_runs = 1;
+  options->cpu = -1;
+  options->baseline_dir = ".bench-baselines";
+  options->threshold = 0.02;
+
+  int option_index = 0;
+  char ch;
+  while ((ch = getopt_long(argc, argv, "ho:f:lr:w:c:pd:s:b:t:", opts, &option_index)) != -1)
+  {
+    switch (ch)
+    {
+      case 'h':
+        print_help();
+        exit(1);
+        break;
+      case 'o':
+        options->output_file_name = strdup(optarg);
+        break;
+      case 'f':
+        options->filter = strdup(optarg);
+        break;
+      case 'l':
+        options->list_workloads = true;
+        break;
+      case 'r':
+        options->runs = atoi(optarg);
+        break;
+      case 'w':
+        options->warmup_runs = atoi(optarg);
+        break;
+      case 'c':
+        options->cpu = atoi(optarg);
+        break;
+      case 'p':
+        options->count_events = true;
+        break;
+      case 'd':
+        options->baseline_dir = strdup(optarg);
+        break;
+      case 's':
+        options->save_baseline = strdup(optarg);
+        break;
+      case 'b':
+        options->compare_baseline = strdup(optarg);
+        break;
+      case 't':
+        options->threshold = atof(optarg) / 100;
+        break;
+      default:
+        print_usage();
+        exit(1);
+        break;
+    }
+  }
+
+  if (options->runs < 1 || options->runs > BENCH_MAX_RUNS)
+  {
+    nn_quit("The number of runs should be between 1 and %d", BENCH_MAX_RUNS);
+  }
+  if (options->warmup_runs < 0)
+  {
+    nn_quit("The number of warm up runs can not be negative");
+  }
+}
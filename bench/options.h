@@ -0,0 +1,25 @@
+#ifndef NEPNES_BENCH_OPTIONS_H
+#define NEPNES_BENCH_OPTIONS_H
+
+#include <stdbool.h>
+
+struct Options
+{
+  char *output_file_name;
+  char *filter;
+  bool list_workloads;
+
+  int runs;
+  int warmup_runs;
+  int cpu; /* CPU to pin to, or -1 */
+  bool count_events;
+
+  char *baseline_dir;
+  char *save_baseline;
+  char *compare_baseline;
+  double threshold; /* minimum regression threshold, as a fraction */
+};
+
+void parse_options(struct Options *options, int argc, char **argv);
+
+#endif
@@ -0,0 +1,59 @@
+#include "bench.h"
+
+#include <lib/nes/include/palette.h>
+#include <lib/nes/include/ppu.h>
+
+#include <stdlib.h>
+
+/* Number of frames converted by a single run of the workload. */
+#define PALETTE_FRAMES 1000
+
+static struct Palette palette;
+static uint16_t *pixels;
+static uint32_t *out;
+
+static int palette_convert_setup(void)
+{
+  palette_init(&palette, PIXEL_FORMAT_RGBA);
+
+  pixels = malloc(PPU_WIDTH * PPU_HEIGHT * sizeof *pixels);
+  out = malloc(PPU_WIDTH * PPU_HEIGHT * sizeof *out);
+  if (pixels == NULL || out == NULL)
+  {
+    return -1;
+  }
+
+  uint32_t x = 0x9e3779b9;
+  for (int i = 0; i < PPU_WIDTH * PPU_HEIGHT; ++i)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pixels[i] = x & PPU_PIXEL_MASK;
+  }
+  return 0;
+}
+
+/*
+ * Converts a framebuffer of random pixels to RGBA, with the widest instruction
+ * set the CPU supports.
+ */
+static uint64_t palette_convert_run(void)
+{
+  for (int frame = 0; frame < PALETTE_FRAMES; ++frame)
+  {
+    palette_convert(&palette, pixels, out, PPU_WIDTH * PPU_HEIGHT);
+  }
+
+  return PALETTE_FRAMES;
+}
+
+static void palette_convert_teardown(void)
+{
+  free(pixels);
+  free(out);
+}
+
+const struct Workload palette_convert_workload = {"palette/convert", "frames",
+                                                  palette_convert_setup, palette_convert_run,
+                                                  palette_convert_teardown};
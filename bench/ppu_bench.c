@@ -0,0 +1,89 @@
+#include "bench.h"
+
+#include <lib/nes/include/ppu.h>
+
+#include <string.h>
+
+/* Number of frames rendered by a single run of the workload. */
+#define PPU_FRAMES 600
+
+static struct Ppu ppu;
+
+/*
+ * Fills the pattern tables, nametables and OAM with pseudo random data, and
+ * spreads the sprites over the screen such that most scanlines have a few of
+ * them, and some more than eight.
+ */
+static int ppu_frame_setup(void)
+{
+  memset(&ppu, 0, sizeof ppu);
+  ppu_power_on(&ppu, MIRRORING_VERTICAL);
+
+  uint32_t x = 0x9e3779b9;
+  uint8_t *memories[] = {ppu.chr, ppu.nametables, ppu.palette, ppu.oam};
+  const size_t sizes[] = {sizeof ppu.chr, sizeof ppu.nametables, sizeof ppu.palette,
+                          sizeof ppu.oam};
+  for (int m = 0; m < 4; ++m)
+  {
+    for (size_t i = 0; i < sizes[m]; ++i)
+    {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      memories[m][i] = x >> 24;
+    }
+  }
+  for (int i = 0; i < 32; ++i)
+  {
+    ppu.palette[i] &= 0x3f;
+  }
+  for (int i = 0; i < 64; ++i)
+  {
+    ppu.oam[i * 4] = (i * 37) % PPU_HEIGHT;
+  }
+
+  ppu.ctrl = PPUCTRL_BACKGROUND_TABLE;
+  ppu.mask = PPUMASK_RENDERING | PPUMASK_BACKGROUND_LEFT | PPUMASK_SPRITES_LEFT;
+  return 0;
+}
+
+static int ppu_frame_dot_setup(void)
+{
+  ppu_frame_setup();
+  ppu_set_accuracy(&ppu, PPU_ACCURACY_DOT);
+  return 0;
+}
+
+static int ppu_frame_skip_setup(void)
+{
+  ppu_frame_setup();
+  ppu.skip_render = true;
+  return 0;
+}
+
+/*
+ * Renders frames with background and sprites enabled, without any CPU
+ * involvement; measures the renderer on its own.
+ */
+static uint64_t ppu_frame_run(void)
+{
+  for (int frame = 0; frame < PPU_FRAMES; ++frame)
+  {
+    ppu.status = 0;
+    ppu_run_until(&ppu, ppu_next_vblank(&ppu));
+  }
+
+  return PPU_FRAMES;
+}
+
+static void ppu_frame_teardown(void)
+{
+  ppu_power_off(&ppu);
+}
+
+const struct Workload ppu_frame_workload = {"ppu/frame", "frames", ppu_frame_setup,
+                                            ppu_frame_run, ppu_frame_teardown};
+const struct Workload ppu_frame_dot_workload = {"ppu/frame_dot", "frames", ppu_frame_dot_setup,
+                                                ppu_frame_run, ppu_frame_teardown};
+const struct Workload ppu_frame_skip_workload = {"ppu/frame_skip", "frames", ppu_frame_skip_setup,
+                                                 ppu_frame_run, ppu_frame_teardown};
@@ -0,0 +1,73 @@
+#include "bench.h"
+
+#include <lib/std/include/resampler.h>
+#include <lib/std/include/simd.h>
+
+#include <string.h>
+
+/* Number of frames resampled by a single run of the workload. */
+#define RESAMPLER_FRAMES 600
+
+/* Input rate, and samples per frame of the input at 60 frames per second. */
+#define RESAMPLER_INPUT_RATE 96000
+#define RESAMPLER_FRAME_SAMPLES (RESAMPLER_INPUT_RATE / 60)
+
+/* Output rate; 44.1 kHz needs the most phases of the common rates. */
+#define RESAMPLER_OUTPUT_RATE 44100
+
+static struct resampler resampler;
+static int16_t in[RESAMPLER_FRAME_SAMPLES];
+static int16_t out[RESAMPLER_FRAME_SAMPLES];
+
+/*
+ * Makes a resampler from the rate at which the APU is synthesized to 44.1 kHz,
+ * and a frame of pseudo random input.
+ */
+static int resampler_frame_setup(void)
+{
+  uint32_t x = 0x9e3779b9;
+  for (int i = 0; i < RESAMPLER_FRAME_SAMPLES; ++i)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    in[i] = (int16_t)(x >> 16) / 4;
+  }
+
+  resampler = make_resampler(RESAMPLER_INPUT_RATE, RESAMPLER_OUTPUT_RATE);
+  return 0;
+}
+
+static int resampler_frame_scalar_setup(void)
+{
+  simd_limit(SIMD_SCALAR);
+  return resampler_frame_setup();
+}
+
+/*
+ * Resamples a frame of input at a time, as the audio sinks do.
+ */
+static uint64_t resampler_frame_run(void)
+{
+  for (int frame = 0; frame < RESAMPLER_FRAMES; ++frame)
+  {
+    resampler_write(&resampler, in, RESAMPLER_FRAME_SAMPLES);
+    resampler_read(&resampler, out, RESAMPLER_FRAME_SAMPLES);
+  }
+
+  return RESAMPLER_FRAMES;
+}
+
+static void resampler_frame_teardown(void)
+{
+  simd_limit(SIMD_AVX2);
+  destroy_resampler(&resampler);
+  memset(&resampler, 0, sizeof resampler);
+}
+
+const struct Workload resampler_frame_workload = {"resampler/frame", "frames",
+                                                  resampler_frame_setup, resampler_frame_run,
+                                                  resampler_frame_teardown};
+const struct Workload resampler_frame_scalar_workload = {
+    "resampler/frame_scalar", "frames", resampler_frame_scalar_setup, resampler_frame_run,
+    resampler_frame_teardown};
@@ -0,0 +1,114 @@
+#include "bench.h"
+
+#include <lib/nes/include/palette.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/scaler.h>
+#include <lib/std/include/thread_pool.h>
+
+#include <stdlib.h>
+
+/* Number of frames scaled by a single run of the workload. */
+#define SCALER_FRAMES 20
+
+static struct thread_pool pool;
+static enum scaler scaler;
+static uint32_t *pixels;
+static uint32_t *out;
+
+/*
+ * Prepares a frame of palette colors in runs of random length, which has
+ * edges like pixel art, and a thread pool that occupies all CPUs.
+ */
+static int scaler_setup(enum scaler setup_scaler)
+{
+  scaler = setup_scaler;
+  if (thread_pool_init(&pool, thread_pool_default_size()) != 0)
+  {
+    return -1;
+  }
+
+  const int factor = scaler_factor(scaler);
+  uint16_t *framebuffer = malloc(PPU_WIDTH * PPU_HEIGHT * sizeof *framebuffer);
+  pixels = malloc(PPU_WIDTH * PPU_HEIGHT * sizeof *pixels);
+  out = malloc(PPU_WIDTH * PPU_HEIGHT * factor * factor * sizeof *out);
+  if (framebuffer == NULL || pixels == NULL || out == NULL)
+  {
+    free(framebuffer);
+    return -1;
+  }
+
+  uint32_t x = 0x9e3779b9;
+  uint16_t pixel = 0;
+  for (int i = 0; i < PPU_WIDTH * PPU_HEIGHT; ++i)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    if (x % 8 == 0)
+    {
+      pixel = (x >> 8) & 0x3f;
+    }
+    framebuffer[i] = pixel;
+  }
+
+  struct Palette palette;
+  palette_init(&palette, PIXEL_FORMAT_RGBA);
+  palette_convert(&palette, framebuffer, pixels, PPU_WIDTH * PPU_HEIGHT);
+  free(framebuffer);
+  return 0;
+}
+
+static int scaler_nearest4x_setup(void)
+{
+  return scaler_setup(SCALER_NEAREST4X);
+}
+
+static int scaler_scale2x_setup(void)
+{
+  return scaler_setup(SCALER_SCALE2X);
+}
+
+static int scaler_scale3x_setup(void)
+{
+  return scaler_setup(SCALER_SCALE3X);
+}
+
+static int scaler_hq2x_setup(void)
+{
+  return scaler_setup(SCALER_HQ2X);
+}
+
+/*
+ * Scales the frame, in bands of rows on the thread pool, with the widest
+ * instruction set the CPU supports.
+ */
+static uint64_t scaler_frame_run(void)
+{
+  const int factor = scaler_factor(scaler);
+  for (int frame = 0; frame < SCALER_FRAMES; ++frame)
+  {
+    scaler_run(scaler, pixels, PPU_WIDTH, PPU_WIDTH, PPU_HEIGHT, out, PPU_WIDTH * factor, &pool);
+  }
+
+  return SCALER_FRAMES;
+}
+
+static void scaler_teardown(void)
+{
+  thread_pool_destroy(&pool);
+  free(pixels);
+  free(out);
+}
+
+const struct Workload scaler_nearest4x_workload = {"scaler/nearest4x", "frames",
+                                                   scaler_nearest4x_setup, scaler_frame_run,
+                                                   scaler_teardown};
+
+const struct Workload scaler_scale2x_workload = {"scaler/scale2x", "frames", scaler_scale2x_setup,
+                                                 scaler_frame_run, scaler_teardown};
+
+const struct Workload scaler_scale3x_workload = {"scaler/scale3x", "frames", scaler_scale3x_setup,
+                                                 scaler_frame_run, scaler_teardown};
+
+const struct Workload scaler_hq2x_workload = {"scaler/hq2x", "frames", scaler_hq2x_setup,
+                                              scaler_frame_run, scaler_teardown};
@@ -0,0 +1,50 @@
+#include "stats.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int compare_doubles(const void *a, const void *b)
+{
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Returns the median of the given samples. Unlike the mean, the median is not
+ * skewed by the occasional run that got preempted.
+ */
+double stats_median(const double *x, size_t n)
+{
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  double sorted[n];
+  memcpy(sorted, x, n * sizeof *x);
+  qsort(sorted, n, sizeof *sorted, compare_doubles);
+
+  return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+/*
+ * Returns the median absolute deviation of the given samples from their
+ * median, a measure of noise that is robust against outliers.
+ */
+double stats_mad(const double *x, size_t n, double median)
+{
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  double deviations[n];
+  for (size_t i = 0; i < n; ++i)
+  {
+    deviations[i] = fabs(x[i] - median);
+  }
+
+  return stats_median(deviations, n);
+}
@@ -0,0 +1,9 @@
+#ifndef NEPNES_BENCH_STATS_H
+#define NEPNES_BENCH_STATS_H
+
+#include <stddef.h>
+
+double stats_median(const double *x, size_t n);
+double stats_mad(const double *x, size_t n, double median);
+
+#endif
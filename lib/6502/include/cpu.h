@@ -1,6 +1,7 @@
 #ifndef NEPNES_6502_CPU_H
 #define NEPNES_6502_CPU_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -11,7 +12,9 @@
  * the PAL NES, the CPU and APU are contained within the RP2A07 chip.
  */
 
+#define CPU_ADDRESS_NMI_VECTOR 0xfffa
 #define CPU_ADDRESS_RESET_VECTOR 0xfffc
+#define CPU_ADDRESS_IRQ_VECTOR 0xfffe
 #define CPU_ADDRESS_MAX 0xffff
 
 /*
@@ -50,6 +53,30 @@ enum FlagsBit
 
 typedef uint16_t Address;
 
+struct Instruction;
+struct Profiler;
+
+/*
+ * Memory mapped I/O devices in the address range [begin, end]. Before an
+ * instruction reads its operand from this range, the value is fetched from the
+ * device into memory; after an instruction writes its operand to this range,
+ * the written value is passed to the device. Instruction fetches and stack
+ * operations never reach the devices.
+ *
+ * Both happen outside of the instruction, hence `cycle` holds the CPU cycle at
+ * which the instruction accesses its operand, its last cycle (not counting
+ * page crossings), so that devices can time the access.
+ */
+struct CpuIo
+{
+  Address begin;
+  Address end;
+  uint64_t cycle;
+  void *context;
+  uint8_t (*read)(void *context, Address address);
+  void (*write)(void *context, Address address, uint8_t value);
+};
+
 /*
  * Representation of the 6502 CPU.
  */
@@ -64,7 +91,11 @@ struct Cpu
 
   uint8_t ram[CPU_ADDRESS_MAX + 1];
 
-  unsigned cycle; /* Number of cycles elapsed since execution */
+  uint64_t cycle; /* Number of cycles elapsed since execution */
+  bool jammed;    /* Halted by a JAM opcode, until power on or reset */
+
+  struct Profiler *profiler; /* Optional, collects execution statistics */
+  struct CpuIo *io;          /* Optional, memory mapped I/O devices */
 };
 
 uint8_t cpu_read_8b(struct Cpu *cpu, Address a);
@@ -85,9 +116,13 @@ uint8_t cpu_make_zero_page_y_offset(struct Cpu *cpu, uint8_t offset);
 uint8_t cpu_read_zero_page_y(struct Cpu *cpu, uint8_t offset);
 
 int cpu_page_cross(Address address, uint8_t offset);
+Address cpu_effective_address(struct Cpu *cpu, const struct Instruction *ins);
 
 void cpu_execute_next_instruction(struct Cpu *cpu);
 
+void cpu_nmi(struct Cpu *cpu);
+bool cpu_irq(struct Cpu *cpu);
+
 void cpu_power_on(struct Cpu *cpu);
 void cpu_reset(struct Cpu *cpu);
 
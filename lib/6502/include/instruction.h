@@ -241,6 +241,9 @@ size_t instruction_size(uint8_t opcode);
 Encoding instruction_read_encoding(const uint8_t *buf, int bytes);
 uint8_t *advance_instruction(uint8_t *pc, int n);
 uint8_t *next_instruction(uint8_t *pc);
+bool instruction_accesses_memory(const struct Instruction *ins);
+bool instruction_reads_memory(const struct Instruction *ins);
+bool instruction_writes_memory(const struct Instruction *ins);
 
 /*
  * Size of the buffer that holds the textual representation of an instruction.
@@ -258,6 +261,7 @@ enum InstructionLayout
 
 struct Cpu;
 
+const char *instruction_mnemonic(const struct Instruction *ins);
 const char *instruction_print(struct Instruction *ins, Encoding encoding);
 const char *instruction_print_layout(struct Instruction *ins, Encoding encoding,
                                      enum InstructionLayout layout, struct Cpu *cpu);
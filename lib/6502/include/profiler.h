@@ -0,0 +1,94 @@
+#ifndef NEPNES_6502_PROFILER_H
+#define NEPNES_6502_PROFILER_H
+
+#include <lib/6502/include/cpu.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * The profiler counts the number of executions and the number of cycles spent
+ * per instruction address, and per opcode. Addresses are qualified by the bank
+ * that is mapped in at the time the instruction is executed, so that code in
+ * different PRG banks that shares a CPU address is counted separately.
+ *
+ * Counters are stored in flat arrays indexed by (bank, address), so recording
+ * an instruction never requires a lookup. On top of that, the profiler follows
+ * JSR/RTS (and RTI) using a shadow stack to attribute cycles to call stacks,
+ * which can be exported in the folded stack format understood by flamegraph
+ * tools.
+ */
+
+enum
+{
+  PROFILER_PAGE_SIZE = 0x1000, /* granularity of the bank mapping */
+  PROFILER_PAGES = 16,         /* number of pages in the CPU address space */
+  PROFILER_MAX_DEPTH = 128,    /* JSR pushes two bytes on a 256 byte stack */
+};
+
+/*
+ * A node in the call tree; represents a single call stack, identified by the
+ * routine that was called and the node of the calling stack.
+ */
+struct ProfilerNode
+{
+  Address routine;
+  uint8_t bank;
+
+  uint32_t parent;
+  uint32_t first_child;
+  uint32_t next_sibling;
+
+  uint64_t calls;
+  uint64_t cycles; /* cycles spent in this routine itself, excluding callees */
+};
+
+struct ProfilerFrame
+{
+  uint32_t node;
+  uint8_t S; /* stack pointer right after the JSR pushed its return address */
+};
+
+struct Profiler
+{
+  int banks;
+
+  /* Maps each 4KB page of the CPU address space to the bank mapped in. */
+  uint8_t page_bank[PROFILER_PAGES];
+
+  /* Per (bank, address) counters, `banks` * 64KB entries each. */
+  uint64_t *executions;
+  uint64_t *cycles;
+
+  /* Per opcode counters. */
+  uint64_t opcode_executions[256];
+  uint64_t opcode_cycles[256];
+
+  /* Call tree; node 0 is the root, which represents code that is not called
+   * by any (known) JSR. */
+  struct ProfilerNode *nodes;
+  size_t nodes_size;
+  size_t nodes_capacity;
+
+  /* Shadow stack of active calls. */
+  struct ProfilerFrame stack[PROFILER_MAX_DEPTH];
+  int depth;
+};
+
+struct Profiler make_profiler(int banks);
+void destroy_profiler(struct Profiler *profiler);
+
+void profiler_clear(struct Profiler *profiler);
+void profiler_map_bank(struct Profiler *profiler, Address address, size_t size, uint8_t bank);
+
+void profiler_record(struct Profiler *profiler, const struct Cpu *cpu, Address pc, uint8_t opcode,
+                     unsigned cycles);
+void profiler_call(struct Profiler *profiler, Address routine, uint8_t S);
+void profiler_return(struct Profiler *profiler, uint8_t S);
+
+int profiler_write_report(const struct Profiler *profiler, FILE *fp, const struct Cpu *cpu,
+                          size_t max_entries);
+int profiler_write_folded(const struct Profiler *profiler, FILE *fp);
+
+#endif
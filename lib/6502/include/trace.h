@@ -0,0 +1,176 @@
+#ifndef NEPNES_6502_TRACE_H
+#define NEPNES_6502_TRACE_H
+
+#include <lib/6502/include/cpu.h>
+#include <lib/std/include/ring_buffer.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * An instruction trace is a sequence of binary trace records, one for every
+ * executed instruction. A record holds the CPU state right before the
+ * instruction is executed, and enough information about the memory operand to
+ * reproduce the Nintendulator log format offline, thus without having to
+ * format text while emulating.
+ */
+struct TraceRecord
+{
+  uint64_t cycle;
+  Address PC;
+  Address address;   /* effective address of the memory operand, or the jump
+                        target in case of an indirect JMP */
+  uint8_t opcode[3]; /* instruction encoding, unused bytes are zero */
+  uint8_t value;     /* value at `address` before execution */
+  uint8_t A;
+  uint8_t X;
+  uint8_t Y;
+  uint8_t P;
+  uint8_t S;
+  uint8_t flags; /* combination of TRACE_RECORD_* flags */
+  uint8_t padding[2];
+};
+
+_Static_assert(sizeof(struct TraceRecord) == 24, "unexpected trace record size");
+
+/* Set by the emulator on the first instruction of every video frame but the
+ * first, which starts at the beginning of the trace; frame N starts at the N-th
+ * record so marked, as frames are counted by the PPU. */
+#define TRACE_RECORD_FRAME_START 0x01
+
+/*
+ * A trace file consists of a header, followed by a sequence of chunks, and
+ * ends with an index of all chunks plus a footer. Each chunk holds a fixed
+ * number of consecutive records (except for the last one), byte shuffled and
+ * deflate compressed. Every chunk is preceded by its own index entry, so that
+ * the index can be rebuilt by scanning the file in case the footer is missing,
+ * for example after a crash.
+ *
+ * The index is sparse; it stores the first cycle and the number of frames
+ * started before every chunk, which allows to seek to a cycle or frame by
+ * decompressing a single chunk. Besides, every index entry holds a bloom
+ * filter of all program counters, and one of all memory operand addresses in
+ * its chunk, such that chunks can be skipped when searching for an address.
+ *
+ * All values are stored in host byte order.
+ */
+struct TraceFileHeader
+{
+  char magic[8]; /* "NNTRACE" */
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t chunk_size; /* number of records per chunk */
+  uint32_t reserved;
+};
+
+#define TRACE_FILE_MAGIC "NNTRACE"
+#define TRACE_FILE_VERSION 2
+
+/* Number of bits in each of the bloom filters of a chunk. */
+#define TRACE_BLOOM_BITS 8192
+
+struct TraceChunkInfo
+{
+  uint64_t offset; /* file offset of the compressed data */
+  uint64_t first_record;
+  uint64_t first_cycle;
+  uint64_t frames; /* number of frames started before this chunk */
+  uint32_t records;
+  uint32_t compressed_size;
+  uint64_t pc_bloom[TRACE_BLOOM_BITS / 64];
+  uint64_t address_bloom[TRACE_BLOOM_BITS / 64];
+};
+
+struct TraceFileFooter
+{
+  uint64_t index_offset;
+  uint64_t chunks;
+  char magic[8]; /* "NNINDEX" */
+};
+
+#define TRACE_INDEX_MAGIC "NNINDEX"
+
+struct TraceRecord make_trace_record(struct Cpu *cpu);
+int trace_print_nintendulator(FILE *fp, const struct TraceRecord *record);
+bool trace_record_writes(const struct TraceRecord *record, Address address);
+int trace_parse_nintendulator(const char *line, struct TraceRecord *record);
+const char *trace_record_compare(const struct TraceRecord *expected,
+                                 const struct TraceRecord *actual, bool compare_operand);
+
+bool trace_chunk_may_execute(const struct TraceChunkInfo *chunk, Address pc);
+bool trace_chunk_may_access(const struct TraceChunkInfo *chunk, Address address);
+
+/*
+ * Writes trace records to a file from a background thread. Records are handed
+ * over to the writer thread through a lock-free ring buffer, so that the
+ * emulation thread never blocks on I/O or compression, unless the writer
+ * thread can not keep up at all.
+ */
+struct TraceWriter
+{
+  FILE *fp;
+  struct ring_buffer records;
+
+  pthread_t thread;
+  atomic_bool is_closing;
+  atomic_int error;
+
+  /* Owned by the writer thread. */
+  struct TraceRecord *chunk;
+  uint8_t *shuffled;
+  uint8_t *compressed;
+  struct TraceChunkInfo *index;
+  size_t index_size;
+  size_t index_capacity;
+  struct TraceChunkInfo info;
+};
+
+int trace_writer_open(struct TraceWriter *writer, const char *file_name);
+void trace_writer_push(struct TraceWriter *writer, const struct TraceRecord *record);
+size_t trace_writer_backlog(struct TraceWriter *writer);
+int trace_writer_close(struct TraceWriter *writer);
+
+/*
+ * Reads trace records from a trace file, either sequentially, or by seeking
+ * to a chunk using the index.
+ */
+struct TraceReader
+{
+  FILE *fp;
+  struct TraceFileHeader header;
+
+  struct TraceChunkInfo *chunks;
+  size_t chunk_count;
+
+  /* Decompressed records of the currently loaded chunk. */
+  struct TraceRecord *records;
+  size_t loaded_chunk;
+  uint8_t *shuffled;
+  uint8_t *compressed;
+  size_t compressed_capacity;
+  size_t chunks_loaded; /* number of chunks decompressed so far */
+
+  /* Position of the next record to read. */
+  size_t chunk;
+  size_t record;
+};
+
+int trace_reader_open(struct TraceReader *reader, const char *file_name);
+void trace_reader_close(struct TraceReader *reader);
+uint64_t trace_reader_record_count(const struct TraceReader *reader);
+
+const struct TraceRecord *trace_reader_load_chunk(struct TraceReader *reader, size_t chunk);
+size_t trace_reader_read(struct TraceReader *reader, struct TraceRecord *records, size_t n);
+
+int trace_reader_find_cycle(struct TraceReader *reader, uint64_t cycle,
+                            struct TraceRecord *record);
+int trace_reader_find_frame(struct TraceReader *reader, uint64_t frame,
+                            struct TraceRecord *record);
+int trace_reader_next_pc(struct TraceReader *reader, Address pc, struct TraceRecord *record);
+int trace_reader_next_write(struct TraceReader *reader, Address address,
+                            struct TraceRecord *record);
+
+#endif
@@ -1,5 +1,6 @@
 #include <lib/6502/include/cpu.h>
 #include <lib/6502/include/instruction.h>
+#include <lib/6502/include/profiler.h>
 #include <lib/std/include/util.h>
 
 #include <stdio.h>
@@ -21,11 +22,6 @@
  */
 #define BIT_SET_IF(p, x, n) (x = (x & ~(1 << n)) | (((p) > 0) << n))
 
-/*
- * TODO(ton): all instructions with relative addressing modes should read a
- * signed operand!
- */
-
 /*
  * Pops an 8-bit value from the stack.
  */
@@ -62,6 +58,26 @@ static void cpu_push_16b(struct Cpu *cpu, uint16_t i)
   cpu->S -= 2;
 }
 
+/*
+ * Executes a relative branch instruction. In case the condition holds, the
+ * signed operand is added to the address of the next instruction, which takes
+ * an extra cycle, plus another one in case the target is on a different page.
+ */
+static void cpu_branch(struct Cpu *cpu, bool condition, const struct Instruction *instruction)
+{
+  const Address next = cpu->PC + instruction->bytes;
+  if (condition)
+  {
+    const Address target = next + cpu_read_signed_8b(cpu, cpu->PC + 1);
+    cpu->cycle += 1 + ((next & 0xff00) != (target & 0xff00));
+    cpu->PC = target;
+  }
+  else
+  {
+    cpu->PC = next;
+  }
+}
+
 /*
  * Depending on the given value `x`, sets the zero and negative CPU flags
  * accordingly. The zero flag is set in case the value in the accumulator is
@@ -289,18 +305,97 @@ int cpu_page_cross(Address address, uint8_t offset)
   return 0xff - offset < (address & 0xff);
 }
 
+/*
+ * Returns the effective address of the memory operand of the given
+ * instruction, which is the instruction pointed to by the program counter.
+ * For an indirect JMP, returns the jump target. Returns zero in case the
+ * instruction has no memory operand.
+ */
+Address cpu_effective_address(struct Cpu *cpu, const struct Instruction *ins)
+{
+  const uint8_t operand = cpu->ram[(Address)(cpu->PC + 1)];
+  const Address operand_16b = operand + (cpu->ram[(Address)(cpu->PC + 2)] << 8);
+
+  switch (ins->addressing_mode)
+  {
+    case AM_ABSOLUTE:
+      return operand_16b;
+    case AM_ABSOLUTE_X:
+      return operand_16b + cpu->X;
+    case AM_ABSOLUTE_Y:
+      return operand_16b + cpu->Y;
+    case AM_INDIRECT:
+      return cpu_read_indirect_16b(cpu, operand_16b);
+    case AM_INDIRECT_X:
+      return cpu_read_indirect_x_address(cpu, operand);
+    case AM_INDIRECT_Y:
+      return cpu_read_indirect_y_address(cpu, operand);
+    case AM_ZERO_PAGE:
+      return operand;
+    case AM_ZERO_PAGE_X:
+      return cpu_make_zero_page_x_offset(cpu, operand);
+    case AM_ZERO_PAGE_Y:
+      return cpu_make_zero_page_y_offset(cpu, operand);
+    default:
+      return 0;
+  }
+}
+
 /*
  * Executes the instruction currently pointed to by the program counter register
  * (PC). Updates register state, updates cycle count.
  */
 void cpu_execute_next_instruction(struct Cpu *cpu)
 {
+  const Address pc = cpu->PC;
+  const uint64_t cycle = cpu->cycle;
   const struct Instruction instruction = make_instruction(cpu->ram[cpu->PC]);
 
+  /* Let memory mapped devices provide the operand before it is read. */
+  Address io_address = 0;
+  bool io_write = false;
+  if (cpu->io && instruction_accesses_memory(&instruction))
+  {
+    io_address = cpu_effective_address(cpu, &instruction);
+    if (cpu->io->begin <= io_address && io_address <= cpu->io->end)
+    {
+      if (instruction_reads_memory(&instruction))
+      {
+        cpu->io->cycle = cpu->cycle + instruction.cycles - 1;
+        cpu->ram[io_address] = cpu->io->read(cpu->io->context, io_address);
+      }
+      io_write = instruction_writes_memory(&instruction);
+    }
+  }
+
   switch (instruction.opcode)
   {
     case 0:
-      /* TODO(ton): invalid opcode; what to do? */
+      if (cpu->ram[pc] == 0x00)
+      {
+        /*
+         * BRK - Force Interrupt
+         *
+         * Pushes the address of the byte after its padding byte, and the
+         * status flags with the B-flag set, and continues at the address in
+         * the IRQ vector.
+         */
+        cpu_push_16b(cpu, cpu->PC + 2);
+        cpu_push_8b(cpu, cpu->P | FLAGS_BRK_PHP_PUSH);
+        cpu->P |= FLAGS_INTERRUPT_DISABLE;
+        cpu->PC = cpu_read_16b(cpu, CPU_ADDRESS_IRQ_VECTOR);
+        break;
+      }
+
+      /*
+       * JAM - Halt (unofficial), as are other opcodes without an instruction
+       *
+       * The CPU stops fetching instructions, and ignores interrupts. The clock
+       * keeps running, hence time passes a cycle per call, and callers that
+       * run the CPU until a given cycle still get there.
+       */
+      cpu->jammed = true;
+      cpu->cycle += 1;
       return;
     case 0x01:
       /*
@@ -494,15 +589,7 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
        * If the negative flag is clear then add the relative displacement to the
        * program counter to cause a branch to a new location.
        */
-      if (!(cpu->P & FLAGS_NEGATIVE))
-      {
-        cpu->PC += instruction.bytes + cpu->ram[cpu->PC + 1];
-        cpu->cycle++;
-      }
-      else
-      {
-        cpu->PC += instruction.bytes;
-      }
+      cpu_branch(cpu, !(cpu->P & FLAGS_NEGATIVE), &instruction);
       break;
     case 0x11:
       /*
@@ -933,15 +1020,7 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
        * If the negative flag is set, then add the relative displacement to the
        * program counter to cause a branch to a new location.
        */
-      if (cpu->P & FLAGS_NEGATIVE)
-      {
-        cpu->PC += instruction.bytes + cpu_read_8b(cpu, cpu->PC + 1);
-        cpu->cycle++;
-      }
-      else
-      {
-        cpu->PC += instruction.bytes;
-      }
+      cpu_branch(cpu, cpu->P & FLAGS_NEGATIVE, &instruction);
       break;
     case 0x31:
       /*
@@ -1337,15 +1416,7 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
        * If the overflow flag is clear then add the relative displacement to the
        * program counter to cause a branch to a new location.
        */
-      if (!(cpu->P & FLAGS_OVERFLOW))
-      {
-        cpu->PC += instruction.bytes + cpu->ram[cpu->PC + 1];
-        cpu->cycle++;
-      }
-      else
-      {
-        cpu->PC += instruction.bytes;
-      }
+      cpu_branch(cpu, !(cpu->P & FLAGS_OVERFLOW), &instruction);
       break;
     case 0x51:
       /*
@@ -1436,6 +1507,15 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
         cpu->PC += instruction.bytes;
       }
       break;
+    case 0x58:
+      /*
+       * CLI - Clear Interrupt Disable
+       *
+       * Clears the interrupt disable flag allowing normal interrupt requests to be serviced.
+       */
+      cpu->P &= ~FLAGS_INTERRUPT_DISABLE;
+      cpu->PC += instruction.bytes;
+      break;
     case 0x59:
       /*
        * EOR - Exclusive OR (absolute, Y)
@@ -1730,15 +1810,7 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
        * If the overflow flag is set then add the relative displacement to the
        * program counter to cause a branch to a new location.
        */
-      if (cpu->P & FLAGS_OVERFLOW)
-      {
-        cpu->PC += instruction.bytes + cpu->ram[cpu->PC + 1];
-        cpu->cycle++;
-      }
-      else
-      {
-        cpu->PC += instruction.bytes;
-      }
+      cpu_branch(cpu, cpu->P & FLAGS_OVERFLOW, &instruction);
       break;
     case 0x71:
       /*
@@ -2100,15 +2172,7 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
        * If the carry flag is clear then add the relative displacement to the
        * program counter to cause a branch to a new location.
        */
-      if (!(cpu->P & FLAGS_CARRY))
-      {
-        cpu->PC += instruction.bytes + cpu->ram[cpu->PC + 1];
-        cpu->cycle++;
-      }
-      else
-      {
-        cpu->PC += instruction.bytes;
-      }
+      cpu_branch(cpu, !(cpu->P & FLAGS_CARRY), &instruction);
       break;
     case 0x91:
       /*
@@ -2403,15 +2467,7 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
        * If the carry flag is set then add the relative displacement to the
        * program counter to cause a branch to a new location.
        */
-      if (cpu->P & FLAGS_CARRY)
-      {
-        cpu->PC += instruction.bytes + cpu->ram[cpu->PC + 1];
-        cpu->cycle++;
-      }
-      else
-      {
-        cpu->PC += instruction.bytes;
-      }
+      cpu_branch(cpu, cpu->P & FLAGS_CARRY, &instruction);
       break;
     case 0xb1:
       /*
@@ -2818,15 +2874,7 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
        * If the zero flag is clear then add the relative displacement to the
        * program counter to cause a branch to a new location.
        */
-      if (!(cpu->P & FLAGS_ZERO))
-      {
-        cpu->PC += instruction.bytes + cpu_read_signed_8b(cpu, cpu->PC + 1);
-        cpu->cycle++; /* TODO: +2 if branching to a new page */
-      }
-      else
-      {
-        cpu->PC += instruction.bytes;
-      }
+      cpu_branch(cpu, !(cpu->P & FLAGS_ZERO), &instruction);
       break;
     case 0xd1:
       /*
@@ -3325,16 +3373,7 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
        * If the zero flag is set then add the relative displacement to the
        * program counter to cause a branch to a new location.
        */
-      if (cpu->P & FLAGS_ZERO)
-      {
-        const int offset = cpu->ram[cpu->PC + 1];
-        cpu->cycle += 1 + cpu_page_cross(cpu->PC + instruction.bytes, offset);
-        cpu->PC += instruction.bytes + offset;
-      }
-      else
-      {
-        cpu->PC += instruction.bytes;
-      }
+      cpu_branch(cpu, cpu->P & FLAGS_ZERO, &instruction);
       break;
     case 0xf1:
       /*
@@ -3587,6 +3626,60 @@ void cpu_execute_next_instruction(struct Cpu *cpu)
   }
 
   cpu->cycle += instruction.cycles;
+
+  if (io_write)
+  {
+    cpu->io->cycle = cpu->cycle - 1;
+    cpu->io->write(cpu->io->context, io_address, cpu->ram[io_address]);
+  }
+
+  if (cpu->profiler)
+  {
+    profiler_record(cpu->profiler, cpu, pc, instruction.opcode, cpu->cycle - cycle);
+  }
+}
+
+/*
+ * Pushes the program counter and the status flags (with the B-flag clear),
+ * and continues at the address in the given interrupt vector.
+ */
+static void cpu_interrupt(struct Cpu *cpu, Address vector)
+{
+  cpu_push_16b(cpu, cpu->PC);
+  cpu_push_8b(cpu, (cpu->P & ~FLAGS_BIT_4) | FLAGS_BIT_5);
+  cpu->P |= FLAGS_INTERRUPT_DISABLE;
+  cpu->PC = cpu_read_16b(cpu, vector);
+  cpu->cycle += 7;
+}
+
+/*
+ * Handles a non-maskable interrupt, unless the CPU jammed. Must be called in
+ * between instructions.
+ */
+void cpu_nmi(struct Cpu *cpu)
+{
+  if (cpu->jammed)
+  {
+    return;
+  }
+
+  cpu_interrupt(cpu, CPU_ADDRESS_NMI_VECTOR);
+}
+
+/*
+ * Handles an interrupt request, in case interrupts are not disabled, and the
+ * CPU did not jam. Returns
+ * whether the interrupt was taken. Must be called in between instructions.
+ */
+bool cpu_irq(struct Cpu *cpu)
+{
+  if ((cpu->P & FLAGS_INTERRUPT_DISABLE) || cpu->jammed)
+  {
+    return false;
+  }
+
+  cpu_interrupt(cpu, CPU_ADDRESS_IRQ_VECTOR);
+  return true;
 }
 
 /*
@@ -3611,6 +3704,7 @@ void cpu_power_on(struct Cpu *cpu)
   cpu->PC = cpu_read_16b(cpu, CPU_ADDRESS_RESET_VECTOR);
 
   cpu->cycle = 7;
+  cpu->jammed = false;
 }
 
 /*
@@ -3621,4 +3715,5 @@ void cpu_power_reset(struct Cpu *cpu)
   cpu->S -= 3;
   cpu->P |= FLAGS_INTERRUPT_DISABLE;
   cpu->cycle += 7;
+  cpu->jammed = false;
 }
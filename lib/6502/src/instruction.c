@@ -388,6 +388,91 @@ uint8_t *next_instruction(uint8_t *pc)
   return pc + (ins->opcode == opcode ? ins->bytes : 1);
 }
 
+/*
+ * Returns whether the given instruction reads or writes memory through its
+ * operand. Stack operations are not taken into account.
+ */
+bool instruction_accesses_memory(const struct Instruction *ins)
+{
+  switch (ins->addressing_mode)
+  {
+    case AM_ACCUMULATOR:
+    case AM_IMMEDIATE:
+    case AM_IMPLIED:
+    case AM_RELATIVE:
+      return false;
+    default:
+      return ins->op != OP_JMP && ins->op != OP_JSR;
+  }
+}
+
+/*
+ * Returns whether the given instruction reads memory through its operand,
+ * which holds for all memory accessing instructions except for stores.
+ */
+bool instruction_reads_memory(const struct Instruction *ins)
+{
+  if (!instruction_accesses_memory(ins))
+  {
+    return false;
+  }
+
+  switch (ins->op)
+  {
+    case OP_STA:
+    case OP_STX:
+    case OP_STY:
+    case OP_SAX:
+      return false;
+    default:
+      return true;
+  }
+}
+
+/*
+ * Returns whether the given instruction writes memory through its operand,
+ * either by a store or by a read-modify-write operation.
+ */
+bool instruction_writes_memory(const struct Instruction *ins)
+{
+  if (!instruction_accesses_memory(ins))
+  {
+    return false;
+  }
+
+  switch (ins->op)
+  {
+    case OP_STA:
+    case OP_STX:
+    case OP_STY:
+    case OP_SAX:
+    case OP_ASL:
+    case OP_LSR:
+    case OP_ROL:
+    case OP_ROR:
+    case OP_INC:
+    case OP_DEC:
+    case OP_DCP:
+    case OP_ISC:
+    case OP_SLO:
+    case OP_RLA:
+    case OP_SRE:
+    case OP_RRA:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/*
+ * Returns the assembly token for the operation of the given instruction, using
+ * the `nes-disasm` naming of unofficial operations.
+ */
+const char *instruction_mnemonic(const struct Instruction *ins)
+{
+  return operation_name(ins->op, IL_NES_DISASM);
+}
+
 /*
  * See `instruction_print_layout`. Prints an instruction to some statically
  * allocated buffer using `nes-disasm` instruction layout.
@@ -0,0 +1,434 @@
+#include <lib/6502/include/instruction.h>
+#include <lib/6502/include/profiler.h>
+#include <lib/std/include/util.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of counters per bank; one for every address in the CPU address
+ * space. */
+#define PROFILER_BANK_SIZE (CPU_ADDRESS_MAX + 1)
+
+/*
+ * Entry in the address or routine sections of the profiler report.
+ */
+struct ProfilerEntry
+{
+  uint8_t bank;
+  Address address;
+  uint64_t executions;
+  uint64_t cycles;
+};
+
+/*
+ * Creates a profiler that is able to distinguish the given number of banks.
+ * Counter memory is allocated up front, thus requires 1MB per bank.
+ */
+struct Profiler make_profiler(int banks)
+{
+  struct Profiler profiler = {0};
+  profiler.banks = MIN(MAX(banks, 1), 256);
+  profiler.executions = calloc(profiler.banks * PROFILER_BANK_SIZE, sizeof(uint64_t));
+  profiler.cycles = calloc(profiler.banks * PROFILER_BANK_SIZE, sizeof(uint64_t));
+  if (profiler.executions == NULL || profiler.cycles == NULL)
+  {
+    nn_quit("Could not allocate profiler counters for %d banks", profiler.banks);
+  }
+
+  profiler.nodes_capacity = 256;
+  profiler.nodes = malloc(profiler.nodes_capacity * sizeof(struct ProfilerNode));
+  if (profiler.nodes == NULL)
+  {
+    nn_quit("Could not allocate the profiler call tree");
+  }
+
+  profiler_clear(&profiler);
+
+  return profiler;
+}
+
+/*
+ * Frees dynamically allocated memory for a profiler object.
+ */
+void destroy_profiler(struct Profiler *profiler)
+{
+  free(profiler->executions);
+  free(profiler->cycles);
+  free(profiler->nodes);
+}
+
+/*
+ * Resets all counters and the call tree, keeps the bank mapping.
+ */
+void profiler_clear(struct Profiler *profiler)
+{
+  memset(profiler->executions, 0, profiler->banks * PROFILER_BANK_SIZE * sizeof(uint64_t));
+  memset(profiler->cycles, 0, profiler->banks * PROFILER_BANK_SIZE * sizeof(uint64_t));
+  memset(profiler->opcode_executions, 0, sizeof profiler->opcode_executions);
+  memset(profiler->opcode_cycles, 0, sizeof profiler->opcode_cycles);
+
+  /* The root node represents all code executed outside of any known call. */
+  profiler->nodes[0] = (struct ProfilerNode){0};
+  profiler->nodes_size = 1;
+  profiler->depth = 0;
+}
+
+/*
+ * Notifies the profiler that the given bank is mapped in at the given address
+ * range. Typically called by a mapper on a bank switch. Bank numbers that do
+ * not fit in the number of banks the profiler was created with are wrapped.
+ */
+void profiler_map_bank(struct Profiler *profiler, Address address, size_t size, uint8_t bank)
+{
+  const size_t first = address / PROFILER_PAGE_SIZE;
+  const size_t last = MIN((address + size + PROFILER_PAGE_SIZE - 1) / PROFILER_PAGE_SIZE,
+                          (size_t)PROFILER_PAGES);
+  for (size_t page = first; page < last; ++page)
+  {
+    profiler->page_bank[page] = bank % profiler->banks;
+  }
+}
+
+/*
+ * Returns the index of the call tree node of the currently executing routine.
+ */
+static uint32_t profiler_current_node(const struct Profiler *profiler)
+{
+  return profiler->depth > 0 ? profiler->stack[profiler->depth - 1].node : 0;
+}
+
+/*
+ * Returns the child node of `parent` for the given routine, creates it in case
+ * it does not exist yet.
+ */
+static uint32_t profiler_child_node(struct Profiler *profiler, uint32_t parent, Address routine,
+                                    uint8_t bank)
+{
+  uint32_t child = profiler->nodes[parent].first_child;
+  while (child != 0)
+  {
+    const struct ProfilerNode *node = &profiler->nodes[child];
+    if (node->routine == routine && node->bank == bank)
+    {
+      return child;
+    }
+    child = node->next_sibling;
+  }
+
+  if (profiler->nodes_size == profiler->nodes_capacity)
+  {
+    profiler->nodes_capacity *= 2;
+    profiler->nodes =
+        realloc(profiler->nodes, profiler->nodes_capacity * sizeof(struct ProfilerNode));
+    if (profiler->nodes == NULL)
+    {
+      nn_quit("Could not grow the profiler call tree");
+    }
+  }
+
+  child = profiler->nodes_size++;
+  profiler->nodes[child] = (struct ProfilerNode){.routine = routine,
+                                                 .bank = bank,
+                                                 .parent = parent,
+                                                 .next_sibling =
+                                                     profiler->nodes[parent].first_child};
+  profiler->nodes[parent].first_child = child;
+
+  return child;
+}
+
+/*
+ * Records the execution of a single instruction at the given address, which
+ * took the given number of cycles. Called by the CPU core after an instruction
+ * is executed, thus `cpu` reflects the state after execution.
+ */
+void profiler_record(struct Profiler *profiler, const struct Cpu *cpu, Address pc, uint8_t opcode,
+                     unsigned cycles)
+{
+  const size_t slot =
+      ((size_t)profiler->page_bank[pc / PROFILER_PAGE_SIZE] * PROFILER_BANK_SIZE) + pc;
+  profiler->executions[slot]++;
+  profiler->cycles[slot] += cycles;
+
+  profiler->opcode_executions[opcode]++;
+  profiler->opcode_cycles[opcode] += cycles;
+
+  profiler->nodes[profiler_current_node(profiler)].cycles += cycles;
+
+  switch (opcode)
+  {
+    case 0x20: /* JSR */
+      profiler_call(profiler, cpu->PC, cpu->S);
+      break;
+    case 0x40: /* RTI */
+    case 0x60: /* RTS */
+      profiler_return(profiler, cpu->S);
+      break;
+  }
+}
+
+/*
+ * Pushes a call to the given routine on the shadow stack. `S` is the stack
+ * pointer right after the return address has been pushed.
+ */
+void profiler_call(struct Profiler *profiler, Address routine, uint8_t S)
+{
+  if (profiler->depth == PROFILER_MAX_DEPTH)
+  {
+    /* The shadow stack is out of sync with the program; the program is
+     * probably manipulating the stack directly. Start over. */
+    profiler->depth = 0;
+  }
+
+  const uint8_t bank = profiler->page_bank[routine / PROFILER_PAGE_SIZE];
+  const uint32_t node =
+      profiler_child_node(profiler, profiler_current_node(profiler), routine, bank);
+  profiler->nodes[node].calls++;
+
+  profiler->stack[profiler->depth++] = (struct ProfilerFrame){node, S};
+}
+
+/*
+ * Pops all calls from the shadow stack whose return address has been popped
+ * from the stack, given the stack pointer `S` after returning. Unwinding based
+ * on the stack pointer keeps the shadow stack in sync with programs that
+ * return using pushed addresses (RTS jump tables), or that discard return
+ * addresses.
+ */
+void profiler_return(struct Profiler *profiler, uint8_t S)
+{
+  while (profiler->depth > 0 && profiler->stack[profiler->depth - 1].S < S)
+  {
+    --profiler->depth;
+  }
+}
+
+/*
+ * Sorts profiler entries by cycles, in descending order.
+ */
+static int profiler_entry_compare(const void *x, const void *y)
+{
+  const struct ProfilerEntry *a = x;
+  const struct ProfilerEntry *b = y;
+  return (a->cycles < b->cycles) - (a->cycles > b->cycles);
+}
+
+/*
+ * Sorts call tree nodes by bank and routine.
+ */
+static int profiler_node_compare(const void *x, const void *y)
+{
+  const struct ProfilerNode *a = x;
+  const struct ProfilerNode *b = y;
+  const int lhs = (a->bank << 16) | a->routine;
+  const int rhs = (b->bank << 16) | b->routine;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+/*
+ * Prints the name of a routine or address to the given buffer, qualified by
+ * the bank in case the profiler distinguishes multiple banks.
+ */
+static const char *profiler_address_name(const struct Profiler *profiler, uint8_t bank,
+                                         Address address)
+{
+  static char buffer[16];
+  if (profiler->banks > 1)
+  {
+    snprintf(buffer, sizeof buffer, "%02X:%04X", bank, address);
+  }
+  else
+  {
+    snprintf(buffer, sizeof buffer, "%04X", address);
+  }
+  return buffer;
+}
+
+/*
+ * Writes a report of the collected counters to the given file pointer,
+ * consisting of three sections; routines sorted by inclusive cycles, addresses
+ * sorted by cycles, and opcodes sorted by cycles. At most `max_entries` entries
+ * are written per section, or all entries in case `max_entries` is 0. In case
+ * a CPU is given, the instruction currently in memory at each address is
+ * disassembled. Returns zero in case writing the report succeeded, or the error
+ * code on the file pointer otherwise.
+ */
+int profiler_write_report(const struct Profiler *profiler, FILE *fp, const struct Cpu *cpu,
+                          size_t max_entries)
+{
+  const size_t slots = profiler->banks * PROFILER_BANK_SIZE;
+
+  /* Collect all executed addresses. */
+  uint64_t total_cycles = 0;
+  uint64_t total_executions = 0;
+  size_t entries_size = 0;
+  for (size_t slot = 0; slot < slots; ++slot)
+  {
+    entries_size += profiler->executions[slot] > 0;
+  }
+
+  struct ProfilerEntry *entries = malloc((entries_size + 1) * sizeof(struct ProfilerEntry));
+  struct ProfilerNode *nodes = malloc(profiler->nodes_size * sizeof(struct ProfilerNode));
+  if (entries == NULL || nodes == NULL)
+  {
+    nn_quit("Could not allocate memory for the profiler report");
+  }
+
+  for (size_t slot = 0, i = 0; slot < slots; ++slot)
+  {
+    if (profiler->executions[slot] > 0)
+    {
+      entries[i++] = (struct ProfilerEntry){slot / PROFILER_BANK_SIZE, slot % PROFILER_BANK_SIZE,
+                                            profiler->executions[slot], profiler->cycles[slot]};
+      total_cycles += profiler->cycles[slot];
+      total_executions += profiler->executions[slot];
+    }
+  }
+
+  const double cycles_pct = total_cycles > 0 ? 100.0 / total_cycles : 0.0;
+
+  fprintf(fp, "; instructions executed: %llu\n", (unsigned long long)total_executions);
+  fprintf(fp, "; cycles:                %llu\n", (unsigned long long)total_cycles);
+
+  /* Routines, by inclusive cycles. Since nodes are always created after their
+   * parents, accumulating in reverse order propagates cycles up the tree. */
+  memcpy(nodes, profiler->nodes, profiler->nodes_size * sizeof(struct ProfilerNode));
+  for (size_t i = profiler->nodes_size - 1; i > 0; --i)
+  {
+    nodes[nodes[i].parent].cycles += nodes[i].cycles;
+  }
+
+  qsort(nodes + 1, profiler->nodes_size - 1, sizeof(struct ProfilerNode), profiler_node_compare);
+
+  /* Merge all call stacks that end in the same routine. Note that recursive
+   * calls are counted once for every level of recursion. */
+  struct ProfilerEntry *routines = malloc(profiler->nodes_size * sizeof(struct ProfilerEntry));
+  if (routines == NULL)
+  {
+    nn_quit("Could not allocate memory for the profiler report");
+  }
+
+  size_t routines_size = 0;
+  for (size_t i = 1; i < profiler->nodes_size; ++i)
+  {
+    if (routines_size == 0 || routines[routines_size - 1].address != nodes[i].routine ||
+        routines[routines_size - 1].bank != nodes[i].bank)
+    {
+      routines[routines_size++] = (struct ProfilerEntry){nodes[i].bank, nodes[i].routine, 0, 0};
+    }
+    routines[routines_size - 1].executions += nodes[i].calls;
+    routines[routines_size - 1].cycles += nodes[i].cycles;
+  }
+  qsort(routines, routines_size, sizeof(struct ProfilerEntry), profiler_entry_compare);
+
+  fprintf(fp, "\n; routines (by inclusive cycles)\n");
+  fprintf(fp, "; %-10s %14s %16s %8s\n", "routine", "calls", "cycles", "cycles%");
+  for (size_t i = 0; i < routines_size && (max_entries == 0 || i < max_entries); ++i)
+  {
+    fprintf(fp, "  %-10s %14llu %16llu %7.2f%%\n",
+            profiler_address_name(profiler, routines[i].bank, routines[i].address),
+            (unsigned long long)routines[i].executions, (unsigned long long)routines[i].cycles,
+            routines[i].cycles * cycles_pct);
+  }
+
+  /* Addresses, by cycles. */
+  qsort(entries, entries_size, sizeof(struct ProfilerEntry), profiler_entry_compare);
+
+  fprintf(fp, "\n; addresses (by cycles)\n");
+  fprintf(fp, "; %-10s %14s %16s %8s %8s  %s\n", "address", "executions", "cycles", "cycles%",
+          "cumul%", "instruction");
+
+  uint64_t cumulative_cycles = 0;
+  for (size_t i = 0; i < entries_size && (max_entries == 0 || i < max_entries); ++i)
+  {
+    const struct ProfilerEntry *entry = &entries[i];
+    cumulative_cycles += entry->cycles;
+
+    fprintf(fp, "  %-10s %14llu %16llu %7.2f%% %7.2f%%",
+            profiler_address_name(profiler, entry->bank, entry->address),
+            (unsigned long long)entry->executions, (unsigned long long)entry->cycles,
+            entry->cycles * cycles_pct, cumulative_cycles * cycles_pct);
+
+    /* Only disassemble in case the bank is still mapped in. */
+    if (cpu != NULL && profiler->page_bank[entry->address / PROFILER_PAGE_SIZE] == entry->bank &&
+        entry->address <= CPU_ADDRESS_MAX - 2)
+    {
+      struct Instruction ins = make_instruction(cpu->ram[entry->address]);
+      if (ins.bytes > 0)
+      {
+        fprintf(fp, "  %s",
+                instruction_print(&ins, instruction_read_encoding(cpu->ram + entry->address,
+                                                                  ins.bytes)));
+      }
+    }
+    fputc('\n', fp);
+  }
+
+  /* Opcodes, by cycles. */
+  size_t opcodes_size = 0;
+  struct ProfilerEntry opcodes[256];
+  for (int opcode = 0; opcode < 256; ++opcode)
+  {
+    if (profiler->opcode_executions[opcode] > 0)
+    {
+      opcodes[opcodes_size++] = (struct ProfilerEntry){0, opcode,
+                                                       profiler->opcode_executions[opcode],
+                                                       profiler->opcode_cycles[opcode]};
+    }
+  }
+  qsort(opcodes, opcodes_size, sizeof(struct ProfilerEntry), profiler_entry_compare);
+
+  fprintf(fp, "\n; opcodes (by cycles)\n");
+  fprintf(fp, "; %-10s %14s %16s %8s\n", "opcode", "executions", "cycles", "cycles%");
+  for (size_t i = 0; i < opcodes_size && (max_entries == 0 || i < max_entries); ++i)
+  {
+    const struct Instruction ins = make_instruction(opcodes[i].address);
+    fprintf(fp, "  $%02X %-5s %14llu %16llu %7.2f%%\n", opcodes[i].address,
+            instruction_mnemonic(&ins), (unsigned long long)opcodes[i].executions,
+            (unsigned long long)opcodes[i].cycles, opcodes[i].cycles * cycles_pct);
+  }
+
+  free(routines);
+  free(nodes);
+  free(entries);
+
+  return ferror(fp);
+}
+
+/*
+ * Writes the call tree to the given file pointer in the folded stack format,
+ * that is, one line per call stack, with the routines on the stack separated
+ * by semicolons, followed by the number of cycles spent in the top-most
+ * routine. This format is accepted by `flamegraph.pl` and compatible tools.
+ * Returns zero in case writing succeeded, or the error code on the file pointer
+ * otherwise.
+ */
+int profiler_write_folded(const struct Profiler *profiler, FILE *fp)
+{
+  uint32_t stack[PROFILER_MAX_DEPTH + 1];
+
+  for (size_t i = 0; i < profiler->nodes_size; ++i)
+  {
+    const struct ProfilerNode *node = &profiler->nodes[i];
+    if (node->cycles == 0)
+    {
+      continue;
+    }
+
+    int depth = 0;
+    for (uint32_t n = i; n != 0 && depth < PROFILER_MAX_DEPTH; n = profiler->nodes[n].parent)
+    {
+      stack[depth++] = n;
+    }
+
+    fputs("reset", fp);
+    while (depth > 0)
+    {
+      const struct ProfilerNode *frame = &profiler->nodes[stack[--depth]];
+      fprintf(fp, ";%s", profiler_address_name(profiler, frame->bank, frame->routine));
+    }
+    fprintf(fp, " %llu\n", (unsigned long long)node->cycles);
+  }
+
+  return ferror(fp);
+}
@@ -0,0 +1,1052 @@
+#include <lib/6502/include/instruction.h>
+#include <lib/6502/include/trace.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+/* Number of records that fit in the ring buffer between the emulation thread
+ * and the writer thread. */
+#define TRACE_WRITER_CAPACITY (1 << 16)
+/* Number of records per compressed chunk. */
+#define TRACE_CHUNK_SIZE (1 << 15)
+/* Upper bound on the chunk size that is accepted when reading a trace. */
+#define TRACE_MAX_CHUNK_SIZE (1 << 24)
+
+/*
+ * Captures the state of the given CPU right before it executes the instruction
+ * pointed to by the program counter.
+ */
+struct TraceRecord make_trace_record(struct Cpu *cpu)
+{
+  struct TraceRecord record = {0};
+
+  const struct Instruction ins = make_instruction(cpu->ram[cpu->PC]);
+
+  record.cycle = cpu->cycle;
+  record.PC = cpu->PC;
+  record.A = cpu->A;
+  record.X = cpu->X;
+  record.Y = cpu->Y;
+  record.P = cpu->P;
+  record.S = cpu->S;
+
+  record.opcode[0] = cpu->ram[cpu->PC];
+  if (ins.bytes > 1)
+  {
+    record.opcode[1] = cpu->ram[(Address)(cpu->PC + 1)];
+  }
+  if (ins.bytes > 2)
+  {
+    record.opcode[2] = cpu->ram[(Address)(cpu->PC + 2)];
+  }
+
+  record.address = cpu_effective_address(cpu, &ins);
+  record.value = cpu->ram[record.address];
+
+  return record;
+}
+
+/*
+ * Writes the given trace record to the given file pointer in Nintendulator
+ * format, so that it can be easily diffed with some verified output. Returns
+ * zero on success, or the error code on the file pointer otherwise.
+ */
+int trace_print_nintendulator(FILE *fp, const struct TraceRecord *record)
+{
+  /* The Nintendulator layout prints memory contents next to the assembly.
+   * Reconstruct the relevant parts of memory from the record in a scratch CPU,
+   * so that `instruction_print_layout` can be reused as is. */
+  static struct Cpu cpu;
+
+  cpu.A = record->A;
+  cpu.X = record->X;
+  cpu.Y = record->Y;
+  cpu.P = record->P;
+  cpu.S = record->S;
+  cpu.PC = record->PC;
+
+  struct Instruction ins = make_instruction(record->opcode[0]);
+  const int bytes = MAX(ins.bytes, 1);
+
+  for (int i = 0; i < bytes; ++i)
+  {
+    cpu.ram[(Address)(record->PC + i)] = record->opcode[i];
+  }
+
+  const uint8_t operand = record->opcode[1];
+  const Address operand_16b = record->opcode[1] + (record->opcode[2] << 8);
+
+  switch (ins.addressing_mode)
+  {
+    case AM_INDIRECT:
+      /* Mimics the page boundary bug of indirect JMP. */
+      cpu.ram[operand_16b] = record->address & 0xff;
+      cpu.ram[(operand_16b & 0xff00) | ((operand_16b + 1) & 0xff)] = record->address >> 8;
+      break;
+    case AM_INDIRECT_X:
+    {
+      const uint8_t pointer = operand + record->X;
+      cpu.ram[pointer] = record->address & 0xff;
+      cpu.ram[(uint8_t)(pointer + 1)] = record->address >> 8;
+      cpu.ram[record->address] = record->value;
+    }
+    break;
+    case AM_INDIRECT_Y:
+    {
+      const Address base = record->address - record->Y;
+      cpu.ram[operand] = base & 0xff;
+      cpu.ram[(uint8_t)(operand + 1)] = base >> 8;
+      cpu.ram[record->address] = record->value;
+    }
+    break;
+    default:
+      cpu.ram[record->address] = record->value;
+      break;
+  }
+
+  char encoding_buf[9];
+  switch (bytes)
+  {
+    case 1:
+      sprintf(encoding_buf, "%02X      ", record->opcode[0]);
+      break;
+    case 2:
+      sprintf(encoding_buf, "%02X %02X   ", record->opcode[0], record->opcode[1]);
+      break;
+    default:
+      sprintf(encoding_buf, "%02X %02X %02X", record->opcode[0], record->opcode[1],
+              record->opcode[2]);
+      break;
+  }
+
+  const Encoding encoding = instruction_read_encoding(record->opcode, bytes);
+
+  fprintf(fp, "%04X  %s %c%-31s A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu\n", record->PC,
+          encoding_buf, ins.is_supported ? ' ' : '*',
+          instruction_print_layout(&ins, encoding, IL_NINTENDULATOR, &cpu), record->A, record->X,
+          record->Y, record->P, record->S, (unsigned long long)record->cycle);
+
+  return ferror(fp);
+}
+
+/*
+ * Parses `digits` hexadecimal digits. Returns 0 on success, or -1 in case a
+ * character is not a hexadecimal digit.
+ */
+static int parse_hex(const char *s, int digits, unsigned *value)
+{
+  unsigned v = 0;
+  for (int i = 0; i < digits; ++i)
+  {
+    const char c = s[i];
+    if (c >= '0' && c <= '9')
+    {
+      v = (v << 4) | (c - '0');
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+      v = (v << 4) | (c - 'A' + 10);
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+      v = (v << 4) | (c - 'a' + 10);
+    }
+    else
+    {
+      return -1;
+    }
+  }
+  *value = v;
+  return 0;
+}
+
+/*
+ * Parses a register field like "A:00" at the given column of a Nintendulator
+ * log line.
+ */
+static int parse_register(const char *line, size_t length, size_t column, const char *name,
+                          uint8_t *value)
+{
+  const size_t name_length = strlen(name);
+  unsigned v;
+  if (column + name_length + 2 > length || memcmp(line + column, name, name_length) != 0 ||
+      parse_hex(line + column + name_length, 2, &v) != 0)
+  {
+    return -1;
+  }
+  *value = v;
+  return 0;
+}
+
+/*
+ * Parses a single line of a Nintendulator log, as written by
+ * `trace_print_nintendulator`, into a trace record. Only the program counter,
+ * the instruction encoding, the registers and the cycle count are parsed, the
+ * memory operand is left zero. Fields are read from their fixed columns,
+ * instead of scanning the line, since conformance runs parse millions of
+ * lines. An optional "PPU:" field before the cycle count is skipped. Returns 0
+ * on success, or -1 in case the line is not in Nintendulator format.
+ */
+int trace_parse_nintendulator(const char *line, struct TraceRecord *record)
+{
+  memset(record, 0, sizeof *record);
+
+  const size_t length = strlen(line);
+  if (length < 73)
+  {
+    return -1;
+  }
+
+  unsigned v;
+  if (parse_hex(line, 4, &v) != 0)
+  {
+    return -1;
+  }
+  record->PC = v;
+
+  /* The encoding takes up to three bytes at columns 6, 9 and 12. */
+  for (int i = 0; i < 3; ++i)
+  {
+    if (line[6 + 3 * i] == ' ' && i > 0)
+    {
+      break;
+    }
+    if (parse_hex(line + 6 + 3 * i, 2, &v) != 0)
+    {
+      return -1;
+    }
+    record->opcode[i] = v;
+  }
+
+  if (parse_register(line, length, 48, "A:", &record->A) != 0 ||
+      parse_register(line, length, 53, "X:", &record->X) != 0 ||
+      parse_register(line, length, 58, "Y:", &record->Y) != 0 ||
+      parse_register(line, length, 63, "P:", &record->P) != 0 ||
+      parse_register(line, length, 68, "SP:", &record->S) != 0)
+  {
+    return -1;
+  }
+
+  const char *cycle = strstr(line + 73, "CYC:");
+  if (cycle == NULL || cycle[4] < '0' || cycle[4] > '9')
+  {
+    return -1;
+  }
+
+  uint64_t c = 0;
+  for (cycle += 4; *cycle >= '0' && *cycle <= '9'; ++cycle)
+  {
+    c = 10 * c + (*cycle - '0');
+  }
+  record->cycle = c;
+
+  return 0;
+}
+
+/*
+ * Compares the CPU state of two trace records. Returns NULL in case they are
+ * equal, or the name of the first field that differs otherwise. The memory
+ * operand is only compared if `compare_operand` is set, since it is not
+ * available in text logs.
+ */
+const char *trace_record_compare(const struct TraceRecord *expected,
+                                 const struct TraceRecord *actual, bool compare_operand)
+{
+  if (expected->PC != actual->PC)
+  {
+    return "PC";
+  }
+  if (memcmp(expected->opcode, actual->opcode, sizeof expected->opcode) != 0)
+  {
+    return "opcode";
+  }
+  if (expected->A != actual->A)
+  {
+    return "A";
+  }
+  if (expected->X != actual->X)
+  {
+    return "X";
+  }
+  if (expected->Y != actual->Y)
+  {
+    return "Y";
+  }
+  if (expected->P != actual->P)
+  {
+    return "P";
+  }
+  if (expected->S != actual->S)
+  {
+    return "SP";
+  }
+  if (expected->cycle != actual->cycle)
+  {
+    return "CYC";
+  }
+  if (compare_operand && expected->address != actual->address)
+  {
+    return "address";
+  }
+  if (compare_operand && expected->value != actual->value)
+  {
+    return "value";
+  }
+  return NULL;
+}
+
+/*
+ * Returns whether the instruction of the given record writes to the given
+ * address.
+ */
+bool trace_record_writes(const struct TraceRecord *record, Address address)
+{
+  if (record->address != address)
+  {
+    return false;
+  }
+
+  const struct Instruction ins = make_instruction(record->opcode[0]);
+  return instruction_writes_memory(&ins);
+}
+
+/*
+ * Computes the bit positions of the given address in a chunk bloom filter.
+ * Since addresses are only 16 bits wide, a few multiplicative hashes suffice.
+ */
+static void trace_bloom_bits(Address address, unsigned bits[3])
+{
+  bits[0] = (address * 0x9e3779b1u) >> 19;
+  bits[1] = (address * 0x85ebca77u) >> 19;
+  bits[2] = (address * 0xc2b2ae3du) >> 19;
+}
+
+static void trace_bloom_add(uint64_t *bloom, Address address)
+{
+  unsigned bits[3];
+  trace_bloom_bits(address, bits);
+  for (int i = 0; i < 3; ++i)
+  {
+    bloom[bits[i] / 64] |= UINT64_C(1) << (bits[i] % 64);
+  }
+}
+
+static bool trace_bloom_test(const uint64_t *bloom, Address address)
+{
+  unsigned bits[3];
+  trace_bloom_bits(address, bits);
+  for (int i = 0; i < 3; ++i)
+  {
+    if ((bloom[bits[i] / 64] & (UINT64_C(1) << (bits[i] % 64))) == 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Returns whether the given chunk may contain an instruction at the given
+ * address. False positives are possible, false negatives are not.
+ */
+bool trace_chunk_may_execute(const struct TraceChunkInfo *chunk, Address pc)
+{
+  return trace_bloom_test(chunk->pc_bloom, pc);
+}
+
+/*
+ * Returns whether the given chunk may contain an instruction that accesses the
+ * given address through its memory operand. False positives are possible,
+ * false negatives are not.
+ */
+bool trace_chunk_may_access(const struct TraceChunkInfo *chunk, Address address)
+{
+  return trace_bloom_test(chunk->address_bloom, address);
+}
+
+/*
+ * Stores the bytes of the given records plane by plane; the n-th byte of all
+ * records first, then the (n + 1)-th byte, etc. Consecutive records mostly
+ * differ in only a few bytes, so this makes the chunk compress a lot better.
+ */
+static void trace_shuffle(uint8_t *dst, const struct TraceRecord *records, size_t n)
+{
+  const uint8_t *src = (const uint8_t *)records;
+  for (size_t i = 0; i < n; ++i)
+  {
+    for (size_t b = 0; b < sizeof(struct TraceRecord); ++b)
+    {
+      dst[b * n + i] = src[i * sizeof(struct TraceRecord) + b];
+    }
+  }
+}
+
+/*
+ * Inverse of `trace_shuffle`.
+ */
+static void trace_unshuffle(struct TraceRecord *records, const uint8_t *src, size_t n)
+{
+  uint8_t *dst = (uint8_t *)records;
+  for (size_t i = 0; i < n; ++i)
+  {
+    for (size_t b = 0; b < sizeof(struct TraceRecord); ++b)
+    {
+      dst[i * sizeof(struct TraceRecord) + b] = src[b * n + i];
+    }
+  }
+}
+
+/*
+ * Compresses the current chunk, and writes it to file preceded by its index
+ * entry. Returns 0 on success, or -1 otherwise, in which case `errno` is set.
+ */
+static int trace_writer_flush_chunk(struct TraceWriter *writer)
+{
+  struct TraceChunkInfo *info = &writer->info;
+  if (info->records == 0)
+  {
+    return 0;
+  }
+
+  NN_ZONE("trace flush");
+
+  trace_shuffle(writer->shuffled, writer->chunk, info->records);
+
+  uLongf compressed_size = compressBound(TRACE_CHUNK_SIZE * sizeof(struct TraceRecord));
+  if (compress2(writer->compressed, &compressed_size, writer->shuffled,
+                info->records * sizeof(struct TraceRecord), Z_BEST_SPEED) != Z_OK)
+  {
+    errno = EIO;
+    return -1;
+  }
+
+  off_t offset;
+  if ((offset = ftello(writer->fp)) == -1)
+  {
+    return -1;
+  }
+
+  info->offset = offset + sizeof *info;
+  info->first_cycle = writer->chunk[0].cycle;
+  info->compressed_size = compressed_size;
+
+  if (fwrite(info, sizeof *info, 1, writer->fp) != 1 ||
+      fwrite(writer->compressed, compressed_size, 1, writer->fp) != 1)
+  {
+    return -1;
+  }
+
+  if (writer->index_size == writer->index_capacity)
+  {
+    writer->index_capacity = MAX(64, 2 * writer->index_capacity);
+    if ((writer->index = realloc(writer->index, writer->index_capacity * sizeof *writer->index)) ==
+        NULL)
+    {
+      nn_quit("Could not allocate the index for %zu trace chunks", writer->index_capacity);
+    }
+  }
+  writer->index[writer->index_size++] = *info;
+
+  /* Start the next chunk. */
+  uint64_t frames = info->frames;
+  for (uint32_t i = 0; i < info->records; ++i)
+  {
+    frames += (writer->chunk[i].flags & TRACE_RECORD_FRAME_START) != 0;
+  }
+
+  const uint64_t first_record = info->first_record + info->records;
+  memset(info, 0, sizeof *info);
+  info->first_record = first_record;
+  info->frames = frames;
+
+  return 0;
+}
+
+/*
+ * Writes the last (partial) chunk, followed by the chunk index and the footer.
+ * Returns 0 on success, or -1 otherwise, in which case `errno` is set.
+ */
+static int trace_writer_finish(struct TraceWriter *writer)
+{
+  if (trace_writer_flush_chunk(writer) != 0)
+  {
+    return -1;
+  }
+
+  off_t index_offset;
+  if ((index_offset = ftello(writer->fp)) == -1)
+  {
+    return -1;
+  }
+
+  struct TraceFileFooter footer = {index_offset, writer->index_size, TRACE_INDEX_MAGIC};
+  if (fwrite(writer->index, sizeof *writer->index, writer->index_size, writer->fp) !=
+          writer->index_size ||
+      fwrite(&footer, sizeof footer, 1, writer->fp) != 1)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Pops records into the current chunk, and flushes the chunk once it is full.
+ * Returns the number of records popped.
+ */
+static size_t trace_writer_consume(struct ring_buffer *rb, void *arg)
+{
+  struct TraceWriter *writer = arg;
+  struct TraceChunkInfo *info = &writer->info;
+
+  struct TraceRecord *records = writer->chunk + info->records;
+  const size_t n = ring_buffer_pop(rb, records, TRACE_CHUNK_SIZE - info->records);
+  for (size_t i = 0; i < n; ++i)
+  {
+    trace_bloom_add(info->pc_bloom, records[i].PC);
+
+    const struct Instruction ins = make_instruction(records[i].opcode[0]);
+    if (instruction_accesses_memory(&ins))
+    {
+      trace_bloom_add(info->address_bloom, records[i].address);
+    }
+  }
+
+  info->records += n;
+  if (info->records == TRACE_CHUNK_SIZE && trace_writer_flush_chunk(writer) != 0)
+  {
+    atomic_store(&writer->error, errno != 0 ? errno : EIO);
+  }
+
+  return n;
+}
+
+/*
+ * Body of the trace writer thread; drains the ring buffer into chunks until the
+ * writer is closed and the ring buffer is empty.
+ */
+static void *trace_writer_run(void *arg)
+{
+  struct TraceWriter *writer = arg;
+
+  NN_ZONE_THREAD_NAME("trace writer");
+
+  ring_buffer_drain(&writer->records, &writer->is_closing, trace_writer_consume, writer);
+
+  if (trace_writer_finish(writer) != 0)
+  {
+    atomic_store(&writer->error, errno != 0 ? errno : EIO);
+  }
+
+  return NULL;
+}
+
+/*
+ * Frees the buffers of the writer thread.
+ */
+static void trace_writer_free(struct TraceWriter *writer)
+{
+  destroy_ring_buffer(&writer->records);
+  free(writer->chunk);
+  free(writer->shuffled);
+  free(writer->compressed);
+  free(writer->index);
+}
+
+/*
+ * Creates the given trace file, and starts the writer thread. Returns 0 on
+ * success, or -1 in case the file could not be created or the thread could not
+ * be started, in which case `errno` is set.
+ */
+int trace_writer_open(struct TraceWriter *writer, const char *file_name)
+{
+  memset(writer, 0, sizeof *writer);
+
+  if ((writer->fp = fopen(file_name, "wb")) == NULL)
+  {
+    return -1;
+  }
+
+  struct TraceFileHeader header = {TRACE_FILE_MAGIC, TRACE_FILE_VERSION,
+                                   sizeof(struct TraceRecord), TRACE_CHUNK_SIZE, 0};
+  if (fwrite(&header, sizeof header, 1, writer->fp) != 1)
+  {
+    fclose(writer->fp);
+    return -1;
+  }
+
+  const size_t chunk_bytes = TRACE_CHUNK_SIZE * sizeof(struct TraceRecord);
+  writer->records = make_ring_buffer(sizeof(struct TraceRecord), TRACE_WRITER_CAPACITY);
+  if ((writer->chunk = malloc(chunk_bytes)) == NULL ||
+      (writer->shuffled = malloc(chunk_bytes)) == NULL ||
+      (writer->compressed = malloc(compressBound(chunk_bytes))) == NULL)
+  {
+    nn_quit("Could not allocate trace chunk buffers");
+  }
+
+  atomic_init(&writer->is_closing, false);
+  atomic_init(&writer->error, 0);
+
+  int error;
+  if ((error = pthread_create(&writer->thread, NULL, trace_writer_run, writer)) != 0)
+  {
+    trace_writer_free(writer);
+    fclose(writer->fp);
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Hands the given record over to the writer thread. In case the ring buffer is
+ * full, waits for the writer thread to catch up.
+ */
+void trace_writer_push(struct TraceWriter *writer, const struct TraceRecord *record)
+{
+  while (ring_buffer_push(&writer->records, record, 1) == 0)
+  {
+    sched_yield();
+  }
+}
+
+/*
+ * Returns the (approximate) number of records that still need to be written
+ * by the writer thread.
+ */
+size_t trace_writer_backlog(struct TraceWriter *writer)
+{
+  return ring_buffer_size(&writer->records);
+}
+
+/*
+ * Writes all pending records and the index, stops the writer thread, and
+ * closes the trace file. Returns 0 in case all records were written
+ * successfully, or -1 otherwise, in which case `errno` is set.
+ */
+int trace_writer_close(struct TraceWriter *writer)
+{
+  atomic_store(&writer->is_closing, true);
+  pthread_join(writer->thread, NULL);
+
+  trace_writer_free(writer);
+
+  int error = atomic_load(&writer->error);
+  if (fclose(writer->fp) != 0 && error == 0)
+  {
+    error = errno;
+  }
+
+  if (error != 0)
+  {
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Reads the chunk index from the end of the trace file. Returns 0 on success,
+ * or -1 in case the file has no (valid) index.
+ */
+static int trace_reader_read_index(struct TraceReader *reader, off_t file_size)
+{
+  struct TraceFileFooter footer;
+  if (file_size < (off_t)(sizeof reader->header + sizeof footer) ||
+      fseeko(reader->fp, file_size - sizeof footer, SEEK_SET) != 0 ||
+      fread(&footer, sizeof footer, 1, reader->fp) != 1 ||
+      memcmp(footer.magic, TRACE_INDEX_MAGIC, sizeof footer.magic) != 0 ||
+      footer.index_offset + footer.chunks * sizeof(struct TraceChunkInfo) + sizeof footer !=
+          (uint64_t)file_size)
+  {
+    return -1;
+  }
+
+  if ((reader->chunks = malloc(MAX(footer.chunks, 1) * sizeof *reader->chunks)) == NULL)
+  {
+    nn_quit("Could not allocate the index for %zu trace chunks", (size_t)footer.chunks);
+  }
+
+  if (fseeko(reader->fp, footer.index_offset, SEEK_SET) != 0 ||
+      fread(reader->chunks, sizeof *reader->chunks, footer.chunks, reader->fp) != footer.chunks)
+  {
+    free(reader->chunks);
+    reader->chunks = NULL;
+    return -1;
+  }
+
+  reader->chunk_count = footer.chunks;
+  return 0;
+}
+
+/*
+ * Rebuilds the chunk index by walking over all chunks in the trace file, for
+ * traces that were not closed properly. A truncated last chunk is ignored.
+ */
+static void trace_reader_scan_index(struct TraceReader *reader, off_t file_size)
+{
+  size_t capacity = 0;
+  off_t offset = sizeof reader->header;
+
+  struct TraceChunkInfo info;
+  while (fseeko(reader->fp, offset, SEEK_SET) == 0 && fread(&info, sizeof info, 1, reader->fp) == 1)
+  {
+    if (info.offset != (uint64_t)offset + sizeof info || info.records == 0 ||
+        info.records > reader->header.chunk_size ||
+        info.offset + info.compressed_size > (uint64_t)file_size)
+    {
+      break;
+    }
+
+    if (reader->chunk_count == capacity)
+    {
+      capacity = MAX(64, 2 * capacity);
+      if ((reader->chunks = realloc(reader->chunks, capacity * sizeof *reader->chunks)) == NULL)
+      {
+        nn_quit("Could not allocate the index for %zu trace chunks", capacity);
+      }
+    }
+    reader->chunks[reader->chunk_count++] = info;
+
+    offset = info.offset + info.compressed_size;
+  }
+}
+
+/*
+ * Opens the given trace file for reading, and reads its index. Returns 0 on
+ * success, or -1 in case the file can not be opened or is not a trace file, in
+ * which case `errno` is set.
+ */
+int trace_reader_open(struct TraceReader *reader, const char *file_name)
+{
+  memset(reader, 0, sizeof *reader);
+  reader->loaded_chunk = SIZE_MAX;
+
+  if ((reader->fp = fopen(file_name, "rb")) == NULL)
+  {
+    return -1;
+  }
+
+  struct TraceFileHeader *header = &reader->header;
+  if (fread(header, sizeof *header, 1, reader->fp) != 1 ||
+      memcmp(header->magic, TRACE_FILE_MAGIC, sizeof header->magic) != 0 ||
+      header->version != TRACE_FILE_VERSION || header->record_size != sizeof(struct TraceRecord) ||
+      header->chunk_size == 0 || header->chunk_size > TRACE_MAX_CHUNK_SIZE)
+  {
+    fclose(reader->fp);
+    errno = EINVAL;
+    return -1;
+  }
+
+  off_t file_size;
+  if (fseeko(reader->fp, 0, SEEK_END) != 0 || (file_size = ftello(reader->fp)) == -1)
+  {
+    fclose(reader->fp);
+    return -1;
+  }
+
+  if (trace_reader_read_index(reader, file_size) != 0)
+  {
+    trace_reader_scan_index(reader, file_size);
+  }
+
+  const size_t chunk_bytes = header->chunk_size * sizeof(struct TraceRecord);
+  if ((reader->records = malloc(chunk_bytes)) == NULL ||
+      (reader->shuffled = malloc(chunk_bytes)) == NULL)
+  {
+    nn_quit("Could not allocate trace chunk buffers");
+  }
+
+  return 0;
+}
+
+/*
+ * Closes the trace file, and frees all memory held by the reader.
+ */
+void trace_reader_close(struct TraceReader *reader)
+{
+  fclose(reader->fp);
+  free(reader->chunks);
+  free(reader->records);
+  free(reader->shuffled);
+  free(reader->compressed);
+}
+
+/*
+ * Returns the total number of records in the trace.
+ */
+uint64_t trace_reader_record_count(const struct TraceReader *reader)
+{
+  if (reader->chunk_count == 0)
+  {
+    return 0;
+  }
+
+  const struct TraceChunkInfo *last = &reader->chunks[reader->chunk_count - 1];
+  return last->first_record + last->records;
+}
+
+/*
+ * Decompresses the given chunk, and returns its records. The returned records
+ * remain valid until another chunk is loaded. Returns NULL in case the chunk
+ * could not be read, in which case `errno` is set.
+ */
+const struct TraceRecord *trace_reader_load_chunk(struct TraceReader *reader, size_t chunk)
+{
+  if (chunk == reader->loaded_chunk)
+  {
+    return reader->records;
+  }
+
+  const struct TraceChunkInfo *info = &reader->chunks[chunk];
+  if (info->compressed_size > reader->compressed_capacity)
+  {
+    reader->compressed_capacity = info->compressed_size;
+    if ((reader->compressed = realloc(reader->compressed, reader->compressed_capacity)) == NULL)
+    {
+      nn_quit("Could not allocate a buffer of %zu bytes", reader->compressed_capacity);
+    }
+  }
+
+  reader->loaded_chunk = SIZE_MAX;
+  if (fseeko(reader->fp, info->offset, SEEK_SET) != 0 ||
+      fread(reader->compressed, info->compressed_size, 1, reader->fp) != 1)
+  {
+    return NULL;
+  }
+
+  uLongf size = reader->header.chunk_size * sizeof(struct TraceRecord);
+  if (uncompress(reader->shuffled, &size, reader->compressed, info->compressed_size) != Z_OK ||
+      size != info->records * sizeof(struct TraceRecord))
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  trace_unshuffle(reader->records, reader->shuffled, info->records);
+  reader->loaded_chunk = chunk;
+  ++reader->chunks_loaded;
+
+  return reader->records;
+}
+
+/*
+ * Reads at most `n` records from the current position in the trace. Returns
+ * the number of records read, which is less than `n` at the end of the trace,
+ * or in case a chunk could not be read.
+ */
+size_t trace_reader_read(struct TraceReader *reader, struct TraceRecord *records, size_t n)
+{
+  size_t count = 0;
+  while (count < n && reader->chunk < reader->chunk_count)
+  {
+    const struct TraceChunkInfo *info = &reader->chunks[reader->chunk];
+    if (reader->record >= info->records)
+    {
+      ++reader->chunk;
+      reader->record = 0;
+      continue;
+    }
+
+    const struct TraceRecord *chunk_records = trace_reader_load_chunk(reader, reader->chunk);
+    if (chunk_records == NULL)
+    {
+      break;
+    }
+
+    const size_t m = MIN(n - count, info->records - reader->record);
+    memcpy(records + count, chunk_records + reader->record, m * sizeof *records);
+    count += m;
+    reader->record += m;
+  }
+
+  return count;
+}
+
+/*
+ * Finds the state of the CPU at the given cycle, that is, the record of the
+ * last instruction that started at or before the given cycle. On success, the
+ * current position is set to the record right after it. Returns 1 in case the
+ * record was found, 0 in case the trace starts after the given cycle, or -1 in
+ * case the trace could not be read.
+ */
+int trace_reader_find_cycle(struct TraceReader *reader, uint64_t cycle, struct TraceRecord *record)
+{
+  /* Find the last chunk that starts at or before the given cycle. */
+  size_t lo = 0;
+  size_t hi = reader->chunk_count;
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (reader->chunks[mid].first_cycle <= cycle)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  if (lo == 0)
+  {
+    return 0;
+  }
+
+  const size_t chunk = lo - 1;
+  const struct TraceRecord *records = trace_reader_load_chunk(reader, chunk);
+  if (records == NULL)
+  {
+    return -1;
+  }
+
+  /* Same, for the records within the chunk. */
+  lo = 0;
+  hi = reader->chunks[chunk].records;
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (records[mid].cycle <= cycle)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  *record = records[lo - 1];
+  reader->chunk = chunk;
+  reader->record = lo;
+
+  return 1;
+}
+
+/*
+ * Finds the first record of the given frame, where frame 0 starts at the
+ * beginning of the trace, and every record marked with
+ * `TRACE_RECORD_FRAME_START` starts the next frame. On success, the current
+ * position is set to the record right after it. Returns 1 in case the record
+ * was found, 0 in case the trace does not contain the frame, or -1 in case the
+ * trace could not be read.
+ */
+int trace_reader_find_frame(struct TraceReader *reader, uint64_t frame, struct TraceRecord *record)
+{
+  if (reader->chunk_count == 0)
+  {
+    return 0;
+  }
+
+  /* The frame starts in the last chunk that has less frames started before
+   * it. */
+  size_t lo = 0;
+  size_t hi = reader->chunk_count;
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (reader->chunks[mid].frames < frame)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  const size_t chunk = frame == 0 ? 0 : lo - 1;
+  const struct TraceRecord *records = trace_reader_load_chunk(reader, chunk);
+  if (records == NULL)
+  {
+    return -1;
+  }
+
+  uint64_t frames = reader->chunks[chunk].frames;
+  for (size_t i = 0; i < reader->chunks[chunk].records; ++i)
+  {
+    frames += (records[i].flags & TRACE_RECORD_FRAME_START) != 0;
+    if (frames == frame || frame == 0)
+    {
+      *record = records[i];
+      reader->chunk = chunk;
+      reader->record = i + 1;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Searches for the next record, starting from the current position, that
+ * matches the given address. Chunks for which the bloom filter rules out the
+ * address are skipped without being decompressed.
+ */
+static int trace_reader_next(struct TraceReader *reader, Address address,
+                             bool (*may_contain)(const struct TraceChunkInfo *, Address),
+                             bool (*matches)(const struct TraceRecord *, Address),
+                             struct TraceRecord *record)
+{
+  for (; reader->chunk < reader->chunk_count; ++reader->chunk, reader->record = 0)
+  {
+    const struct TraceChunkInfo *info = &reader->chunks[reader->chunk];
+    if (reader->record >= info->records || !may_contain(info, address))
+    {
+      continue;
+    }
+
+    const struct TraceRecord *records = trace_reader_load_chunk(reader, reader->chunk);
+    if (records == NULL)
+    {
+      return -1;
+    }
+
+    for (size_t i = reader->record; i < info->records; ++i)
+    {
+      if (matches(&records[i], address))
+      {
+        *record = records[i];
+        reader->record = i + 1;
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static bool trace_record_executes(const struct TraceRecord *record, Address pc)
+{
+  return record->PC == pc;
+}
+
+/*
+ * Finds the next record, starting from the current position, that executes
+ * the instruction at the given address. On success, the current position is
+ * set to the record right after it. Returns 1 in case a record was found, 0 at
+ * the end of the trace, or -1 in case the trace could not be read.
+ */
+int trace_reader_next_pc(struct TraceReader *reader, Address pc, struct TraceRecord *record)
+{
+  return trace_reader_next(reader, pc, trace_chunk_may_execute, trace_record_executes, record);
+}
+
+/*
+ * Finds the next record, starting from the current position, that writes to
+ * the given address. On success, the current position is set to the record
+ * right after it. Returns 1 in case a record was found, 0 at the end of the
+ * trace, or -1 in case the trace could not be read.
+ */
+int trace_reader_next_write(struct TraceReader *reader, Address address,
+                            struct TraceRecord *record)
+{
+  return trace_reader_next(reader, address, trace_chunk_may_access, trace_record_writes, record);
+}
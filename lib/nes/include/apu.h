@@ -0,0 +1,160 @@
+#ifndef NEPNES_NES_APU_H
+#define NEPNES_NES_APU_H
+
+#include <lib/6502/include/cpu.h>
+#include <lib/std/include/blip_buffer.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* CPU cycles per second of the NTSC NES, the clock of the APU. */
+#define APU_CLOCK_RATE 1789773.0
+
+/*
+ * Volume envelope of the pulse and noise channels; a constant volume, or a
+ * decay from 15 to 0 clocked every quarter frame.
+ */
+struct ApuEnvelope
+{
+  bool start;
+  bool loop;
+  bool constant;
+  uint8_t period; /* also the constant volume */
+  uint8_t divider;
+  uint8_t decay;
+};
+
+struct ApuPulse
+{
+  bool enabled;
+  uint8_t duty;
+  uint8_t step;    /* position in the duty cycle */
+  uint16_t period; /* timer reload value, in APU cycles minus one */
+  uint8_t length;
+  bool halt;
+  struct ApuEnvelope envelope;
+
+  bool sweep_enabled;
+  bool sweep_negate;
+  bool sweep_reload;
+  uint8_t sweep_period;
+  uint8_t sweep_shift;
+  uint8_t sweep_divider;
+  bool ones_complement; /* pulse 1 negates with one's complement */
+
+  uint64_t next; /* CPU cycle of the next timer clock */
+  int level;     /* current output, in blip amplitude */
+};
+
+struct ApuTriangle
+{
+  bool enabled;
+  uint8_t step;    /* position in the 32 step triangle */
+  uint16_t period; /* timer reload value, in CPU cycles minus one */
+  uint8_t length;
+  bool control; /* halts the length counter, and keeps reloading the linear counter */
+  uint8_t linear_reload;
+  uint8_t linear;
+  bool linear_reload_flag;
+
+  uint64_t next;
+  int level;
+};
+
+struct ApuNoise
+{
+  bool enabled;
+  bool mode;       /* short, 93 step sequence */
+  uint16_t period; /* in CPU cycles */
+  uint16_t lfsr;
+  uint8_t length;
+  bool halt;
+  struct ApuEnvelope envelope;
+
+  uint64_t next;
+  int level;
+};
+
+/*
+ * Delta modulation channel; plays 1-bit delta encoded samples, which it reads
+ * from CPU memory, halting the CPU for a few cycles on every byte.
+ */
+struct ApuDmc
+{
+  bool irq_enabled;
+  bool loop;
+  uint16_t period; /* in CPU cycles */
+  uint8_t output;  /* 7-bit DAC */
+
+  uint16_t start_address;
+  uint16_t start_length;
+  uint16_t address;
+  uint16_t bytes_remaining;
+
+  uint8_t buffer;
+  bool buffer_full;
+  uint8_t shift;
+  uint8_t bits; /* bits left in the current output cycle, 1-8 */
+  bool silence;
+
+  uint64_t next;
+  int level;
+};
+
+/*
+ * The audio processing unit. Like the PPU, the APU does not run in lockstep
+ * with the CPU; it catches up with the CPU when the CPU accesses one of its
+ * registers, when one of its IRQs is due (see `apu_next_irq`), and at the end
+ * of every frame. Catching up is event driven; channels only do work when
+ * their timers clock their sequencers, and the frame counter in between.
+ *
+ * Channels write the changes of their output to a blip buffer, if any, at the
+ * CPU cycle they happen, which gives band-limited audio at any sample rate.
+ * Channels are mixed linearly, with the weights of the linear approximation
+ * of the mixer of the NES.
+ */
+struct Apu
+{
+  struct ApuPulse pulse[2];
+  struct ApuTriangle triangle;
+  struct ApuNoise noise;
+  struct ApuDmc dmc;
+
+  uint64_t cycle; /* CPU cycle the APU caught up with */
+
+  /* Frame counter; four steps of quarter frames, with half frames on the
+   * second and the last step. */
+  bool five_step;
+  bool irq_inhibit;
+  int frame_step;          /* next step of the sequence */
+  uint64_t sequence_start; /* CPU cycle at which the current sequence started */
+
+  bool frame_irq;
+  bool dmc_irq;
+
+  uint64_t dma_cycles;   /* CPU cycles stolen by the DMC, not yet added to the CPU */
+  const uint8_t *memory; /* CPU memory, read by the DMC */
+
+  struct blip_buffer *blip; /* Optional, receives the output */
+  uint64_t frame_start;     /* CPU cycle at which the current blip frame started */
+};
+
+void apu_power_on(struct Apu *apu, const uint8_t *memory, uint64_t cycle);
+
+uint8_t apu_read(struct Apu *apu, Address address);
+void apu_write(struct Apu *apu, Address address, uint8_t value);
+
+void apu_run_until(struct Apu *apu, uint64_t cycle);
+void apu_end_frame(struct Apu *apu, uint64_t cycle);
+
+uint64_t apu_next_irq(const struct Apu *apu);
+
+/*
+ * Returns whether the APU asserts the IRQ line.
+ */
+static inline bool apu_irq(const struct Apu *apu)
+{
+  return apu->frame_irq || apu->dmc_irq;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef NEPNES_NES_AUDIO_H
+#define NEPNES_NES_AUDIO_H
+
+#include <lib/std/include/blip_buffer.h>
+#include <lib/std/include/resampler.h>
+#include <lib/std/include/ring_buffer.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Default, and supported range of sample rates of the audio output. */
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_MIN_SAMPLE_RATE 8000
+#define AUDIO_MAX_SAMPLE_RATE 192000
+
+/* Sample rate at which the output of the APU is synthesized; twice the usual
+ * output rates, such that the short kernel of the blip buffer rolls off and
+ * aliases well above the audible band, where the long kernel of the resampler
+ * of a sink removes it. */
+#define AUDIO_SYNTHESIS_RATE 96000
+
+/* Number of samples the ring buffer of a sink holds, about 85 ms. */
+#define AUDIO_SINK_CAPACITY 4096
+
+/* Number of samples a paced sink consumes at once, like the period of an audio
+ * device. */
+#define AUDIO_SINK_PERIOD 512
+
+/* Largest adjustment of the sample rate by rate control; pitch changes this
+ * small are inaudible. */
+#define AUDIO_MAX_RATE_DELTA 0.005
+
+/*
+ * Destinations of audio; WAV files, 16-bit mono, or nothing at all.
+ */
+enum AudioSinkType
+{
+  AUDIO_SINK_NULL,
+  AUDIO_SINK_WAV
+};
+
+/*
+ * Plays samples on a thread of its own. Samples are handed over to the sink
+ * thread through a lock-free ring buffer, so that the emulation thread never
+ * blocks on I/O.
+ *
+ * A paced sink consumes its samples in real time, a period at a time, like an
+ * audio device does; it is the clock the emulation runs by. Its producer keeps
+ * the ring buffer half full by adjusting its sample rate slightly, see
+ * `audio_sink_rate_ratio`, hence the sink neither runs dry nor overflows,
+ * however much the clock of the sink and the pace of the emulation differ. In
+ * case it runs dry anyway, it plays silence.
+ *
+ * A sink that is not paced consumes samples as fast as they are pushed, e.g.
+ * to render audio to a file faster than real time.
+ */
+struct AudioSink
+{
+  enum AudioSinkType type;
+  FILE *fp; /* WAV only; stdout in case the file name is "-" */
+  int sample_rate;
+  bool paced;
+  struct ring_buffer samples;
+
+  /* Owned by the producer; from AUDIO_SYNTHESIS_RATE to the sample rate. */
+  struct resampler resampler;
+
+  pthread_t thread;
+  atomic_bool is_closing;
+  atomic_int error;
+  atomic_uint_fast64_t played;   /* samples consumed, including silence */
+  atomic_uint_fast64_t underrun; /* samples of silence played for lack of samples */
+  atomic_uint_fast64_t overrun;  /* samples dropped, as the ring buffer was full */
+
+  /* Owned by the sink thread. */
+  int16_t period[AUDIO_SINK_PERIOD];
+  uint64_t data_size; /* bytes of WAV data written */
+};
+
+double audio_rate_ratio(double fill);
+
+int audio_sink_open(struct AudioSink *sink, enum AudioSinkType type, const char *file_name,
+                    int sample_rate, bool paced);
+size_t audio_sink_push(struct AudioSink *sink, const int16_t *samples, size_t count);
+void audio_sink_push_blip(struct AudioSink *sink, struct blip_buffer *blip, double clock_rate);
+double audio_sink_fill(struct AudioSink *sink);
+double audio_sink_rate_ratio(struct AudioSink *sink);
+int audio_sink_close(struct AudioSink *sink);
+
+#endif
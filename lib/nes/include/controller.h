@@ -0,0 +1,38 @@
+#ifndef NEPNES_NES_CONTROLLER_H
+#define NEPNES_NES_CONTROLLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Standard NES controller. While the strobe bit is set by writing $4016, the
+ * controller continuously reloads its shift register with the state of the
+ * buttons. Afterwards, every read of $4016 (first controller) or $4017
+ * (second controller) returns the next button, in the order of the bits
+ * below, and 1 once all eight buttons have been read.
+ */
+enum ControllerButton
+{
+  BUTTON_A = 0x01,
+  BUTTON_B = 0x02,
+  BUTTON_SELECT = 0x04,
+  BUTTON_START = 0x08,
+  BUTTON_UP = 0x10,
+  BUTTON_DOWN = 0x20,
+  BUTTON_LEFT = 0x40,
+  BUTTON_RIGHT = 0x80
+};
+
+struct Controller
+{
+  uint8_t buttons; /* combination of pressed ControllerButton values */
+  uint8_t shift;
+  uint8_t reads;   /* number of buttons shifted out since the last strobe */
+  bool strobe;
+};
+
+void controller_write(struct Controller *controller, uint8_t value);
+uint8_t controller_read(struct Controller *controller);
+int controller_parse_buttons(const char *s, uint8_t *buttons);
+
+#endif
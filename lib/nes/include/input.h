@@ -0,0 +1,41 @@
+#ifndef NEPNES_NES_INPUT_H
+#define NEPNES_NES_INPUT_H
+
+#include <lib/nes/include/controller.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A scripted sequence of controller input, e.g. to replay a session in a
+ * headless run. A script is a text file with one line per change of input:
+ *
+ *   # frame  controller 1  [controller 2]
+ *   0        .
+ *   120      START
+ *   130      RIGHT+A       B
+ *
+ * Buttons are held from the given frame on, until the next line. Frames must
+ * be in ascending order. Empty lines and lines starting with '#' are ignored.
+ */
+struct InputEvent
+{
+  uint64_t frame;
+  uint8_t buttons[2];
+};
+
+struct InputScript
+{
+  struct InputEvent *events;
+  size_t size;
+  size_t capacity;
+  size_t next;       /* index of the next event to apply */
+  size_t error_line; /* line number of a parse error */
+};
+
+int input_script_read(struct InputScript *script, const char *file_name);
+void input_script_apply(struct InputScript *script, uint64_t frame,
+                        struct Controller controllers[2]);
+void destroy_input_script(struct InputScript *script);
+
+#endif
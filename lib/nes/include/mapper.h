@@ -331,9 +331,13 @@ static inline const char *mapper_to_string(enum Mapper mapper)
 enum MapperErrorCode
 {
   MAPPER_ERR_UNSUPPORTED = 1,
-  MAPPER_ERR_NROM_UNEXPECTED_PRG_SIZE = 2
+  MAPPER_ERR_NROM_UNEXPECTED_PRG_SIZE = 2,
+  MAPPER_ERR_NROM_UNEXPECTED_CHR_SIZE = 3
 };
 
+struct Ppu;
+
 int mapper_initialize_cpu(enum Mapper mapper, struct Cpu *cpu, uint8_t *prg_data, size_t prg_size);
+int mapper_initialize_ppu(enum Mapper mapper, struct Ppu *ppu, uint8_t *chr_data, size_t chr_size);
 
 #endif
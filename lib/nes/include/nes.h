@@ -0,0 +1,75 @@
+#ifndef NEPNES_NES_NES_H
+#define NEPNES_NES_NES_H
+
+#include <lib/6502/include/cpu.h>
+#include <lib/6502/include/trace.h>
+#include <lib/nes/include/apu.h>
+#include <lib/nes/include/controller.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/nes/include/rom.h>
+#include <lib/std/include/perf.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of the internal work RAM at $0000-$07ff. */
+#define NES_WORK_RAM_SIZE 0x800
+
+/*
+ * Hardware event counts of the parts of the emulation, all per emulated
+ * instruction; the CPU executing batches of instructions, the PPU catching up,
+ * and the APU catching up and ending its frames. PPU and APU work done on
+ * register accesses in the middle of a batch counts toward the PPU and the
+ * APU, not the CPU.
+ */
+struct NesPerf
+{
+  const struct perf_counters *counters;
+  struct perf_region cpu;
+  struct perf_region ppu;
+  struct perf_region apu;
+  uint64_t frame_instructions; /* instructions executed in the current frame */
+};
+
+/*
+ * The console; the CPU with a cartridge inserted, and the devices connected
+ * to its memory mapped I/O range $2000-$401f. The CPU refers back to the
+ * console through its I/O hooks, hence a console must not be moved in memory
+ * after it was loaded.
+ *
+ * A loaded console holds on to resources, release them with `nes_unload`.
+ *
+ * A frame ends when VBlank starts, that is, when the PPU completed the
+ * picture; `ppu.frame` counts the frames completed. Set `ppu.skip_render`
+ * before running frames that need not be drawn. Attach a blip buffer to
+ * `apu.blip` after loading to receive the audio, a blip frame per frame.
+ */
+struct Nes
+{
+  struct Cpu cpu;
+  struct CpuIo io;
+  struct Ppu ppu;
+  struct Apu apu;
+  struct RomHeader header;
+  struct Controller controllers[2];
+
+  uint64_t first_cycle; /* CPU cycle at power on */
+  uint64_t batch_end;   /* CPU cycle at which the current batch of instructions ends */
+
+  struct TraceWriter *trace; /* Optional, receives every executed instruction */
+  uint8_t trace_flags;       /* TRACE_RECORD_* flags of the next instruction */
+
+  struct NesPerf *perf; /* Optional, counts hardware events of the emulation */
+};
+
+struct NesPerf make_nes_perf(const struct perf_counters *counters);
+
+int nes_load(struct Nes *nes, uint8_t *rom_data, size_t rom_size);
+void nes_unload(struct Nes *nes);
+void nes_run_until(struct Nes *nes, uint64_t cycle);
+void nes_run_frame(struct Nes *nes);
+
+uint64_t nes_frame_hash(const struct Nes *nes);
+uint64_t nes_ram_hash(const struct Nes *nes);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef NEPNES_NES_NSF_H
+#define NEPNES_NES_NSF_H
+
+#include <lib/6502/include/cpu.h>
+#include <lib/nes/include/apu.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of the header of an NSF file, which the program data follows. */
+#define NSF_HEADER_SIZE 0x80
+
+/* Size of the banks of bank switched tunes, mapped at $8000-$ffff. */
+#define NSF_BANK_SIZE 0x1000
+
+/* Registers that select the bank of each slot of $8000-$ffff. */
+#define NSF_BANK_REGISTERS 0x5ff8
+
+/* Address the init and play routines return to; the player stops executing
+ * once the CPU gets there, hence it is never executed. */
+#define NSF_RETURN_ADDRESS 0x4100
+
+/* CPU cycles the init routine may take before a song counts as broken. */
+#define NSF_INIT_CYCLES ((uint64_t)APU_CLOCK_RATE)
+
+/*
+ * Expansion sound chips an NSF tune may use, in the header bit field.
+ */
+enum NsfChip
+{
+  NSF_CHIP_VRC6 = 0x01,
+  NSF_CHIP_VRC7 = 0x02,
+  NSF_CHIP_FDS = 0x04,
+  NSF_CHIP_MMC5 = 0x08,
+  NSF_CHIP_NAMCO_163 = 0x10,
+  NSF_CHIP_SUNSOFT_5B = 0x20
+};
+
+struct NsfHeader
+{
+  uint8_t version;
+  int songs;         /* number of songs */
+  int starting_song; /* 0-based */
+  Address load_address;
+  Address init_address;
+  Address play_address;
+  char name[33];
+  char artist[33];
+  char copyright[33];
+  uint16_t ntsc_speed; /* microseconds between play calls */
+  uint8_t banks[8];    /* initial banks of $8000-$ffff, all zero unless bank switched */
+  bool bank_switched;
+  uint8_t chips; /* NsfChip flags */
+};
+
+int nsf_parse_header(struct NsfHeader *header, const uint8_t *data, size_t size);
+
+/*
+ * Plays NSF tunes; a CPU that runs the init and play routines of a tune, and
+ * the APU. There is no PPU; play routines are called at the speed the header
+ * asks for rather than on VBlank. Tunes play at the NTSC clock.
+ *
+ * The player refers to the NSF data it was loaded with, which must outlive
+ * it, and is not modified; players of the same data may run concurrently.
+ * The CPU refers back to the player through its I/O hooks, hence a player
+ * must not be moved in memory after it was loaded. Attach a blip buffer to
+ * `apu.blip` to receive the audio, a blip frame per play period.
+ */
+struct NsfPlayer
+{
+  struct Cpu cpu;
+  struct CpuIo io;
+  struct Apu apu;
+  struct NsfHeader header;
+
+  const uint8_t *data; /* program data, following the header */
+  size_t data_size;
+
+  uint64_t song_start; /* CPU cycle at which the current song started playing */
+  uint64_t frames;     /* play periods played of the current song */
+};
+
+int nsf_load(struct NsfPlayer *player, const uint8_t *data, size_t size);
+int nsf_start_song(struct NsfPlayer *player, int song);
+int nsf_run_frame(struct NsfPlayer *player);
+double nsf_frame_rate(const struct NsfPlayer *player);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef NEPNES_NES_NTSC_H
+#define NEPNES_NES_NTSC_H
+
+#include <lib/nes/include/palette.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/thread_pool.h>
+
+#include <stdint.h>
+
+/*
+ * Phases of the color subcarrier a pixel can start at. A pixel lasts 8 of the
+ * 12 steps of a subcarrier cycle, so consecutive pixels, scanlines and frames
+ * start at one of three phases.
+ */
+#define NTSC_PHASES 3
+
+/*
+ * Number of output pixels a framebuffer pixel contributes to; the pixel
+ * itself, and its neighbors from 3 pixels to its left up to 4 pixels to its
+ * right.
+ */
+#define NTSC_TAPS 8
+
+/* Lanes of a kernel; a kernel is placed at one of four offsets in 12 lanes. */
+#define NTSC_LANES 12
+
+/*
+ * Filter emulating the composite video signal of the NES; the PPU outputs a
+ * square wave per pixel, which a TV decodes with filters that smear color
+ * over neighboring pixels, and leave color fringes along sharp edges.
+ *
+ * The decoder is linear, so every output pixel is the sum of the
+ * contributions of its neighbors, which only depend on their framebuffer pixel
+ * and their phase. These contributions (the kernels) are computed once, as
+ * fixed point RGBA, such that filtering a frame is a table lookup and an add
+ * per pixel and tap. Every kernel is stored at all four offsets of a group of
+ * four pixels, which lets vectorized code add four pixels without shuffles.
+ */
+struct NtscFilter
+{
+  int16_t (*kernels)[4][NTSC_LANES][4]; /* per phase and framebuffer pixel */
+  struct thread_pool *pool;             /* runs bands of rows, may be NULL */
+};
+
+void ntsc_init(struct NtscFilter *ntsc, enum PixelFormat format, struct thread_pool *pool);
+void ntsc_destroy(struct NtscFilter *ntsc);
+
+int ntsc_frame_phase(const struct Ppu *ppu);
+void ntsc_filter(const struct NtscFilter *ntsc, const uint16_t *framebuffer, int phase,
+                 uint32_t *out);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef NEPNES_NES_PALETTE_H
+#define NEPNES_NES_PALETTE_H
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of colors; 64 palette indices in each of the 8 emphasis modes. */
+#define PALETTE_SIZE 512
+
+/*
+ * Byte order of converted pixels in memory; RGBA for most texture APIs, BGRA
+ * for Cairo and GDK on little endian machines. Alpha is always opaque.
+ */
+enum PixelFormat
+{
+  PIXEL_FORMAT_RGBA,
+  PIXEL_FORMAT_BGRA
+};
+
+/*
+ * Lookup table from framebuffer pixels (a 6-bit palette index and 3 emphasis
+ * bits, see ppu.h) to 32-bit pixels. Conversion is left to the consumer of a
+ * frame, such that frames that are only hashed or skipped are never
+ * converted.
+ */
+struct Palette
+{
+  alignas(32) uint32_t colors[PALETTE_SIZE];
+};
+
+void palette_init(struct Palette *palette, enum PixelFormat format);
+void palette_convert(const struct Palette *palette, const uint16_t *pixels, uint32_t *out,
+                     size_t size);
+
+#endif
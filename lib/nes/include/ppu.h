@@ -0,0 +1,178 @@
+#ifndef NEPNES_NES_PPU_H
+#define NEPNES_NES_PPU_H
+
+#include <lib/6502/include/cpu.h>
+#include <lib/nes/include/rom.h>
+#include <lib/nes/include/tile_cache.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PPU_WIDTH 256
+#define PPU_HEIGHT 240
+
+/*
+ * NTSC timing; a frame consists of 262 scanlines of 341 dots. Scanlines 0-239
+ * are visible, VBlank starts at dot 1 of scanline 241, and scanline 261 is the
+ * pre-render scanline. The PPU runs three dots per CPU cycle.
+ */
+#define PPU_DOTS_PER_SCANLINE 341
+#define PPU_SCANLINES 262
+#define PPU_DOTS_PER_FRAME (PPU_DOTS_PER_SCANLINE * PPU_SCANLINES)
+#define PPU_VBLANK_SCANLINE 241
+#define PPU_PRE_RENDER_SCANLINE 261
+#define PPU_DOTS_PER_CPU_CYCLE 3
+
+/* Dot of the current frame at which VBlank starts. */
+#define PPU_VBLANK_DOT (PPU_VBLANK_SCANLINE * PPU_DOTS_PER_SCANLINE + 1)
+
+enum PpuCtrl
+{
+  PPUCTRL_NAMETABLE = 0x03,
+  PPUCTRL_INCREMENT_32 = 0x04,
+  PPUCTRL_SPRITE_TABLE = 0x08,
+  PPUCTRL_BACKGROUND_TABLE = 0x10,
+  PPUCTRL_SPRITE_8X16 = 0x20,
+  PPUCTRL_NMI = 0x80
+};
+
+enum PpuMask
+{
+  PPUMASK_GRAYSCALE = 0x01,
+  PPUMASK_BACKGROUND_LEFT = 0x02,
+  PPUMASK_SPRITES_LEFT = 0x04,
+  PPUMASK_BACKGROUND = 0x08,
+  PPUMASK_SPRITES = 0x10,
+  PPUMASK_RENDERING = PPUMASK_BACKGROUND | PPUMASK_SPRITES,
+  PPUMASK_EMPHASIZE_RED = 0x20,
+  PPUMASK_EMPHASIZE_GREEN = 0x40,
+  PPUMASK_EMPHASIZE_BLUE = 0x80,
+  PPUMASK_EMPHASIS = 0xe0
+};
+
+/*
+ * Pixels in the framebuffer hold the palette index of their color in bits
+ * 0-5, and the color emphasis bits of PPUMASK in bits 6-8; see palette.h to
+ * convert them to RGB.
+ */
+#define PPU_PIXEL_EMPHASIS_SHIFT 6
+#define PPU_PIXEL_MASK 0x1ff
+
+enum PpuStatus
+{
+  PPUSTATUS_SPRITE_OVERFLOW = 0x20,
+  PPUSTATUS_SPRITE_0_HIT = 0x40,
+  PPUSTATUS_VBLANK = 0x80
+};
+
+/*
+ * Rendering accuracy. The scanline renderer draws every visible scanline at
+ * once, with the register state at the moment the scanline is reached;
+ * mid-scanline register changes only take effect on the next scanline, which
+ * is what batch runs need. The dot renderer steps the PPU dot by dot through
+ * the background and sprite fetch pipeline, such that mid-scanline changes,
+ * the exact dot of a sprite 0 hit, and the toggles of pattern table address
+ * line A12 are reproduced.
+ */
+enum PpuAccuracy
+{
+  PPU_ACCURACY_SCANLINE,
+  PPU_ACCURACY_DOT
+};
+
+/* Number of sprites fetched for a scanline. */
+#define PPU_SPRITES_PER_SCANLINE 8
+
+/*
+ * The picture processing unit. The PPU does not run in lockstep with the CPU;
+ * it catches up with the CPU whenever the CPU accesses one of its registers,
+ * at the end of every frame, and at `sync_dot` in case a mapper times IRQs with
+ * A12. It renders into a framebuffer of palette indices with emphasis.
+ */
+struct Ppu
+{
+  uint8_t ctrl;   /* $2000 */
+  uint8_t mask;   /* $2001 */
+  uint8_t status; /* $2002 */
+  uint8_t oam_address;
+
+  uint16_t v; /* current VRAM address */
+  uint16_t t; /* temporary VRAM address, the top left of the screen */
+  uint8_t x;  /* fine X scroll */
+  bool w;     /* first or second write to $2005/$2006 */
+
+  uint8_t read_buffer; /* $2007 read buffer */
+  uint8_t bus;         /* last value transferred through a register */
+
+  bool nmi; /* set when an NMI is raised, cleared by the console */
+
+  uint64_t dot;         /* dots elapsed since power on */
+  uint64_t frame_start; /* dot at which the current frame started */
+  uint64_t frame;       /* number of frames completed, i.e. VBlanks started */
+  bool odd_frame;
+  int event; /* next timing event of the current frame */
+  bool suppress_vblank;
+
+  enum PpuAccuracy accuracy;
+
+  /* While set, the PPU keeps its timing and side effects; VBlank, sprite 0
+   * hits, sprite overflow and A12, but leaves the framebuffer untouched, for
+   * frames nobody looks at. May be changed at any time, typically between
+   * frames. */
+  bool skip_render;
+
+  /* Dot renderer state; background shift registers, the tile fetched for the
+   * next 8 dots, and the sprites of the current scanline. */
+  uint16_t bg_low;
+  uint16_t bg_high;
+  uint16_t bg_attribute_low;
+  uint16_t bg_attribute_high;
+  uint8_t next_index;
+  uint8_t next_attribute;
+  uint8_t next_low;
+  uint8_t next_high;
+  int sprite_count;
+  bool sprite_zero; /* sprite 0 is the first sprite of the scanline */
+  uint8_t sprites[PPU_SPRITES_PER_SCANLINE][4]; /* secondary OAM */
+  uint8_t sprite_low[PPU_SPRITES_PER_SCANLINE];
+  uint8_t sprite_high[PPU_SPRITES_PER_SCANLINE];
+
+  /* Pattern table address line A12, as driven by the dot renderer and VRAM
+   * accesses through $2006/$2007. On every rising edge, `a12_rise` is called
+   * with the number of dots A12 was low, for mappers that count scanlines. */
+  bool a12;
+  uint64_t a12_fall;
+  void *a12_context;
+  void (*a12_rise)(void *context, uint64_t low_dots);
+
+  uint64_t sync_dot; /* dot to catch up at, or UINT64_MAX */
+
+  enum Mirroring mirroring;
+  bool chr_ram; /* pattern tables are writable */
+  uint8_t chr[0x2000];
+  /* Decoded pattern tables; shared for CHR ROM, or created on power on. Direct
+   * writes to `chr` after rendering started must be followed by
+   * tile_cache_invalidate. */
+  struct TileCache *tiles;
+  uint8_t nametables[0x1000];
+  uint8_t palette[32];
+  uint8_t oam[256];
+
+  uint16_t framebuffer[PPU_HEIGHT * PPU_WIDTH];
+};
+
+void ppu_power_on(struct Ppu *ppu, enum Mirroring mirroring);
+void ppu_power_off(struct Ppu *ppu);
+void ppu_set_accuracy(struct Ppu *ppu, enum PpuAccuracy accuracy);
+
+uint8_t ppu_read(struct Ppu *ppu, Address address);
+void ppu_write(struct Ppu *ppu, Address address, uint8_t value);
+void ppu_oam_dma(struct Ppu *ppu, const uint8_t *page);
+
+uint8_t ppu_memory_read(struct Ppu *ppu, Address address);
+void ppu_memory_write(struct Ppu *ppu, Address address, uint8_t value);
+
+void ppu_run_until(struct Ppu *ppu, uint64_t dot);
+uint64_t ppu_next_vblank(const struct Ppu *ppu);
+
+#endif
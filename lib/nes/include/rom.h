@@ -173,6 +173,8 @@ struct RomHeader
 struct RomHeader rom_make_header(uint8_t header_data[16]);
 void rom_prg_data(struct RomHeader *header, uint8_t *rom_data, uint8_t **prg_data,
                   size_t *prg_data_size);
+void rom_chr_data(struct RomHeader *header, uint8_t *rom_data, uint8_t **chr_data,
+                  size_t *chr_data_size);
 
 enum RomFormat rom_get_format(uint8_t rom_header[16]);
 int write_rom_information(FILE *fp, uint8_t *rom_data);
@@ -0,0 +1,65 @@
+#ifndef NEPNES_NES_TILE_CACHE_H
+#define NEPNES_NES_TILE_CACHE_H
+
+#include <stdint.h>
+
+/* Number of 16 byte tiles in the pattern tables at $0000-$1fff. */
+#define TILE_CACHE_TILES 512
+
+/* Flip orientations of a tile; bit 0 flips horizontally, bit 1 vertically, as
+ * bits 6 and 7 of the sprite attributes. */
+#define TILE_CACHE_FLIPS 4
+
+/*
+ * The pattern tables decoded to one byte per pixel, holding its 2-bit color,
+ * in all four flip orientations, such that rendering a tile row is an 8 byte
+ * copy rather than decoding two bit planes pixel by pixel.
+ *
+ * Caches of CHR ROM are built once, and shared by all PPUs with the same
+ * pattern tables, hence they must not be modified. Caches of CHR RAM are
+ * private to a PPU; a write to a tile marks it dirty, and the tile is decoded
+ * again when it is next used.
+ */
+struct TileCache
+{
+  uint8_t pixels[TILE_CACHE_FLIPS][TILE_CACHE_TILES][64];
+  uint64_t dirty[TILE_CACHE_TILES / 64]; /* tiles to decode before use */
+
+  /* Shared caches are kept in a list, keyed by the pattern tables. */
+  int references;
+  uint64_t hash;
+  uint8_t chr[0x2000];
+  struct TileCache *next;
+};
+
+struct TileCache *make_tile_cache(void);
+struct TileCache *tile_cache_share(const uint8_t *chr);
+void tile_cache_release(struct TileCache *cache);
+
+void tile_cache_decode(struct TileCache *cache, const uint8_t *chr, unsigned tile);
+
+/*
+ * Marks the tile at the given pattern table address for decoding.
+ */
+static inline void tile_cache_invalidate(struct TileCache *cache, unsigned address)
+{
+  const unsigned tile = (address >> 4) & (TILE_CACHE_TILES - 1);
+  cache->dirty[tile / 64] |= 1ull << (tile % 64);
+}
+
+/*
+ * Returns the 8 pixels of row `row` of the given tile in flip orientation
+ * `flip`, decoding the tile from `chr` first in case it is dirty.
+ */
+static inline const uint8_t *tile_cache_row(struct TileCache *cache, const uint8_t *chr,
+                                            unsigned tile, unsigned flip, unsigned row)
+{
+  if (cache->dirty[tile / 64] & (1ull << (tile % 64)))
+  {
+    tile_cache_decode(cache, chr, tile);
+  }
+
+  return cache->pixels[flip][tile] + row * 8;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef NEPNES_NES_VIDEO_H
+#define NEPNES_NES_VIDEO_H
+
+#include <lib/nes/include/ntsc.h>
+#include <lib/nes/include/palette.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/ring_buffer.h>
+#include <lib/std/include/scaler.h>
+#include <lib/std/include/thread_pool.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Filters converting framebuffers to 32-bit pixels; a plain palette lookup, or
+ * an emulation of the composite video signal, see ntsc.h.
+ */
+enum VideoFilter
+{
+  VIDEO_FILTER_PALETTE,
+  VIDEO_FILTER_NTSC
+};
+
+/*
+ * The output stage of the frame pipeline; converts frames of the PPU to
+ * pixels for display, with the filter it was initialized with. The palette
+ * filter is the default, and the cheapest one by far.
+ */
+struct VideoOutput
+{
+  enum VideoFilter filter;
+  struct Palette palette;
+  struct NtscFilter ntsc; /* only for VIDEO_FILTER_NTSC */
+};
+
+void video_output_init(struct VideoOutput *output, enum VideoFilter filter,
+                       enum PixelFormat format, struct thread_pool *pool);
+void video_output_destroy(struct VideoOutput *output);
+void video_output_convert(const struct VideoOutput *output, const struct Ppu *ppu,
+                          uint32_t *pixels);
+
+/*
+ * Formats of raw video streams. Y4M is understood by most encoders, e.g.
+ * `ffmpeg -i - out.mp4`; PPM is a sequence of binary PPM images, e.g. for
+ * `ffmpeg -f image2pipe -c:v ppm -i -`.
+ */
+enum VideoFormat
+{
+  VIDEO_FORMAT_Y4M,
+  VIDEO_FORMAT_PPM
+};
+
+/* Frame rate of the NTSC PPU, 1789773 * 3 / (341 * 262 - 0.5) frames per
+ * second, as the fraction used in Y4M headers. */
+#define VIDEO_FRAME_RATE "39375000:655171"
+
+/* Maximum number of frames waiting for the writer thread. */
+#define VIDEO_WRITER_CAPACITY 8
+
+/*
+ * The part of the picture that is written; a rectangle in PPU pixels, scaled
+ * up with the given scaler.
+ */
+struct VideoLayout
+{
+  int x;
+  int y;
+  int width;
+  int height;
+  enum scaler scaler;
+};
+
+/*
+ * Streams frames to a file from a background thread. Framebuffers are handed
+ * over to the writer thread through a lock-free ring buffer, and scaled and
+ * converted to RGB or YUV on that thread, so that the emulation thread never
+ * blocks on conversion or I/O, unless the writer thread can not keep up at
+ * all. The writer thread spreads scaling and conversion over a thread pool of
+ * its own.
+ */
+struct VideoWriter
+{
+  FILE *fp; /* stdout in case the file name is "-" */
+  enum VideoFormat format;
+  struct VideoLayout layout;
+  struct ring_buffer frames;
+
+  pthread_t thread;
+  atomic_bool is_closing;
+  atomic_int error;
+
+  /* Owned by the writer thread. */
+  struct thread_pool pool;
+  struct Palette palette;
+  uint16_t *framebuffer;
+  uint32_t *pixels; /* RGBA of the framebuffer */
+  uint32_t *scaled; /* RGBA of the scaled layout, unless not scaled */
+  uint8_t *out;
+  size_t out_size;
+};
+
+bool video_layout_valid(const struct VideoLayout *layout);
+
+int video_writer_open(struct VideoWriter *writer, const char *file_name, enum VideoFormat format,
+                      const struct VideoLayout *layout);
+void video_writer_push(struct VideoWriter *writer, const uint16_t *framebuffer);
+int video_writer_close(struct VideoWriter *writer);
+
+#endif
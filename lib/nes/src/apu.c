@@ -0,0 +1,691 @@
+#include <lib/nes/include/apu.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <string.h>
+
+/*
+ * Weights of the channels in the mix, per step of their output, in blip
+ * amplitude; the linear approximation of the mixer of the NES, scaled such
+ * that all channels at full volume stay below 32768.
+ */
+#define APU_PULSE_WEIGHT 246    /* 0.00752 */
+#define APU_TRIANGLE_WEIGHT 279 /* 0.00851 */
+#define APU_NOISE_WEIGHT 162    /* 0.00494 */
+#define APU_DMC_WEIGHT 110      /* 0.00335 */
+
+/* Delay in CPU cycles before a write to $4017 restarts the frame counter; one
+ * more in case the write happens in between APU cycles. */
+#define APU_FRAME_COUNTER_DELAY 3
+
+/* Number of CPU cycles the CPU is halted for every byte the DMC reads. */
+#define APU_DMC_DMA_CYCLES 4
+
+static const uint8_t apu_length_table[32] = {
+    10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60, 10, 14, 12, 26, 14,
+    12, 16,  24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30,
+};
+
+static const uint8_t apu_duty_table[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1},
+};
+
+static const uint8_t apu_triangle_table[32] = {
+    15, 14, 13, 12, 11, 10, 9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15,
+};
+
+static const uint16_t apu_noise_periods[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068,
+};
+
+static const uint16_t apu_dmc_periods[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54,
+};
+
+/* CPU cycles of the steps of the frame counter, from the start of the
+ * sequence, and the length of the sequence, in four and five step mode. The
+ * fourth step of the five step sequence does nothing, and is left out. */
+static const uint64_t apu_frame_steps[2][4] = {
+    {7457, 14913, 22371, 29829},
+    {7457, 14913, 22371, 37281},
+};
+static const uint64_t apu_frame_periods[2] = {29830, 37282};
+
+/*
+ * Changes the output of a channel at the given CPU cycle, and adds the change
+ * to the blip buffer.
+ */
+static inline void apu_output(struct Apu *apu, int *level, int value, uint64_t cycle)
+{
+  if (value != *level)
+  {
+    if (apu->blip)
+    {
+      blip_add_delta(apu->blip, cycle - apu->frame_start, value - *level);
+    }
+    *level = value;
+  }
+}
+
+/*
+ * Returns the number of timer clocks of the given period from `next` up to,
+ * but not including, `end`.
+ */
+static inline uint64_t apu_clocks_until(uint64_t next, uint64_t period, uint64_t end)
+{
+  return next < end ? (end - next + period - 1) / period : 0;
+}
+
+/* Envelopes. */
+
+static void apu_envelope_clock(struct ApuEnvelope *envelope)
+{
+  if (envelope->start)
+  {
+    envelope->start = false;
+    envelope->decay = 15;
+    envelope->divider = envelope->period;
+  }
+  else if (envelope->divider == 0)
+  {
+    envelope->divider = envelope->period;
+    if (envelope->decay > 0)
+    {
+      --envelope->decay;
+    }
+    else if (envelope->loop)
+    {
+      envelope->decay = 15;
+    }
+  }
+  else
+  {
+    --envelope->divider;
+  }
+}
+
+static inline int apu_envelope_volume(const struct ApuEnvelope *envelope)
+{
+  return envelope->constant ? envelope->period : envelope->decay;
+}
+
+/* Pulse channels. */
+
+static uint16_t apu_pulse_sweep_target(const struct ApuPulse *pulse)
+{
+  const int change = pulse->period >> pulse->sweep_shift;
+  if (!pulse->sweep_negate)
+  {
+    return pulse->period + change;
+  }
+  return MAX(0, pulse->period - change - pulse->ones_complement);
+}
+
+/*
+ * Returns whether the sweep unit silences the channel; periods below 8, and
+ * sweep targets out of range, whether the sweep is enabled or not.
+ */
+static bool apu_pulse_muted(const struct ApuPulse *pulse)
+{
+  return pulse->period < 8 || apu_pulse_sweep_target(pulse) > 0x7ff;
+}
+
+static int apu_pulse_volume(const struct ApuPulse *pulse)
+{
+  if (pulse->length == 0 || apu_pulse_muted(pulse))
+  {
+    return 0;
+  }
+  return apu_envelope_volume(&pulse->envelope) * APU_PULSE_WEIGHT;
+}
+
+static int apu_pulse_value(const struct ApuPulse *pulse)
+{
+  return apu_duty_table[pulse->duty][pulse->step] ? apu_pulse_volume(pulse) : 0;
+}
+
+static void apu_pulse_run(struct Apu *apu, struct ApuPulse *pulse, uint64_t end)
+{
+  const uint64_t period = 2 * (pulse->period + 1);
+  const int volume = apu_pulse_volume(pulse);
+
+  /* A silent channel only moves through its duty cycle. */
+  if (volume == 0)
+  {
+    const uint64_t clocks = apu_clocks_until(pulse->next, period, end);
+    pulse->step = (pulse->step + clocks) & 7;
+    pulse->next += clocks * period;
+    return;
+  }
+
+  const uint8_t *duty = apu_duty_table[pulse->duty];
+  for (; pulse->next < end; pulse->next += period)
+  {
+    pulse->step = (pulse->step + 1) & 7;
+    apu_output(apu, &pulse->level, duty[pulse->step] ? volume : 0, pulse->next);
+  }
+}
+
+static void apu_pulse_clock_sweep(struct ApuPulse *pulse)
+{
+  if (pulse->sweep_divider == 0 && pulse->sweep_enabled && pulse->sweep_shift > 0 &&
+      !apu_pulse_muted(pulse))
+  {
+    pulse->period = apu_pulse_sweep_target(pulse);
+  }
+
+  if (pulse->sweep_divider == 0 || pulse->sweep_reload)
+  {
+    pulse->sweep_divider = pulse->sweep_period;
+    pulse->sweep_reload = false;
+  }
+  else
+  {
+    --pulse->sweep_divider;
+  }
+}
+
+static void apu_pulse_write(struct ApuPulse *pulse, int reg, uint8_t value)
+{
+  switch (reg)
+  {
+    case 0:
+      pulse->duty = value >> 6;
+      pulse->halt = pulse->envelope.loop = value & 0x20;
+      pulse->envelope.constant = value & 0x10;
+      pulse->envelope.period = value & 0x0f;
+      break;
+    case 1:
+      pulse->sweep_enabled = value & 0x80;
+      pulse->sweep_period = (value >> 4) & 0x07;
+      pulse->sweep_negate = value & 0x08;
+      pulse->sweep_shift = value & 0x07;
+      pulse->sweep_reload = true;
+      break;
+    case 2:
+      pulse->period = (pulse->period & 0x700) | value;
+      break;
+    case 3:
+      pulse->period = (pulse->period & 0xff) | (value & 0x07) << 8;
+      if (pulse->enabled)
+      {
+        pulse->length = apu_length_table[value >> 3];
+      }
+      pulse->step = 0;
+      pulse->envelope.start = true;
+      break;
+  }
+}
+
+/* Triangle channel. */
+
+/*
+ * Returns whether the triangle steps through its sequence. Periods below 2
+ * are ultrasonic; the channel holds its output rather than alias.
+ */
+static bool apu_triangle_active(const struct ApuTriangle *triangle)
+{
+  return triangle->length > 0 && triangle->linear > 0 && triangle->period >= 2;
+}
+
+static void apu_triangle_run(struct Apu *apu, struct ApuTriangle *triangle, uint64_t end)
+{
+  const uint64_t period = triangle->period + 1;
+  if (!apu_triangle_active(triangle))
+  {
+    triangle->next += apu_clocks_until(triangle->next, period, end) * period;
+    return;
+  }
+
+  for (; triangle->next < end; triangle->next += period)
+  {
+    triangle->step = (triangle->step + 1) & 31;
+    apu_output(apu, &triangle->level, apu_triangle_table[triangle->step] * APU_TRIANGLE_WEIGHT,
+               triangle->next);
+  }
+}
+
+static void apu_triangle_clock_linear(struct ApuTriangle *triangle)
+{
+  if (triangle->linear_reload_flag)
+  {
+    triangle->linear = triangle->linear_reload;
+  }
+  else if (triangle->linear > 0)
+  {
+    --triangle->linear;
+  }
+
+  if (!triangle->control)
+  {
+    triangle->linear_reload_flag = false;
+  }
+}
+
+/* Noise channel. */
+
+static int apu_noise_volume(const struct ApuNoise *noise)
+{
+  return noise->length > 0 ? apu_envelope_volume(&noise->envelope) * APU_NOISE_WEIGHT : 0;
+}
+
+static void apu_noise_run(struct Apu *apu, struct ApuNoise *noise, uint64_t end)
+{
+  const int volume = apu_noise_volume(noise);
+  const int tap = noise->mode ? 6 : 1;
+  for (; noise->next < end; noise->next += noise->period)
+  {
+    const uint16_t feedback = (noise->lfsr ^ (noise->lfsr >> tap)) & 1;
+    noise->lfsr = (noise->lfsr >> 1) | feedback << 14;
+    apu_output(apu, &noise->level, noise->lfsr & 1 ? 0 : volume, noise->next);
+  }
+}
+
+/* DMC. */
+
+/*
+ * Starts the sample from its start address.
+ */
+static void apu_dmc_restart(struct ApuDmc *dmc)
+{
+  dmc->address = dmc->start_address;
+  dmc->bytes_remaining = dmc->start_length;
+}
+
+/*
+ * Fills the sample buffer with the next byte of the sample, if any; at the
+ * end of the sample, loops or raises an IRQ.
+ */
+static void apu_dmc_fetch(struct Apu *apu)
+{
+  struct ApuDmc *dmc = &apu->dmc;
+  if (dmc->buffer_full || dmc->bytes_remaining == 0)
+  {
+    return;
+  }
+
+  dmc->buffer = apu->memory[dmc->address];
+  dmc->buffer_full = true;
+  dmc->address = dmc->address == 0xffff ? 0x8000 : dmc->address + 1;
+  apu->dma_cycles += APU_DMC_DMA_CYCLES;
+
+  if (--dmc->bytes_remaining == 0)
+  {
+    if (dmc->loop)
+    {
+      apu_dmc_restart(dmc);
+    }
+    else if (dmc->irq_enabled)
+    {
+      apu->dmc_irq = true;
+    }
+  }
+}
+
+static void apu_dmc_run(struct Apu *apu, struct ApuDmc *dmc, uint64_t end)
+{
+  /* An idle DMC only counts down the bits of its output cycle. */
+  if (dmc->silence && !dmc->buffer_full && dmc->bytes_remaining == 0)
+  {
+    const uint64_t clocks = apu_clocks_until(dmc->next, dmc->period, end);
+    dmc->bits = 8 - (8 - dmc->bits + clocks) % 8;
+    dmc->next += clocks * dmc->period;
+    return;
+  }
+
+  for (; dmc->next < end; dmc->next += dmc->period)
+  {
+    if (!dmc->silence)
+    {
+      if (dmc->shift & 1)
+      {
+        dmc->output += dmc->output <= 125 ? 2 : 0;
+      }
+      else
+      {
+        dmc->output -= dmc->output >= 2 ? 2 : 0;
+      }
+      apu_output(apu, &dmc->level, dmc->output * APU_DMC_WEIGHT, dmc->next);
+    }
+    dmc->shift >>= 1;
+
+    if (--dmc->bits == 0)
+    {
+      dmc->bits = 8;
+      dmc->silence = !dmc->buffer_full;
+      if (dmc->buffer_full)
+      {
+        dmc->shift = dmc->buffer;
+        dmc->buffer_full = false;
+        apu_dmc_fetch(apu);
+      }
+    }
+  }
+}
+
+/* Frame counter. */
+
+/*
+ * Brings the output of every channel up to date with its state, after a
+ * register write or a frame counter step changed it.
+ */
+static void apu_update_outputs(struct Apu *apu)
+{
+  for (int i = 0; i < 2; ++i)
+  {
+    apu_output(apu, &apu->pulse[i].level, apu_pulse_value(&apu->pulse[i]), apu->cycle);
+  }
+
+  /* The triangle holds its output when halted. */
+  struct ApuNoise *noise = &apu->noise;
+  apu_output(apu, &noise->level, noise->lfsr & 1 ? 0 : apu_noise_volume(noise), apu->cycle);
+  apu_output(apu, &apu->dmc.level, apu->dmc.output * APU_DMC_WEIGHT, apu->cycle);
+}
+
+static void apu_clock_quarter_frame(struct Apu *apu)
+{
+  apu_envelope_clock(&apu->pulse[0].envelope);
+  apu_envelope_clock(&apu->pulse[1].envelope);
+  apu_envelope_clock(&apu->noise.envelope);
+  apu_triangle_clock_linear(&apu->triangle);
+}
+
+static void apu_clock_half_frame(struct Apu *apu)
+{
+  for (int i = 0; i < 2; ++i)
+  {
+    struct ApuPulse *pulse = &apu->pulse[i];
+    if (pulse->length > 0 && !pulse->halt)
+    {
+      --pulse->length;
+    }
+    apu_pulse_clock_sweep(pulse);
+  }
+
+  if (apu->triangle.length > 0 && !apu->triangle.control)
+  {
+    --apu->triangle.length;
+  }
+  if (apu->noise.length > 0 && !apu->noise.halt)
+  {
+    --apu->noise.length;
+  }
+}
+
+/*
+ * Returns the CPU cycle of the next step of the frame counter.
+ */
+static inline uint64_t apu_next_frame_step(const struct Apu *apu)
+{
+  return apu->sequence_start + apu_frame_steps[apu->five_step][apu->frame_step];
+}
+
+static void apu_clock_frame_counter(struct Apu *apu)
+{
+  apu_clock_quarter_frame(apu);
+  if (apu->frame_step == 1 || apu->frame_step == 3)
+  {
+    apu_clock_half_frame(apu);
+  }
+
+  if (apu->frame_step == 3)
+  {
+    if (!apu->five_step && !apu->irq_inhibit)
+    {
+      apu->frame_irq = true;
+    }
+    apu->sequence_start += apu_frame_periods[apu->five_step];
+    apu->frame_step = 0;
+  }
+  else
+  {
+    ++apu->frame_step;
+  }
+
+  apu_update_outputs(apu);
+}
+
+/*
+ * Restarts the sequence of the frame counter at the given CPU cycle.
+ */
+static void apu_restart_frame_counter(struct Apu *apu, uint64_t cycle)
+{
+  apu->sequence_start = cycle;
+  apu->frame_step = 0;
+}
+
+/*
+ * Powers on the APU at the given CPU cycle; all channels are silent, and the
+ * frame counter runs in four step mode with IRQs enabled. The DMC reads
+ * samples from the given CPU memory. No blip buffer is attached.
+ */
+void apu_power_on(struct Apu *apu, const uint8_t *memory, uint64_t cycle)
+{
+  memset(apu, 0, sizeof *apu);
+  apu->memory = memory;
+  apu->cycle = cycle;
+  apu->frame_start = cycle;
+
+  apu->pulse[0].ones_complement = true;
+  apu->noise.lfsr = 1;
+  apu->noise.period = apu_noise_periods[0];
+  apu->dmc.period = apu_dmc_periods[0];
+  apu->dmc.bits = 8;
+  apu->dmc.silence = true;
+
+  apu->pulse[0].next = apu->pulse[1].next = cycle;
+  apu->triangle.next = apu->noise.next = apu->dmc.next = cycle;
+  apu_restart_frame_counter(apu, cycle);
+}
+
+/*
+ * Handles a read of $4015, the only readable register; returns the status of
+ * the channels and the IRQs, and acknowledges the frame IRQ. The APU must have
+ * caught up with the read.
+ */
+uint8_t apu_read(struct Apu *apu, Address address)
+{
+  if (address != 0x4015)
+  {
+    return 0;
+  }
+
+  const uint8_t status = (apu->pulse[0].length > 0) | (apu->pulse[1].length > 0) << 1 |
+                         (apu->triangle.length > 0) << 2 | (apu->noise.length > 0) << 3 |
+                         (apu->dmc.bytes_remaining > 0) << 4 | apu->frame_irq << 6 |
+                         apu->dmc_irq << 7;
+  apu->frame_irq = false;
+  return status;
+}
+
+static void apu_write_status(struct Apu *apu, uint8_t value)
+{
+  apu->pulse[0].enabled = value & 0x01;
+  apu->pulse[1].enabled = value & 0x02;
+  apu->triangle.enabled = value & 0x04;
+  apu->noise.enabled = value & 0x08;
+  for (int i = 0; i < 2; ++i)
+  {
+    apu->pulse[i].length = apu->pulse[i].enabled ? apu->pulse[i].length : 0;
+  }
+  apu->triangle.length = apu->triangle.enabled ? apu->triangle.length : 0;
+  apu->noise.length = apu->noise.enabled ? apu->noise.length : 0;
+
+  apu->dmc_irq = false;
+  if (!(value & 0x10))
+  {
+    apu->dmc.bytes_remaining = 0;
+  }
+  else if (apu->dmc.bytes_remaining == 0)
+  {
+    apu_dmc_restart(&apu->dmc);
+    apu_dmc_fetch(apu);
+  }
+}
+
+/*
+ * Handles a write to one of the registers at $4000-$4013, $4015 and $4017.
+ * The APU must have caught up with the write.
+ */
+void apu_write(struct Apu *apu, Address address, uint8_t value)
+{
+  struct ApuTriangle *triangle = &apu->triangle;
+  struct ApuNoise *noise = &apu->noise;
+  struct ApuDmc *dmc = &apu->dmc;
+
+  switch (address)
+  {
+    case 0x4000:
+    case 0x4001:
+    case 0x4002:
+    case 0x4003:
+    case 0x4004:
+    case 0x4005:
+    case 0x4006:
+    case 0x4007:
+      apu_pulse_write(&apu->pulse[(address >> 2) & 1], address & 3, value);
+      break;
+    case 0x4008:
+      triangle->control = value & 0x80;
+      triangle->linear_reload = value & 0x7f;
+      break;
+    case 0x400a:
+      triangle->period = (triangle->period & 0x700) | value;
+      break;
+    case 0x400b:
+      triangle->period = (triangle->period & 0xff) | (value & 0x07) << 8;
+      if (triangle->enabled)
+      {
+        triangle->length = apu_length_table[value >> 3];
+      }
+      triangle->linear_reload_flag = true;
+      break;
+    case 0x400c:
+      noise->halt = noise->envelope.loop = value & 0x20;
+      noise->envelope.constant = value & 0x10;
+      noise->envelope.period = value & 0x0f;
+      break;
+    case 0x400e:
+      noise->mode = value & 0x80;
+      noise->period = apu_noise_periods[value & 0x0f];
+      break;
+    case 0x400f:
+      if (noise->enabled)
+      {
+        noise->length = apu_length_table[value >> 3];
+      }
+      noise->envelope.start = true;
+      break;
+    case 0x4010:
+      dmc->irq_enabled = value & 0x80;
+      dmc->loop = value & 0x40;
+      dmc->period = apu_dmc_periods[value & 0x0f];
+      apu->dmc_irq = dmc->irq_enabled && apu->dmc_irq;
+      break;
+    case 0x4011:
+      dmc->output = value & 0x7f;
+      break;
+    case 0x4012:
+      dmc->start_address = 0xc000 + value * 64;
+      break;
+    case 0x4013:
+      dmc->start_length = value * 16 + 1;
+      break;
+    case 0x4015:
+      apu_write_status(apu, value);
+      break;
+    case 0x4017:
+      apu->five_step = value & 0x80;
+      apu->irq_inhibit = value & 0x40;
+      apu->frame_irq = !apu->irq_inhibit && apu->frame_irq;
+      apu_restart_frame_counter(apu, apu->cycle + APU_FRAME_COUNTER_DELAY + (apu->cycle & 1));
+      if (apu->five_step)
+      {
+        apu_clock_quarter_frame(apu);
+        apu_clock_half_frame(apu);
+      }
+      break;
+    default:
+      break;
+  }
+
+  apu_update_outputs(apu);
+}
+
+/*
+ * Runs the APU until the given CPU cycle; every channel runs on its own up
+ * to the next step of the frame counter, which then updates the envelopes,
+ * length counters and sweeps.
+ */
+void apu_run_until(struct Apu *apu, uint64_t cycle)
+{
+  while (apu->cycle < cycle)
+  {
+    const uint64_t step = apu_next_frame_step(apu);
+    const uint64_t end = MIN(cycle, step);
+
+    apu_pulse_run(apu, &apu->pulse[0], end);
+    apu_pulse_run(apu, &apu->pulse[1], end);
+    apu_triangle_run(apu, &apu->triangle, end);
+    apu_noise_run(apu, &apu->noise, end);
+    apu_dmc_run(apu, &apu->dmc, end);
+    apu->cycle = end;
+
+    if (end == step)
+    {
+      apu_clock_frame_counter(apu);
+    }
+  }
+}
+
+/*
+ * Runs the APU until the given CPU cycle, and ends the frame of the blip
+ * buffer there; its samples can be read afterwards. Samples that are not read
+ * are dropped once they fill half of the buffer, such that the next frame
+ * fits.
+ */
+void apu_end_frame(struct Apu *apu, uint64_t cycle)
+{
+  NN_ZONE("audio mix");
+
+  apu_run_until(apu, cycle);
+  if (apu->blip)
+  {
+    blip_end_frame(apu->blip, apu->cycle - apu->frame_start);
+    const int excess = blip_samples_available(apu->blip) - apu->blip->capacity / 2;
+    if (excess > 0)
+    {
+      blip_read_samples(apu->blip, NULL, excess);
+    }
+  }
+  apu->frame_start = apu->cycle;
+}
+
+/*
+ * Returns the first CPU cycle at which the APU raises an IRQ, unless registers
+ * are written before; UINT64_MAX in case no IRQ is pending. The APU must be
+ * run until this cycle for `apu_irq` to report it.
+ */
+uint64_t apu_next_irq(const struct Apu *apu)
+{
+  uint64_t cycle = UINT64_MAX;
+  if (!apu->five_step && !apu->irq_inhibit && !apu->frame_irq)
+  {
+    cycle = apu->sequence_start + apu_frame_steps[0][3];
+  }
+
+  /* The last byte is read at the end of the output cycle of the byte before
+   * it; the DMC raises the IRQ once that timer clock ran. */
+  const struct ApuDmc *dmc = &apu->dmc;
+  if (dmc->irq_enabled && !dmc->loop && !apu->dmc_irq && dmc->bytes_remaining > 0)
+  {
+    const uint64_t clocks = dmc->bits - 1 + 8 * (dmc->bytes_remaining - 1);
+    cycle = MIN(cycle, dmc->next + clocks * dmc->period + 1);
+  }
+
+  return cycle;
+}
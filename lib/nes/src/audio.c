@@ -0,0 +1,361 @@
+#include <lib/nes/include/audio.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+/* Size of the header of a WAV file with a single data chunk. */
+#define AUDIO_WAV_HEADER_SIZE 44
+
+/*
+ * Returns the ratio to apply to the sample rate of a producer, given the fill
+ * level of the buffer it produces into, from 0 (empty) to 1 (full); producing
+ * faster while the buffer is less than half full, and slower while it is more
+ * than half full, steers the buffer to half full.
+ */
+double audio_rate_ratio(double fill)
+{
+  fill = MAX(0.0, MIN(fill, 1.0));
+  return 1.0 + AUDIO_MAX_RATE_DELTA * (1.0 - 2.0 * fill);
+}
+
+static void audio_put_le16(uint8_t *p, uint16_t x)
+{
+  p[0] = x;
+  p[1] = x >> 8;
+}
+
+static void audio_put_le32(uint8_t *p, uint32_t x)
+{
+  audio_put_le16(p, x);
+  audio_put_le16(p + 2, x >> 16);
+}
+
+/*
+ * Writes the header of a 16-bit mono WAV file with the given number of bytes
+ * of sample data; the largest size possible for streams of unknown length.
+ */
+static int audio_write_wav_header(FILE *fp, int sample_rate, uint32_t data_size)
+{
+  uint8_t header[AUDIO_WAV_HEADER_SIZE];
+  memcpy(header, "RIFF", 4);
+  audio_put_le32(header + 4, MIN(data_size, UINT32_MAX - 36) + 36);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  audio_put_le32(header + 16, 16);
+  audio_put_le16(header + 20, 1); /* PCM */
+  audio_put_le16(header + 22, 1); /* channels */
+  audio_put_le32(header + 24, sample_rate);
+  audio_put_le32(header + 28, sample_rate * sizeof(int16_t));
+  audio_put_le16(header + 32, sizeof(int16_t));
+  audio_put_le16(header + 34, 16);
+  memcpy(header + 36, "data", 4);
+  audio_put_le32(header + 40, data_size);
+
+  return fwrite(header, sizeof header, 1, fp) == 1 ? 0 : -1;
+}
+
+/*
+ * Plays the given samples; writes them to the file of a WAV sink.
+ */
+static int audio_sink_play(struct AudioSink *sink, const int16_t *samples, size_t count)
+{
+  atomic_fetch_add(&sink->played, count);
+  if (sink->type != AUDIO_SINK_WAV)
+  {
+    return 0;
+  }
+
+  uint8_t data[AUDIO_SINK_PERIOD * sizeof(int16_t)];
+  for (size_t i = 0; i < count; ++i)
+  {
+    audio_put_le16(data + 2 * i, samples[i]);
+  }
+  sink->data_size += count * sizeof(int16_t);
+  return fwrite(data, sizeof(int16_t), count, sink->fp) == count ? 0 : -1;
+}
+
+/*
+ * Returns the time at which the given sample is due, given the time at which
+ * the first sample was due. Times are derived from the sample count, rather
+ * than accumulated, so that rounding errors do not add up.
+ */
+static struct timespec audio_sample_time(struct timespec start, uint64_t sample, int sample_rate)
+{
+  start.tv_sec += sample / sample_rate;
+  start.tv_nsec += sample % sample_rate * 1000000000 / sample_rate;
+  if (start.tv_nsec >= 1000000000)
+  {
+    start.tv_nsec -= 1000000000;
+    ++start.tv_sec;
+  }
+  return start;
+}
+
+/*
+ * Body of the thread of a paced sink; plays a period of samples at a time, on
+ * the clock. Playing starts once the ring buffer is half full, as an audio
+ * device starts playing once its buffer is primed.
+ */
+static void audio_sink_run_paced(struct AudioSink *sink)
+{
+  const struct timespec idle = {0, 500 * 1000};
+  while (ring_buffer_size(&sink->samples) < AUDIO_SINK_CAPACITY / 2 &&
+         !atomic_load(&sink->is_closing))
+  {
+    nanosleep(&idle, NULL);
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (uint64_t sample = AUDIO_SINK_PERIOD; !atomic_load(&sink->is_closing);
+       sample += AUDIO_SINK_PERIOD)
+  {
+    const size_t count = ring_buffer_pop(&sink->samples, sink->period, AUDIO_SINK_PERIOD);
+    if (count < AUDIO_SINK_PERIOD)
+    {
+      memset(sink->period + count, 0, (AUDIO_SINK_PERIOD - count) * sizeof *sink->period);
+      atomic_fetch_add(&sink->underrun, AUDIO_SINK_PERIOD - count);
+    }
+
+    if (atomic_load(&sink->error) == 0 &&
+        audio_sink_play(sink, sink->period, AUDIO_SINK_PERIOD) != 0)
+    {
+      atomic_store(&sink->error, errno != 0 ? errno : EIO);
+    }
+
+    /* Wait until the period played. */
+    const struct timespec next = audio_sample_time(start, sample, sink->sample_rate);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+    {
+    }
+  }
+}
+
+/*
+ * Pops a period of samples, or what is there, and plays them. Returns the
+ * number of samples popped.
+ */
+static size_t audio_sink_consume(struct ring_buffer *rb, void *arg)
+{
+  struct AudioSink *sink = arg;
+
+  const size_t count = ring_buffer_pop(rb, sink->period, AUDIO_SINK_PERIOD);
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  NN_ZONE("audio period");
+  if (atomic_load(&sink->error) == 0 && audio_sink_play(sink, sink->period, count) != 0)
+  {
+    atomic_store(&sink->error, errno != 0 ? errno : EIO);
+  }
+  return count;
+}
+
+static void *audio_sink_run(void *arg)
+{
+  struct AudioSink *sink = arg;
+
+  NN_ZONE_THREAD_NAME("audio sink");
+
+  if (sink->paced)
+  {
+    audio_sink_run_paced(sink);
+  }
+  else
+  {
+    /* Not paced; play samples as they come. */
+    ring_buffer_drain(&sink->samples, &sink->is_closing, audio_sink_consume, sink);
+  }
+
+  return NULL;
+}
+
+/*
+ * Frees the ring buffer of the sink, and completes and closes its file, if
+ * any, unless it is stdout. Returns 0 on success, or -1 in case writing the
+ * file failed.
+ */
+static int audio_sink_free(struct AudioSink *sink)
+{
+  destroy_ring_buffer(&sink->samples);
+  destroy_resampler(&sink->resampler);
+  if (sink->type != AUDIO_SINK_WAV)
+  {
+    return 0;
+  }
+
+  if (sink->fp == stdout)
+  {
+    return fflush(stdout) == 0 ? 0 : -1;
+  }
+
+  /* Now that the size of the data is known, complete the header. */
+  int result = 0;
+  const uint32_t data_size = MIN(sink->data_size, UINT32_MAX - 36);
+  if (fseek(sink->fp, 0, SEEK_SET) != 0 ||
+      audio_write_wav_header(sink->fp, sink->sample_rate, data_size) != 0)
+  {
+    result = -1;
+  }
+  return fclose(sink->fp) == 0 ? result : -1;
+}
+
+/*
+ * Opens a sink of the given type that plays samples at the given rate, and
+ * starts its thread. A WAV sink creates the given file, or writes to stdout in
+ * case the file name is "-"; the file name of a null sink is ignored, and may
+ * be NULL. Returns 0 on success, or -1 in case the file could not be created
+ * or the thread could not be started, in which case `errno` is set.
+ *
+ * The sink embeds a ring buffer aligned to cache lines, hence it must be
+ * allocated with that alignment.
+ */
+int audio_sink_open(struct AudioSink *sink, enum AudioSinkType type, const char *file_name,
+                    int sample_rate, bool paced)
+{
+  memset(sink, 0, sizeof *sink);
+  sink->type = type;
+  sink->sample_rate = sample_rate;
+  sink->paced = paced;
+
+  if (type == AUDIO_SINK_WAV)
+  {
+    if (strcmp(file_name, "-") == 0)
+    {
+      sink->fp = stdout;
+    }
+    else if ((sink->fp = fopen(file_name, "wb")) == NULL)
+    {
+      return -1;
+    }
+
+    /* Streams get the largest size possible, files get their actual size on
+     * closing. */
+    const uint32_t data_size = sink->fp == stdout ? UINT32_MAX - 36 : 0;
+    if (audio_write_wav_header(sink->fp, sample_rate, data_size) != 0)
+    {
+      if (sink->fp != stdout)
+      {
+        fclose(sink->fp);
+      }
+      return -1;
+    }
+  }
+
+  sink->samples = make_ring_buffer(sizeof(int16_t), AUDIO_SINK_CAPACITY);
+  sink->resampler = make_resampler(AUDIO_SYNTHESIS_RATE, sample_rate);
+  atomic_init(&sink->is_closing, false);
+  atomic_init(&sink->error, 0);
+  atomic_init(&sink->played, 0);
+  atomic_init(&sink->underrun, 0);
+  atomic_init(&sink->overrun, 0);
+
+  int error;
+  if ((error = pthread_create(&sink->thread, NULL, audio_sink_run, sink)) != 0)
+  {
+    audio_sink_free(sink);
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Hands the given samples over to the sink thread. A paced sink drops the
+ * samples that do not fit, and counts them as overrun; otherwise, waits for
+ * the sink thread to catch up while the ring buffer is full. Returns the
+ * number of samples pushed.
+ */
+size_t audio_sink_push(struct AudioSink *sink, const int16_t *samples, size_t count)
+{
+  size_t pushed = ring_buffer_push(&sink->samples, samples, count);
+  if (sink->paced)
+  {
+    atomic_fetch_add(&sink->overrun, count - pushed);
+    return pushed;
+  }
+
+  while (pushed < count)
+  {
+    sched_yield();
+    pushed += ring_buffer_push(&sink->samples, samples + pushed, count - pushed);
+  }
+  return pushed;
+}
+
+/*
+ * Resamples the samples available in the given blip buffer to the sample rate
+ * of the sink, pushes them to the sink, and adjusts the sample rate of the
+ * blip buffer to the fill level of the sink, for its next frame. The blip
+ * buffer must be made for AUDIO_SYNTHESIS_RATE and the given clock rate.
+ */
+void audio_sink_push_blip(struct AudioSink *sink, struct blip_buffer *blip, double clock_rate)
+{
+  NN_ZONE("audio resample");
+
+  /* Every block read from the blip buffer fits into the resampler, as the
+   * resampler is drained after every block. */
+  int16_t samples[AUDIO_SINK_PERIOD];
+  int count;
+  while ((count = blip_read_samples(blip, samples, AUDIO_SINK_PERIOD)) > 0)
+  {
+    resampler_write(&sink->resampler, samples, count);
+    while ((count = resampler_read(&sink->resampler, samples, AUDIO_SINK_PERIOD)) > 0)
+    {
+      audio_sink_push(sink, samples, count);
+    }
+  }
+
+  blip_set_rates(blip, clock_rate, AUDIO_SYNTHESIS_RATE * audio_sink_rate_ratio(sink));
+}
+
+/*
+ * Returns the fill level of the ring buffer of the sink, from 0 (empty) to 1
+ * (full). The level is only an approximation while the sink thread runs.
+ */
+double audio_sink_fill(struct AudioSink *sink)
+{
+  return (double)ring_buffer_size(&sink->samples) / sink->samples.capacity;
+}
+
+/*
+ * Returns the ratio to apply to the sample rate of samples pushed to the sink,
+ * to keep the ring buffer of a paced sink half full; 1 for sinks that are not
+ * paced, these never run dry.
+ */
+double audio_sink_rate_ratio(struct AudioSink *sink)
+{
+  return sink->paced ? audio_rate_ratio(audio_sink_fill(sink)) : 1.0;
+}
+
+/*
+ * Plays all pending samples unless the sink is paced, stops the sink thread,
+ * and closes the file, if any. Returns 0 in case all samples were played
+ * successfully, or -1 otherwise, in which case `errno` is set.
+ */
+int audio_sink_close(struct AudioSink *sink)
+{
+  atomic_store(&sink->is_closing, true);
+  pthread_join(sink->thread, NULL);
+
+  int error = atomic_load(&sink->error);
+  if (audio_sink_free(sink) != 0 && error == 0)
+  {
+    error = errno;
+  }
+
+  if (error != 0)
+  {
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
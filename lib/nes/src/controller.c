@@ -0,0 +1,94 @@
+#include <lib/nes/include/controller.h>
+
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+
+/*
+ * Handles a write to $4016; bit 0 is the strobe bit.
+ */
+void controller_write(struct Controller *controller, uint8_t value)
+{
+  controller->strobe = value & 0x01;
+  if (controller->strobe)
+  {
+    controller->shift = controller->buttons;
+    controller->reads = 0;
+  }
+}
+
+/*
+ * Handles a read of $4016 or $4017; returns the next button in bit 0.
+ */
+uint8_t controller_read(struct Controller *controller)
+{
+  if (controller->strobe)
+  {
+    return controller->buttons & BUTTON_A;
+  }
+
+  if (controller->reads >= 8)
+  {
+    return 1;
+  }
+
+  const uint8_t bit = controller->shift & 0x01;
+  controller->shift >>= 1;
+  ++controller->reads;
+  return bit;
+}
+
+/*
+ * Parses a '+' separated list of button names, e.g. "A+RIGHT", into a
+ * combination of ControllerButton values. A single '.' denotes no buttons.
+ * Returns 0 on success, or -1 in case of an unknown button name, in which
+ * case errno is set to EINVAL.
+ */
+int controller_parse_buttons(const char *s, uint8_t *buttons)
+{
+  static const struct
+  {
+    const char *name;
+    enum ControllerButton button;
+  } names[] = {
+      {"A", BUTTON_A},
+      {"B", BUTTON_B},
+      {"SELECT", BUTTON_SELECT},
+      {"START", BUTTON_START},
+      {"UP", BUTTON_UP},
+      {"DOWN", BUTTON_DOWN},
+      {"LEFT", BUTTON_LEFT},
+      {"RIGHT", BUTTON_RIGHT},
+  };
+
+  *buttons = 0;
+  if (strcmp(s, ".") == 0)
+  {
+    return 0;
+  }
+
+  while (*s)
+  {
+    const size_t length = strcspn(s, "+");
+
+    size_t i;
+    for (i = 0; i < sizeof names / sizeof names[0]; ++i)
+    {
+      if (strlen(names[i].name) == length && strncasecmp(s, names[i].name, length) == 0)
+      {
+        *buttons |= names[i].button;
+        break;
+      }
+    }
+    if (i == sizeof names / sizeof names[0])
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    s += length;
+    s += *s == '+';
+  }
+
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <lib/nes/include/input.h>
+#include <lib/std/include/util.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Parses a single non-empty line of an input script. Returns 0 on success, or
+ * -1 in case the line is malformed.
+ */
+static int input_parse_line(char *line, struct InputEvent *event)
+{
+  char *save;
+  const char *frame = strtok_r(line, " \t\r\n", &save);
+  const char *buttons[3] = {0};
+  for (int i = 0; i < 3; ++i)
+  {
+    buttons[i] = strtok_r(NULL, " \t\r\n", &save);
+  }
+
+  char *end;
+  errno = 0;
+  event->frame = strtoull(frame, &end, 10);
+  if (errno != 0 || *end != '\0' || buttons[0] == NULL || buttons[2] != NULL)
+  {
+    return -1;
+  }
+
+  event->buttons[1] = 0;
+  for (int i = 0; i < 2 && buttons[i]; ++i)
+  {
+    if (controller_parse_buttons(buttons[i], &event->buttons[i]) != 0)
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Reads the input script from the given file. Returns 0 on success, or -1 in
+ * case of an error, in which case errno is set. In case the script is
+ * malformed, errno is set to EINVAL, and `error_line` holds the offending line
+ * number.
+ */
+int input_script_read(struct InputScript *script, const char *file_name)
+{
+  memset(script, 0, sizeof *script);
+
+  FILE *fp;
+  if ((fp = fopen(file_name, "r")) == NULL)
+  {
+    return -1;
+  }
+
+  char line[256];
+  size_t line_number = 0;
+  while (fgets(line, sizeof line, fp))
+  {
+    ++line_number;
+
+    const char *s = line + strspn(line, " \t\r\n");
+    if (*s == '\0' || *s == '#')
+    {
+      continue;
+    }
+
+    struct InputEvent event;
+    if (input_parse_line(line, &event) != 0 ||
+        (script->size > 0 && event.frame < script->events[script->size - 1].frame))
+    {
+      script->error_line = line_number;
+      fclose(fp);
+      errno = EINVAL;
+      return -1;
+    }
+
+    if (script->size == script->capacity)
+    {
+      script->capacity = MAX(64, 2 * script->capacity);
+      if ((script->events = realloc(script->events, script->capacity * sizeof *script->events)) ==
+          NULL)
+      {
+        nn_quit("Could not allocate %zu input events", script->capacity);
+      }
+    }
+    script->events[script->size++] = event;
+  }
+
+  const int error = ferror(fp);
+  fclose(fp);
+  if (error)
+  {
+    errno = EIO;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Sets the buttons of both controllers to the state scripted for the given
+ * frame. Frames must be applied in ascending order.
+ */
+void input_script_apply(struct InputScript *script, uint64_t frame,
+                        struct Controller controllers[2])
+{
+  while (script->next < script->size && script->events[script->next].frame <= frame)
+  {
+    const struct InputEvent *event = &script->events[script->next++];
+    controllers[0].buttons = event->buttons[0];
+    controllers[1].buttons = event->buttons[1];
+  }
+}
+
+/*
+ * Frees dynamically allocated memory for an input script.
+ */
+void destroy_input_script(struct InputScript *script)
+{
+  free(script->events);
+}
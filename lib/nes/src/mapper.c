@@ -1,4 +1,6 @@
 #include <lib/nes/include/mapper.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/nes/include/tile_cache.h>
 
 #include <string.h>
 
@@ -25,6 +27,31 @@ static int nrom_initialize_cpu(struct Cpu *cpu, uint8_t *prg_data, size_t prg_si
   return 0;
 }
 
+/*
+ * Maps the 8KB of CHR ROM to the pattern tables at 0x0000-0x1fff. Without CHR
+ * ROM, the pattern tables are 8KB of CHR RAM.
+ */
+static int nrom_initialize_ppu(struct Ppu *ppu, uint8_t *chr_data, size_t chr_size)
+{
+  if (chr_size != 0 && chr_size != 0x2000)  // CHR RAM or 8Kb
+  {
+    return MAPPER_ERR_NROM_UNEXPECTED_CHR_SIZE;
+  }
+
+  ppu->chr_ram = chr_size == 0;
+  if (ppu->chr_ram)
+  {
+    memset(ppu->chr, 0, sizeof ppu->chr);
+  }
+  else
+  {
+    memcpy(ppu->chr, chr_data, chr_size);
+    ppu->tiles = tile_cache_share(ppu->chr);
+  }
+
+  return 0;
+}
+
 int mapper_initialize_cpu(enum Mapper mapper, struct Cpu *cpu, uint8_t *prg_data, size_t prg_size)
 {
   switch (mapper)
@@ -36,3 +63,15 @@ int mapper_initialize_cpu(enum Mapper mapper, struct Cpu *cpu, uint8_t *prg_data
       return MAPPER_ERR_UNSUPPORTED;
   }
 }
+
+int mapper_initialize_ppu(enum Mapper mapper, struct Ppu *ppu, uint8_t *chr_data, size_t chr_size)
+{
+  switch (mapper)
+  {
+    case MAPPER_NROM:
+      return nrom_initialize_ppu(ppu, chr_data, chr_size);
+      break;
+    default:
+      return MAPPER_ERR_UNSUPPORTED;
+  }
+}
@@ -0,0 +1,359 @@
+#include <lib/nes/include/mapper.h>
+#include <lib/nes/include/nes.h>
+#include <lib/std/include/hash.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <errno.h>
+#include <string.h>
+
+/* Upper bits of controller reads, left on the data bus from the address. */
+#define NES_CONTROLLER_OPEN_BUS 0x40
+
+/* Number of CPU cycles the CPU is halted by an OAM DMA, plus one on odd
+ * cycles. */
+#define NES_OAM_DMA_CYCLES 513
+
+/*
+ * Converts a PPU dot to the first CPU cycle at or after it.
+ */
+static inline uint64_t nes_dot_to_cycle(uint64_t dot)
+{
+  return (dot + PPU_DOTS_PER_CPU_CYCLE - 1) / PPU_DOTS_PER_CPU_CYCLE;
+}
+
+/*
+ * Switches counting hardware events from the CPU batch to the PPU, or to the
+ * APU, in case events are counted; for catching up on a register access in
+ * the middle of a batch.
+ */
+static inline void nes_perf_suspend_batch(struct Nes *nes, bool apu)
+{
+  struct NesPerf *perf = nes->perf;
+  if (perf)
+  {
+    perf_region_end(perf->counters, &perf->cpu, 0);
+    perf_region_begin(perf->counters, apu ? &perf->apu : &perf->ppu);
+  }
+}
+
+/*
+ * Switches counting hardware events back to the CPU batch, see
+ * `nes_perf_suspend_batch`.
+ */
+static inline void nes_perf_resume_batch(struct Nes *nes, bool apu)
+{
+  struct NesPerf *perf = nes->perf;
+  if (perf)
+  {
+    perf_region_end(perf->counters, apu ? &perf->apu : &perf->ppu, 0);
+    perf_region_begin(perf->counters, &perf->cpu);
+  }
+}
+
+/*
+ * Advances the APU to the given CPU cycle, and halts the CPU for the cycles
+ * the DMC read samples meanwhile.
+ */
+static void nes_apu_run_until(struct Nes *nes, uint64_t cycle)
+{
+  apu_run_until(&nes->apu, cycle);
+  nes->cpu.cycle += nes->apu.dma_cycles;
+  nes->apu.dma_cycles = 0;
+}
+
+/*
+ * Ends the current batch of instructions early, in case an access to the APU
+ * raised an IRQ, or moved its next IRQ forward.
+ */
+static void nes_apu_reschedule(struct Nes *nes)
+{
+  const uint64_t irq = apu_irq(&nes->apu) ? 0 : apu_next_irq(&nes->apu);
+  nes->batch_end = MIN(nes->batch_end, irq);
+}
+
+/*
+ * Advances the PPU to the current CPU cycle, and the APU in case one of its
+ * IRQs is due, and handles the interrupts they raised, if any.
+ */
+static void nes_catch_up(struct Nes *nes)
+{
+  ppu_run_until(&nes->ppu, nes->cpu.cycle * PPU_DOTS_PER_CPU_CYCLE);
+
+  if (nes->ppu.nmi)
+  {
+    nes->ppu.nmi = false;
+    cpu_nmi(&nes->cpu);
+  }
+
+  if (nes->cpu.cycle >= apu_next_irq(&nes->apu))
+  {
+    nes_apu_run_until(nes, nes->cpu.cycle);
+  }
+  if (apu_irq(&nes->apu))
+  {
+    cpu_irq(&nes->cpu);
+  }
+}
+
+static uint8_t nes_io_read(void *context, Address address)
+{
+  struct Nes *nes = context;
+  if (address < 0x4000)
+  {
+    nes_perf_suspend_batch(nes, false);
+    ppu_run_until(&nes->ppu, nes->io.cycle * PPU_DOTS_PER_CPU_CYCLE);
+    nes_perf_resume_batch(nes, false);
+    return ppu_read(&nes->ppu, address);
+  }
+
+  switch (address)
+  {
+    case 0x4015:
+    {
+      nes_perf_suspend_batch(nes, true);
+      nes_apu_run_until(nes, nes->io.cycle);
+      nes_perf_resume_batch(nes, true);
+      const uint8_t status = apu_read(&nes->apu, address);
+      nes_apu_reschedule(nes);
+      return status;
+    }
+    case 0x4016:
+      return NES_CONTROLLER_OPEN_BUS | controller_read(&nes->controllers[0]);
+    case 0x4017:
+      return NES_CONTROLLER_OPEN_BUS | controller_read(&nes->controllers[1]);
+    default:
+      return nes->cpu.ram[address];
+  }
+}
+
+static void nes_io_write(void *context, Address address, uint8_t value)
+{
+  struct Nes *nes = context;
+  if (address < 0x4000)
+  {
+    /* Writes are forwarded after the instruction completed, hence an NMI
+     * raised by enabling NMIs during VBlank can be handled right away. */
+    nes_perf_suspend_batch(nes, false);
+    ppu_run_until(&nes->ppu, nes->io.cycle * PPU_DOTS_PER_CPU_CYCLE);
+    ppu_write(&nes->ppu, address, value);
+    nes_catch_up(nes);
+    nes_perf_resume_batch(nes, false);
+    return;
+  }
+
+  if (address <= 0x4013 || address == 0x4015 || address == 0x4017)
+  {
+    nes_perf_suspend_batch(nes, true);
+    nes_apu_run_until(nes, nes->io.cycle);
+    apu_write(&nes->apu, address, value);
+    nes_perf_resume_batch(nes, true);
+    nes_apu_reschedule(nes);
+    return;
+  }
+
+  switch (address)
+  {
+    case 0x4014:
+      nes_perf_suspend_batch(nes, false);
+      ppu_run_until(&nes->ppu, nes->io.cycle * PPU_DOTS_PER_CPU_CYCLE);
+      nes_perf_resume_batch(nes, false);
+      ppu_oam_dma(&nes->ppu, nes->cpu.ram + (value << 8));
+      nes->cpu.cycle += NES_OAM_DMA_CYCLES + (nes->cpu.cycle & 1);
+      break;
+    case 0x4016:
+      controller_write(&nes->controllers[0], value);
+      controller_write(&nes->controllers[1], value);
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * Inserts the given ROM, and powers on the console. Returns 0 on success, -1
+ * in case the data is not a NES ROM, in which case errno is set to EINVAL, or
+ * one of the MapperErrorCode values in case the cartridge is not supported.
+ */
+int nes_load(struct Nes *nes, uint8_t *rom_data, size_t rom_size)
+{
+  memset(nes, 0, sizeof *nes);
+
+  if (rom_size < 16 || (nes->header = rom_make_header(rom_data)).rom_format == RF_UNKNOWN)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  uint8_t *prg_data;
+  size_t prg_size;
+  rom_prg_data(&nes->header, rom_data, &prg_data, &prg_size);
+  uint8_t *chr_data;
+  size_t chr_size;
+  rom_chr_data(&nes->header, rom_data, &chr_data, &chr_size);
+  if (chr_data + chr_size > rom_data + rom_size)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int error_code;
+  if ((error_code = mapper_initialize_cpu(nes->header.mapper, &nes->cpu, prg_data, prg_size)) !=
+          0 ||
+      (error_code = mapper_initialize_ppu(nes->header.mapper, &nes->ppu, chr_data, chr_size)) != 0)
+  {
+    return error_code;
+  }
+
+  nes->io = (struct CpuIo){
+      .begin = 0x2000,
+      .end = 0x401f,
+      .context = nes,
+      .read = nes_io_read,
+      .write = nes_io_write,
+  };
+  nes->cpu.io = &nes->io;
+
+  cpu_power_on(&nes->cpu);
+  ppu_power_on(&nes->ppu, nes->header.mirroring);
+  apu_power_on(&nes->apu, nes->cpu.ram, nes->cpu.cycle);
+  nes->first_cycle = nes->cpu.cycle;
+  nes->trace_flags = 0;
+
+  return 0;
+}
+
+/*
+ * Removes the cartridge, and releases the resources of the console.
+ */
+void nes_unload(struct Nes *nes)
+{
+  ppu_power_off(&nes->ppu);
+}
+
+/*
+ * Creates the regions in which hardware events of a console are counted, with
+ * the given counters.
+ */
+struct NesPerf make_nes_perf(const struct perf_counters *counters)
+{
+  return (struct NesPerf){
+      .counters = counters,
+      .cpu = make_perf_region("cpu batch"),
+      .ppu = make_perf_region("ppu catch-up"),
+      .apu = make_perf_region("apu catch-up"),
+  };
+}
+
+/*
+ * Returns whether the current batch of instructions continues; until its end,
+ * or until the CPU unmasks an IRQ that was pending at its start.
+ */
+static inline bool nes_batch_continues(const struct Nes *nes, bool irq)
+{
+  return nes->cpu.cycle < nes->batch_end && !(irq && !(nes->cpu.P & FLAGS_INTERRUPT_DISABLE));
+}
+
+/*
+ * Runs the console until the given CPU cycle is reached, or until the end of
+ * the current frame, whichever comes first. Instructions are never
+ * interrupted, hence the console may run a few cycles past either.
+ */
+void nes_run_until(struct Nes *nes, uint64_t cycle)
+{
+  NN_ZONE("CPU batch");
+
+  struct NesPerf *perf = nes->perf;
+  const uint64_t frame = nes->ppu.frame;
+  while (nes->ppu.frame == frame && nes->cpu.cycle < cycle)
+  {
+    /* Nothing but an NMI at the start of VBlank, or an IRQ of the APU,
+     * interrupts the CPU, as long as it does not access the PPU or the APU,
+     * or a mapper asks to synchronize. */
+    const uint64_t dot = MIN(ppu_next_vblank(&nes->ppu), nes->ppu.sync_dot);
+    nes->batch_end = MIN(MIN(cycle, nes_dot_to_cycle(dot)), apu_next_irq(&nes->apu));
+    const bool irq = apu_irq(&nes->apu);
+    if (perf)
+    {
+      perf_region_begin(perf->counters, &perf->cpu);
+    }
+
+    uint64_t instructions = 0;
+    if (nes->trace)
+    {
+      while (nes_batch_continues(nes, irq))
+      {
+        struct TraceRecord record = make_trace_record(&nes->cpu);
+        record.flags = nes->trace_flags;
+        nes->trace_flags = 0;
+        trace_writer_push(nes->trace, &record);
+
+        cpu_execute_next_instruction(&nes->cpu);
+        ++instructions;
+      }
+    }
+    else
+    {
+      while (nes_batch_continues(nes, irq))
+      {
+        cpu_execute_next_instruction(&nes->cpu);
+        ++instructions;
+      }
+    }
+
+    if (perf)
+    {
+      perf_region_end(perf->counters, &perf->cpu, instructions);
+      perf->frame_instructions += instructions;
+      perf_region_begin(perf->counters, &perf->ppu);
+    }
+    nes_catch_up(nes);
+    if (perf)
+    {
+      perf_region_end(perf->counters, &perf->ppu, instructions);
+    }
+  }
+
+  if (nes->ppu.frame != frame)
+  {
+    nes->trace_flags |= TRACE_RECORD_FRAME_START;
+    if (perf)
+    {
+      perf_region_begin(perf->counters, &perf->apu);
+    }
+    apu_end_frame(&nes->apu, nes->cpu.cycle);
+    if (perf)
+    {
+      perf_region_end(perf->counters, &perf->apu, perf->frame_instructions);
+      perf->frame_instructions = 0;
+    }
+    nes->cpu.cycle += nes->apu.dma_cycles;
+    nes->apu.dma_cycles = 0;
+  }
+}
+
+/*
+ * Runs the console until the end of the current frame.
+ */
+void nes_run_frame(struct Nes *nes)
+{
+  nes_run_until(nes, UINT64_MAX);
+}
+
+/*
+ * Returns a hash of the framebuffer, i.e. of the palette indices and emphasis
+ * of the last picture, such that runs can be compared without converting
+ * pictures to RGB.
+ */
+uint64_t nes_frame_hash(const struct Nes *nes)
+{
+  return nn_hash64(nes->ppu.framebuffer, sizeof nes->ppu.framebuffer);
+}
+
+/*
+ * Returns a hash of the work RAM.
+ */
+uint64_t nes_ram_hash(const struct Nes *nes)
+{
+  return nn_hash64(nes->cpu.ram, NES_WORK_RAM_SIZE);
+}
@@ -0,0 +1,303 @@
+#include <lib/nes/include/nsf.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+/* Offsets of the fields of the header. */
+#define NSF_VERSION 0x05
+#define NSF_SONGS 0x06
+#define NSF_STARTING_SONG 0x07
+#define NSF_LOAD_ADDRESS 0x08
+#define NSF_INIT_ADDRESS 0x0a
+#define NSF_PLAY_ADDRESS 0x0c
+#define NSF_NAME 0x0e
+#define NSF_ARTIST 0x2e
+#define NSF_COPYRIGHT 0x4e
+#define NSF_NTSC_SPEED 0x6e
+#define NSF_BANKS 0x70
+#define NSF_CHIPS 0x7b
+
+/* Speed of tunes that leave it zero; the frame rate of the NTSC NES. */
+#define NSF_DEFAULT_SPEED 16639
+
+/* CPU cycles of the JSR through which players call the routines of a tune. */
+#define NSF_CALL_CYCLES 6
+
+static uint16_t nsf_read_le16(const uint8_t *p)
+{
+  return p[0] | p[1] << 8;
+}
+
+/*
+ * Copies a string field of the header, which need not be terminated.
+ */
+static void nsf_read_string(char out[33], const uint8_t *p)
+{
+  memcpy(out, p, 32);
+  out[32] = '\0';
+}
+
+/*
+ * Parses the header of the given NSF data. Returns 0 on success, or -1 in case
+ * the data is not an NSF file, in which case errno is set to EINVAL.
+ */
+int nsf_parse_header(struct NsfHeader *header, const uint8_t *data, size_t size)
+{
+  memset(header, 0, sizeof *header);
+  if (size < NSF_HEADER_SIZE || memcmp(data, "NESM\x1a", 5) != 0 || data[NSF_SONGS] == 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  header->version = data[NSF_VERSION];
+  header->songs = data[NSF_SONGS];
+  header->starting_song = MAX(1, MIN(data[NSF_STARTING_SONG], header->songs)) - 1;
+  header->load_address = nsf_read_le16(data + NSF_LOAD_ADDRESS);
+  header->init_address = nsf_read_le16(data + NSF_INIT_ADDRESS);
+  header->play_address = nsf_read_le16(data + NSF_PLAY_ADDRESS);
+  nsf_read_string(header->name, data + NSF_NAME);
+  nsf_read_string(header->artist, data + NSF_ARTIST);
+  nsf_read_string(header->copyright, data + NSF_COPYRIGHT);
+  header->ntsc_speed = nsf_read_le16(data + NSF_NTSC_SPEED);
+  memcpy(header->banks, data + NSF_BANKS, sizeof header->banks);
+  header->chips = data[NSF_CHIPS];
+
+  for (size_t i = 0; i < sizeof header->banks; ++i)
+  {
+    header->bank_switched |= header->banks[i] != 0;
+  }
+
+  /* Without bank switching, the data is loaded in place, which must lie
+   * within the cartridge space. */
+  if (!header->bank_switched && header->load_address < 0x6000)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Maps the given bank of the data to the given 4KB slot of $8000-$ffff. The
+ * first bank starts at the load address rounded down to a bank boundary,
+ * hence is padded with zeroes up to the load address; so are banks past the
+ * end of the data.
+ */
+static void nsf_switch_bank(struct NsfPlayer *player, int slot, uint8_t bank)
+{
+  uint8_t *out = player->cpu.ram + 0x8000 + slot * NSF_BANK_SIZE;
+  memset(out, 0, NSF_BANK_SIZE);
+
+  const long padding = player->header.load_address & (NSF_BANK_SIZE - 1);
+  const long start = (long)bank * NSF_BANK_SIZE - padding;
+  const long begin = MAX(start, 0);
+  const long end = MIN(start + NSF_BANK_SIZE, (long)player->data_size);
+  if (begin < end)
+  {
+    memcpy(out + (begin - start), player->data + begin, end - begin);
+  }
+}
+
+/*
+ * Advances the APU to the given CPU cycle, and halts the CPU for the cycles
+ * the DMC read samples meanwhile.
+ */
+static void nsf_apu_run_until(struct NsfPlayer *player, uint64_t cycle)
+{
+  apu_run_until(&player->apu, cycle);
+  player->cpu.cycle += player->apu.dma_cycles;
+  player->apu.dma_cycles = 0;
+}
+
+static uint8_t nsf_io_read(void *context, Address address)
+{
+  struct NsfPlayer *player = context;
+  if (address == 0x4015)
+  {
+    nsf_apu_run_until(player, player->io.cycle);
+    return apu_read(&player->apu, address);
+  }
+  return player->cpu.ram[address];
+}
+
+static void nsf_io_write(void *context, Address address, uint8_t value)
+{
+  struct NsfPlayer *player = context;
+  if (address <= 0x4013 || address == 0x4015 || address == 0x4017)
+  {
+    nsf_apu_run_until(player, player->io.cycle);
+    apu_write(&player->apu, address, value);
+  }
+  else if (address >= NSF_BANK_REGISTERS && player->header.bank_switched)
+  {
+    nsf_switch_bank(player, address - NSF_BANK_REGISTERS, value);
+  }
+}
+
+/*
+ * Loads the given NSF data into the player; song `header.starting_song` is
+ * to be started next. Returns 0 on success, or -1 in case the data is not an
+ * NSF file, in which case errno is set to EINVAL.
+ */
+int nsf_load(struct NsfPlayer *player, const uint8_t *data, size_t size)
+{
+  memset(player, 0, sizeof *player);
+  if (nsf_parse_header(&player->header, data, size) != 0)
+  {
+    return -1;
+  }
+
+  player->data = data + NSF_HEADER_SIZE;
+  player->data_size = size - NSF_HEADER_SIZE;
+
+  /* The APU, and the bank registers, are the only devices. */
+  player->io = (struct CpuIo){
+      .begin = 0x4000,
+      .end = 0x5fff,
+      .context = player,
+      .read = nsf_io_read,
+      .write = nsf_io_write,
+  };
+  player->cpu.io = &player->io;
+
+  return 0;
+}
+
+/*
+ * Calls the routine at the given address, as a JSR from the return address
+ * would.
+ */
+static void nsf_call(struct NsfPlayer *player, Address address)
+{
+  struct Cpu *cpu = &player->cpu;
+  cpu_write_16b(cpu, 0x100 + (uint8_t)(cpu->S - 1), NSF_RETURN_ADDRESS - 1);
+  cpu->S -= 2;
+  cpu->PC = address;
+  cpu->cycle += NSF_CALL_CYCLES;
+}
+
+/*
+ * Runs the CPU until the routine it runs returns, until it jams, or until the
+ * given CPU cycle. Returns whether the routine returned.
+ */
+static bool nsf_run_until(struct NsfPlayer *player, uint64_t cycle)
+{
+  while (player->cpu.PC != NSF_RETURN_ADDRESS && player->cpu.cycle < cycle && !player->cpu.jammed)
+  {
+    cpu_execute_next_instruction(&player->cpu);
+  }
+  return player->cpu.PC == NSF_RETURN_ADDRESS;
+}
+
+/*
+ * Starts playing the given song, 0-based; resets the console, loads the tune,
+ * and runs its init routine. A blip buffer attached to the APU stays attached.
+ * Returns 0 on success, or -1 in case the song does not exist, its init
+ * routine jams the CPU, or does not return within NSF_INIT_CYCLES, in which
+ * case errno is set to EINVAL, EILSEQ or ETIMEDOUT respectively.
+ */
+int nsf_start_song(struct NsfPlayer *player, int song)
+{
+  if (song < 0 || song >= player->header.songs)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct Cpu *cpu = &player->cpu;
+  memset(cpu->ram, 0, sizeof cpu->ram);
+  cpu_power_on(cpu);
+  if (player->header.bank_switched)
+  {
+    for (int slot = 0; slot < 8; ++slot)
+    {
+      nsf_switch_bank(player, slot, player->header.banks[slot]);
+    }
+  }
+  else
+  {
+    const size_t size = MIN(player->data_size, (size_t)0x10000 - player->header.load_address);
+    memcpy(cpu->ram + player->header.load_address, player->data, size);
+  }
+
+  struct blip_buffer *blip = player->apu.blip;
+  apu_power_on(&player->apu, cpu->ram, cpu->cycle);
+  player->apu.blip = blip;
+
+  /* Silence all channels, enable all but the DMC, and inhibit the frame IRQ,
+   * as players do before calling init. */
+  for (Address address = 0x4000; address <= 0x4013; ++address)
+  {
+    apu_write(&player->apu, address, 0x00);
+  }
+  apu_write(&player->apu, 0x4015, 0x00);
+  apu_write(&player->apu, 0x4015, 0x0f);
+  apu_write(&player->apu, 0x4017, 0x40);
+
+  cpu->A = song;
+  cpu->X = 0; /* NTSC */
+  cpu->P |= FLAGS_INTERRUPT_DISABLE;
+  nsf_call(player, player->header.init_address);
+  if (!nsf_run_until(player, cpu->cycle + NSF_INIT_CYCLES))
+  {
+    errno = cpu->jammed ? EILSEQ : ETIMEDOUT;
+    return -1;
+  }
+
+  player->song_start = cpu->cycle;
+  player->frames = 0;
+  return 0;
+}
+
+/*
+ * Returns the number of play periods per second of the loaded tune.
+ */
+double nsf_frame_rate(const struct NsfPlayer *player)
+{
+  const uint16_t speed = player->header.ntsc_speed ? player->header.ntsc_speed : NSF_DEFAULT_SPEED;
+  return 1e6 / speed;
+}
+
+/*
+ * Plays a play period of the current song; calls its play routine, unless the
+ * previous call did not return yet, in which case that call continues, and
+ * ends the frame of the APU at the end of the period. Returns 0 on success, or
+ * -1 in case the CPU jammed, in which case errno is set to EILSEQ; the APU
+ * plays on, but the song is broken.
+ */
+int nsf_run_frame(struct NsfPlayer *player)
+{
+  NN_ZONE("NSF frame");
+
+  ++player->frames;
+  const uint64_t end =
+      player->song_start + llround(player->frames * APU_CLOCK_RATE / nsf_frame_rate(player));
+
+  if (player->cpu.PC == NSF_RETURN_ADDRESS)
+  {
+    nsf_call(player, player->header.play_address);
+  }
+
+  /* Once the play routine returns, or the CPU jams, the CPU idles until the
+   * next period. */
+  if (nsf_run_until(player, end) || player->cpu.jammed)
+  {
+    player->cpu.cycle = MAX(player->cpu.cycle, end);
+  }
+
+  apu_end_frame(&player->apu, player->cpu.cycle);
+  player->cpu.cycle += player->apu.dma_cycles;
+  player->apu.dma_cycles = 0;
+
+  if (player->cpu.jammed)
+  {
+    errno = EILSEQ;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,436 @@
+#include <lib/nes/include/ntsc.h>
+#include <lib/std/include/simd.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NN_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* Samples of the composite signal per pixel, and per subcarrier cycle. */
+#define NTSC_SAMPLES 8
+#define NTSC_CYCLE 12
+
+/* Tap of the output pixel at the framebuffer pixel itself. */
+#define NTSC_CENTER 3
+
+/*
+ * Fraction bits of the fixed point kernels. The sum of the largest magnitudes
+ * of all taps stays below 20000, so sums never overflow 16 bits.
+ */
+#define NTSC_FRACTION 5
+
+/* Length of the windows of the luma and chroma filters, in samples. */
+#define NTSC_LUMA_WINDOW NTSC_CYCLE
+#define NTSC_CHROMA_WINDOW (3 * NTSC_CYCLE - 2)
+
+/*
+ * Voltages of the low and high level of the square wave for every luma level,
+ * relative to sync, and the levels of black and white (see "NTSC video" on the
+ * NESdev wiki).
+ */
+static const double ntsc_low[4] = {0.350, 0.518, 0.962, 1.550};
+static const double ntsc_high[4] = {1.094, 1.506, 1.962, 1.962};
+#define NTSC_BLACK 0.518
+#define NTSC_WHITE 1.962
+
+/* Attenuation of the signal while one of the emphasized colors is in phase. */
+#define NTSC_ATTENUATION 0.746
+
+/* Gain of the decoded chroma; matches the saturation of the RGB palette. */
+#define NTSC_SATURATION 0.7
+
+/*
+ * Returns whether the given hue is in phase at the given step of the
+ * subcarrier; the PPU outputs the high level during half of the cycle.
+ */
+static bool ntsc_in_phase(int hue, int step)
+{
+  return (hue + step) % NTSC_CYCLE < NTSC_CYCLE / 2;
+}
+
+/*
+ * Returns the signal the PPU outputs for a framebuffer pixel at the given step
+ * of the subcarrier, normalized to 0 for black and 1 for white.
+ */
+static double ntsc_signal(unsigned pixel, int step)
+{
+  const int hue = pixel & 0x0f;
+  const int level = hue > 13 ? 1 : (pixel >> 4) & 0x03;
+  const unsigned emphasis = pixel >> PPU_PIXEL_EMPHASIS_SHIFT;
+
+  double low = ntsc_low[level];
+  double high = ntsc_high[level];
+  if (hue == 0)
+  {
+    low = high;
+  }
+  else if (hue > 12)
+  {
+    high = low;
+  }
+
+  double signal = ntsc_in_phase(hue, step) ? high : low;
+  if (((emphasis & 1) && ntsc_in_phase(0, step)) || ((emphasis & 2) && ntsc_in_phase(4, step)) ||
+      ((emphasis & 4) && ntsc_in_phase(8, step)))
+  {
+    signal *= NTSC_ATTENUATION;
+  }
+
+  return (signal - NTSC_BLACK) / (NTSC_WHITE - NTSC_BLACK);
+}
+
+/*
+ * Fills the weights of the chroma filter; three box filters of a subcarrier
+ * cycle in a row, which remove the subcarrier from the demodulated chroma
+ * completely, and limit its bandwidth to roughly 1 MHz.
+ */
+static void ntsc_chroma_window(double window[NTSC_CHROMA_WINDOW])
+{
+  double box[NTSC_CHROMA_WINDOW] = {0};
+  for (int i = 0; i < NTSC_CYCLE; ++i)
+  {
+    box[i] = 1.0 / NTSC_CYCLE;
+  }
+
+  memcpy(window, box, sizeof box);
+  for (int pass = 1; pass < 3; ++pass)
+  {
+    double result[NTSC_CHROMA_WINDOW] = {0};
+    for (int i = 0; i < NTSC_CHROMA_WINDOW; ++i)
+    {
+      for (int j = 0; j < NTSC_CYCLE && j <= i; ++j)
+      {
+        result[i] += window[i - j] * box[j];
+      }
+    }
+    memcpy(window, result, sizeof result);
+  }
+}
+
+/*
+ * Computes the contribution of a framebuffer pixel starting at the given
+ * phase to the output pixels around it, as RGB in the range 0-1. The decoder
+ * centers its windows on the middle of every output pixel, and demodulates
+ * chroma with the subcarrier phase at every sample.
+ */
+static void ntsc_kernel(unsigned pixel, int phase, double rgb[NTSC_TAPS][3])
+{
+  double chroma_window[NTSC_CHROMA_WINDOW];
+  ntsc_chroma_window(chroma_window);
+
+  for (int tap = 0; tap < NTSC_TAPS; ++tap)
+  {
+    /* Center of the output pixel, in samples relative to the pixel start. */
+    const double center = (tap - NTSC_CENTER) * NTSC_SAMPLES + (NTSC_SAMPLES - 1) / 2.0;
+
+    double y = 0.0;
+    double u = 0.0;
+    double v = 0.0;
+    for (int sample = 0; sample < NTSC_SAMPLES; ++sample)
+    {
+      const int step = phase * (NTSC_CYCLE / NTSC_PHASES) + sample;
+      const double signal = ntsc_signal(pixel, step % NTSC_CYCLE);
+
+      const double luma = sample - (center - (NTSC_LUMA_WINDOW - 1) / 2.0);
+      if (luma >= 0 && luma < NTSC_LUMA_WINDOW)
+      {
+        y += signal / NTSC_LUMA_WINDOW;
+      }
+
+      const double chroma = sample - (center - (NTSC_CHROMA_WINDOW - 1) / 2.0);
+      if (chroma >= 0 && chroma < NTSC_CHROMA_WINDOW)
+      {
+        const double weight = 2.0 * NTSC_SATURATION * chroma_window[(int)chroma] * signal;
+        /* V lags U by a quarter of the subcarrier cycle. */
+        const double angle = 2.0 * M_PI * step / NTSC_CYCLE;
+        u += weight * cos(angle);
+        v -= weight * sin(angle);
+      }
+    }
+
+    rgb[tap][0] = y + 1.140 * v;
+    rgb[tap][1] = y - 0.395 * u - 0.581 * v;
+    rgb[tap][2] = y + 2.032 * u;
+  }
+}
+
+/*
+ * Computes the kernels of all framebuffer pixels at all phases, in the byte
+ * order of the given pixel format. The alpha lanes stay zero; output pixels
+ * are made opaque after filtering.
+ */
+void ntsc_init(struct NtscFilter *ntsc, enum PixelFormat format, struct thread_pool *pool)
+{
+  const size_t size = NTSC_PHASES * PALETTE_SIZE * sizeof *ntsc->kernels;
+  if ((ntsc->kernels = aligned_alloc(32, size)) == NULL)
+  {
+    nn_quit("Could not allocate NTSC kernels");
+  }
+  memset(ntsc->kernels, 0, size);
+  ntsc->pool = pool;
+
+  for (int phase = 0; phase < NTSC_PHASES; ++phase)
+  {
+    for (unsigned pixel = 0; pixel < PALETTE_SIZE; ++pixel)
+    {
+      double rgb[NTSC_TAPS][3];
+      ntsc_kernel(pixel, phase, rgb);
+
+      for (int tap = 0; tap < NTSC_TAPS; ++tap)
+      {
+        int16_t value[4] = {0};
+        for (int c = 0; c < 3; ++c)
+        {
+          double x = rgb[tap][c] * 255.0 * (1 << NTSC_FRACTION);
+          /* Round once per output pixel, with the tap of the pixel itself. */
+          if (tap == NTSC_CENTER)
+          {
+            x += 0.5 * (1 << NTSC_FRACTION);
+          }
+          value[format == PIXEL_FORMAT_RGBA ? c : 2 - c] = lround(x);
+        }
+
+        /* A pixel at offset `o` in a group of four lands in lanes o+1 to o+8. */
+        for (int offset = 0; offset < 4; ++offset)
+        {
+          memcpy(ntsc->kernels[phase * PALETTE_SIZE + pixel][offset][offset + 1 + tap], value,
+                 sizeof value);
+        }
+      }
+    }
+  }
+}
+
+void ntsc_destroy(struct NtscFilter *ntsc)
+{
+  free(ntsc->kernels);
+}
+
+/*
+ * Returns the phase of the first pixel of the current frame of the PPU. Every
+ * dot lasts two thirds of a subcarrier cycle.
+ */
+int ntsc_frame_phase(const struct Ppu *ppu)
+{
+  return (ppu->frame_start * 2) % NTSC_PHASES;
+}
+
+/* Opaque alpha, in both pixel formats. */
+#define NTSC_ALPHA 0xff000000u
+
+/*
+ * Returns the offset of the kernels of the given framebuffer pixel at the
+ * given phase.
+ */
+static inline size_t ntsc_kernel_index(uint16_t pixel, int phase)
+{
+  return phase * PALETTE_SIZE + (pixel & PPU_PIXEL_MASK);
+}
+
+/*
+ * Filters a row. Framebuffer pixels are added in groups of four, into three
+ * accumulators of four output pixels; once a group is added, the first
+ * accumulator is complete. Output pixels start four pixels left of the row,
+ * such that the leftmost contribution lands in the first accumulator.
+ */
+static void ntsc_filter_row_scalar(const struct NtscFilter *ntsc, const uint16_t *pixels,
+                                   int phase, uint32_t *out)
+{
+  int acc[NTSC_LANES][4] = {{0}};
+
+  for (int group = 0; group <= PPU_WIDTH / 4; ++group)
+  {
+    for (int offset = 0; offset < 4 && group < PPU_WIDTH / 4; ++offset)
+    {
+      const int16_t *kernel =
+          ntsc->kernels[ntsc_kernel_index(pixels[group * 4 + offset], phase)][offset][0];
+      for (int lane = 0; lane < NTSC_LANES; ++lane)
+      {
+        for (int c = 0; c < 4; ++c)
+        {
+          acc[lane][c] += kernel[lane * 4 + c];
+        }
+      }
+      phase = phase == 0 ? NTSC_PHASES - 1 : phase - 1;
+    }
+
+    /* The first accumulator holds the pixels four pixels left of the group. */
+    if (group > 0)
+    {
+      for (int lane = 0; lane < 4; ++lane)
+      {
+        uint32_t pixel = NTSC_ALPHA;
+        for (int c = 0; c < 3; ++c)
+        {
+          const int x = acc[lane][c] >> NTSC_FRACTION;
+          pixel |= (uint32_t)(x < 0 ? 0 : x > 255 ? 255 : x) << (8 * c);
+        }
+        out[group * 4 - 4 + lane] = pixel;
+      }
+    }
+
+    memmove(acc, acc[4], 8 * sizeof acc[0]);
+    memset(acc[8], 0, 4 * sizeof acc[0]);
+  }
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Filters a row like ntsc_filter_row_scalar, with the accumulators in six
+ * registers of two output pixels.
+ */
+__attribute__((target("sse4.1"))) static void ntsc_filter_row_sse4(const struct NtscFilter *ntsc,
+                                                                   const uint16_t *pixels,
+                                                                   int phase, uint32_t *out)
+{
+  const __m128i alpha = _mm_set1_epi32((int)NTSC_ALPHA);
+  __m128i acc[6];
+  for (int i = 0; i < 6; ++i)
+  {
+    acc[i] = _mm_setzero_si128();
+  }
+
+  for (int group = 0; group <= PPU_WIDTH / 4; ++group)
+  {
+    for (int offset = 0; offset < 4 && group < PPU_WIDTH / 4; ++offset)
+    {
+      const __m128i *kernel = (const __m128i *)ntsc
+                                  ->kernels[ntsc_kernel_index(pixels[group * 4 + offset], phase)]
+                                           [offset];
+      for (int i = 0; i < 6; ++i)
+      {
+        acc[i] = _mm_add_epi16(acc[i], _mm_load_si128(kernel + i));
+      }
+      phase = phase == 0 ? NTSC_PHASES - 1 : phase - 1;
+    }
+
+    if (group > 0)
+    {
+      const __m128i low = _mm_srai_epi16(acc[0], NTSC_FRACTION);
+      const __m128i high = _mm_srai_epi16(acc[1], NTSC_FRACTION);
+      _mm_storeu_si128((__m128i *)(out + group * 4 - 4),
+                       _mm_or_si128(_mm_packus_epi16(low, high), alpha));
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+      acc[i] = acc[i + 2];
+    }
+    acc[4] = _mm_setzero_si128();
+    acc[5] = _mm_setzero_si128();
+  }
+}
+
+/*
+ * Filters a row like ntsc_filter_row_scalar, with the accumulators in three
+ * registers of four output pixels.
+ */
+__attribute__((target("avx2"))) static void ntsc_filter_row_avx2(const struct NtscFilter *ntsc,
+                                                                 const uint16_t *pixels, int phase,
+                                                                 uint32_t *out)
+{
+  const __m128i alpha = _mm_set1_epi32((int)NTSC_ALPHA);
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  __m256i acc2 = _mm256_setzero_si256();
+
+  for (int group = 0; group <= PPU_WIDTH / 4; ++group)
+  {
+    for (int offset = 0; offset < 4 && group < PPU_WIDTH / 4; ++offset)
+    {
+      const __m256i *kernel = (const __m256i *)ntsc
+                                  ->kernels[ntsc_kernel_index(pixels[group * 4 + offset], phase)]
+                                           [offset];
+      acc0 = _mm256_add_epi16(acc0, _mm256_load_si256(kernel));
+      acc1 = _mm256_add_epi16(acc1, _mm256_load_si256(kernel + 1));
+      acc2 = _mm256_add_epi16(acc2, _mm256_load_si256(kernel + 2));
+      phase = phase == 0 ? NTSC_PHASES - 1 : phase - 1;
+    }
+
+    if (group > 0)
+    {
+      /* Packing works per 128-bit lane; the low half of each lane is needed. */
+      const __m256i packed = _mm256_packus_epi16(_mm256_srai_epi16(acc0, NTSC_FRACTION),
+                                                 _mm256_setzero_si256());
+      const __m128i pixels4 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, 0x08));
+      _mm_storeu_si128((__m128i *)(out + group * 4 - 4), _mm_or_si128(pixels4, alpha));
+    }
+
+    acc0 = acc1;
+    acc1 = acc2;
+    acc2 = _mm256_setzero_si256();
+  }
+}
+#endif
+
+static void ntsc_filter_row(const struct NtscFilter *ntsc, const uint16_t *pixels, int phase,
+                            uint32_t *out)
+{
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      ntsc_filter_row_avx2(ntsc, pixels, phase, out);
+      break;
+    case SIMD_SSE4:
+      ntsc_filter_row_sse4(ntsc, pixels, phase, out);
+      break;
+#endif
+    default:
+      ntsc_filter_row_scalar(ntsc, pixels, phase, out);
+      break;
+  }
+}
+
+/* A frame being filtered, split into bands of rows. */
+struct NtscJob
+{
+  const struct NtscFilter *ntsc;
+  const uint16_t *framebuffer;
+  int phase;
+  uint32_t *out;
+  int bands;
+};
+
+static void ntsc_filter_band(void *arg, int band)
+{
+  NN_ZONE("ntsc band");
+
+  const struct NtscJob *job = arg;
+  const int first = PPU_HEIGHT * band / job->bands;
+  const int last = PPU_HEIGHT * (band + 1) / job->bands;
+  for (int y = first; y < last; ++y)
+  {
+    /* Every scanline starts one phase later than the previous one. */
+    ntsc_filter_row(job->ntsc, job->framebuffer + y * PPU_WIDTH, (job->phase + y) % NTSC_PHASES,
+                    job->out + y * PPU_WIDTH);
+  }
+}
+
+/*
+ * Filters a frame to 32-bit pixels of the same size, in the pixel format the
+ * filter was initialized with. The phase is the phase of the first pixel of
+ * the frame, see ntsc_frame_phase; it changes between frames, which makes
+ * the color fringes crawl as on a TV. Bands of rows are filtered on the
+ * thread pool of the filter, if any.
+ */
+void ntsc_filter(const struct NtscFilter *ntsc, const uint16_t *framebuffer, int phase,
+                 uint32_t *out)
+{
+  NN_ZONE("ntsc");
+
+  struct NtscJob job = {ntsc, framebuffer, phase % NTSC_PHASES, out, 1};
+  if (ntsc->pool == NULL)
+  {
+    ntsc_filter_band(&job, 0);
+    return;
+  }
+
+  job.bands = thread_pool_bands(ntsc->pool, PPU_HEIGHT, 1);
+  thread_pool_run(ntsc->pool, ntsc_filter_band, &job, job.bands);
+}
@@ -0,0 +1,144 @@
+#include <lib/nes/include/palette.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/simd.h>
+
+#ifdef NN_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* The colors of the 2C02, as RGB. */
+static const uint8_t palette_2c02[64][3] = {
+    {0x54, 0x54, 0x54}, {0x00, 0x1e, 0x74}, {0x08, 0x10, 0x90}, {0x30, 0x00, 0x88},
+    {0x44, 0x00, 0x64}, {0x5c, 0x00, 0x30}, {0x54, 0x04, 0x00}, {0x3c, 0x18, 0x00},
+    {0x20, 0x2a, 0x00}, {0x08, 0x3a, 0x00}, {0x00, 0x40, 0x00}, {0x00, 0x3c, 0x00},
+    {0x00, 0x32, 0x3c}, {0x00, 0x00, 0x00}, {0x00, 0x00, 0x00}, {0x00, 0x00, 0x00},
+    {0x98, 0x96, 0x98}, {0x08, 0x4c, 0xc4}, {0x30, 0x32, 0xec}, {0x5c, 0x1e, 0xe4},
+    {0x88, 0x14, 0xb0}, {0xa0, 0x14, 0x64}, {0x98, 0x22, 0x20}, {0x78, 0x3c, 0x00},
+    {0x54, 0x5a, 0x00}, {0x28, 0x72, 0x00}, {0x08, 0x7c, 0x00}, {0x00, 0x76, 0x28},
+    {0x00, 0x66, 0x78}, {0x00, 0x00, 0x00}, {0x00, 0x00, 0x00}, {0x00, 0x00, 0x00},
+    {0xec, 0xee, 0xec}, {0x4c, 0x9a, 0xec}, {0x78, 0x7c, 0xec}, {0xb0, 0x62, 0xec},
+    {0xe4, 0x54, 0xec}, {0xec, 0x58, 0xb4}, {0xec, 0x6a, 0x64}, {0xd4, 0x88, 0x20},
+    {0xa0, 0xaa, 0x00}, {0x74, 0xc4, 0x00}, {0x4c, 0xd0, 0x20}, {0x38, 0xcc, 0x6c},
+    {0x38, 0xb4, 0xcc}, {0x3c, 0x3c, 0x3c}, {0x00, 0x00, 0x00}, {0x00, 0x00, 0x00},
+    {0xec, 0xee, 0xec}, {0xa8, 0xcc, 0xec}, {0xbc, 0xbc, 0xec}, {0xd4, 0xb2, 0xec},
+    {0xec, 0xae, 0xec}, {0xec, 0xae, 0xd4}, {0xec, 0xb4, 0xb0}, {0xe4, 0xc4, 0x90},
+    {0xcc, 0xd2, 0x78}, {0xb4, 0xde, 0x78}, {0xa8, 0xe2, 0x90}, {0x98, 0xe2, 0xb4},
+    {0xa0, 0xd6, 0xe4}, {0xa0, 0xa2, 0xa0}, {0x00, 0x00, 0x00}, {0x00, 0x00, 0x00},
+};
+
+/* Attenuation of the color components that are not emphasized, in 1/256. */
+#define PALETTE_ATTENUATION 209
+
+/*
+ * Fills the lookup table for the given pixel format. Every emphasis bit
+ * attenuates the two color components it does not emphasize.
+ */
+void palette_init(struct Palette *palette, enum PixelFormat format)
+{
+  for (unsigned pixel = 0; pixel < PALETTE_SIZE; ++pixel)
+  {
+    const unsigned emphasis = pixel >> PPU_PIXEL_EMPHASIS_SHIFT;
+    unsigned rgb[3];
+    for (int c = 0; c < 3; ++c)
+    {
+      rgb[c] = palette_2c02[pixel & 0x3f][c];
+      if (emphasis & ~(1u << c))
+      {
+        rgb[c] = rgb[c] * PALETTE_ATTENUATION / 256;
+      }
+    }
+
+    /* Pixels are stored little endian. */
+    const unsigned first = format == PIXEL_FORMAT_RGBA ? rgb[0] : rgb[2];
+    const unsigned third = format == PIXEL_FORMAT_RGBA ? rgb[2] : rgb[0];
+    palette->colors[pixel] = 0xff000000u | third << 16 | rgb[1] << 8 | first;
+  }
+}
+
+static void palette_convert_scalar(const struct Palette *palette, const uint16_t *pixels,
+                                   uint32_t *out, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    out[i] = palette->colors[pixels[i] & PPU_PIXEL_MASK];
+  }
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Looks up eight pixels at a time; SSE4.1 has no gather, but inserting the
+ * looked up colors into vectors halves the number of stores.
+ */
+__attribute__((target("sse4.1"))) static void palette_convert_sse4(const struct Palette *palette,
+                                                                   const uint16_t *pixels,
+                                                                   uint32_t *out, size_t size)
+{
+  const __m128i mask = _mm_set1_epi16(PPU_PIXEL_MASK);
+  const uint32_t *colors = palette->colors;
+
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8)
+  {
+    const __m128i p = _mm_and_si128(_mm_loadu_si128((const __m128i *)(pixels + i)), mask);
+    __m128i low = _mm_cvtsi32_si128(colors[_mm_extract_epi16(p, 0)]);
+    low = _mm_insert_epi32(low, colors[_mm_extract_epi16(p, 1)], 1);
+    low = _mm_insert_epi32(low, colors[_mm_extract_epi16(p, 2)], 2);
+    low = _mm_insert_epi32(low, colors[_mm_extract_epi16(p, 3)], 3);
+    __m128i high = _mm_cvtsi32_si128(colors[_mm_extract_epi16(p, 4)]);
+    high = _mm_insert_epi32(high, colors[_mm_extract_epi16(p, 5)], 1);
+    high = _mm_insert_epi32(high, colors[_mm_extract_epi16(p, 6)], 2);
+    high = _mm_insert_epi32(high, colors[_mm_extract_epi16(p, 7)], 3);
+    _mm_storeu_si128((__m128i *)(out + i), low);
+    _mm_storeu_si128((__m128i *)(out + i + 4), high);
+  }
+
+  palette_convert_scalar(palette, pixels + i, out + i, size - i);
+}
+
+/*
+ * Looks up sixteen pixels at a time with two gathers.
+ */
+__attribute__((target("avx2"))) static void palette_convert_avx2(const struct Palette *palette,
+                                                                 const uint16_t *pixels,
+                                                                 uint32_t *out, size_t size)
+{
+  const __m256i mask = _mm256_set1_epi32(PPU_PIXEL_MASK);
+  const int *colors = (const int *)palette->colors;
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16)
+  {
+    const __m128i p0 = _mm_loadu_si128((const __m128i *)(pixels + i));
+    const __m128i p1 = _mm_loadu_si128((const __m128i *)(pixels + i + 8));
+    const __m256i i0 = _mm256_and_si256(_mm256_cvtepu16_epi32(p0), mask);
+    const __m256i i1 = _mm256_and_si256(_mm256_cvtepu16_epi32(p1), mask);
+    _mm256_storeu_si256((__m256i *)(out + i), _mm256_i32gather_epi32(colors, i0, 4));
+    _mm256_storeu_si256((__m256i *)(out + i + 8), _mm256_i32gather_epi32(colors, i1, 4));
+  }
+
+  palette_convert_scalar(palette, pixels + i, out + i, size - i);
+}
+#endif
+
+/*
+ * Converts `size` framebuffer pixels to 32-bit pixels in the format of the
+ * palette, with the widest instruction set the CPU supports.
+ */
+void palette_convert(const struct Palette *palette, const uint16_t *pixels, uint32_t *out,
+                     size_t size)
+{
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      palette_convert_avx2(palette, pixels, out, size);
+      break;
+    case SIMD_SSE4:
+      palette_convert_sse4(palette, pixels, out, size);
+      break;
+#endif
+    default:
+      palette_convert_scalar(palette, pixels, out, size);
+      break;
+  }
+}
@@ -0,0 +1,1317 @@
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/simd.h>
+#include <lib/std/include/util.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef NN_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Timing events within a frame, in the order in which they occur. Events
+ * 0-239 render the visible scanline of the same number.
+ */
+enum PpuEvent
+{
+  PPU_EVENT_VBLANK = PPU_HEIGHT,
+  PPU_EVENT_PRE_RENDER,
+  PPU_EVENT_VERTICAL_COPY,
+  PPU_EVENT_FRAME_END
+};
+
+/* Dot of a scanline after which its pixels are output, and the horizontal
+ * scroll is reloaded. */
+#define PPU_RENDER_DOT 257
+/* Dot of the pre-render scanline at which the vertical scroll is reloaded. */
+#define PPU_VERTICAL_COPY_DOT 280
+
+/* Flags of the pixels in a sprite line buffer; the low five bits hold the
+ * palette RAM index of the pixel. */
+#define PPU_SPRITE_BEHIND 0x20
+#define PPU_SPRITE_ZERO 0x40
+
+/*
+ * Initializes the PPU to its state after power on. Unless a mapper shared the
+ * tile cache of its CHR ROM, creates a private tile cache.
+ */
+void ppu_power_on(struct Ppu *ppu, enum Mirroring mirroring)
+{
+  ppu->ctrl = 0;
+  ppu->mask = 0;
+  ppu->status = 0;
+  ppu->oam_address = 0;
+  ppu->v = 0;
+  ppu->t = 0;
+  ppu->x = 0;
+  ppu->w = false;
+  ppu->read_buffer = 0;
+  ppu->bus = 0;
+  ppu->nmi = false;
+
+  ppu->dot = 0;
+  ppu->frame_start = 0;
+  ppu->frame = 0;
+  ppu->odd_frame = false;
+  ppu->event = 0;
+  ppu->suppress_vblank = false;
+
+  ppu->bg_low = 0;
+  ppu->bg_high = 0;
+  ppu->bg_attribute_low = 0;
+  ppu->bg_attribute_high = 0;
+  ppu->sprite_count = 0;
+  ppu->sprite_zero = false;
+
+  ppu->a12 = false;
+  ppu->a12_fall = 0;
+  ppu->sync_dot = UINT64_MAX;
+
+  if (ppu->tiles == NULL)
+  {
+    ppu->tiles = make_tile_cache();
+  }
+
+  ppu->mirroring = mirroring;
+  memset(ppu->nametables, 0, sizeof ppu->nametables);
+  memset(ppu->palette, 0, sizeof ppu->palette);
+  memset(ppu->oam, 0, sizeof ppu->oam);
+  memset(ppu->framebuffer, 0, sizeof ppu->framebuffer);
+}
+
+/*
+ * Releases the tile cache of the PPU.
+ */
+void ppu_power_off(struct Ppu *ppu)
+{
+  tile_cache_release(ppu->tiles);
+  ppu->tiles = NULL;
+}
+
+static inline bool ppu_rendering(const struct Ppu *ppu)
+{
+  return ppu->mask & PPUMASK_RENDERING;
+}
+
+/*
+ * Returns the offset in nametable memory of the given address in $2000-$2fff.
+ * With horizontal mirroring, $2000 equals $2400 and $2800 equals $2c00; with
+ * vertical mirroring, $2000 equals $2800 and $2400 equals $2c00.
+ */
+static inline unsigned ppu_nametable_offset(const struct Ppu *ppu, Address address)
+{
+  unsigned table = (address >> 10) & 3;
+  switch (ppu->mirroring)
+  {
+    case MIRRORING_HORIZONTAL:
+      table >>= 1;
+      break;
+    case MIRRORING_VERTICAL:
+      table &= 1;
+      break;
+    case MIRRORING_FOUR_SCREEN:
+      break;
+  }
+
+  return (table << 10) | (address & 0x3ff);
+}
+
+/*
+ * Returns the offset in palette memory of the given address in $3f00-$3fff.
+ * The backdrop entries of the sprite palettes mirror those of the background
+ * palettes.
+ */
+static inline unsigned ppu_palette_offset(Address address)
+{
+  address &= 0x1f;
+  return (address & 0x13) == 0x10 ? address & 0x0f : address;
+}
+
+/*
+ * Reads a byte from the PPU address space.
+ */
+uint8_t ppu_memory_read(struct Ppu *ppu, Address address)
+{
+  address &= 0x3fff;
+  if (address < 0x2000)
+  {
+    return ppu->chr[address];
+  }
+  else if (address < 0x3f00)
+  {
+    return ppu->nametables[ppu_nametable_offset(ppu, address)];
+  }
+
+  return ppu->palette[ppu_palette_offset(address)];
+}
+
+/*
+ * Writes a byte to the PPU address space. Writes to CHR ROM are ignored.
+ */
+void ppu_memory_write(struct Ppu *ppu, Address address, uint8_t value)
+{
+  address &= 0x3fff;
+  if (address < 0x2000)
+  {
+    if (ppu->chr_ram)
+    {
+      ppu->chr[address] = value;
+      tile_cache_invalidate(ppu->tiles, address);
+    }
+  }
+  else if (address < 0x3f00)
+  {
+    ppu->nametables[ppu_nametable_offset(ppu, address)] = value;
+  }
+  else
+  {
+    ppu->palette[ppu_palette_offset(address)] = value & 0x3f;
+  }
+}
+
+/*
+ * Puts the given address on the PPU address bus, and reports a rising edge of
+ * A12 to the mapper.
+ */
+static inline void ppu_drive_address(struct Ppu *ppu, Address address)
+{
+  const bool a12 = address & 0x1000;
+  if (a12 == ppu->a12)
+  {
+    return;
+  }
+
+  ppu->a12 = a12;
+  if (!a12)
+  {
+    ppu->a12_fall = ppu->dot;
+  }
+  else if (ppu->a12_rise)
+  {
+    ppu->a12_rise(ppu->a12_context, ppu->dot - ppu->a12_fall);
+  }
+}
+
+/*
+ * Increments the VRAM address after an access through $2007.
+ */
+static inline void ppu_increment_address(struct Ppu *ppu)
+{
+  ppu->v = (ppu->v + (ppu->ctrl & PPUCTRL_INCREMENT_32 ? 32 : 1)) & 0x7fff;
+  ppu_drive_address(ppu, ppu->v);
+}
+
+/*
+ * Reads the PPU register at the given address, $2000-$2007 or any of its
+ * mirrors. Write-only registers return the last value on the bus.
+ */
+uint8_t ppu_read(struct Ppu *ppu, Address address)
+{
+  switch (address & 7)
+  {
+    case 2:
+    {
+      /* Reading the status right before VBlank starts suppresses both the
+       * flag and the NMI; reading it as VBlank starts only the NMI. */
+      const uint64_t vblank = ppu->frame_start + PPU_VBLANK_DOT;
+      if (ppu->dot + 1 == vblank)
+      {
+        ppu->suppress_vblank = true;
+      }
+      else if (ppu->dot == vblank || ppu->dot == vblank + 1)
+      {
+        ppu->nmi = false;
+      }
+
+      ppu->bus = (ppu->status & 0xe0) | (ppu->bus & 0x1f);
+      ppu->status &= ~PPUSTATUS_VBLANK;
+      ppu->w = false;
+      break;
+    }
+    case 4:
+      ppu->bus = ppu->oam[ppu->oam_address];
+      break;
+    case 7:
+      /* Reads are delayed by a buffer, except for palette reads, which fill
+       * the buffer with the nametable byte below the palette. */
+      if ((ppu->v & 0x3fff) >= 0x3f00)
+      {
+        ppu->bus = (ppu->bus & 0xc0) | ppu_memory_read(ppu, ppu->v);
+        ppu->read_buffer = ppu_memory_read(ppu, ppu->v - 0x1000);
+      }
+      else
+      {
+        ppu->bus = ppu->read_buffer;
+        ppu->read_buffer = ppu_memory_read(ppu, ppu->v);
+      }
+      ppu_increment_address(ppu);
+      break;
+    default:
+      break;
+  }
+
+  return ppu->bus;
+}
+
+/*
+ * Writes the PPU register at the given address, $2000-$2007 or any of its
+ * mirrors.
+ */
+void ppu_write(struct Ppu *ppu, Address address, uint8_t value)
+{
+  ppu->bus = value;
+
+  switch (address & 7)
+  {
+    case 0:
+      /* Enabling NMIs during VBlank raises an NMI immediately. */
+      if (!(ppu->ctrl & PPUCTRL_NMI) && (value & PPUCTRL_NMI) && (ppu->status & PPUSTATUS_VBLANK))
+      {
+        ppu->nmi = true;
+      }
+      ppu->ctrl = value;
+      ppu->t = (ppu->t & 0xf3ff) | ((value & PPUCTRL_NAMETABLE) << 10);
+      break;
+    case 1:
+      ppu->mask = value;
+      break;
+    case 3:
+      ppu->oam_address = value;
+      break;
+    case 4:
+      ppu->oam[ppu->oam_address++] = value;
+      break;
+    case 5:
+      if (!ppu->w)
+      {
+        ppu->t = (ppu->t & 0xffe0) | (value >> 3);
+        ppu->x = value & 7;
+      }
+      else
+      {
+        ppu->t = (ppu->t & 0x8c1f) | ((value & 0x07) << 12) | ((value & 0xf8) << 2);
+      }
+      ppu->w = !ppu->w;
+      break;
+    case 6:
+      if (!ppu->w)
+      {
+        ppu->t = (ppu->t & 0x00ff) | ((value & 0x3f) << 8);
+      }
+      else
+      {
+        ppu->t = (ppu->t & 0xff00) | value;
+        ppu->v = ppu->t;
+        ppu_drive_address(ppu, ppu->v);
+      }
+      ppu->w = !ppu->w;
+      break;
+    case 7:
+      ppu_memory_write(ppu, ppu->v, value);
+      ppu_increment_address(ppu);
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * Copies a page of CPU memory to OAM, starting at the current OAM address.
+ */
+void ppu_oam_dma(struct Ppu *ppu, const uint8_t *page)
+{
+  for (int i = 0; i < 256; ++i)
+  {
+    ppu->oam[ppu->oam_address++] = page[i];
+  }
+}
+
+/*
+ * Increments the coarse X scroll in `v`, switching horizontal nametable at
+ * the end of a row of tiles.
+ */
+static inline uint16_t ppu_increment_x(uint16_t v)
+{
+  return (v & 0x001f) == 31 ? (v & ~0x001f) ^ 0x0400 : v + 1;
+}
+
+/*
+ * Increments the fine Y scroll in `v`, and the coarse Y scroll when it
+ * overflows, switching vertical nametable after the last row of tiles.
+ */
+static inline uint16_t ppu_increment_y(uint16_t v)
+{
+  if ((v & 0x7000) != 0x7000)
+  {
+    return v + 0x1000;
+  }
+
+  v &= ~0x7000;
+  unsigned y = (v & 0x03e0) >> 5;
+  if (y == 29)
+  {
+    y = 0;
+    v ^= 0x0800;
+  }
+  else if (y == 31)
+  {
+    y = 0;
+  }
+  else
+  {
+    ++y;
+  }
+
+  return (v & ~0x03e0) | (y << 5);
+}
+
+/*
+ * Copies the 8 pixels of a tile row from the tile cache to `line`, combining
+ * the colors of opaque pixels with the given palette. Transparent pixels are 0.
+ */
+static inline void ppu_copy_row(uint8_t *line, const uint8_t *pixels, uint8_t palette)
+{
+  uint64_t row;
+  memcpy(&row, pixels, sizeof row);
+  const uint64_t opaque = (row | (row >> 1)) & 0x0101010101010101ull;
+  row |= opaque * palette;
+  memcpy(line, &row, sizeof row);
+}
+
+/*
+ * Returns the 2-bit color of pixel `column` (0 is the leftmost) in the given
+ * pattern table row.
+ */
+static inline uint8_t ppu_pattern_pixel(uint8_t low, uint8_t high, int column)
+{
+  return ((low >> (7 - column)) & 1) | (((high >> (7 - column)) & 1) << 1);
+}
+
+/*
+ * Fetches `count` of the 33 background tiles that overlap the current
+ * scanline, starting at tile `first`, and writes the palette RAM index of
+ * their pixels to `line`, which starts at fine X scroll 0. Transparent pixels
+ * are 0.
+ */
+static void ppu_render_background(struct Ppu *ppu, uint8_t line[PPU_WIDTH + 8], int first,
+                                  int count)
+{
+  const unsigned table = ppu->ctrl & PPUCTRL_BACKGROUND_TABLE ? 256 : 0;
+  const unsigned fine_y = (ppu->v >> 12) & 7;
+
+  uint16_t v = ppu->v;
+  for (int tile = 0; tile < first; ++tile)
+  {
+    v = ppu_increment_x(v);
+  }
+
+  for (int tile = first; tile < first + count; ++tile)
+  {
+    const uint8_t index = ppu->nametables[ppu_nametable_offset(ppu, 0x2000 | (v & 0x0fff))];
+    const uint8_t attribute = ppu->nametables[ppu_nametable_offset(
+        ppu, 0x23c0 | (v & 0x0c00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07))];
+    const uint8_t palette = ((attribute >> (((v >> 4) & 4) | (v & 2))) & 3) << 2;
+
+    ppu_copy_row(line + tile * 8, tile_cache_row(ppu->tiles, ppu->chr, table + index, 0, fine_y),
+                 palette);
+
+    v = ppu_increment_x(v);
+  }
+}
+
+/*
+ * Returns a mask of the sprites in OAM that cover scanline `line`, such that
+ * `line` - Y is in [0, `height`); bit i is set for sprite i.
+ */
+static uint64_t ppu_sprite_mask_scalar(const struct Ppu *ppu, int line, int height)
+{
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; ++i)
+  {
+    const int y = ppu->oam[i * 4];
+    if (y <= line && line - y < height)
+    {
+      mask |= 1ull << i;
+    }
+  }
+  return mask;
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Packs the Y coordinates of 16 sprites into a vector, and compares them all
+ * at once.
+ */
+__attribute__((target("sse4.1"))) static uint64_t ppu_sprite_mask_sse4(const struct Ppu *ppu,
+                                                                       int line, int height)
+{
+  const __m128i low_byte = _mm_set1_epi32(0xff);
+  const __m128i l = _mm_set1_epi8(line);
+  const __m128i h = _mm_set1_epi8(height - 1);
+
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; i += 16)
+  {
+    const __m128i *oam = (const __m128i *)(ppu->oam + i * 4);
+    const __m128i v0 = _mm_and_si128(_mm_loadu_si128(oam + 0), low_byte);
+    const __m128i v1 = _mm_and_si128(_mm_loadu_si128(oam + 1), low_byte);
+    const __m128i v2 = _mm_and_si128(_mm_loadu_si128(oam + 2), low_byte);
+    const __m128i v3 = _mm_and_si128(_mm_loadu_si128(oam + 3), low_byte);
+    const __m128i y = _mm_packus_epi16(_mm_packus_epi32(v0, v1), _mm_packus_epi32(v2, v3));
+
+    /* Y <= line, and line - Y <= height - 1, unsigned. */
+    const __m128i row = _mm_sub_epi8(l, y);
+    const __m128i in_range = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(row, h), row),
+                                           _mm_cmpeq_epi8(_mm_max_epu8(y, l), l));
+    mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(in_range) << i;
+  }
+  return mask;
+}
+
+/*
+ * Packs the Y coordinates of 32 sprites into a vector, and compares them all
+ * at once. Packing works per 128-bit lane, hence the final permutation.
+ */
+__attribute__((target("avx2"))) static uint64_t ppu_sprite_mask_avx2(const struct Ppu *ppu,
+                                                                     int line, int height)
+{
+  const __m256i low_byte = _mm256_set1_epi32(0xff);
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  const __m256i l = _mm256_set1_epi8(line);
+  const __m256i h = _mm256_set1_epi8(height - 1);
+
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; i += 32)
+  {
+    const __m256i *oam = (const __m256i *)(ppu->oam + i * 4);
+    const __m256i v0 = _mm256_and_si256(_mm256_loadu_si256(oam + 0), low_byte);
+    const __m256i v1 = _mm256_and_si256(_mm256_loadu_si256(oam + 1), low_byte);
+    const __m256i v2 = _mm256_and_si256(_mm256_loadu_si256(oam + 2), low_byte);
+    const __m256i v3 = _mm256_and_si256(_mm256_loadu_si256(oam + 3), low_byte);
+    const __m256i y = _mm256_permutevar8x32_epi32(
+        _mm256_packus_epi16(_mm256_packus_epi32(v0, v1), _mm256_packus_epi32(v2, v3)), order);
+
+    const __m256i row = _mm256_sub_epi8(l, y);
+    const __m256i in_range = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(row, h), row),
+                                              _mm256_cmpeq_epi8(_mm256_max_epu8(y, l), l));
+    mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(in_range) << i;
+  }
+  return mask;
+}
+#endif
+
+static uint64_t ppu_sprite_mask(const struct Ppu *ppu, int line, int height)
+{
+  if (line < 0)
+  {
+    return 0;
+  }
+
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      return ppu_sprite_mask_avx2(ppu, line, height);
+    case SIMD_SSE4:
+      return ppu_sprite_mask_sse4(ppu, line, height);
+#endif
+    default:
+      return ppu_sprite_mask_scalar(ppu, line, height);
+  }
+}
+
+/*
+ * Returns whether sprite evaluation sets the overflow flag, given the mask of
+ * sprites covering scanline `line`. Once eight sprites are found, the PPU
+ * keeps comparing, but due to a hardware bug it moves through the bytes of
+ * each next sprite rather than through their Y coordinates; it may miss a
+ * ninth sprite, or take a tile index or an attribute for a Y coordinate.
+ */
+static bool ppu_sprite_overflow(const struct Ppu *ppu, uint64_t mask, int line, int height)
+{
+  if (__builtin_popcountll(mask) < PPU_SPRITES_PER_SCANLINE)
+  {
+    return false;
+  }
+
+  for (int i = 1; i < PPU_SPRITES_PER_SCANLINE; ++i)
+  {
+    mask &= mask - 1;
+  }
+
+  int m = 0;
+  for (int n = __builtin_ctzll(mask) + 1; n < 64; ++n)
+  {
+    const int y = ppu->oam[n * 4 + m];
+    if (y <= line && line - y < height)
+    {
+      return true;
+    }
+    m = (m + 1) & 3;
+  }
+  return false;
+}
+
+/*
+ * Returns the 8 pixels of row `row` of the given sprite, flipped as the sprite
+ * is, from the tile cache.
+ */
+static inline const uint8_t *ppu_sprite_row(struct Ppu *ppu, const uint8_t *sprite, int row,
+                                            int height)
+{
+  /* The tile cache flips the rows of a tile; the tiles of 8x16 sprites are
+   * swapped. */
+  const unsigned flip = sprite[2] >> 6;
+  unsigned tile;
+  if (height == 16)
+  {
+    tile = (sprite[1] & 1) * 256 + (sprite[1] & 0xfe) + ((row >> 3) ^ (flip >> 1));
+  }
+  else
+  {
+    tile = (ppu->ctrl & PPUCTRL_SPRITE_TABLE ? 256 : 0) + sprite[1];
+  }
+
+  return tile_cache_row(ppu->tiles, ppu->chr, tile, flip, row & 7);
+}
+
+/*
+ * Selects the first eight sprites in OAM that cover the given scanline, and
+ * draws them into the sprite line buffer `line`. Earlier sprites have
+ * priority over later ones, hence sprites are drawn in reverse order. Sets the
+ * sprite overflow flag as sprite evaluation does.
+ */
+static void ppu_render_sprites(struct Ppu *ppu, int scanline, uint8_t line[PPU_WIDTH + 8])
+{
+  const int height = ppu->ctrl & PPUCTRL_SPRITE_8X16 ? 16 : 8;
+
+  /* Sprites are drawn one scanline below their Y coordinate. */
+  uint64_t mask = ppu_sprite_mask(ppu, scanline - 1, height);
+  if (ppu_sprite_overflow(ppu, mask, scanline - 1, height))
+  {
+    ppu->status |= PPUSTATUS_SPRITE_OVERFLOW;
+  }
+
+  int selected[PPU_SPRITES_PER_SCANLINE];
+  int count = 0;
+  for (; mask && count < PPU_SPRITES_PER_SCANLINE; mask &= mask - 1)
+  {
+    selected[count++] = __builtin_ctzll(mask);
+  }
+
+  while (count > 0)
+  {
+    const int i = selected[--count];
+    const uint8_t *sprite = ppu->oam + i * 4;
+    const uint8_t flags = (i == 0 ? PPU_SPRITE_ZERO : 0) |
+                          (sprite[2] & 0x20 ? PPU_SPRITE_BEHIND : 0) | 0x10 |
+                          ((sprite[2] & 3) << 2);
+
+    /* Overwrite the opaque pixels of the sprite, 8 at a time. */
+    uint64_t pixels;
+    memcpy(&pixels, ppu_sprite_row(ppu, sprite, scanline - 1 - sprite[0], height), sizeof pixels);
+    const uint64_t opaque = ((pixels | (pixels >> 1)) & 0x0101010101010101ull) * 0xff;
+    uint64_t buffer;
+    memcpy(&buffer, line + sprite[3], sizeof buffer);
+    buffer = (buffer & ~opaque) | ((pixels | flags * 0x0101010101010101ull) & opaque);
+    memcpy(line + sprite[3], &buffer, sizeof buffer);
+  }
+}
+
+/*
+ * Returns the framebuffer pixel of the given palette RAM index, in the current
+ * grayscale and emphasis mode.
+ */
+static inline uint16_t ppu_pixel(const struct Ppu *ppu, unsigned index)
+{
+  return (ppu->palette[index] & (ppu->mask & PPUMASK_GRAYSCALE ? 0x30 : 0x3f)) |
+         (ppu->mask & PPUMASK_EMPHASIS) << (PPU_PIXEL_EMPHASIS_SHIFT - 5);
+}
+
+/*
+ * Flags a sprite 0 hit in case an opaque pixel of sprite 0 overlaps an opaque
+ * background pixel at pixel `x` of a scanline.
+ */
+static inline void ppu_detect_sprite_0_hit(struct Ppu *ppu, uint8_t b, uint8_t s, int x)
+{
+  if ((s & PPU_SPRITE_ZERO) && (b & 3) && x != 255)
+  {
+    ppu->status |= PPUSTATUS_SPRITE_0_HIT;
+  }
+}
+
+/*
+ * Returns pixel `x` of a scanline, given the palette RAM index of its
+ * background pixel `b` and sprite line buffer pixel `s`, and detects sprite 0
+ * hits.
+ */
+static inline uint16_t ppu_compose(struct Ppu *ppu, uint8_t b, uint8_t s, int x)
+{
+  ppu_detect_sprite_0_hit(ppu, b, s, x);
+
+  uint8_t index = b;
+  if ((s & 3) && (!(s & PPU_SPRITE_BEHIND) || !(b & 3)))
+  {
+    index = s & 0x1f;
+  }
+  return ppu_pixel(ppu, index & 3 ? index : 0);
+}
+
+static void ppu_compose_line_scalar(struct Ppu *ppu, const uint8_t *bg, const uint8_t *sprites,
+                                    uint16_t *pixels)
+{
+  for (int x = 0; x < PPU_WIDTH; ++x)
+  {
+    pixels[x] = ppu_compose(ppu, bg[x], sprites[x], x);
+  }
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Composes 16 pixels at a time; the palette is looked up with two byte
+ * shuffles, one per half of palette RAM.
+ */
+__attribute__((target("sse4.1"))) static void ppu_compose_line_sse4(struct Ppu *ppu,
+                                                                    const uint8_t *bg,
+                                                                    const uint8_t *sprites,
+                                                                    uint16_t *pixels)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i color_bits = _mm_set1_epi8(3);
+  const __m128i behind = _mm_set1_epi8(PPU_SPRITE_BEHIND);
+  const __m128i sprite_zero = _mm_set1_epi8(PPU_SPRITE_ZERO);
+  const __m128i index_bits = _mm_set1_epi8(0x1f);
+  const __m128i entry_bits = _mm_set1_epi8(0x0f);
+  const __m128i upper_half = _mm_set1_epi8(0x10);
+  const __m128i palette_low = _mm_loadu_si128((const __m128i *)ppu->palette);
+  const __m128i palette_high = _mm_loadu_si128((const __m128i *)(ppu->palette + 16));
+  const __m128i gray = _mm_set1_epi8(ppu->mask & PPUMASK_GRAYSCALE ? 0x30 : 0x3f);
+  const __m128i emphasis =
+      _mm_set1_epi16((ppu->mask & PPUMASK_EMPHASIS) << (PPU_PIXEL_EMPHASIS_SHIFT - 5));
+
+  unsigned hits = 0;
+  for (int x = 0; x < PPU_WIDTH; x += 16)
+  {
+    const __m128i b = _mm_loadu_si128((const __m128i *)(bg + x));
+    const __m128i s = _mm_loadu_si128((const __m128i *)(sprites + x));
+
+    const __m128i b_transparent = _mm_cmpeq_epi8(_mm_and_si128(b, color_bits), zero);
+    const __m128i s_transparent = _mm_cmpeq_epi8(_mm_and_si128(s, color_bits), zero);
+    const __m128i s_front = _mm_cmpeq_epi8(_mm_and_si128(s, behind), zero);
+    const __m128i use_sprite =
+        _mm_andnot_si128(s_transparent, _mm_or_si128(s_front, b_transparent));
+
+    __m128i index = _mm_blendv_epi8(b, _mm_and_si128(s, index_bits), use_sprite);
+    index = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(index, color_bits), zero), index);
+    const __m128i entry = _mm_and_si128(index, entry_bits);
+    __m128i color = _mm_blendv_epi8(_mm_shuffle_epi8(palette_low, entry),
+                                    _mm_shuffle_epi8(palette_high, entry),
+                                    _mm_cmpeq_epi8(_mm_and_si128(index, upper_half), upper_half));
+    color = _mm_and_si128(color, gray);
+
+    const __m128i hit = _mm_andnot_si128(
+        b_transparent, _mm_cmpeq_epi8(_mm_and_si128(s, sprite_zero), sprite_zero));
+    hits |= _mm_movemask_epi8(hit) & (x + 16 == PPU_WIDTH ? 0x7fff : 0xffff);
+
+    _mm_storeu_si128((__m128i *)(pixels + x), _mm_or_si128(_mm_cvtepu8_epi16(color), emphasis));
+    _mm_storeu_si128((__m128i *)(pixels + x + 8),
+                     _mm_or_si128(_mm_cvtepu8_epi16(_mm_srli_si128(color, 8)), emphasis));
+  }
+
+  if (hits)
+  {
+    ppu->status |= PPUSTATUS_SPRITE_0_HIT;
+  }
+}
+
+/*
+ * Composes 32 pixels at a time, as the SSE4.1 version.
+ */
+__attribute__((target("avx2"))) static void ppu_compose_line_avx2(struct Ppu *ppu,
+                                                                  const uint8_t *bg,
+                                                                  const uint8_t *sprites,
+                                                                  uint16_t *pixels)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i color_bits = _mm256_set1_epi8(3);
+  const __m256i behind = _mm256_set1_epi8(PPU_SPRITE_BEHIND);
+  const __m256i sprite_zero = _mm256_set1_epi8(PPU_SPRITE_ZERO);
+  const __m256i index_bits = _mm256_set1_epi8(0x1f);
+  const __m256i entry_bits = _mm256_set1_epi8(0x0f);
+  const __m256i upper_half = _mm256_set1_epi8(0x10);
+  const __m256i palette_low =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ppu->palette));
+  const __m256i palette_high =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(ppu->palette + 16)));
+  const __m256i gray = _mm256_set1_epi8(ppu->mask & PPUMASK_GRAYSCALE ? 0x30 : 0x3f);
+  const __m256i emphasis =
+      _mm256_set1_epi16((ppu->mask & PPUMASK_EMPHASIS) << (PPU_PIXEL_EMPHASIS_SHIFT - 5));
+
+  uint32_t hits = 0;
+  for (int x = 0; x < PPU_WIDTH; x += 32)
+  {
+    const __m256i b = _mm256_loadu_si256((const __m256i *)(bg + x));
+    const __m256i s = _mm256_loadu_si256((const __m256i *)(sprites + x));
+
+    const __m256i b_transparent = _mm256_cmpeq_epi8(_mm256_and_si256(b, color_bits), zero);
+    const __m256i s_transparent = _mm256_cmpeq_epi8(_mm256_and_si256(s, color_bits), zero);
+    const __m256i s_front = _mm256_cmpeq_epi8(_mm256_and_si256(s, behind), zero);
+    const __m256i use_sprite =
+        _mm256_andnot_si256(s_transparent, _mm256_or_si256(s_front, b_transparent));
+
+    __m256i index = _mm256_blendv_epi8(b, _mm256_and_si256(s, index_bits), use_sprite);
+    index = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_and_si256(index, color_bits), zero),
+                                index);
+    const __m256i entry = _mm256_and_si256(index, entry_bits);
+    __m256i color =
+        _mm256_blendv_epi8(_mm256_shuffle_epi8(palette_low, entry),
+                           _mm256_shuffle_epi8(palette_high, entry),
+                           _mm256_cmpeq_epi8(_mm256_and_si256(index, upper_half), upper_half));
+    color = _mm256_and_si256(color, gray);
+
+    const __m256i hit = _mm256_andnot_si256(
+        b_transparent, _mm256_cmpeq_epi8(_mm256_and_si256(s, sprite_zero), sprite_zero));
+    hits |= (uint32_t)_mm256_movemask_epi8(hit) & (x + 32 == PPU_WIDTH ? 0x7fffffff : 0xffffffff);
+
+    _mm256_storeu_si256(
+        (__m256i *)(pixels + x),
+        _mm256_or_si256(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(color)), emphasis));
+    _mm256_storeu_si256(
+        (__m256i *)(pixels + x + 16),
+        _mm256_or_si256(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(color, 1)), emphasis));
+  }
+
+  if (hits)
+  {
+    ppu->status |= PPUSTATUS_SPRITE_0_HIT;
+  }
+}
+#endif
+
+/*
+ * Merges the background and sprite line buffers into a scanline of the
+ * framebuffer in a single pass, and detects sprite 0 hits.
+ */
+static void ppu_compose_line(struct Ppu *ppu, const uint8_t *bg, const uint8_t *sprites,
+                             uint16_t *pixels)
+{
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      ppu_compose_line_avx2(ppu, bg, sprites, pixels);
+      break;
+    case SIMD_SSE4:
+      ppu_compose_line_sse4(ppu, bg, sprites, pixels);
+      break;
+#endif
+    default:
+      ppu_compose_line_scalar(ppu, bg, sprites, pixels);
+      break;
+  }
+}
+
+/*
+ * Evaluates the sprites of the given visible scanline without drawing it; sets
+ * the sprite overflow flag, and detects a sprite 0 hit from the pixels of
+ * sprite 0 and the one or two background tiles behind it.
+ */
+static void ppu_skip_sprites(struct Ppu *ppu, int scanline)
+{
+  const int height = ppu->ctrl & PPUCTRL_SPRITE_8X16 ? 16 : 8;
+  const uint64_t mask = ppu_sprite_mask(ppu, scanline - 1, height);
+  if (ppu_sprite_overflow(ppu, mask, scanline - 1, height))
+  {
+    ppu->status |= PPUSTATUS_SPRITE_OVERFLOW;
+  }
+
+  if (!(mask & 1) || !(ppu->mask & PPUMASK_BACKGROUND) ||
+      (ppu->status & PPUSTATUS_SPRITE_0_HIT))
+  {
+    return;
+  }
+
+  const uint8_t *sprite = ppu->oam;
+  const uint8_t *pixels = ppu_sprite_row(ppu, sprite, scanline - 1 - sprite[0], height);
+
+  uint8_t background[PPU_WIDTH + 8];
+  const int first = (sprite[3] + ppu->x) / 8;
+  ppu_render_background(ppu, background, first, MIN(2, PPU_WIDTH / 8 + 1 - first));
+
+  /* Either left column clip hides the pixels of one of both. */
+  const bool left = (ppu->mask & (PPUMASK_BACKGROUND_LEFT | PPUMASK_SPRITES_LEFT)) ==
+                    (PPUMASK_BACKGROUND_LEFT | PPUMASK_SPRITES_LEFT);
+  for (int column = 0; column < 8 && sprite[3] + column < PPU_WIDTH; ++column)
+  {
+    const int x = sprite[3] + column;
+    if (pixels[column] && (x >= 8 || left))
+    {
+      ppu_detect_sprite_0_hit(ppu, background[x + ppu->x], PPU_SPRITE_ZERO, x);
+    }
+  }
+}
+
+/*
+ * Renders the given visible scanline into the framebuffer, unless rendering is
+ * skipped, and advances the VRAM address to the next scanline.
+ */
+static void ppu_render_scanline(struct Ppu *ppu, int scanline)
+{
+  uint16_t *pixels = ppu->framebuffer + scanline * PPU_WIDTH;
+
+  if (!ppu_rendering(ppu))
+  {
+    if (!ppu->skip_render)
+    {
+      const uint16_t backdrop = ppu_pixel(ppu, 0);
+      for (int x = 0; x < PPU_WIDTH; ++x)
+      {
+        pixels[x] = backdrop;
+      }
+    }
+    return;
+  }
+
+  if (ppu->skip_render)
+  {
+    if (ppu->mask & PPUMASK_SPRITES)
+    {
+      ppu_skip_sprites(ppu, scanline);
+    }
+  }
+  else
+  {
+    uint8_t background[PPU_WIDTH + 8] = {0};
+    if (ppu->mask & PPUMASK_BACKGROUND)
+    {
+      ppu_render_background(ppu, background, 0, PPU_WIDTH / 8 + 1);
+    }
+    uint8_t *bg = background + ppu->x;
+
+    uint8_t sprites[PPU_WIDTH + 8] = {0};
+    if (ppu->mask & PPUMASK_SPRITES)
+    {
+      ppu_render_sprites(ppu, scanline, sprites);
+    }
+
+    if (!(ppu->mask & PPUMASK_BACKGROUND_LEFT))
+    {
+      memset(bg, 0, 8);
+    }
+    if (!(ppu->mask & PPUMASK_SPRITES_LEFT))
+    {
+      memset(sprites, 0, 8);
+    }
+    ppu_compose_line(ppu, bg, sprites, pixels);
+  }
+
+  ppu->v = ppu_increment_y(ppu->v);
+  ppu->v = (ppu->v & ~0x041f) | (ppu->t & 0x041f);
+}
+
+/*
+ * Sets the VBlank flag and raises an NMI if enabled, unless a status read
+ * suppressed both, and completes the frame.
+ */
+static void ppu_start_vblank(struct Ppu *ppu)
+{
+  if (!ppu->suppress_vblank)
+  {
+    ppu->status |= PPUSTATUS_VBLANK;
+    if (ppu->ctrl & PPUCTRL_NMI)
+    {
+      ppu->nmi = true;
+    }
+  }
+  ppu->suppress_vblank = false;
+  ++ppu->frame;
+}
+
+/*
+ * Returns the dot of the current frame at which the given event occurs.
+ */
+static uint64_t ppu_event_dot(const struct Ppu *ppu, int event)
+{
+  switch (event)
+  {
+    case PPU_EVENT_VBLANK:
+      return PPU_VBLANK_DOT;
+    case PPU_EVENT_PRE_RENDER:
+      return PPU_PRE_RENDER_SCANLINE * PPU_DOTS_PER_SCANLINE + 1;
+    case PPU_EVENT_VERTICAL_COPY:
+      return PPU_PRE_RENDER_SCANLINE * PPU_DOTS_PER_SCANLINE + PPU_VERTICAL_COPY_DOT;
+    case PPU_EVENT_FRAME_END:
+      /* The last dot of odd frames is skipped while rendering is enabled. */
+      return PPU_DOTS_PER_FRAME - (ppu->odd_frame && ppu_rendering(ppu));
+    default:
+      return event * PPU_DOTS_PER_SCANLINE + PPU_RENDER_DOT;
+  }
+}
+
+/*
+ * Advances the PPU to the given dot, rendering whole scanlines.
+ */
+static void ppu_run_scanlines(struct Ppu *ppu, uint64_t dot)
+{
+  uint64_t event_dot;
+  while ((event_dot = ppu->frame_start + ppu_event_dot(ppu, ppu->event)) <= dot)
+  {
+    ppu->dot = event_dot;
+
+    switch (ppu->event)
+    {
+      case PPU_EVENT_VBLANK:
+        ppu_start_vblank(ppu);
+        break;
+      case PPU_EVENT_PRE_RENDER:
+        ppu->status &= ~(PPUSTATUS_VBLANK | PPUSTATUS_SPRITE_0_HIT | PPUSTATUS_SPRITE_OVERFLOW);
+        break;
+      case PPU_EVENT_VERTICAL_COPY:
+        if (ppu_rendering(ppu))
+        {
+          ppu->v = (ppu->v & ~0x7be0) | (ppu->t & 0x7be0);
+        }
+        break;
+      case PPU_EVENT_FRAME_END:
+        ppu->frame_start = event_dot;
+        ppu->odd_frame = !ppu->odd_frame;
+        ppu->event = 0;
+        continue;
+      default:
+        ppu_render_scanline(ppu, ppu->event);
+        break;
+    }
+
+    ++ppu->event;
+  }
+
+  if (dot > ppu->dot)
+  {
+    ppu->dot = dot;
+  }
+}
+
+/*
+ * Returns the pattern table address of row `row` of the given sprite, or of
+ * tile $ff for empty sprite slots.
+ */
+static unsigned ppu_sprite_address(const struct Ppu *ppu, const uint8_t *sprite, int row)
+{
+  if (ppu->ctrl & PPUCTRL_SPRITE_8X16)
+  {
+    if (sprite[2] & 0x80)
+    {
+      row = 15 - row;
+    }
+    return (sprite[1] & 1) * 0x1000 + (sprite[1] & 0xfe) * 16 + (row & 8) * 2 + (row & 7);
+  }
+
+  if (sprite[2] & 0x80)
+  {
+    row = 7 - row;
+  }
+  return (ppu->ctrl & PPUCTRL_SPRITE_TABLE ? 0x1000 : 0) + sprite[1] * 16 + row;
+}
+
+/*
+ * Copies the first eight sprites in OAM that cover the scanline after the
+ * given one to secondary OAM.
+ */
+static void ppu_evaluate_sprites(struct Ppu *ppu, int scanline)
+{
+  const int height = ppu->ctrl & PPUCTRL_SPRITE_8X16 ? 16 : 8;
+
+  ppu->sprite_count = 0;
+  ppu->sprite_zero = false;
+  if (scanline >= PPU_HEIGHT)
+  {
+    return;
+  }
+
+  uint64_t mask = ppu_sprite_mask(ppu, scanline, height);
+  if (ppu_sprite_overflow(ppu, mask, scanline, height))
+  {
+    ppu->status |= PPUSTATUS_SPRITE_OVERFLOW;
+  }
+
+  ppu->sprite_zero = mask & 1;
+  for (; mask && ppu->sprite_count < PPU_SPRITES_PER_SCANLINE; mask &= mask - 1)
+  {
+    memcpy(ppu->sprites[ppu->sprite_count++], ppu->oam + __builtin_ctzll(mask) * 4, 4);
+  }
+}
+
+/*
+ * Fetches the pattern of a sprite slot for the next scanline; the low plane
+ * at `phase` 4, and the high plane at `phase` 6.
+ */
+static void ppu_fetch_sprite(struct Ppu *ppu, int scanline, int slot, int phase)
+{
+  static const uint8_t empty[4] = {0xff, 0xff, 0xff, 0xff};
+  const bool used = slot < ppu->sprite_count;
+  const uint8_t *sprite = used ? ppu->sprites[slot] : empty;
+  const unsigned address = ppu_sprite_address(ppu, sprite, used ? scanline - sprite[0] : 0);
+
+  ppu_drive_address(ppu, address);
+  if (phase == 4)
+  {
+    ppu->sprite_low[slot] = used ? ppu->chr[address] : 0;
+  }
+  else
+  {
+    ppu->sprite_high[slot] = used ? ppu->chr[address + 8] : 0;
+  }
+}
+
+/*
+ * Fetches the background tile data of the current dot; the shift registers
+ * are reloaded every eight dots.
+ */
+static void ppu_fetch_background(struct Ppu *ppu, int dot)
+{
+  const unsigned table = ppu->ctrl & PPUCTRL_BACKGROUND_TABLE ? 0x1000 : 0;
+  const uint16_t v = ppu->v;
+
+  switch ((dot - 1) & 7)
+  {
+    case 0:
+    {
+      ppu->bg_low = (ppu->bg_low & 0xff00) | ppu->next_low;
+      ppu->bg_high = (ppu->bg_high & 0xff00) | ppu->next_high;
+      ppu->bg_attribute_low = (ppu->bg_attribute_low & 0xff00) |
+                              (ppu->next_attribute & 1 ? 0xff : 0);
+      ppu->bg_attribute_high = (ppu->bg_attribute_high & 0xff00) |
+                               (ppu->next_attribute & 2 ? 0xff : 0);
+
+      const Address address = 0x2000 | (v & 0x0fff);
+      ppu_drive_address(ppu, address);
+      ppu->next_index = ppu->nametables[ppu_nametable_offset(ppu, address)];
+      break;
+    }
+    case 2:
+    {
+      const Address address = 0x23c0 | (v & 0x0c00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07);
+      ppu_drive_address(ppu, address);
+      ppu->next_attribute =
+          ppu->nametables[ppu_nametable_offset(ppu, address)] >> (((v >> 4) & 4) | (v & 2));
+      break;
+    }
+    case 4:
+    {
+      const unsigned address = table + ppu->next_index * 16 + ((v >> 12) & 7);
+      ppu_drive_address(ppu, address);
+      ppu->next_low = ppu->chr[address];
+      break;
+    }
+    case 6:
+    {
+      const unsigned address = table + ppu->next_index * 16 + ((v >> 12) & 7) + 8;
+      ppu_drive_address(ppu, address);
+      ppu->next_high = ppu->chr[address];
+      break;
+    }
+    case 7:
+      ppu->v = ppu_increment_x(v);
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * Outputs pixel `x` of the given visible scanline from the shift registers and
+ * the sprites fetched for the scanline. While rendering is skipped, only
+ * pixels of sprite 0 are looked at, until it hits.
+ */
+static void ppu_output_pixel(struct Ppu *ppu, int scanline, int x)
+{
+  if (ppu->skip_render && (!ppu->sprite_zero || (ppu->status & PPUSTATUS_SPRITE_0_HIT)))
+  {
+    return;
+  }
+
+  uint8_t b = 0;
+  if ((ppu->mask & PPUMASK_BACKGROUND) && (x >= 8 || (ppu->mask & PPUMASK_BACKGROUND_LEFT)))
+  {
+    const unsigned shift = 15 - ppu->x;
+    const uint8_t color = ((ppu->bg_low >> shift) & 1) | (((ppu->bg_high >> shift) & 1) << 1);
+    const uint8_t palette =
+        ((ppu->bg_attribute_low >> shift) & 1) | (((ppu->bg_attribute_high >> shift) & 1) << 1);
+    b = color ? palette << 2 | color : 0;
+  }
+
+  uint8_t s = 0;
+  if ((ppu->mask & PPUMASK_SPRITES) && (x >= 8 || (ppu->mask & PPUMASK_SPRITES_LEFT)))
+  {
+    const int count = ppu->skip_render ? 1 : ppu->sprite_count;
+    for (int i = 0; i < count; ++i)
+    {
+      const uint8_t *sprite = ppu->sprites[i];
+      const int column = x - sprite[3];
+      if (column < 0 || column >= 8)
+      {
+        continue;
+      }
+
+      const uint8_t color = ppu_pattern_pixel(ppu->sprite_low[i], ppu->sprite_high[i],
+                                              sprite[2] & 0x40 ? 7 - column : column);
+      if (color)
+      {
+        s = (i == 0 && ppu->sprite_zero ? PPU_SPRITE_ZERO : 0) |
+            (sprite[2] & 0x20 ? PPU_SPRITE_BEHIND : 0) | 0x10 | ((sprite[2] & 3) << 2) | color;
+        break;
+      }
+    }
+  }
+
+  if (ppu->skip_render)
+  {
+    ppu_detect_sprite_0_hit(ppu, b, s, x);
+    return;
+  }
+  ppu->framebuffer[scanline * PPU_WIDTH + x] = ppu_compose(ppu, b, s, x);
+}
+
+/*
+ * Runs a single dot of a visible or the pre-render scanline while rendering is
+ * enabled; the background and sprite fetches, and the scroll updates.
+ */
+static void ppu_render_dot(struct Ppu *ppu, int scanline, int dot)
+{
+  if ((dot >= 2 && dot <= PPU_RENDER_DOT) || (dot >= 321 && dot <= 337))
+  {
+    ppu->bg_low <<= 1;
+    ppu->bg_high <<= 1;
+    ppu->bg_attribute_low <<= 1;
+    ppu->bg_attribute_high <<= 1;
+    ppu_fetch_background(ppu, dot);
+  }
+  else if (dot == 338 || dot == 340)
+  {
+    ppu_drive_address(ppu, 0x2000 | (ppu->v & 0x0fff));
+  }
+
+  if (scanline < PPU_HEIGHT && dot >= 1 && dot <= PPU_WIDTH)
+  {
+    ppu_output_pixel(ppu, scanline, dot - 1);
+  }
+
+  if (dot == PPU_WIDTH)
+  {
+    ppu->v = ppu_increment_y(ppu->v);
+  }
+  else if (dot == PPU_RENDER_DOT)
+  {
+    ppu->v = (ppu->v & ~0x041f) | (ppu->t & 0x041f);
+    ppu_evaluate_sprites(ppu, scanline);
+  }
+  else if (scanline == PPU_PRE_RENDER_SCANLINE && dot >= PPU_VERTICAL_COPY_DOT && dot <= 304)
+  {
+    ppu->v = (ppu->v & ~0x7be0) | (ppu->t & 0x7be0);
+  }
+
+  if (dot >= PPU_RENDER_DOT && dot <= 320)
+  {
+    ppu->oam_address = 0;
+    const int phase = (dot - PPU_RENDER_DOT) & 7;
+    if (phase == 4 || phase == 6)
+    {
+      ppu_fetch_sprite(ppu, scanline, (dot - PPU_RENDER_DOT) / 8, phase);
+    }
+  }
+}
+
+/*
+ * Advances the PPU to the given dot, one dot at a time.
+ */
+static void ppu_run_dots(struct Ppu *ppu, uint64_t dot)
+{
+  while (ppu->dot < dot)
+  {
+    ++ppu->dot;
+
+    /* The last dot of odd frames is skipped while rendering is enabled. */
+    if (ppu->dot - ppu->frame_start == ppu_event_dot(ppu, PPU_EVENT_FRAME_END))
+    {
+      ppu->frame_start = ppu->dot;
+      ppu->odd_frame = !ppu->odd_frame;
+    }
+
+    const int position = ppu->dot - ppu->frame_start;
+    const int scanline = position / PPU_DOTS_PER_SCANLINE;
+    const int x = position % PPU_DOTS_PER_SCANLINE;
+
+    if (scanline < PPU_HEIGHT || scanline == PPU_PRE_RENDER_SCANLINE)
+    {
+      if (scanline == PPU_PRE_RENDER_SCANLINE && x == 1)
+      {
+        ppu->status &= ~(PPUSTATUS_VBLANK | PPUSTATUS_SPRITE_0_HIT | PPUSTATUS_SPRITE_OVERFLOW);
+      }
+
+      if (ppu_rendering(ppu))
+      {
+        ppu_render_dot(ppu, scanline, x);
+      }
+      else if (scanline < PPU_HEIGHT && x >= 1 && x <= PPU_WIDTH && !ppu->skip_render)
+      {
+        /* With rendering disabled, the backdrop is shown, unless the VRAM
+         * address points to palette RAM. */
+        const uint8_t index =
+            (ppu->v & 0x3f00) == 0x3f00 ? ppu_palette_offset(ppu->v) : 0;
+        ppu->framebuffer[scanline * PPU_WIDTH + x - 1] = ppu_pixel(ppu, index);
+      }
+    }
+    else if (position == PPU_VBLANK_DOT)
+    {
+      ppu_start_vblank(ppu);
+    }
+  }
+}
+
+/*
+ * Advances the PPU to the given dot.
+ */
+void ppu_run_until(struct Ppu *ppu, uint64_t dot)
+{
+  if (ppu->accuracy == PPU_ACCURACY_DOT)
+  {
+    ppu_run_dots(ppu, dot);
+  }
+  else
+  {
+    ppu_run_scanlines(ppu, dot);
+  }
+}
+
+/*
+ * Switches between the scanline and the dot renderer. The switch takes effect
+ * at the current dot; the scanline in progress is completed by the new
+ * renderer.
+ */
+void ppu_set_accuracy(struct Ppu *ppu, enum PpuAccuracy accuracy)
+{
+  ppu->accuracy = accuracy;
+
+  /* The dot renderer does not keep track of the next timing event. */
+  const uint64_t position = ppu->dot - ppu->frame_start;
+  ppu->event = 0;
+  while (ppu->event < PPU_EVENT_FRAME_END && ppu_event_dot(ppu, ppu->event) <= position)
+  {
+    ++ppu->event;
+  }
+}
+
+/*
+ * Returns the dot at which the next VBlank starts, assuming the rendering
+ * state does not change until then.
+ */
+uint64_t ppu_next_vblank(const struct Ppu *ppu)
+{
+  if (ppu->dot - ppu->frame_start < PPU_VBLANK_DOT)
+  {
+    return ppu->frame_start + PPU_VBLANK_DOT;
+  }
+
+  return ppu->frame_start + ppu_event_dot(ppu, PPU_EVENT_FRAME_END) + PPU_VBLANK_DOT;
+}
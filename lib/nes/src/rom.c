@@ -48,6 +48,24 @@ void rom_prg_data(struct RomHeader *header, uint8_t *rom_data, uint8_t **prg_dat
   *prg_data_size = header->prg_rom_size * 16 * 1024;
 }
 
+/*
+ * Calculates the offset of the CHR data (pattern tables) in the given ROM
+ * data, which follows the PRG data. Returns a pointer to the CHR data in
+ * `chr_data`, and the size of the CHR data segment in `chr_data_size`, which
+ * is zero in case the cartridge has CHR RAM instead.
+ */
+void rom_chr_data(struct RomHeader *header, uint8_t *rom_data, uint8_t **chr_data,
+                  size_t *chr_data_size)
+{
+  uint8_t *prg_data;
+  size_t prg_data_size;
+  rom_prg_data(header, rom_data, &prg_data, &prg_data_size);
+
+  *chr_data = prg_data + prg_data_size;
+  /* CHR ROM size is stored in units of 8KB blocks. */
+  *chr_data_size = header->chr_rom_size * 8 * 1024;
+}
+
 /*
  * Writes ROM meta information to the given file pointer. Returns 0 in case
  * writing ROM meta information was successful, or an non-zero value in case of
@@ -0,0 +1,120 @@
+#include <lib/nes/include/tile_cache.h>
+#include <lib/std/include/hash.h>
+#include <lib/std/include/util.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static pthread_mutex_t tile_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct TileCache *tile_cache_shared;
+
+/*
+ * Decodes the given tile from the pattern tables `chr` in all flip
+ * orientations.
+ */
+void tile_cache_decode(struct TileCache *cache, const uint8_t *chr, unsigned tile)
+{
+  const uint8_t *planes = chr + tile * 16;
+  for (int row = 0; row < 8; ++row)
+  {
+    const uint8_t low = planes[row];
+    const uint8_t high = planes[row + 8];
+    for (int column = 0; column < 8; ++column)
+    {
+      const uint8_t color = ((low >> (7 - column)) & 1) | (((high >> (7 - column)) & 1) << 1);
+      cache->pixels[0][tile][row * 8 + column] = color;
+      cache->pixels[1][tile][row * 8 + 7 - column] = color;
+      cache->pixels[2][tile][(7 - row) * 8 + column] = color;
+      cache->pixels[3][tile][(7 - row) * 8 + 7 - column] = color;
+    }
+  }
+
+  cache->dirty[tile / 64] &= ~(1ull << (tile % 64));
+}
+
+/*
+ * Creates a private cache for CHR RAM, in which every tile is dirty. Use
+ * `tile_cache_release` to free it.
+ */
+struct TileCache *make_tile_cache(void)
+{
+  struct TileCache *cache;
+  if ((cache = malloc(sizeof(struct TileCache))) == NULL)
+  {
+    nn_quit("Could not allocate tile cache");
+  }
+
+  memset(cache->dirty, 0xff, sizeof cache->dirty);
+  cache->references = 1;
+  cache->next = NULL;
+
+  return cache;
+}
+
+/*
+ * Returns the shared cache of the given CHR ROM, decoding it in case no PPU
+ * uses the same pattern tables yet. Use `tile_cache_release` to release it.
+ */
+struct TileCache *tile_cache_share(const uint8_t *chr)
+{
+  const uint64_t hash = nn_hash64(chr, sizeof ((struct TileCache *)NULL)->chr);
+
+  pthread_mutex_lock(&tile_cache_mutex);
+
+  struct TileCache *cache;
+  for (cache = tile_cache_shared; cache; cache = cache->next)
+  {
+    if (cache->hash == hash && memcmp(cache->chr, chr, sizeof cache->chr) == 0)
+    {
+      ++cache->references;
+      break;
+    }
+  }
+
+  if (cache == NULL)
+  {
+    cache = make_tile_cache();
+    cache->hash = hash;
+    memcpy(cache->chr, chr, sizeof cache->chr);
+    for (unsigned tile = 0; tile < TILE_CACHE_TILES; ++tile)
+    {
+      tile_cache_decode(cache, chr, tile);
+    }
+
+    cache->next = tile_cache_shared;
+    tile_cache_shared = cache;
+  }
+
+  pthread_mutex_unlock(&tile_cache_mutex);
+
+  return cache;
+}
+
+/*
+ * Releases a cache, freeing it once it is no longer used.
+ */
+void tile_cache_release(struct TileCache *cache)
+{
+  if (cache == NULL)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&tile_cache_mutex);
+
+  if (--cache->references == 0)
+  {
+    for (struct TileCache **link = &tile_cache_shared; *link; link = &(*link)->next)
+    {
+      if (*link == cache)
+      {
+        *link = cache->next;
+        break;
+      }
+    }
+    free(cache);
+  }
+
+  pthread_mutex_unlock(&tile_cache_mutex);
+}
@@ -0,0 +1,321 @@
+#include <lib/nes/include/video.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Prepares the given filter for pixels in the given format. The NTSC filter
+ * runs bands of rows on the given thread pool, which may be NULL.
+ */
+void video_output_init(struct VideoOutput *output, enum VideoFilter filter,
+                       enum PixelFormat format, struct thread_pool *pool)
+{
+  output->filter = filter;
+  palette_init(&output->palette, format);
+  if (filter == VIDEO_FILTER_NTSC)
+  {
+    ntsc_init(&output->ntsc, format, pool);
+  }
+}
+
+void video_output_destroy(struct VideoOutput *output)
+{
+  if (output->filter == VIDEO_FILTER_NTSC)
+  {
+    ntsc_destroy(&output->ntsc);
+  }
+}
+
+/*
+ * Converts the current framebuffer of the given PPU to PPU_WIDTH x PPU_HEIGHT
+ * pixels.
+ */
+void video_output_convert(const struct VideoOutput *output, const struct Ppu *ppu,
+                          uint32_t *pixels)
+{
+  switch (output->filter)
+  {
+    case VIDEO_FILTER_PALETTE:
+      palette_convert(&output->palette, ppu->framebuffer, pixels, PPU_HEIGHT * PPU_WIDTH);
+      break;
+    case VIDEO_FILTER_NTSC:
+      ntsc_filter(&output->ntsc, ppu->framebuffer, ntsc_frame_phase(ppu), pixels);
+      break;
+  }
+}
+
+/*
+ * Returns whether the given layout lies within the picture, and has a known
+ * scaler.
+ */
+bool video_layout_valid(const struct VideoLayout *layout)
+{
+  return layout->x >= 0 && layout->y >= 0 && layout->width > 0 && layout->height > 0 &&
+         layout->x + layout->width <= PPU_WIDTH && layout->y + layout->height <= PPU_HEIGHT &&
+         layout->scaler >= SCALER_NONE && layout->scaler <= SCALER_HQ2X;
+}
+
+/* A scaled frame being converted to RGB or YUV, split into bands of rows. */
+struct VideoConversion
+{
+  const struct VideoWriter *writer;
+  const uint32_t *pixels;
+  size_t stride;
+  size_t width;
+  size_t height;
+  int bands;
+};
+
+/*
+ * Converts the RGBA pixels of a band of rows to the output format; the RGB
+ * components of every pixel for PPM, or its Y'CbCr components (BT.601,
+ * limited range) in three planes for Y4M.
+ */
+static void video_writer_convert_band(void *arg, int band)
+{
+  const struct VideoConversion *conversion = arg;
+  const size_t first = conversion->height * band / conversion->bands;
+  const size_t last = conversion->height * (band + 1) / conversion->bands;
+  const size_t width = conversion->width;
+  const size_t plane = width * conversion->height;
+  uint8_t *out = conversion->writer->out;
+
+  for (size_t y = first; y < last; ++y)
+  {
+    const uint8_t *rgba = (const uint8_t *)(conversion->pixels + y * conversion->stride);
+    if (conversion->writer->format == VIDEO_FORMAT_PPM)
+    {
+      uint8_t *rgb = out + y * width * 3;
+      for (size_t x = 0; x < width; ++x)
+      {
+        rgb[3 * x] = rgba[4 * x];
+        rgb[3 * x + 1] = rgba[4 * x + 1];
+        rgb[3 * x + 2] = rgba[4 * x + 2];
+      }
+      continue;
+    }
+
+    uint8_t *luma = out + y * width;
+    uint8_t *cb = luma + plane;
+    uint8_t *cr = cb + plane;
+    for (size_t x = 0; x < width; ++x)
+    {
+      const int r = rgba[4 * x];
+      const int g = rgba[4 * x + 1];
+      const int b = rgba[4 * x + 2];
+      luma[x] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+      cb[x] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+      cr[x] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+  }
+}
+
+/*
+ * Converts the framebuffer of the writer to RGBA, scales the part given by the
+ * layout, converts that to the output format, and writes it to the file. Y4M
+ * frames hold three planes, PPM images interleave the components.
+ */
+static int video_writer_write_frame(struct VideoWriter *writer)
+{
+  const struct VideoLayout *layout = &writer->layout;
+  const int factor = scaler_factor(layout->scaler);
+
+  palette_convert(&writer->palette, writer->framebuffer, writer->pixels, PPU_HEIGHT * PPU_WIDTH);
+
+  struct VideoConversion conversion = {writer,
+                                       writer->pixels + layout->y * PPU_WIDTH + layout->x,
+                                       PPU_WIDTH,
+                                       layout->width * factor,
+                                       layout->height * factor,
+                                       1};
+  if (layout->scaler != SCALER_NONE)
+  {
+    scaler_run(layout->scaler, conversion.pixels, PPU_WIDTH, layout->width, layout->height,
+               writer->scaled, conversion.width, &writer->pool);
+    conversion.pixels = writer->scaled;
+    conversion.stride = conversion.width;
+  }
+
+  conversion.bands = thread_pool_bands(&writer->pool, conversion.height, 1);
+  thread_pool_run(&writer->pool, video_writer_convert_band, &conversion, conversion.bands);
+
+  if (writer->format == VIDEO_FORMAT_Y4M)
+  {
+    if (fputs("FRAME\n", writer->fp) == EOF)
+    {
+      return -1;
+    }
+  }
+  else if (fprintf(writer->fp, "P6\n%zu %zu\n255\n", conversion.width, conversion.height) < 0)
+  {
+    return -1;
+  }
+
+  return fwrite(writer->out, writer->out_size, 1, writer->fp) == 1 ? 0 : -1;
+}
+
+/*
+ * Pops a frame and writes it. Returns the number of frames popped.
+ */
+static size_t video_writer_consume(struct ring_buffer *rb, void *arg)
+{
+  struct VideoWriter *writer = arg;
+
+  if (ring_buffer_pop(rb, writer->framebuffer, 1) == 0)
+  {
+    return 0;
+  }
+
+  NN_ZONE("video frame");
+  if (atomic_load(&writer->error) == 0 && video_writer_write_frame(writer) != 0)
+  {
+    atomic_store(&writer->error, errno != 0 ? errno : EIO);
+  }
+  return 1;
+}
+
+/*
+ * Body of the writer thread; drains the ring buffer until the writer is closed
+ * and the ring buffer is empty.
+ */
+static void *video_writer_run(void *arg)
+{
+  struct VideoWriter *writer = arg;
+
+  NN_ZONE_THREAD_NAME("video writer");
+
+  ring_buffer_drain(&writer->frames, &writer->is_closing, video_writer_consume, writer);
+
+  return NULL;
+}
+
+/*
+ * Frees the buffers of the writer, and closes its file unless it is stdout.
+ * Returns 0 on success, or -1 in case closing the file failed.
+ */
+static int video_writer_free(struct VideoWriter *writer)
+{
+  destroy_ring_buffer(&writer->frames);
+  thread_pool_destroy(&writer->pool);
+  free(writer->framebuffer);
+  free(writer->pixels);
+  free(writer->scaled);
+  free(writer->out);
+
+  if (writer->fp == stdout)
+  {
+    return fflush(stdout) == 0 ? 0 : -1;
+  }
+  return fclose(writer->fp) == 0 ? 0 : -1;
+}
+
+/*
+ * Creates the given video file, or writes to stdout in case the file name is
+ * "-", and starts the writer thread. Only the part of the picture given by the
+ * layout is written, which must be valid. Returns 0 on success, or -1 in case
+ * the file could not be created or the thread could not be started, in which
+ * case `errno` is set.
+ */
+int video_writer_open(struct VideoWriter *writer, const char *file_name, enum VideoFormat format,
+                      const struct VideoLayout *layout)
+{
+  memset(writer, 0, sizeof *writer);
+  writer->format = format;
+  writer->layout = *layout;
+
+  if (strcmp(file_name, "-") == 0)
+  {
+    writer->fp = stdout;
+  }
+  else if ((writer->fp = fopen(file_name, "wb")) == NULL)
+  {
+    return -1;
+  }
+
+  const int width = layout->width * scaler_factor(layout->scaler);
+  const int height = layout->height * scaler_factor(layout->scaler);
+  if (format == VIDEO_FORMAT_Y4M &&
+      fprintf(writer->fp, "YUV4MPEG2 W%d H%d F" VIDEO_FRAME_RATE " Ip A1:1 C444\n", width,
+              height) < 0)
+  {
+    if (writer->fp != stdout)
+    {
+      fclose(writer->fp);
+    }
+    return -1;
+  }
+
+  palette_init(&writer->palette, PIXEL_FORMAT_RGBA);
+
+  /* The writer thread works along with the pool, so leave it a CPU. */
+  if (thread_pool_init(&writer->pool, MAX(thread_pool_default_size() - 1, 0)) != 0)
+  {
+    thread_pool_init(&writer->pool, 0);
+  }
+
+  const size_t frame_size = sizeof ((struct Ppu *)NULL)->framebuffer;
+  const size_t scaled_size = layout->scaler != SCALER_NONE ? (size_t)width * height : 1;
+  writer->frames = make_ring_buffer(frame_size, VIDEO_WRITER_CAPACITY);
+  writer->out_size = (size_t)width * height * 3;
+  if ((writer->framebuffer = malloc(frame_size)) == NULL ||
+      (writer->pixels = malloc(PPU_HEIGHT * PPU_WIDTH * sizeof *writer->pixels)) == NULL ||
+      (writer->scaled = malloc(scaled_size * sizeof *writer->scaled)) == NULL ||
+      (writer->out = malloc(writer->out_size)) == NULL)
+  {
+    nn_quit("Could not allocate video frame buffers");
+  }
+
+  atomic_init(&writer->is_closing, false);
+  atomic_init(&writer->error, 0);
+
+  int error;
+  if ((error = pthread_create(&writer->thread, NULL, video_writer_run, writer)) != 0)
+  {
+    video_writer_free(writer);
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Hands a copy of the given framebuffer over to the writer thread. In case the
+ * ring buffer is full, waits for the writer thread to catch up.
+ */
+void video_writer_push(struct VideoWriter *writer, const uint16_t *framebuffer)
+{
+  while (ring_buffer_push(&writer->frames, framebuffer, 1) == 0)
+  {
+    sched_yield();
+  }
+}
+
+/*
+ * Writes all pending frames, stops the writer thread, and closes the file.
+ * Returns 0 in case all frames were written successfully, or -1 otherwise, in
+ * which case `errno` is set.
+ */
+int video_writer_close(struct VideoWriter *writer)
+{
+  atomic_store(&writer->is_closing, true);
+  pthread_join(writer->thread, NULL);
+
+  int error = atomic_load(&writer->error);
+  if (video_writer_free(writer) != 0 && error == 0)
+  {
+    error = errno;
+  }
+
+  if (error != 0)
+  {
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef NEPNES_STD_BLIP_BUFFER_H
+#define NEPNES_STD_BLIP_BUFFER_H
+
+#include <stdint.h>
+
+/* Resolution of the position of a delta within a sample period. */
+#define BLIP_PHASE_BITS 6
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS)
+
+/* Number of samples a delta is spread over; the latency of the buffer is half
+ * of it. */
+#define BLIP_TAPS 16
+
+/* Fixed point fraction bits of the kernel, and of the integrated samples. */
+#define BLIP_KERNEL_BITS 15
+
+/*
+ * Band-limited synthesis of square-ish waveforms. Rather than sampling a
+ * waveform at the output rate, which aliases, sound sources add the changes
+ * of their amplitude (deltas) at the clock at which they happen. Every delta
+ * is spread over a few output samples as a band-limited step, and output
+ * samples are the running sum of all deltas, with a slow leak that removes DC.
+ * Sources thus only spend time on the transitions of their waveforms, however
+ * high the clock rate.
+ *
+ * Clocks are counted from the start of the current frame; a frame is ended
+ * with `blip_end_frame`, after which its samples can be read. The buffer holds
+ * `capacity` samples, which must be read before they overflow.
+ */
+struct blip_buffer
+{
+  int32_t *deltas; /* capacity + BLIP_TAPS deltas, from the first unread sample */
+  int capacity;
+  uint64_t factor;    /* samples per clock, 32.32 fixed point */
+  uint64_t offset;    /* sample position of the start of the frame, 32.32 */
+  int32_t integrator; /* running sum of deltas, with BLIP_KERNEL_BITS fraction bits */
+  int16_t kernel[BLIP_PHASES][BLIP_TAPS];
+};
+
+struct blip_buffer make_blip_buffer(int capacity, double clock_rate, double sample_rate);
+void destroy_blip_buffer(struct blip_buffer *blip);
+void blip_clear(struct blip_buffer *blip);
+void blip_set_rates(struct blip_buffer *blip, double clock_rate, double sample_rate);
+
+/*
+ * Adds a change of amplitude at the given clock of the current frame.
+ */
+static inline void blip_add_delta(struct blip_buffer *blip, uint32_t clock, int delta)
+{
+  const uint64_t position = blip->offset + clock * blip->factor;
+  int32_t *out = blip->deltas + (position >> 32);
+  const int16_t *kernel = blip->kernel[(position >> (32 - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)];
+  for (int i = 0; i < BLIP_TAPS; ++i)
+  {
+    out[i] += delta * kernel[i];
+  }
+}
+
+void blip_end_frame(struct blip_buffer *blip, uint32_t clocks);
+int blip_samples_available(const struct blip_buffer *blip);
+int blip_read_samples(struct blip_buffer *blip, int16_t *out, int count);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef NEPNES_STD_HASH_H
+#define NEPNES_STD_HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A 128-bit hash, for fingerprints that must not collide in practice, e.g. to
+ * deduplicate large numbers of emulator states.
+ */
+struct hash128
+{
+  uint64_t low;
+  uint64_t high;
+};
+
+uint64_t nn_hash64(const void *data, size_t size);
+struct hash128 nn_hash128(const void *data, size_t size);
+
+static inline bool hash128_equal(struct hash128 a, struct hash128 b)
+{
+  return a.low == b.low && a.high == b.high;
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef NEPNES_STD_METRICS_H
+#define NEPNES_STD_METRICS_H
+
+#include <lib/std/include/util.h>
+
+#include <stdint.h>
+
+/*
+ * A process wide registry of runtime metrics, e.g. the number of emulated CPU
+ * cycles or the frame time distribution. There are three types of metrics:
+ *
+ *   - counters, monotonically increasing totals;
+ *   - gauges, the last value set;
+ *   - histograms, the distribution of recorded values, with a relative error
+ *     of at most 1/METRICS_HISTOGRAM_SUB_BUCKETS, over the full range of
+ *     64-bit values.
+ *
+ * Counters and histograms are updated without locking or atomic
+ * read-modify-write operations; every thread updates its own shard, and shards
+ * are only summed when the metrics are read.
+ *
+ * Metrics are registered once, by name, before they are used. Registering a
+ * name again returns the existing metric.
+ */
+enum metric_type
+{
+  METRIC_COUNTER,
+  METRIC_GAUGE,
+  METRIC_HISTOGRAM
+};
+
+/* Maximum number of metrics in the registry. */
+#define METRICS_MAX 64
+
+/* Number of linear buckets per power of two in a histogram. */
+#define METRICS_HISTOGRAM_SUB_BITS 5
+#define METRICS_HISTOGRAM_SUB_BUCKETS (1 << METRICS_HISTOGRAM_SUB_BITS)
+#define METRICS_HISTOGRAM_BUCKETS \
+  ((64 - METRICS_HISTOGRAM_SUB_BITS + 1) * METRICS_HISTOGRAM_SUB_BUCKETS)
+
+typedef int metric_t;
+
+metric_t metrics_register(const char *name, enum metric_type type);
+
+void metrics_add(metric_t metric, uint64_t n);
+void metrics_set(metric_t metric, double value);
+void metrics_record(metric_t metric, uint64_t value);
+
+/*
+ * A snapshot of a single metric, summed over all threads.
+ */
+struct metric_value
+{
+  const char *name;
+  enum metric_type type;
+  uint64_t count;    /* counter total, or number of recorded histogram values */
+  uint64_t sum;      /* sum of the recorded histogram values */
+  double value;      /* gauge value */
+  uint64_t *buckets; /* histogram buckets, owned by the snapshot */
+};
+
+int metrics_snapshot(struct metric_value *values);
+void metrics_free_snapshot(struct metric_value *values, int n);
+
+unsigned metrics_histogram_bucket(uint64_t value);
+uint64_t metrics_histogram_value(unsigned bucket);
+uint64_t metrics_histogram_percentile(const struct metric_value *value, double percentile);
+
+/*
+ * Periodically rewrites a file with the current value of all metrics, in the
+ * Prometheus text exposition format. Besides its total, the rate per second of
+ * every counter since the previous write is included. The file is replaced
+ * atomically, so that readers never observe a partially written file.
+ */
+struct metrics_writer
+{
+  char *file_name;
+  char *temp_file_name;
+  timestamp_t interval;
+  timestamp_t last_write;
+  uint64_t last_counts[METRICS_MAX];
+};
+
+int metrics_writer_open(struct metrics_writer *writer, const char *file_name,
+                        unsigned interval_ms);
+int metrics_writer_poll(struct metrics_writer *writer);
+int metrics_writer_write(struct metrics_writer *writer);
+void metrics_writer_close(struct metrics_writer *writer);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef NEPNES_STD_PERF_H
+#define NEPNES_STD_PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Hardware performance counters of the host CPU, as provided by the Linux
+ * perf_event_open(2) interface. Counters only count user space events of the
+ * thread that opened them. On other platforms, or in case the kernel does not
+ * allow access to the counters, `perf_open` fails and nothing is counted.
+ */
+enum perf_counter
+{
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_BRANCH_MISSES,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_COUNTER_COUNT
+};
+
+struct perf_counters
+{
+  int leader;                     /* file descriptor of the group leader */
+  int fds[PERF_COUNTER_COUNT];    /* -1 in case the counter is unavailable */
+  int index[PERF_COUNTER_COUNT];  /* position of the counter in a group read */
+  int size;                       /* number of counters in the group */
+};
+
+struct perf_sample
+{
+  uint64_t values[PERF_COUNTER_COUNT];
+};
+
+/*
+ * A named region of code, for example a CPU batch. Counters are accumulated
+ * over every time the region is entered, together with the amount of emulated
+ * work done in the region, such that the counters can be reported per unit of
+ * work, e.g. per emulated instruction.
+ */
+struct perf_region
+{
+  const char *name;
+  uint64_t calls;
+  uint64_t work;
+  struct perf_sample total;
+  struct perf_sample start;
+};
+
+int perf_open(struct perf_counters *pc);
+void perf_close(struct perf_counters *pc);
+bool perf_is_available(const struct perf_counters *pc, enum perf_counter counter);
+const char *perf_counter_name(enum perf_counter counter);
+void perf_read(const struct perf_counters *pc, struct perf_sample *sample);
+
+struct perf_region make_perf_region(const char *name);
+void perf_region_begin(const struct perf_counters *pc, struct perf_region *region);
+void perf_region_end(const struct perf_counters *pc, struct perf_region *region, uint64_t work);
+double perf_region_ipc(const struct perf_region *region);
+double perf_region_per_work(const struct perf_region *region, enum perf_counter counter);
+void perf_region_print(FILE *fp, const struct perf_counters *pc, const struct perf_region *region,
+                       const char *work_unit);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef NEPNES_STD_RESAMPLER_H
+#define NEPNES_STD_RESAMPLER_H
+
+#include <stdint.h>
+
+/* Number of input samples every output sample is filtered from; a multiple of
+ * 16, the number of samples in an AVX2 vector. The latency of the resampler is
+ * half of it. */
+#define RESAMPLER_TAPS 64
+
+/* Largest number of phases of the kernel; ratios that need more phases are
+ * approximated. */
+#define RESAMPLER_MAX_PHASES 256
+
+/* Number of input samples that can be written before output has to be read. */
+#define RESAMPLER_BLOCK 4096
+
+/* Fixed point fraction bits of the kernel. */
+#define RESAMPLER_KERNEL_BITS 14
+
+/*
+ * Polyphase FIR resampler of 16-bit samples, for rational ratios between an
+ * input and an output rate. Every output sample is the dot product of
+ * RESAMPLER_TAPS input samples with one of `phases` kernels; a Kaiser windowed
+ * sinc, low-passed at the lower of both Nyquist frequencies, offset by the
+ * fraction of an input sample at which the output sample falls.
+ *
+ * Input is written in blocks, e.g. the samples of a frame, after which output
+ * can be read. Results are identical on all SIMD levels.
+ */
+struct resampler
+{
+  int16_t *kernel; /* phases rows of RESAMPLER_TAPS coefficients, aligned to 32 bytes */
+  int phases;      /* output samples per `step` input samples */
+  int step;        /* input samples per `phases` output samples */
+  int phase;       /* position of the next output sample past input[0], in 1/phases samples */
+  int16_t *input;  /* RESAMPLER_TAPS + RESAMPLER_BLOCK samples, from the first tap of the next
+                      output sample */
+  int buffered;    /* number of samples in input */
+};
+
+struct resampler make_resampler(int input_rate, int output_rate);
+void destroy_resampler(struct resampler *resampler);
+void resampler_clear(struct resampler *resampler);
+int resampler_write(struct resampler *resampler, const int16_t *in, int count);
+int resampler_samples_available(const struct resampler *resampler);
+int resampler_read(struct resampler *resampler, int16_t *out, int count);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef NEPNES_STD_RING_BUFFER_H
+#define NEPNES_STD_RING_BUFFER_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A lock-free single-producer, single-consumer ring buffer of fixed size
+ * elements. One thread may push elements while another thread pops elements
+ * concurrently, without locking. The capacity is always a power of two.
+ *
+ * The producer and consumer indices live on separate cache lines, and each
+ * side keeps a cached copy of the other side's index, so that the shared
+ * indices are only touched when the cached copy indicates the buffer is full
+ * (producer) or empty (consumer).
+ */
+struct ring_buffer
+{
+  uint8_t *data;
+  size_t element_size;
+  size_t capacity;
+  size_t mask;
+
+  /* Producer side. */
+  alignas(64) atomic_size_t head;
+  size_t cached_tail;
+
+  /* Consumer side. */
+  alignas(64) atomic_size_t tail;
+  size_t cached_head;
+};
+
+/*
+ * Pops elements from a ring buffer and consumes them; returns the number of
+ * elements that were popped, 0 if the ring buffer was empty.
+ */
+typedef size_t (*ring_buffer_consumer_t)(struct ring_buffer *rb, void *arg);
+
+struct ring_buffer make_ring_buffer(size_t element_size, size_t capacity);
+void destroy_ring_buffer(struct ring_buffer *rb);
+
+size_t ring_buffer_size(struct ring_buffer *rb);
+size_t ring_buffer_push(struct ring_buffer *rb, const void *elements, size_t n);
+size_t ring_buffer_pop(struct ring_buffer *rb, void *elements, size_t n);
+void ring_buffer_drain(struct ring_buffer *rb, const atomic_bool *is_closing,
+                       ring_buffer_consumer_t consume, void *arg);
+
+#endif
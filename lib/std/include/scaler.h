@@ -0,0 +1,37 @@
+#ifndef NEPNES_STD_SCALER_H
+#define NEPNES_STD_SCALER_H
+
+#include <lib/std/include/thread_pool.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Pixel art scalers for 32-bit pixels, in any byte order with the alpha
+ * channel last:
+ *
+ * - nearest neighbor, which repeats every pixel 2, 3 or 4 times;
+ * - Scale2x and Scale3x (AdvMAME2x/3x), which round off diagonal edges between
+ *   pixels of the exact same color;
+ * - an hq2x-style scaler, which detects edges between similar colors with
+ *   luma and chroma thresholds, and blends colors along them.
+ */
+enum scaler
+{
+  SCALER_NONE,
+  SCALER_NEAREST2X,
+  SCALER_NEAREST3X,
+  SCALER_NEAREST4X,
+  SCALER_SCALE2X,
+  SCALER_SCALE3X,
+  SCALER_HQ2X
+};
+
+int scaler_factor(enum scaler scaler);
+const char *scaler_to_string(enum scaler scaler);
+int scaler_from_string(const char *s, enum scaler *scaler);
+
+void scaler_run(enum scaler scaler, const uint32_t *src, size_t src_stride, int width, int height,
+                uint32_t *dst, size_t dst_stride, struct thread_pool *pool);
+
+#endif
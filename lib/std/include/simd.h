@@ -0,0 +1,24 @@
+#ifndef NEPNES_STD_SIMD_H
+#define NEPNES_STD_SIMD_H
+
+/*
+ * Instruction set extensions used by vectorized kernels. Kernels are compiled
+ * for every level their target supports, and select one at runtime, so that a
+ * single binary runs on any x86-64 CPU.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define NN_SIMD_X86 1
+#endif
+
+enum simd_level
+{
+  SIMD_SCALAR,
+  SIMD_SSE4, /* SSE4.1 */
+  SIMD_AVX2
+};
+
+enum simd_level simd_level(void);
+void simd_limit(enum simd_level level);
+const char *simd_level_to_string(enum simd_level level);
+
+#endif
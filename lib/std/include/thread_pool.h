@@ -0,0 +1,45 @@
+#ifndef NEPNES_STD_THREAD_POOL_H
+#define NEPNES_STD_THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A task of a thread pool job; called once for every index of the job. */
+typedef void (*thread_pool_task_t)(void *arg, int index);
+
+/*
+ * A fixed set of worker threads that run data parallel jobs, e.g. one task per
+ * band of rows of a frame. The thread starting a job takes part in it, and
+ * waits until all of its tasks are done, so a pool without workers simply runs
+ * jobs on the calling thread. Only one thread may start jobs on a pool.
+ */
+struct thread_pool
+{
+  pthread_t *threads;
+  int size; /* number of worker threads */
+
+  pthread_mutex_t mutex;
+  pthread_cond_t wake; /* signaled when a job starts, or the pool is destroyed */
+  pthread_cond_t done; /* signaled when the last worker finishes a job */
+
+  /* The current job; written with the mutex held. */
+  thread_pool_task_t task;
+  void *arg;
+  int count;
+  uint64_t generation; /* incremented for every job */
+  int busy;            /* workers that did not finish the current job yet */
+  bool is_closing;
+
+  atomic_int next; /* next task index to run */
+};
+
+int thread_pool_init(struct thread_pool *pool, int size);
+void thread_pool_destroy(struct thread_pool *pool);
+int thread_pool_default_size(void);
+int thread_pool_bands(const struct thread_pool *pool, int rows, int min_rows);
+
+void thread_pool_run(struct thread_pool *pool, thread_pool_task_t task, void *arg, int count);
+
+#endif
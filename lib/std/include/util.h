@@ -21,6 +21,9 @@ void nn_log(const char *fmt, ...);
 void nn_quit(const char *fmt, ...);
 void nn_quit_strerror(const char *fmt, ...);
 
+/* Monotonic time in nanoseconds, with an unspecified starting point. */
 typedef unsigned long long timestamp_t;
 
+timestamp_t nn_timestamp(void);
+
 #endif
@@ -0,0 +1,82 @@
+#ifndef NEPNES_STD_ZONE_H
+#define NEPNES_STD_ZONE_H
+
+#include <lib/std/include/util.h>
+
+#include <stdio.h>
+
+/*
+ * Timing zones measure the wall clock time spent in a scope of code, e.g. one
+ * iteration of the frame loop. Every thread records the zones it completes to
+ * its own lock-free ring buffer, which a zone writer drains to a file in the
+ * Chrome trace event format, that can be loaded in Perfetto or
+ * chrome://tracing.
+ *
+ * Zones are only compiled in case NEPNES_ZONES is defined (cmake
+ * -DNEPNES_ZONES=ON); otherwise the macros below expand to nothing. Usage:
+ *
+ *   {
+ *     NN_ZONE("render");
+ *     ...
+ *   } // zone ends here
+ *
+ * Zone names must be string literals, or otherwise outlive the zone writer.
+ */
+#ifdef NEPNES_ZONES
+#define NN_ZONE_CONCAT_(a, b) a##b
+#define NN_ZONE_CONCAT(a, b) NN_ZONE_CONCAT_(a, b)
+#define NN_ZONE(name)                                                                          \
+  struct zone_scope NN_ZONE_CONCAT(zone_scope_, __LINE__) __attribute__((cleanup(zone_end))) = \
+      zone_begin(name)
+#define NN_ZONE_THREAD_NAME(name) zone_thread_name(name)
+#else
+#define NN_ZONE(name) \
+  do                  \
+  {                   \
+  } while (0)
+#define NN_ZONE_THREAD_NAME(name) \
+  do                              \
+  {                               \
+  } while (0)
+#endif
+
+/* Number of completed zones a thread can buffer before zones are dropped. */
+#define ZONE_EVENTS_PER_THREAD (1 << 16)
+
+struct zone_scope
+{
+  const char *name;
+  timestamp_t begin;
+};
+
+struct zone_event
+{
+  const char *name;
+  timestamp_t begin;
+  timestamp_t end;
+};
+
+static inline struct zone_scope zone_begin(const char *name)
+{
+  return (struct zone_scope){.name = name, .begin = nn_timestamp()};
+}
+
+void zone_end(struct zone_scope *scope);
+void zone_thread_name(const char *name);
+
+/*
+ * Writes the zones recorded by all threads to a Chrome trace event file. The
+ * writer may be flushed periodically to keep the per-thread buffers from
+ * overflowing; only one zone writer may be open at the same time.
+ */
+struct zone_writer
+{
+  FILE *fp;
+  size_t events;
+};
+
+int zone_writer_open(struct zone_writer *writer, const char *file_name);
+int zone_writer_flush(struct zone_writer *writer);
+int zone_writer_close(struct zone_writer *writer);
+
+#endif
@@ -0,0 +1,141 @@
+#include <lib/std/include/blip_buffer.h>
+#include <lib/std/include/util.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Cutoff of the band limit, as a fraction of the Nyquist frequency. */
+#define BLIP_CUTOFF 0.9
+
+/* Leak of the integrator per sample; removes DC with a time constant of
+ * 2^BLIP_BASS_SHIFT samples, i.e. a high-pass filter at the sample rate over
+ * 3200; about 30 Hz at the 96 kHz the APU is synthesized at. */
+#define BLIP_BASS_SHIFT 9
+
+/*
+ * Fills the kernel with a windowed sinc impulse per phase; the derivative of
+ * a band-limited step. Every phase sums to exactly 1 << BLIP_KERNEL_BITS, such
+ * that the integrated steps settle at their exact amplitude.
+ */
+static void blip_init_kernel(struct blip_buffer *blip)
+{
+  for (int phase = 0; phase < BLIP_PHASES; ++phase)
+  {
+    double impulse[BLIP_TAPS];
+    double sum = 0;
+    for (int i = 0; i < BLIP_TAPS; ++i)
+    {
+      /* Distance of the tap to the center of the step, in samples. */
+      const double x = i + 1 - BLIP_TAPS / 2 - (double)phase / BLIP_PHASES;
+      const double sinc = x == 0 ? 1 : sin(M_PI * BLIP_CUTOFF * x) / (M_PI * BLIP_CUTOFF * x);
+      const double window = 0.42 + 0.5 * cos(2 * M_PI * x / BLIP_TAPS) +
+                            0.08 * cos(4 * M_PI * x / BLIP_TAPS);
+      impulse[i] = sinc * window;
+      sum += impulse[i];
+    }
+
+    int total = 0;
+    int center = 0;
+    for (int i = 0; i < BLIP_TAPS; ++i)
+    {
+      blip->kernel[phase][i] = lround(impulse[i] / sum * (1 << BLIP_KERNEL_BITS));
+      total += blip->kernel[phase][i];
+      if (blip->kernel[phase][i] > blip->kernel[phase][center])
+      {
+        center = i;
+      }
+    }
+    blip->kernel[phase][center] += (1 << BLIP_KERNEL_BITS) - total;
+  }
+}
+
+/*
+ * Creates a buffer of `capacity` samples at the given sample rate, for
+ * sources that count time at the given clock rate.
+ */
+struct blip_buffer make_blip_buffer(int capacity, double clock_rate, double sample_rate)
+{
+  struct blip_buffer blip = {0};
+  blip.capacity = capacity;
+  blip_set_rates(&blip, clock_rate, sample_rate);
+  if ((blip.deltas = calloc(capacity + BLIP_TAPS, sizeof *blip.deltas)) == NULL)
+  {
+    nn_quit("Could not allocate a blip buffer of %d samples", capacity);
+  }
+  blip_init_kernel(&blip);
+
+  return blip;
+}
+
+/*
+ * Changes the sample rate, or the clock rate, from the next frame on; e.g. to
+ * adjust the sample rate slightly to the rate at which samples are consumed.
+ */
+void blip_set_rates(struct blip_buffer *blip, double clock_rate, double sample_rate)
+{
+  blip->factor = (uint64_t)ceil(ldexp(sample_rate / clock_rate, 32));
+}
+
+void destroy_blip_buffer(struct blip_buffer *blip)
+{
+  free(blip->deltas);
+}
+
+/*
+ * Discards all samples and deltas, and starts a new frame.
+ */
+void blip_clear(struct blip_buffer *blip)
+{
+  memset(blip->deltas, 0, (blip->capacity + BLIP_TAPS) * sizeof *blip->deltas);
+  blip->offset = 0;
+  blip->integrator = 0;
+}
+
+/*
+ * Ends the current frame after the given number of clocks; its samples become
+ * available, and clocks of the next frame count from its end.
+ */
+void blip_end_frame(struct blip_buffer *blip, uint32_t clocks)
+{
+  blip->offset += clocks * blip->factor;
+}
+
+/*
+ * Returns the number of samples that can be read.
+ */
+int blip_samples_available(const struct blip_buffer *blip)
+{
+  return blip->offset >> 32;
+}
+
+/*
+ * Reads up to `count` samples, and returns the number of samples read. With
+ * `out` NULL, the samples are discarded.
+ */
+int blip_read_samples(struct blip_buffer *blip, int16_t *out, int count)
+{
+  count = MIN(count, blip_samples_available(blip));
+
+  int32_t integrator = blip->integrator;
+  for (int i = 0; i < count; ++i)
+  {
+    integrator += blip->deltas[i];
+    const int32_t sample = integrator >> BLIP_KERNEL_BITS;
+    if (out)
+    {
+      out[i] = MAX(INT16_MIN, MIN(sample, INT16_MAX));
+    }
+    integrator -= sample * (1 << (BLIP_KERNEL_BITS - BLIP_BASS_SHIFT));
+  }
+  blip->integrator = integrator;
+
+  /* Move the deltas of the unread samples, and those of the current frame, to
+   * the front. */
+  const int remaining = blip->capacity + BLIP_TAPS - count;
+  memmove(blip->deltas, blip->deltas + count, remaining * sizeof *blip->deltas);
+  memset(blip->deltas + remaining, 0, count * sizeof *blip->deltas);
+  blip->offset -= (uint64_t)count << 32;
+
+  return count;
+}
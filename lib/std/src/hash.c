@@ -0,0 +1,324 @@
+#include <lib/std/include/hash.h>
+#include <lib/std/include/simd.h>
+
+#include <string.h>
+
+#ifdef NN_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * The hash follows the design of XXH3: input is consumed in stripes of 64
+ * bytes by eight 64-bit accumulators, each of which adds the product of the
+ * low and high halves of an input word mixed with a secret key, plus the
+ * input word of its neighbor. Such rounds are independent per lane, hence
+ * vectorize well. Every block of 16 stripes, the accumulators are scrambled.
+ * Values are not compatible with XXH3, but are stable across versions and
+ * SIMD levels of nepnes.
+ */
+#define HASH_STRIPE 64
+#define HASH_STRIPES_PER_BLOCK 16
+#define HASH_BLOCK (HASH_STRIPE * HASH_STRIPES_PER_BLOCK)
+
+/* Inputs up to this size are mixed 16 bytes at a time instead. */
+#define HASH_SHORT 128
+
+/* Secret keys of the stripes of a block, and of the scramble at its end. */
+#define HASH_SECRET_WORDS 24
+#define HASH_SCRAMBLE_SECRET (HASH_SECRET_WORDS - 8)
+#define HASH_LAST_STRIPE_SECRET 13
+
+#define PRIME32_1 0x9e3779b1ull
+#define PRIME32_2 0x85ebca77ull
+#define PRIME32_3 0xc2b2ae3dull
+#define PRIME64_1 0x9e3779b185ebca87ull
+#define PRIME64_2 0xc2b2ae3d27d4eb4full
+#define PRIME64_3 0x165667b19e3779f9ull
+#define PRIME64_4 0x85ebca77c2b2ae63ull
+#define PRIME64_5 0x27d4eb2f165667c5ull
+
+static const uint64_t hash_secret[HASH_SECRET_WORDS] = {
+    0x911002fbb4ec1e9dull, 0xd4e64c97ae6a6af3ull, 0xb0d950aba423a97cull,
+    0xa0b63ba56c373f25ull, 0x308271b2e510aedcull, 0x103839a78834d523ull,
+    0xf875f40d23006b60ull, 0x944e06e783f25e1dull, 0xe883ea6f38dccdf3ull,
+    0x7922c118c6f9f4f0ull, 0x89496994901bd56aull, 0x634dacf84ff60a40ull,
+    0x2fd03f33b7fad409ull, 0xd0ee16d9174f7ca2ull, 0x053de25ad6c47ecbull,
+    0xec1dd8842a9e9645ull, 0x18a5d01d53e98eb0ull, 0x3a20e7d02e58b820ull,
+    0x90bc665e4aaf5d71ull, 0x989e3ef110acaa61ull, 0xfec90a693c055af3ull,
+    0x7fab82a62b2f441bull, 0x6446cb4aef2660adull, 0xd7ebb063fc2f93dfull,
+};
+
+static inline uint64_t hash_read64(const uint8_t *p)
+{
+  uint64_t value;
+  memcpy(&value, p, sizeof value);
+  return value;
+}
+
+/*
+ * Returns the 128-bit product of `a` and `b`, folded to 64 bits.
+ */
+static inline uint64_t hash_fold64(uint64_t a, uint64_t b)
+{
+  __extension__ typedef unsigned __int128 uint128_t;
+  const uint128_t product = (uint128_t)a * b;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static inline uint64_t hash_avalanche(uint64_t h)
+{
+  h ^= h >> 37;
+  h *= 0x165667919e3779f9ull;
+  return h ^ (h >> 32);
+}
+
+/*
+ * Hashes inputs up to HASH_SHORT bytes, using the secret from word `secret`.
+ */
+static uint64_t hash_short(const uint8_t *p, size_t size, int secret)
+{
+  const uint64_t *key = hash_secret + secret;
+  uint64_t acc = (size * PRIME64_1) ^ key[18];
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16)
+  {
+    acc += hash_fold64(hash_read64(p + i) ^ key[i / 8], hash_read64(p + i + 8) ^ key[i / 8 + 1]);
+  }
+
+  if (i < size)
+  {
+    /* The last 16 bytes overlap the previous ones, unless the input is
+     * shorter; the size tells apart inputs that differ in trailing zeros. */
+    uint8_t tail[16] = {0};
+    if (size >= 16)
+    {
+      memcpy(tail, p + size - 16, 16);
+    }
+    else
+    {
+      memcpy(tail, p, size);
+    }
+    acc += hash_fold64(hash_read64(tail) ^ key[16], hash_read64(tail + 8) ^ key[17]);
+  }
+
+  return hash_avalanche(acc);
+}
+
+/*
+ * Accumulates `stripes` stripes, starting with the secret at word `key`.
+ */
+static void hash_accumulate_scalar(uint64_t acc[8], const uint8_t *p, size_t stripes,
+                                   const uint64_t *key)
+{
+  for (size_t stripe = 0; stripe < stripes; ++stripe)
+  {
+    for (int lane = 0; lane < 8; ++lane)
+    {
+      const uint64_t data = hash_read64(p + stripe * HASH_STRIPE + lane * 8);
+      const uint64_t mixed = data ^ key[stripe + lane];
+      acc[lane ^ 1] += data;
+      acc[lane] += (mixed & 0xffffffff) * (mixed >> 32);
+    }
+  }
+}
+
+static void hash_scramble_scalar(uint64_t acc[8])
+{
+  for (int lane = 0; lane < 8; ++lane)
+  {
+    acc[lane] ^= acc[lane] >> 47;
+    acc[lane] ^= hash_secret[HASH_SCRAMBLE_SECRET + lane];
+    acc[lane] *= PRIME32_1;
+  }
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Accumulates two lanes per vector; the multiplies are 32x32 to 64 bits, as
+ * in the scalar version.
+ */
+__attribute__((target("sse4.1"))) static void hash_accumulate_sse4(uint64_t acc[8],
+                                                                   const uint8_t *p,
+                                                                   size_t stripes,
+                                                                   const uint64_t *key)
+{
+  __m128i a[4];
+  for (int i = 0; i < 4; ++i)
+  {
+    a[i] = _mm_loadu_si128((const __m128i *)acc + i);
+  }
+
+  for (size_t stripe = 0; stripe < stripes; ++stripe)
+  {
+    const __m128i *data = (const __m128i *)(p + stripe * HASH_STRIPE);
+    const __m128i *secret = (const __m128i *)(key + stripe);
+    for (int i = 0; i < 4; ++i)
+    {
+      const __m128i d = _mm_loadu_si128(data + i);
+      const __m128i mixed = _mm_xor_si128(d, _mm_loadu_si128(secret + i));
+      const __m128i product = _mm_mul_epu32(mixed, _mm_shuffle_epi32(mixed, 0xb1));
+      a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, _mm_shuffle_epi32(d, 0x4e)));
+    }
+  }
+
+  for (int i = 0; i < 4; ++i)
+  {
+    _mm_storeu_si128((__m128i *)acc + i, a[i]);
+  }
+}
+
+__attribute__((target("sse4.1"))) static void hash_scramble_sse4(uint64_t acc[8])
+{
+  const __m128i prime = _mm_set1_epi32((int)PRIME32_1);
+  for (int i = 0; i < 4; ++i)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i *)acc + i);
+    a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+    a = _mm_xor_si128(
+        a, _mm_loadu_si128((const __m128i *)(hash_secret + HASH_SCRAMBLE_SECRET) + i));
+    const __m128i low = _mm_mul_epu32(a, prime);
+    const __m128i high = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+    _mm_storeu_si128((__m128i *)acc + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+  }
+}
+
+/*
+ * Accumulates four lanes per vector, as the SSE4.1 version.
+ */
+__attribute__((target("avx2"))) static void hash_accumulate_avx2(uint64_t acc[8],
+                                                                 const uint8_t *p,
+                                                                 size_t stripes,
+                                                                 const uint64_t *key)
+{
+  __m256i a[2];
+  for (int i = 0; i < 2; ++i)
+  {
+    a[i] = _mm256_loadu_si256((const __m256i *)acc + i);
+  }
+
+  for (size_t stripe = 0; stripe < stripes; ++stripe)
+  {
+    const __m256i *data = (const __m256i *)(p + stripe * HASH_STRIPE);
+    const __m256i *secret = (const __m256i *)(key + stripe);
+    for (int i = 0; i < 2; ++i)
+    {
+      const __m256i d = _mm256_loadu_si256(data + i);
+      const __m256i mixed = _mm256_xor_si256(d, _mm256_loadu_si256(secret + i));
+      const __m256i product = _mm256_mul_epu32(mixed, _mm256_shuffle_epi32(mixed, 0xb1));
+      a[i] = _mm256_add_epi64(a[i], _mm256_add_epi64(product, _mm256_shuffle_epi32(d, 0x4e)));
+    }
+  }
+
+  for (int i = 0; i < 2; ++i)
+  {
+    _mm256_storeu_si256((__m256i *)acc + i, a[i]);
+  }
+}
+
+__attribute__((target("avx2"))) static void hash_scramble_avx2(uint64_t acc[8])
+{
+  const __m256i prime = _mm256_set1_epi32((int)PRIME32_1);
+  for (int i = 0; i < 2; ++i)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i *)acc + i);
+    a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+    a = _mm256_xor_si256(
+        a, _mm256_loadu_si256((const __m256i *)(hash_secret + HASH_SCRAMBLE_SECRET) + i));
+    const __m256i low = _mm256_mul_epu32(a, prime);
+    const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+    _mm256_storeu_si256((__m256i *)acc + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+  }
+}
+#endif
+
+/*
+ * Runs the accumulators over inputs longer than HASH_SHORT bytes: whole blocks
+ * first, then the remaining stripes, and finally the last 64 bytes, which may
+ * overlap the stripes before.
+ */
+static void hash_long(uint64_t acc[8], const uint8_t *p, size_t size)
+{
+  void (*accumulate)(uint64_t *, const uint8_t *, size_t, const uint64_t *);
+  void (*scramble)(uint64_t *);
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      accumulate = hash_accumulate_avx2;
+      scramble = hash_scramble_avx2;
+      break;
+    case SIMD_SSE4:
+      accumulate = hash_accumulate_sse4;
+      scramble = hash_scramble_sse4;
+      break;
+#endif
+    default:
+      accumulate = hash_accumulate_scalar;
+      scramble = hash_scramble_scalar;
+      break;
+  }
+
+  const uint64_t initial[8] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+                               PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+  memcpy(acc, initial, sizeof initial);
+
+  const size_t blocks = (size - 1) / HASH_BLOCK;
+  for (size_t block = 0; block < blocks; ++block)
+  {
+    accumulate(acc, p + block * HASH_BLOCK, HASH_STRIPES_PER_BLOCK, hash_secret);
+    scramble(acc);
+  }
+
+  const size_t stripes = (size - 1 - blocks * HASH_BLOCK) / HASH_STRIPE;
+  accumulate(acc, p + blocks * HASH_BLOCK, stripes, hash_secret);
+  accumulate(acc, p + size - HASH_STRIPE, 1, hash_secret + HASH_LAST_STRIPE_SECRET);
+}
+
+/*
+ * Merges the accumulators into 64 bits, using the secret from word `secret`.
+ */
+static uint64_t hash_merge(const uint64_t acc[8], uint64_t start, int secret)
+{
+  const uint64_t *key = hash_secret + secret;
+  uint64_t result = start;
+  for (int i = 0; i < 8; i += 2)
+  {
+    result += hash_fold64(acc[i] ^ key[i], acc[i + 1] ^ key[i + 1]);
+  }
+  return hash_avalanche(result);
+}
+
+/*
+ * Returns a 64-bit hash of the given data. Used to fingerprint emulator state,
+ * e.g. to compare runs; not suited for adversarial input. Runs at memory
+ * bandwidth for large inputs, using SSE4.1 or AVX2 when available.
+ */
+uint64_t nn_hash64(const void *data, size_t size)
+{
+  if (size <= HASH_SHORT)
+  {
+    return hash_short(data, size, 0);
+  }
+
+  uint64_t acc[8];
+  hash_long(acc, data, size);
+  return hash_merge(acc, size * PRIME64_1, 1);
+}
+
+/*
+ * Returns a 128-bit hash of the given data; the low half differs from
+ * `nn_hash64`, but is computed in the same pass.
+ */
+struct hash128 nn_hash128(const void *data, size_t size)
+{
+  if (size <= HASH_SHORT)
+  {
+    return (struct hash128){hash_short(data, size, 1), hash_short(data, size, 4)};
+  }
+
+  uint64_t acc[8];
+  hash_long(acc, data, size);
+  return (struct hash128){hash_merge(acc, size * PRIME64_2, 3),
+                          hash_merge(acc, ~(size * PRIME64_4), 11)};
+}
@@ -39,6 +39,8 @@ static int inflate_file_index(zip_t *zip, int index, uint8_t **data, size_t *siz
     offset = *data + *size - BUFFER_SIZE;
   }
 
+  zip_fclose(zip_file);
+
   if (bytes_read == -1)
   {
     return -1;
@@ -70,7 +72,9 @@ int nn_read_all(const char *file_name, uint8_t **data, size_t *size)
   zip_t *zip = NULL;
   if ((zip = zip_open(file_name, ZIP_RDONLY, NULL)) != NULL)
   {
-    return inflate_file_index(zip, 0, data, size);
+    const int result = inflate_file_index(zip, 0, data, size);
+    zip_discard(zip);
+    return result;
   }
 
   /* Otherwise, just open the file as a whole. */
@@ -109,10 +113,8 @@ int nn_read_all(const char *file_name, uint8_t **data, size_t *size)
   }
 
   /* Read all data. */
-  if (fread(*data, 1, *size, fp) != *size)
-  {
-    return -1;
-  }
+  const size_t bytes_read = fread(*data, 1, *size, fp);
+  fclose(fp);
 
-  return 0;
+  return bytes_read == *size ? 0 : -1;
 }
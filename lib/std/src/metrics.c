@@ -0,0 +1,371 @@
+#include <lib/std/include/metrics.h>
+#include <lib/std/include/util.h>
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Counters and histograms updated by a single thread. Only the owning thread
+ * writes to its shard, hence plain loads and stores suffice; they are atomic
+ * merely so that a concurrent snapshot never reads a torn value. Shards are
+ * never freed, since their counts still contribute after their thread exited.
+ */
+struct metrics_shard
+{
+  atomic_uint_least64_t counts[METRICS_MAX];
+  atomic_uint_least64_t sums[METRICS_MAX];
+  _Atomic(atomic_uint_least64_t *) buckets[METRICS_MAX];
+  struct metrics_shard *next;
+};
+
+static pthread_mutex_t metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char *metrics_names[METRICS_MAX];
+static enum metric_type metrics_types[METRICS_MAX];
+static int metrics_count;
+static struct metrics_shard *metrics_shards;
+
+/* Gauges are not sharded; they hold the bit pattern of a double. */
+static atomic_uint_least64_t metrics_gauges[METRICS_MAX];
+
+static _Thread_local struct metrics_shard *metrics_current_shard;
+
+/*
+ * Returns the shard of the calling thread, creating it on first use.
+ */
+static struct metrics_shard *metrics_this_shard(void)
+{
+  if (metrics_current_shard)
+  {
+    return metrics_current_shard;
+  }
+
+  struct metrics_shard *shard;
+  if ((shard = calloc(1, sizeof(struct metrics_shard))) == NULL)
+  {
+    nn_quit("Could not allocate metrics shard");
+  }
+
+  pthread_mutex_lock(&metrics_mutex);
+  shard->next = metrics_shards;
+  metrics_shards = shard;
+  pthread_mutex_unlock(&metrics_mutex);
+
+  return metrics_current_shard = shard;
+}
+
+/*
+ * Adds `n` to a value that is only written by the calling thread.
+ */
+static inline void metrics_increment(atomic_uint_least64_t *value, uint64_t n)
+{
+  atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n,
+                        memory_order_relaxed);
+}
+
+/*
+ * Registers a metric of the given type, and returns a handle to it. In case a
+ * metric with the same name is registered already, returns that metric.
+ */
+metric_t metrics_register(const char *name, enum metric_type type)
+{
+  pthread_mutex_lock(&metrics_mutex);
+
+  metric_t metric;
+  for (metric = 0; metric < metrics_count; ++metric)
+  {
+    if (strcmp(metrics_names[metric], name) == 0)
+    {
+      break;
+    }
+  }
+
+  if (metric == metrics_count)
+  {
+    if (metrics_count == METRICS_MAX)
+    {
+      nn_quit("Could not register metric '%s', too many metrics", name);
+    }
+
+    metrics_names[metric] = name;
+    metrics_types[metric] = type;
+    ++metrics_count;
+  }
+
+  pthread_mutex_unlock(&metrics_mutex);
+
+  return metric;
+}
+
+/*
+ * Increments the given counter by `n`.
+ */
+void metrics_add(metric_t metric, uint64_t n)
+{
+  metrics_increment(&metrics_this_shard()->counts[metric], n);
+}
+
+/*
+ * Sets the given gauge to `value`.
+ */
+void metrics_set(metric_t metric, double value)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof bits);
+  atomic_store_explicit(&metrics_gauges[metric], bits, memory_order_relaxed);
+}
+
+/*
+ * Returns the index of the histogram bucket that holds the given value.
+ * Values below the number of sub buckets have a bucket of their own; above,
+ * every power of two is split in METRICS_HISTOGRAM_SUB_BUCKETS equally sized
+ * buckets.
+ */
+unsigned metrics_histogram_bucket(uint64_t value)
+{
+  if (value < METRICS_HISTOGRAM_SUB_BUCKETS)
+  {
+    return value;
+  }
+
+  const unsigned exponent = 63 - __builtin_clzll(value);
+  const unsigned mantissa = value >> (exponent - METRICS_HISTOGRAM_SUB_BITS);
+  return (exponent - METRICS_HISTOGRAM_SUB_BITS + 1) * METRICS_HISTOGRAM_SUB_BUCKETS + mantissa -
+         METRICS_HISTOGRAM_SUB_BUCKETS;
+}
+
+/*
+ * Returns the value in the middle of the given histogram bucket.
+ */
+uint64_t metrics_histogram_value(unsigned bucket)
+{
+  if (bucket < METRICS_HISTOGRAM_SUB_BUCKETS)
+  {
+    return bucket;
+  }
+
+  const unsigned exponent = bucket / METRICS_HISTOGRAM_SUB_BUCKETS + METRICS_HISTOGRAM_SUB_BITS - 1;
+  const uint64_t mantissa =
+      bucket % METRICS_HISTOGRAM_SUB_BUCKETS + METRICS_HISTOGRAM_SUB_BUCKETS;
+  const uint64_t width = 1ull << (exponent - METRICS_HISTOGRAM_SUB_BITS);
+  return mantissa * width + width / 2;
+}
+
+/*
+ * Records a value in the given histogram.
+ */
+void metrics_record(metric_t metric, uint64_t value)
+{
+  struct metrics_shard *shard = metrics_this_shard();
+
+  atomic_uint_least64_t *buckets =
+      atomic_load_explicit(&shard->buckets[metric], memory_order_relaxed);
+  if (buckets == NULL)
+  {
+    if ((buckets = calloc(METRICS_HISTOGRAM_BUCKETS, sizeof *buckets)) == NULL)
+    {
+      nn_quit("Could not allocate histogram '%s'", metrics_names[metric]);
+    }
+    atomic_store_explicit(&shard->buckets[metric], buckets, memory_order_release);
+  }
+
+  metrics_increment(&buckets[metrics_histogram_bucket(value)], 1);
+  metrics_increment(&shard->counts[metric], 1);
+  metrics_increment(&shard->sums[metric], value);
+}
+
+/*
+ * Fills `values` with the current value of all registered metrics, which must
+ * have room for METRICS_MAX values. Returns the number of metrics. Histogram
+ * buckets are allocated, use `metrics_free_snapshot` to free them.
+ */
+int metrics_snapshot(struct metric_value *values)
+{
+  pthread_mutex_lock(&metrics_mutex);
+
+  const int n = metrics_count;
+  for (int i = 0; i < n; ++i)
+  {
+    values[i] = (struct metric_value){.name = metrics_names[i], .type = metrics_types[i]};
+
+    if (values[i].type == METRIC_GAUGE)
+    {
+      const uint64_t bits = atomic_load_explicit(&metrics_gauges[i], memory_order_relaxed);
+      memcpy(&values[i].value, &bits, sizeof bits);
+    }
+    else if (values[i].type == METRIC_HISTOGRAM)
+    {
+      if ((values[i].buckets = calloc(METRICS_HISTOGRAM_BUCKETS, sizeof(uint64_t))) == NULL)
+      {
+        nn_quit("Could not allocate histogram '%s'", metrics_names[i]);
+      }
+    }
+  }
+
+  for (struct metrics_shard *shard = metrics_shards; shard; shard = shard->next)
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      values[i].count += atomic_load_explicit(&shard->counts[i], memory_order_relaxed);
+      values[i].sum += atomic_load_explicit(&shard->sums[i], memory_order_relaxed);
+
+      const atomic_uint_least64_t *buckets =
+          atomic_load_explicit(&shard->buckets[i], memory_order_acquire);
+      if (values[i].buckets && buckets)
+      {
+        for (unsigned b = 0; b < METRICS_HISTOGRAM_BUCKETS; ++b)
+        {
+          values[i].buckets[b] += atomic_load_explicit(&buckets[b], memory_order_relaxed);
+        }
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&metrics_mutex);
+
+  return n;
+}
+
+/*
+ * Frees the histogram buckets of a snapshot of `n` metrics.
+ */
+void metrics_free_snapshot(struct metric_value *values, int n)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    free(values[i].buckets);
+  }
+}
+
+/*
+ * Returns the value below which the given fraction of the values recorded in
+ * a histogram snapshot fall, or zero in case the histogram is empty. Since
+ * the buckets of a snapshot may be read while they are updated, the count of
+ * the buckets is used rather than the histogram count.
+ */
+uint64_t metrics_histogram_percentile(const struct metric_value *value, double percentile)
+{
+  uint64_t total = 0;
+  for (unsigned b = 0; b < METRICS_HISTOGRAM_BUCKETS; ++b)
+  {
+    total += value->buckets[b];
+  }
+
+  const double rank = percentile * total;
+  uint64_t count = 0;
+  for (unsigned b = 0; b < METRICS_HISTOGRAM_BUCKETS; ++b)
+  {
+    count += value->buckets[b];
+    if (count > 0 && count >= rank)
+    {
+      return metrics_histogram_value(b);
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Prepares writing all metrics to the given file, at most once per interval.
+ * Returns 0 on success, or -1 in case of an error, in which case errno is set.
+ */
+int metrics_writer_open(struct metrics_writer *writer, const char *file_name,
+                        unsigned interval_ms)
+{
+  memset(writer, 0, sizeof *writer);
+  if ((writer->file_name = strdup(file_name)) == NULL ||
+      (writer->temp_file_name = nn_strcat(file_name, ".tmp")) == NULL)
+  {
+    free(writer->file_name);
+    return -1;
+  }
+
+  writer->interval = interval_ms * 1000000ull;
+  writer->last_write = nn_timestamp();
+
+  return 0;
+}
+
+/*
+ * Rewrites the metrics file in case the interval elapsed since the previous
+ * write. Returns 0 on success, or -1 in case of a write error.
+ */
+int metrics_writer_poll(struct metrics_writer *writer)
+{
+  if (nn_timestamp() - writer->last_write < writer->interval)
+  {
+    return 0;
+  }
+
+  return metrics_writer_write(writer);
+}
+
+/*
+ * Rewrites the metrics file. Returns 0 on success, or -1 in case of an error,
+ * in which case errno is set.
+ */
+int metrics_writer_write(struct metrics_writer *writer)
+{
+  const timestamp_t now = nn_timestamp();
+  const double elapsed = (now - writer->last_write) / 1e9;
+  writer->last_write = now;
+
+  FILE *fp;
+  if ((fp = fopen(writer->temp_file_name, "w")) == NULL)
+  {
+    return -1;
+  }
+
+  struct metric_value values[METRICS_MAX];
+  const int n = metrics_snapshot(values);
+  for (int i = 0; i < n; ++i)
+  {
+    const struct metric_value *value = &values[i];
+    switch (value->type)
+    {
+      case METRIC_COUNTER:
+        fprintf(fp, "# TYPE nepnes_%s counter\n", value->name);
+        fprintf(fp, "nepnes_%s %" PRIu64 "\n", value->name, value->count);
+        fprintf(fp, "# TYPE nepnes_%s_per_second gauge\n", value->name);
+        fprintf(fp, "nepnes_%s_per_second %g\n", value->name,
+                elapsed > 0 ? (value->count - writer->last_counts[i]) / elapsed : 0.0);
+        writer->last_counts[i] = value->count;
+        break;
+      case METRIC_GAUGE:
+        fprintf(fp, "# TYPE nepnes_%s gauge\n", value->name);
+        fprintf(fp, "nepnes_%s %g\n", value->name, value->value);
+        break;
+      case METRIC_HISTOGRAM:
+        fprintf(fp, "# TYPE nepnes_%s summary\n", value->name);
+        fprintf(fp, "nepnes_%s{quantile=\"0.5\"} %" PRIu64 "\n", value->name,
+                metrics_histogram_percentile(value, 0.5));
+        fprintf(fp, "nepnes_%s{quantile=\"0.99\"} %" PRIu64 "\n", value->name,
+                metrics_histogram_percentile(value, 0.99));
+        fprintf(fp, "nepnes_%s_sum %" PRIu64 "\n", value->name, value->sum);
+        fprintf(fp, "nepnes_%s_count %" PRIu64 "\n", value->name, value->count);
+        break;
+    }
+  }
+  metrics_free_snapshot(values, n);
+
+  const bool error = ferror(fp);
+  if (fclose(fp) != 0 || error)
+  {
+    return -1;
+  }
+
+  return rename(writer->temp_file_name, writer->file_name);
+}
+
+/*
+ * Frees dynamically allocated memory for a metrics writer. The metrics file
+ * is left as is.
+ */
+void metrics_writer_close(struct metrics_writer *writer)
+{
+  free(writer->file_name);
+  free(writer->temp_file_name);
+}
@@ -0,0 +1,244 @@
+#include <lib/std/include/perf.h>
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *counter_names[] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_BRANCH_MISSES] = "branch-misses",
+    [PERF_L1D_MISSES] = "L1d-misses",
+    [PERF_LLC_MISSES] = "LLC-misses",
+};
+
+#ifdef __linux__
+/*
+ * Opens a single counter, as part of the group of the given leader, or as the
+ * group leader in case `leader` is -1.
+ */
+static int open_counter(enum perf_counter counter, int leader)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof attr);
+  attr.size = sizeof attr;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.disabled = leader == -1;
+
+  switch (counter)
+  {
+    case PERF_CYCLES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERF_INSTRUCTIONS:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERF_BRANCH_MISSES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    case PERF_L1D_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case PERF_LLC_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+#endif
+
+/*
+ * Opens and starts all counters for the calling thread. Cycles and
+ * instructions are required, the other counters are only counted when the
+ * host CPU supports them. Returns 0 on success, or -1 in case the counters are
+ * not available, in which case `errno` is set.
+ */
+int perf_open(struct perf_counters *pc)
+{
+  pc->leader = -1;
+  pc->size = 0;
+  for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+  {
+    pc->fds[i] = -1;
+    pc->index[i] = -1;
+  }
+
+#ifdef __linux__
+  for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+  {
+    if ((pc->fds[i] = open_counter(i, pc->leader)) == -1)
+    {
+      if (i == PERF_CYCLES || i == PERF_INSTRUCTIONS)
+      {
+        const int error = errno;
+        perf_close(pc);
+        errno = error;
+        return -1;
+      }
+      continue;
+    }
+
+    if (pc->leader == -1)
+    {
+      pc->leader = pc->fds[i];
+    }
+    pc->index[i] = pc->size++;
+  }
+
+  if (ioctl(pc->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0)
+  {
+    const int error = errno;
+    perf_close(pc);
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/*
+ * Closes all counters.
+ */
+void perf_close(struct perf_counters *pc)
+{
+#ifdef __linux__
+  for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+  {
+    if (pc->fds[i] != -1)
+    {
+      close(pc->fds[i]);
+      pc->fds[i] = -1;
+    }
+  }
+#endif
+  pc->leader = -1;
+}
+
+/*
+ * Returns whether the given counter is being counted.
+ */
+bool perf_is_available(const struct perf_counters *pc, enum perf_counter counter)
+{
+  return pc->index[counter] != -1;
+}
+
+/*
+ * Returns the name of the given counter, as used by perf(1).
+ */
+const char *perf_counter_name(enum perf_counter counter)
+{
+  return counter_names[counter];
+}
+
+/*
+ * Reads the current value of all counters at once. Unavailable counters read
+ * as zero.
+ */
+void perf_read(const struct perf_counters *pc, struct perf_sample *sample)
+{
+  memset(sample, 0, sizeof *sample);
+
+#ifdef __linux__
+  /* Layout of a group read: the number of counters, followed by their
+   * values. */
+  uint64_t buffer[1 + PERF_COUNTER_COUNT];
+  if (pc->leader == -1 || read(pc->leader, buffer, sizeof buffer) < (ssize_t)sizeof(uint64_t))
+  {
+    return;
+  }
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+  {
+    if (pc->index[i] != -1 && (uint64_t)pc->index[i] < buffer[0])
+    {
+      sample->values[i] = buffer[1 + pc->index[i]];
+    }
+  }
+#endif
+}
+
+struct perf_region make_perf_region(const char *name)
+{
+  struct perf_region region = {0};
+  region.name = name;
+  return region;
+}
+
+void perf_region_begin(const struct perf_counters *pc, struct perf_region *region)
+{
+  perf_read(pc, &region->start);
+}
+
+/*
+ * Leaves the given region, and accumulates the counters since the region was
+ * entered, together with the given amount of work done in the region.
+ */
+void perf_region_end(const struct perf_counters *pc, struct perf_region *region, uint64_t work)
+{
+  struct perf_sample end;
+  perf_read(pc, &end);
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+  {
+    region->total.values[i] += end.values[i] - region->start.values[i];
+  }
+  region->work += work;
+  ++region->calls;
+}
+
+/*
+ * Returns the number of host instructions per host cycle in the region.
+ */
+double perf_region_ipc(const struct perf_region *region)
+{
+  const uint64_t cycles = region->total.values[PERF_CYCLES];
+  return cycles > 0 ? (double)region->total.values[PERF_INSTRUCTIONS] / cycles : 0;
+}
+
+/*
+ * Returns the given counter per unit of work done in the region.
+ */
+double perf_region_per_work(const struct perf_region *region, enum perf_counter counter)
+{
+  return region->work > 0 ? (double)region->total.values[counter] / region->work : 0;
+}
+
+/*
+ * Prints a one line summary of the region.
+ */
+void perf_region_print(FILE *fp, const struct perf_counters *pc, const struct perf_region *region,
+                       const char *work_unit)
+{
+  fprintf(fp, "%-16s IPC %.2f", region->name, perf_region_ipc(region));
+  for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+  {
+    if (perf_is_available(pc, i))
+    {
+      fprintf(fp, ", %.3f %s", perf_region_per_work(region, i), counter_names[i]);
+    }
+  }
+  fprintf(fp, " per %s\n", work_unit);
+}
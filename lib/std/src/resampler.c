@@ -0,0 +1,345 @@
+#include <lib/std/include/resampler.h>
+#include <lib/std/include/simd.h>
+#include <lib/std/include/util.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NN_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* Shape of the Kaiser window; trades the width of the transition band for
+ * about 80 dB of stopband attenuation. */
+#define RESAMPLER_KAISER_BETA 8.0
+
+static int resampler_gcd(int a, int b)
+{
+  while (b != 0)
+  {
+    const int r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+/*
+ * Returns the modified Bessel function of the first kind of order zero, which
+ * shapes the Kaiser window.
+ */
+static double resampler_bessel_i0(double x)
+{
+  double sum = 1;
+  double term = 1;
+  for (int k = 1; term > 1e-12 * sum; ++k)
+  {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+/*
+ * Fills the kernel with a windowed sinc impulse per phase, with the given
+ * cutoff in cycles per input sample. Every phase sums to exactly
+ * 1 << RESAMPLER_KERNEL_BITS, such that DC passes unchanged.
+ */
+static void resampler_init_kernel(struct resampler *resampler, double cutoff)
+{
+  for (int phase = 0; phase < resampler->phases; ++phase)
+  {
+    int16_t *kernel = resampler->kernel + phase * RESAMPLER_TAPS;
+
+    double impulse[RESAMPLER_TAPS];
+    double sum = 0;
+    for (int i = 0; i < RESAMPLER_TAPS; ++i)
+    {
+      /* Distance of the tap to the output sample, in input samples. */
+      const double x = RESAMPLER_TAPS / 2 - 1 - i + (double)phase / resampler->phases;
+      const double sinc = x == 0 ? 1 : sin(2 * M_PI * cutoff * x) / (2 * M_PI * cutoff * x);
+      const double r = x / (RESAMPLER_TAPS / 2);
+      const double shape = RESAMPLER_KAISER_BETA * sqrt(MAX(0.0, 1 - r * r));
+      const double window = resampler_bessel_i0(shape) / resampler_bessel_i0(RESAMPLER_KAISER_BETA);
+      impulse[i] = sinc * window;
+      sum += impulse[i];
+    }
+
+    int total = 0;
+    int center = 0;
+    for (int i = 0; i < RESAMPLER_TAPS; ++i)
+    {
+      kernel[i] = lround(impulse[i] / sum * (1 << RESAMPLER_KERNEL_BITS));
+      total += kernel[i];
+      if (kernel[i] > kernel[center])
+      {
+        center = i;
+      }
+    }
+    kernel[center] += (1 << RESAMPLER_KERNEL_BITS) - total;
+  }
+}
+
+/*
+ * Creates a resampler from the given input rate to the given output rate; the
+ * input rate may be at most RESAMPLER_TAPS times the output rate. Ratios of
+ * which the reduced output rate exceeds RESAMPLER_MAX_PHASES are approximated,
+ * e.g. 1789773 to 48000 Hz is off by less than 0.01%.
+ */
+struct resampler make_resampler(int input_rate, int output_rate)
+{
+  if (input_rate > (int64_t)output_rate * RESAMPLER_TAPS)
+  {
+    nn_quit("Can not resample from %d to %d Hz", input_rate, output_rate);
+  }
+
+  struct resampler resampler = {0};
+  const int gcd = resampler_gcd(input_rate, output_rate);
+  resampler.phases = output_rate / gcd;
+  resampler.step = input_rate / gcd;
+  if (resampler.phases > RESAMPLER_MAX_PHASES)
+  {
+    resampler.phases = RESAMPLER_MAX_PHASES;
+    resampler.step = lround((double)input_rate * RESAMPLER_MAX_PHASES / output_rate);
+  }
+
+  const size_t size = resampler.phases * RESAMPLER_TAPS * sizeof *resampler.kernel;
+  if ((resampler.kernel = aligned_alloc(32, size)) == NULL ||
+      (resampler.input = malloc((RESAMPLER_TAPS + RESAMPLER_BLOCK) * sizeof *resampler.input)) ==
+          NULL)
+  {
+    nn_quit("Could not allocate a resampler from %d to %d Hz", input_rate, output_rate);
+  }
+  resampler_init_kernel(&resampler, 0.5 * MIN(input_rate, output_rate) / input_rate);
+  resampler_clear(&resampler);
+
+  return resampler;
+}
+
+void destroy_resampler(struct resampler *resampler)
+{
+  free(resampler->kernel);
+  free(resampler->input);
+}
+
+/*
+ * Discards all input, and starts over from silence.
+ */
+void resampler_clear(struct resampler *resampler)
+{
+  /* The taps before the first input sample are silent. */
+  resampler->buffered = RESAMPLER_TAPS / 2 - 1;
+  memset(resampler->input, 0, resampler->buffered * sizeof *resampler->input);
+  resampler->phase = 0;
+}
+
+/*
+ * Writes up to `count` input samples, and returns the number of samples
+ * written; fewer than `count` in case more than RESAMPLER_BLOCK samples are
+ * pending, which have to be read first.
+ */
+int resampler_write(struct resampler *resampler, const int16_t *in, int count)
+{
+  count = MIN(count, RESAMPLER_TAPS + RESAMPLER_BLOCK - resampler->buffered);
+  memcpy(resampler->input + resampler->buffered, in, count * sizeof *in);
+  resampler->buffered += count;
+  return count;
+}
+
+/*
+ * Returns the number of output samples that can be read.
+ */
+int resampler_samples_available(const struct resampler *resampler)
+{
+  if (resampler->buffered < RESAMPLER_TAPS)
+  {
+    return 0;
+  }
+
+  /* The last output sample starts at the last input sample that leaves room
+   * for all of its taps. */
+  const int64_t last = (int64_t)(resampler->buffered - RESAMPLER_TAPS + 1) * resampler->phases;
+  return (last - resampler->phase - 1) / resampler->step + 1;
+}
+
+/*
+ * Scales a dot product of the kernel back to a sample, rounding to nearest.
+ */
+static inline int16_t resampler_sample(int32_t sum)
+{
+  sum = (sum + (1 << (RESAMPLER_KERNEL_BITS - 1))) >> RESAMPLER_KERNEL_BITS;
+  return MAX(INT16_MIN, MIN(sum, INT16_MAX));
+}
+
+/*
+ * Computes `count` output samples, of which the first starts at the given
+ * input sample and phase; as many must be available.
+ */
+static void resampler_filter_scalar(const struct resampler *resampler, const int16_t *in,
+                                    int phase, int16_t *out, int count)
+{
+  const int whole = resampler->step / resampler->phases;
+  const int fraction = resampler->step % resampler->phases;
+  for (int n = 0; n < count; ++n)
+  {
+    const int16_t *kernel = resampler->kernel + phase * RESAMPLER_TAPS;
+    int32_t sum = 0;
+    for (int i = 0; i < RESAMPLER_TAPS; ++i)
+    {
+      sum += in[i] * kernel[i];
+    }
+    out[n] = resampler_sample(sum);
+
+    in += whole;
+    if ((phase += fraction) >= resampler->phases)
+    {
+      phase -= resampler->phases;
+      ++in;
+    }
+  }
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Computes four output samples at a time, multiplying and adding eight pairs
+ * of taps at a time into two independent sums; the sums of the four are
+ * reduced together, and packed with saturation. Sums of 32-bit products are
+ * exact, hence the order in which they are added does not matter.
+ */
+__attribute__((target("sse4.1"))) static void resampler_filter_sse4(
+    const struct resampler *resampler, const int16_t *in, int phase, int16_t *out, int count)
+{
+  const int whole = resampler->step / resampler->phases;
+  const int fraction = resampler->step % resampler->phases;
+  const __m128i round = _mm_set1_epi32(1 << (RESAMPLER_KERNEL_BITS - 1));
+
+  int n = 0;
+  for (; n + 4 <= count; n += 4)
+  {
+    __m128i sums[4];
+    for (int k = 0; k < 4; ++k)
+    {
+      const int16_t *kernel = resampler->kernel + phase * RESAMPLER_TAPS;
+      __m128i even = _mm_setzero_si128();
+      __m128i odd = _mm_setzero_si128();
+      for (int i = 0; i < RESAMPLER_TAPS; i += 16)
+      {
+        const __m128i x0 = _mm_loadu_si128((const __m128i *)(in + i));
+        const __m128i x1 = _mm_loadu_si128((const __m128i *)(in + i + 8));
+        const __m128i h0 = _mm_load_si128((const __m128i *)(kernel + i));
+        const __m128i h1 = _mm_load_si128((const __m128i *)(kernel + i + 8));
+        even = _mm_add_epi32(even, _mm_madd_epi16(x0, h0));
+        odd = _mm_add_epi32(odd, _mm_madd_epi16(x1, h1));
+      }
+      sums[k] = _mm_add_epi32(even, odd);
+
+      in += whole;
+      if ((phase += fraction) >= resampler->phases)
+      {
+        phase -= resampler->phases;
+        ++in;
+      }
+    }
+
+    __m128i sum = _mm_hadd_epi32(_mm_hadd_epi32(sums[0], sums[1]),
+                                 _mm_hadd_epi32(sums[2], sums[3]));
+    sum = _mm_srai_epi32(_mm_add_epi32(sum, round), RESAMPLER_KERNEL_BITS);
+    _mm_storel_epi64((__m128i *)(out + n), _mm_packs_epi32(sum, sum));
+  }
+
+  resampler_filter_scalar(resampler, in, phase, out + n, count - n);
+}
+
+/*
+ * Computes eight output samples at a time, multiplying and adding sixteen
+ * pairs of taps at a time.
+ */
+__attribute__((target("avx2"))) static void resampler_filter_avx2(
+    const struct resampler *resampler, const int16_t *in, int phase, int16_t *out, int count)
+{
+  const int whole = resampler->step / resampler->phases;
+  const int fraction = resampler->step % resampler->phases;
+  const __m256i round = _mm256_set1_epi32(1 << (RESAMPLER_KERNEL_BITS - 1));
+
+  int n = 0;
+  for (; n + 8 <= count; n += 8)
+  {
+    __m256i sums[8];
+    for (int k = 0; k < 8; ++k)
+    {
+      const int16_t *kernel = resampler->kernel + phase * RESAMPLER_TAPS;
+      __m256i even = _mm256_setzero_si256();
+      __m256i odd = _mm256_setzero_si256();
+      for (int i = 0; i < RESAMPLER_TAPS; i += 32)
+      {
+        const __m256i x0 = _mm256_loadu_si256((const __m256i *)(in + i));
+        const __m256i x1 = _mm256_loadu_si256((const __m256i *)(in + i + 16));
+        const __m256i h0 = _mm256_load_si256((const __m256i *)(kernel + i));
+        const __m256i h1 = _mm256_load_si256((const __m256i *)(kernel + i + 16));
+        even = _mm256_add_epi32(even, _mm256_madd_epi16(x0, h0));
+        odd = _mm256_add_epi32(odd, _mm256_madd_epi16(x1, h1));
+      }
+      sums[k] = _mm256_add_epi32(even, odd);
+
+      in += whole;
+      if ((phase += fraction) >= resampler->phases)
+      {
+        phase -= resampler->phases;
+        ++in;
+      }
+    }
+
+    /* Both halves hold partial sums of samples 0-3 and 4-7. */
+    const __m256i low = _mm256_hadd_epi32(_mm256_hadd_epi32(sums[0], sums[1]),
+                                          _mm256_hadd_epi32(sums[2], sums[3]));
+    const __m256i high = _mm256_hadd_epi32(_mm256_hadd_epi32(sums[4], sums[5]),
+                                           _mm256_hadd_epi32(sums[6], sums[7]));
+    __m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(low, high, 0x20),
+                                   _mm256_permute2x128_si256(low, high, 0x31));
+    sum = _mm256_srai_epi32(_mm256_add_epi32(sum, round), RESAMPLER_KERNEL_BITS);
+    _mm_storeu_si128((__m128i *)(out + n), _mm_packs_epi32(_mm256_castsi256_si128(sum),
+                                                           _mm256_extracti128_si256(sum, 1)));
+  }
+
+  resampler_filter_scalar(resampler, in, phase, out + n, count - n);
+}
+#endif
+
+/*
+ * Reads up to `count` output samples, and returns the number of samples read,
+ * with the widest instruction set the CPU supports.
+ */
+int resampler_read(struct resampler *resampler, int16_t *out, int count)
+{
+  count = MIN(count, resampler_samples_available(resampler));
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      resampler_filter_avx2(resampler, resampler->input, resampler->phase, out, count);
+      break;
+    case SIMD_SSE4:
+      resampler_filter_sse4(resampler, resampler->input, resampler->phase, out, count);
+      break;
+#endif
+    default:
+      resampler_filter_scalar(resampler, resampler->input, resampler->phase, out, count);
+      break;
+  }
+
+  /* Move the input of the next output sample to the front. */
+  const int64_t position = resampler->phase + (int64_t)count * resampler->step;
+  const int consumed = position / resampler->phases;
+  resampler->phase = position % resampler->phases;
+  resampler->buffered -= consumed;
+  memmove(resampler->input, resampler->input + consumed,
+          resampler->buffered * sizeof *resampler->input);
+
+  return count;
+}
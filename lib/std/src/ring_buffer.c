@@ -0,0 +1,152 @@
+#include <lib/std/include/ring_buffer.h>
+#include <lib/std/include/util.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Creates a ring buffer that holds at least `capacity` elements of the given
+ * size. The capacity is rounded up to the next power of two.
+ */
+struct ring_buffer make_ring_buffer(size_t element_size, size_t capacity)
+{
+  struct ring_buffer rb = {0};
+
+  rb.capacity = 1;
+  while (rb.capacity < capacity)
+  {
+    rb.capacity <<= 1;
+  }
+  rb.mask = rb.capacity - 1;
+  rb.element_size = element_size;
+
+  if ((rb.data = malloc(rb.capacity * element_size)) == NULL)
+  {
+    nn_quit("Could not allocate a ring buffer of %zu elements", rb.capacity);
+  }
+
+  atomic_init(&rb.head, 0);
+  atomic_init(&rb.tail, 0);
+
+  return rb;
+}
+
+/*
+ * Frees dynamically allocated memory for a ring buffer object.
+ */
+void destroy_ring_buffer(struct ring_buffer *rb)
+{
+  free(rb->data);
+}
+
+/*
+ * Returns the number of elements in the ring buffer. In case this is called
+ * while the ring buffer is being used concurrently, the returned size is only
+ * an approximation.
+ */
+size_t ring_buffer_size(struct ring_buffer *rb)
+{
+  const size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+  const size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+  return head - tail;
+}
+
+/*
+ * Copies `n` elements from `src` to the ring buffer starting at the given
+ * (unmasked) index, wrapping around at the end of the buffer.
+ */
+static void ring_buffer_copy_in(struct ring_buffer *rb, size_t index, const uint8_t *src, size_t n)
+{
+  const size_t offset = index & rb->mask;
+  const size_t first = MIN(n, rb->capacity - offset);
+  memcpy(rb->data + offset * rb->element_size, src, first * rb->element_size);
+  memcpy(rb->data, src + first * rb->element_size, (n - first) * rb->element_size);
+}
+
+/*
+ * Copies `n` elements from the ring buffer starting at the given (unmasked)
+ * index to `dst`, wrapping around at the end of the buffer.
+ */
+static void ring_buffer_copy_out(struct ring_buffer *rb, size_t index, uint8_t *dst, size_t n)
+{
+  const size_t offset = index & rb->mask;
+  const size_t first = MIN(n, rb->capacity - offset);
+  memcpy(dst, rb->data + offset * rb->element_size, first * rb->element_size);
+  memcpy(dst + first * rb->element_size, rb->data, (n - first) * rb->element_size);
+}
+
+/*
+ * Pushes at most `n` elements to the ring buffer. Returns the number of
+ * elements that were pushed, which is less than `n` in case the ring buffer is
+ * full. May only be called from the producer thread.
+ */
+size_t ring_buffer_push(struct ring_buffer *rb, const void *elements, size_t n)
+{
+  const size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+
+  size_t available = rb->capacity - (head - rb->cached_tail);
+  if (available < n)
+  {
+    rb->cached_tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    available = rb->capacity - (head - rb->cached_tail);
+  }
+
+  n = MIN(n, available);
+  ring_buffer_copy_in(rb, head, elements, n);
+  atomic_store_explicit(&rb->head, head + n, memory_order_release);
+
+  return n;
+}
+
+/*
+ * Pops at most `n` elements from the ring buffer. Returns the number of
+ * elements that were popped, which is less than `n` in case the ring buffer
+ * runs empty. May only be called from the consumer thread.
+ */
+size_t ring_buffer_pop(struct ring_buffer *rb, void *elements, size_t n)
+{
+  const size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+  size_t available = rb->cached_head - tail;
+  if (available < n)
+  {
+    rb->cached_head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    available = rb->cached_head - tail;
+  }
+
+  n = MIN(n, available);
+  ring_buffer_copy_out(rb, tail, elements, n);
+  atomic_store_explicit(&rb->tail, tail + n, memory_order_release);
+
+  return n;
+}
+
+/*
+ * Runs the consumer of a ring buffer, polling for elements while the ring
+ * buffer is empty, until `is_closing` is set and the ring buffer is empty.
+ * May only be called from the consumer thread; the producer sets `is_closing`
+ * after its last push.
+ */
+void ring_buffer_drain(struct ring_buffer *rb, const atomic_bool *is_closing,
+                       ring_buffer_consumer_t consume, void *arg)
+{
+  const struct timespec idle = {0, 200 * 1000};
+
+  for (;;)
+  {
+    /* Read the closing flag before popping, such that elements pushed right
+     * before closing are never missed. */
+    const bool is_closed = atomic_load(is_closing);
+
+    if (consume(rb, arg) > 0)
+    {
+      continue;
+    }
+    if (is_closed)
+    {
+      break;
+    }
+    nanosleep(&idle, NULL);
+  }
+}
@@ -0,0 +1,735 @@
+#include <lib/std/include/scaler.h>
+#include <lib/std/include/simd.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NN_SIMD_X86
+#include <immintrin.h>
+#endif
+
+static const char *scaler_strings[] = {
+    [SCALER_NONE] = "none",         [SCALER_NEAREST2X] = "nearest2x",
+    [SCALER_NEAREST3X] = "nearest3x", [SCALER_NEAREST4X] = "nearest4x",
+    [SCALER_SCALE2X] = "scale2x",   [SCALER_SCALE3X] = "scale3x",
+    [SCALER_HQ2X] = "hq2x",
+};
+
+#define SCALERS (int)(sizeof scaler_strings / sizeof scaler_strings[0])
+
+/*
+ * Returns the number of output pixels per input pixel, in each direction.
+ */
+int scaler_factor(enum scaler scaler)
+{
+  switch (scaler)
+  {
+    case SCALER_NONE:
+      return 1;
+    case SCALER_NEAREST2X:
+    case SCALER_SCALE2X:
+    case SCALER_HQ2X:
+      return 2;
+    case SCALER_NEAREST3X:
+    case SCALER_SCALE3X:
+      return 3;
+    case SCALER_NEAREST4X:
+      return 4;
+  }
+  return 1;
+}
+
+const char *scaler_to_string(enum scaler scaler)
+{
+  return scaler_strings[scaler];
+}
+
+/*
+ * Parses the name of a scaler; also accepts the factors 1 to 4 for no scaling
+ * and nearest neighbor scaling. Returns 0 on success, or -1 in case the name
+ * is unknown.
+ */
+int scaler_from_string(const char *s, enum scaler *scaler)
+{
+  static const enum scaler factors[] = {SCALER_NONE, SCALER_NEAREST2X, SCALER_NEAREST3X,
+                                        SCALER_NEAREST4X};
+  if (s[0] >= '1' && s[0] <= '4' && s[1] == '\0')
+  {
+    *scaler = factors[s[0] - '1'];
+    return 0;
+  }
+
+  for (int i = 0; i < SCALERS; ++i)
+  {
+    if (strcmp(s, scaler_strings[i]) == 0)
+    {
+      *scaler = i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Neighbors of a pixel, named as in the descriptions of Scale2x and hq2x:
+ *
+ *   A B C
+ *   D E F
+ *   G H I
+ */
+struct scaler_neighbors
+{
+  uint32_t a, b, c, d, e, f, g, h, i;
+};
+
+/*
+ * Returns the neighbors of the pixel at column `x`; pixels outside the image
+ * repeat the pixels at its border.
+ */
+static inline struct scaler_neighbors scaler_neighbors(const uint32_t *above, const uint32_t *row,
+                                                       const uint32_t *below, int width, int x)
+{
+  const int left = x > 0 ? x - 1 : 0;
+  const int right = x + 1 < width ? x + 1 : width - 1;
+  return (struct scaler_neighbors){above[left], above[x], above[right], row[left], row[x],
+                                   row[right],  below[left], below[x], below[right]};
+}
+
+/* Nearest neighbor. */
+
+static void nearest_row_scalar(const uint32_t *row, int width, int factor, uint32_t *dst)
+{
+  for (int x = 0; x < width; ++x)
+  {
+    for (int i = 0; i < factor; ++i)
+    {
+      dst[x * factor + i] = row[x];
+    }
+  }
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Repeats eight pixels at a time; output vector `j` holds input pixels
+ * (8j + lane) / factor, which a single permute gathers.
+ */
+__attribute__((target("avx2"))) static void nearest_row_avx2(const uint32_t *row, int width,
+                                                             int factor, uint32_t *dst)
+{
+  __m256i indices[4];
+  for (int j = 0; j < factor; ++j)
+  {
+    int lanes[8];
+    for (int lane = 0; lane < 8; ++lane)
+    {
+      lanes[lane] = (8 * j + lane) / factor;
+    }
+    indices[j] = _mm256_loadu_si256((const __m256i *)lanes);
+  }
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8)
+  {
+    const __m256i pixels = _mm256_loadu_si256((const __m256i *)(row + x));
+    for (int j = 0; j < factor; ++j)
+    {
+      _mm256_storeu_si256((__m256i *)(dst + x * factor + 8 * j),
+                          _mm256_permutevar8x32_epi32(pixels, indices[j]));
+    }
+  }
+
+  nearest_row_scalar(row + x, width - x, factor, dst + x * factor);
+}
+#endif
+
+/*
+ * Scales a row up `factor` times; the first output row is scaled, the others
+ * are copies of it.
+ */
+static void nearest_row(const uint32_t *row, int width, int factor, uint32_t *dst,
+                        size_t dst_stride)
+{
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      nearest_row_avx2(row, width, factor, dst);
+      break;
+#endif
+    default:
+      nearest_row_scalar(row, width, factor, dst);
+      break;
+  }
+
+  for (int i = 1; i < factor; ++i)
+  {
+    memcpy(dst + i * dst_stride, dst, width * factor * sizeof *dst);
+  }
+}
+
+/* Scale2x. */
+
+/*
+ * Scales the pixels in columns [from, to) of a row; a corner takes the color
+ * of its two neighbors in case they are equal, unless they are part of a
+ * straight edge.
+ */
+static void scale2x_span(const uint32_t *above, const uint32_t *row, const uint32_t *below,
+                         int width, int from, int to, uint32_t *dst, size_t dst_stride)
+{
+  for (int x = from; x < to; ++x)
+  {
+    const struct scaler_neighbors n = scaler_neighbors(above, row, below, width, x);
+    dst[2 * x] = n.d == n.b && n.b != n.f && n.d != n.h ? n.d : n.e;
+    dst[2 * x + 1] = n.b == n.f && n.b != n.d && n.f != n.h ? n.f : n.e;
+    dst[dst_stride + 2 * x] = n.d == n.h && n.d != n.b && n.h != n.f ? n.d : n.e;
+    dst[dst_stride + 2 * x + 1] = n.h == n.f && n.d != n.h && n.b != n.f ? n.f : n.e;
+  }
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Interleaves the pixels of two vectors; a0 b0 a1 b1 ... a7 b7.
+ */
+__attribute__((target("avx2"))) static inline void scaler_store2_avx2(uint32_t *dst, __m256i a,
+                                                                      __m256i b)
+{
+  const __m256i low = _mm256_unpacklo_epi32(a, b);
+  const __m256i high = _mm256_unpackhi_epi32(a, b);
+  _mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(low, high, 0x20));
+  _mm256_storeu_si256((__m256i *)(dst + 8), _mm256_permute2x128_si256(low, high, 0x31));
+}
+
+/*
+ * Interleaves the pixels of three vectors; a0 b0 c0 a1 b1 c1 ... c7. Every
+ * output vector permutes all three inputs the same way, and blends them.
+ */
+__attribute__((target("avx2"))) static inline void scaler_store3_avx2(uint32_t *dst, __m256i a,
+                                                                      __m256i b, __m256i c)
+{
+  const __m256i first = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+  const __m256i second = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+  const __m256i third = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+
+  __m256i out = _mm256_permutevar8x32_epi32(a, first);
+  out = _mm256_blend_epi32(out, _mm256_permutevar8x32_epi32(b, first), 0x92);
+  out = _mm256_blend_epi32(out, _mm256_permutevar8x32_epi32(c, first), 0x24);
+  _mm256_storeu_si256((__m256i *)dst, out);
+
+  out = _mm256_permutevar8x32_epi32(a, second);
+  out = _mm256_blend_epi32(out, _mm256_permutevar8x32_epi32(b, second), 0x24);
+  out = _mm256_blend_epi32(out, _mm256_permutevar8x32_epi32(c, second), 0x49);
+  _mm256_storeu_si256((__m256i *)(dst + 8), out);
+
+  out = _mm256_permutevar8x32_epi32(a, third);
+  out = _mm256_blend_epi32(out, _mm256_permutevar8x32_epi32(b, third), 0x49);
+  out = _mm256_blend_epi32(out, _mm256_permutevar8x32_epi32(c, third), 0x92);
+  _mm256_storeu_si256((__m256i *)(dst + 16), out);
+}
+
+/* Loads the pixels E at column `x`, and their neighbors B, D, F, H, eight of
+ * each. */
+#define SCALER_LOAD_CROSS_AVX2()                                        \
+  const __m256i b = _mm256_loadu_si256((const __m256i *)(above + x));   \
+  const __m256i d = _mm256_loadu_si256((const __m256i *)(row + x - 1)); \
+  const __m256i e = _mm256_loadu_si256((const __m256i *)(row + x));     \
+  const __m256i f = _mm256_loadu_si256((const __m256i *)(row + x + 1)); \
+  const __m256i h = _mm256_loadu_si256((const __m256i *)(below + x))
+
+/*
+ * Scales eight pixels at a time, with the rules of scale2x_span as masks.
+ * Pixels at the left and right border lack neighbors, and are left to the
+ * scalar code.
+ */
+__attribute__((target("avx2"))) static void scale2x_row_avx2(const uint32_t *above,
+                                                             const uint32_t *row,
+                                                             const uint32_t *below, int width,
+                                                             uint32_t *dst, size_t dst_stride)
+{
+  const int first = MIN(1, width);
+  scale2x_span(above, row, below, width, 0, first, dst, dst_stride);
+
+  int x = first;
+  for (; x + 9 <= width; x += 8)
+  {
+    SCALER_LOAD_CROSS_AVX2();
+    const __m256i db = _mm256_cmpeq_epi32(d, b);
+    const __m256i bf = _mm256_cmpeq_epi32(b, f);
+    const __m256i dh = _mm256_cmpeq_epi32(d, h);
+    const __m256i hf = _mm256_cmpeq_epi32(h, f);
+
+    const __m256i e0 = _mm256_blendv_epi8(e, d, _mm256_andnot_si256(_mm256_or_si256(bf, dh), db));
+    const __m256i e1 = _mm256_blendv_epi8(e, f, _mm256_andnot_si256(_mm256_or_si256(db, hf), bf));
+    const __m256i e2 = _mm256_blendv_epi8(e, d, _mm256_andnot_si256(_mm256_or_si256(db, hf), dh));
+    const __m256i e3 = _mm256_blendv_epi8(e, f, _mm256_andnot_si256(_mm256_or_si256(dh, bf), hf));
+
+    scaler_store2_avx2(dst + 2 * x, e0, e1);
+    scaler_store2_avx2(dst + dst_stride + 2 * x, e2, e3);
+  }
+
+  scale2x_span(above, row, below, width, x, width, dst, dst_stride);
+}
+#endif
+
+static void scale2x_row(const uint32_t *above, const uint32_t *row, const uint32_t *below,
+                        int width, uint32_t *dst, size_t dst_stride)
+{
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      scale2x_row_avx2(above, row, below, width, dst, dst_stride);
+      break;
+#endif
+    default:
+      scale2x_span(above, row, below, width, 0, width, dst, dst_stride);
+      break;
+  }
+}
+
+/* Scale3x. */
+
+/*
+ * Scales the pixels in columns [from, to) of a row. Like Scale2x, but edges
+ * also extend into the middle pixels of the sides of the 3x3 block.
+ */
+static void scale3x_span(const uint32_t *above, const uint32_t *row, const uint32_t *below,
+                         int width, int from, int to, uint32_t *dst, size_t dst_stride)
+{
+  for (int x = from; x < to; ++x)
+  {
+    const struct scaler_neighbors n = scaler_neighbors(above, row, below, width, x);
+    uint32_t *out[3] = {dst + 3 * x, dst + dst_stride + 3 * x, dst + 2 * dst_stride + 3 * x};
+
+    for (int i = 0; i < 3; ++i)
+    {
+      out[i][0] = out[i][1] = out[i][2] = n.e;
+    }
+    if (n.b == n.h || n.d == n.f)
+    {
+      continue;
+    }
+
+    const bool db = n.d == n.b;
+    const bool bf = n.b == n.f;
+    const bool dh = n.d == n.h;
+    const bool hf = n.h == n.f;
+    out[0][0] = db ? n.d : n.e;
+    out[0][1] = (db && n.e != n.c) || (bf && n.e != n.a) ? n.b : n.e;
+    out[0][2] = bf ? n.f : n.e;
+    out[1][0] = (db && n.e != n.g) || (dh && n.e != n.a) ? n.d : n.e;
+    out[1][2] = (bf && n.e != n.i) || (hf && n.e != n.c) ? n.f : n.e;
+    out[2][0] = dh ? n.d : n.e;
+    out[2][1] = (dh && n.e != n.i) || (hf && n.e != n.g) ? n.h : n.e;
+    out[2][2] = hf ? n.f : n.e;
+  }
+}
+
+#ifdef NN_SIMD_X86
+/*
+ * Scales eight pixels at a time, with the rules of scale3x_span as masks.
+ */
+__attribute__((target("avx2"))) static void scale3x_row_avx2(const uint32_t *above,
+                                                             const uint32_t *row,
+                                                             const uint32_t *below, int width,
+                                                             uint32_t *dst, size_t dst_stride)
+{
+  const int first = MIN(1, width);
+  scale3x_span(above, row, below, width, 0, first, dst, dst_stride);
+
+  int x = first;
+  for (; x + 9 <= width; x += 8)
+  {
+    SCALER_LOAD_CROSS_AVX2();
+    const __m256i a = _mm256_loadu_si256((const __m256i *)(above + x - 1));
+    const __m256i c = _mm256_loadu_si256((const __m256i *)(above + x + 1));
+    const __m256i g = _mm256_loadu_si256((const __m256i *)(below + x - 1));
+    const __m256i i = _mm256_loadu_si256((const __m256i *)(below + x + 1));
+
+    /* Edges only apply in case neither B and H nor D and F are equal. */
+    const __m256i straight = _mm256_or_si256(_mm256_cmpeq_epi32(b, h), _mm256_cmpeq_epi32(d, f));
+    const __m256i db = _mm256_andnot_si256(straight, _mm256_cmpeq_epi32(d, b));
+    const __m256i bf = _mm256_andnot_si256(straight, _mm256_cmpeq_epi32(b, f));
+    const __m256i dh = _mm256_andnot_si256(straight, _mm256_cmpeq_epi32(d, h));
+    const __m256i hf = _mm256_andnot_si256(straight, _mm256_cmpeq_epi32(h, f));
+    const __m256i ea = _mm256_cmpeq_epi32(e, a);
+    const __m256i ec = _mm256_cmpeq_epi32(e, c);
+    const __m256i eg = _mm256_cmpeq_epi32(e, g);
+    const __m256i ei = _mm256_cmpeq_epi32(e, i);
+
+    const __m256i e0 = _mm256_blendv_epi8(e, d, db);
+    const __m256i e1 = _mm256_blendv_epi8(
+        e, b, _mm256_or_si256(_mm256_andnot_si256(ec, db), _mm256_andnot_si256(ea, bf)));
+    const __m256i e2 = _mm256_blendv_epi8(e, f, bf);
+    const __m256i e3 = _mm256_blendv_epi8(
+        e, d, _mm256_or_si256(_mm256_andnot_si256(eg, db), _mm256_andnot_si256(ea, dh)));
+    const __m256i e5 = _mm256_blendv_epi8(
+        e, f, _mm256_or_si256(_mm256_andnot_si256(ei, bf), _mm256_andnot_si256(ec, hf)));
+    const __m256i e6 = _mm256_blendv_epi8(e, d, dh);
+    const __m256i e7 = _mm256_blendv_epi8(
+        e, h, _mm256_or_si256(_mm256_andnot_si256(ei, dh), _mm256_andnot_si256(eg, hf)));
+    const __m256i e8 = _mm256_blendv_epi8(e, f, hf);
+
+    scaler_store3_avx2(dst + 3 * x, e0, e1, e2);
+    scaler_store3_avx2(dst + dst_stride + 3 * x, e3, e, e5);
+    scaler_store3_avx2(dst + 2 * dst_stride + 3 * x, e6, e7, e8);
+  }
+
+  scale3x_span(above, row, below, width, x, width, dst, dst_stride);
+}
+#endif
+
+static void scale3x_row(const uint32_t *above, const uint32_t *row, const uint32_t *below,
+                        int width, uint32_t *dst, size_t dst_stride)
+{
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      scale3x_row_avx2(above, row, below, width, dst, dst_stride);
+      break;
+#endif
+    default:
+      scale3x_span(above, row, below, width, 0, width, dst, dst_stride);
+      break;
+  }
+}
+
+/* hq2x. */
+
+/*
+ * Thresholds of the similarity of two colors, for luma and for both chroma
+ * components, as packed by hq2x_color_space. Red and blue are treated alike,
+ * so the result is the same for RGBA and BGRA pixels.
+ */
+#define HQ2X_THRESHOLDS 0x000c0c30u
+
+/*
+ * Returns a pixel in a luma/chroma space, with one byte per component; luma
+ * (R + 2G + B) / 4, and the differences of red and blue with green.
+ */
+static inline uint32_t hq2x_color_space(uint32_t pixel)
+{
+  const int r = pixel & 0xff;
+  const int g = (pixel >> 8) & 0xff;
+  const int b = (pixel >> 16) & 0xff;
+  const int y = (r + 2 * g + b) >> 2;
+  const int u = ((r - g) >> 1) + 128;
+  const int v = ((b - g) >> 1) + 128;
+  return y | u << 8 | v << 16;
+}
+
+static inline bool hq2x_similar(uint32_t p, uint32_t q)
+{
+  for (int shift = 0; shift < 24; shift += 8)
+  {
+    const int a = (p >> shift) & 0xff;
+    const int b = (q >> shift) & 0xff;
+    if ((a > b ? a - b : b - a) > (int)((HQ2X_THRESHOLDS >> shift) & 0xff))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Averages the bytes of two pixels, rounding up, like the pavgb instruction.
+ */
+static inline uint32_t hq2x_average(uint32_t p, uint32_t q)
+{
+  return (p | q) - (((p ^ q) >> 1) & 0x7f7f7f7fu);
+}
+
+/*
+ * Returns the color of the corner of pixel E that borders pixels S and T
+ * horizontally and vertically, and pixel X diagonally. An edge crossing the
+ * corner (S and T alike, and unlike E) blends the corner halfway towards S and
+ * T; a diagonal neighbor unlike its surroundings softens the corner a bit.
+ */
+static inline uint32_t hq2x_corner(uint32_t e, uint32_t s, uint32_t t, uint32_t x, uint32_t ye,
+                                   uint32_t ys, uint32_t yt, uint32_t yx)
+{
+  if (hq2x_similar(ys, yt) && !hq2x_similar(ye, ys))
+  {
+    return hq2x_average(e, hq2x_average(s, t));
+  }
+  if (!hq2x_similar(ye, yx) && hq2x_similar(ye, ys) && hq2x_similar(ye, yt))
+  {
+    return hq2x_average(e, hq2x_average(e, x));
+  }
+  return e;
+}
+
+static void hq2x_span(const uint32_t *above, const uint32_t *row, const uint32_t *below,
+                      const uint32_t *yuv_above, const uint32_t *yuv_row,
+                      const uint32_t *yuv_below, int width, int from, int to, uint32_t *dst,
+                      size_t dst_stride)
+{
+  for (int x = from; x < to; ++x)
+  {
+    const struct scaler_neighbors n = scaler_neighbors(above, row, below, width, x);
+    const struct scaler_neighbors y = scaler_neighbors(yuv_above, yuv_row, yuv_below, width, x);
+    dst[2 * x] = hq2x_corner(n.e, n.b, n.d, n.a, y.e, y.b, y.d, y.a);
+    dst[2 * x + 1] = hq2x_corner(n.e, n.b, n.f, n.c, y.e, y.b, y.f, y.c);
+    dst[dst_stride + 2 * x] = hq2x_corner(n.e, n.h, n.d, n.g, y.e, y.h, y.d, y.g);
+    dst[dst_stride + 2 * x + 1] = hq2x_corner(n.e, n.h, n.f, n.i, y.e, y.h, y.f, y.i);
+  }
+}
+
+static void hq2x_color_space_scalar(const uint32_t *row, int width, uint32_t *yuv)
+{
+  for (int x = 0; x < width; ++x)
+  {
+    yuv[x] = hq2x_color_space(row[x]);
+  }
+}
+
+#ifdef NN_SIMD_X86
+__attribute__((target("avx2"))) static void hq2x_color_space_avx2(const uint32_t *row, int width,
+                                                                  uint32_t *yuv)
+{
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  const __m256i bias = _mm256_set1_epi32(128);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8)
+  {
+    const __m256i pixels = _mm256_loadu_si256((const __m256i *)(row + x));
+    const __m256i r = _mm256_and_si256(pixels, mask);
+    const __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask);
+    const __m256i b = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask);
+    const __m256i y =
+        _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(r, b), _mm256_add_epi32(g, g)), 2);
+    const __m256i u = _mm256_add_epi32(_mm256_srai_epi32(_mm256_sub_epi32(r, g), 1), bias);
+    const __m256i v = _mm256_add_epi32(_mm256_srai_epi32(_mm256_sub_epi32(b, g), 1), bias);
+    const __m256i packed =
+        _mm256_or_si256(y, _mm256_or_si256(_mm256_slli_epi32(u, 8), _mm256_slli_epi32(v, 16)));
+    _mm256_storeu_si256((__m256i *)(yuv + x), packed);
+  }
+
+  hq2x_color_space_scalar(row + x, width - x, yuv + x);
+}
+
+/*
+ * Returns a mask of the lanes in which the colors are similar; the absolute
+ * difference of every component is within its threshold.
+ */
+__attribute__((target("avx2"))) static inline __m256i hq2x_similar_avx2(__m256i p, __m256i q)
+{
+  const __m256i thresholds = _mm256_set1_epi32((int)HQ2X_THRESHOLDS);
+  const __m256i difference = _mm256_or_si256(_mm256_subs_epu8(p, q), _mm256_subs_epu8(q, p));
+  return _mm256_cmpeq_epi32(_mm256_subs_epu8(difference, thresholds), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static inline __m256i hq2x_corner_avx2(__m256i e, __m256i s,
+                                                                       __m256i t, __m256i x,
+                                                                       __m256i ye, __m256i ys,
+                                                                       __m256i yt, __m256i yx)
+{
+  const __m256i es = hq2x_similar_avx2(ye, ys);
+  const __m256i edge = _mm256_andnot_si256(es, hq2x_similar_avx2(ys, yt));
+  const __m256i corner = _mm256_andnot_si256(_mm256_or_si256(edge, hq2x_similar_avx2(ye, yx)),
+                                             _mm256_and_si256(es, hq2x_similar_avx2(ye, yt)));
+
+  __m256i out = _mm256_blendv_epi8(e, _mm256_avg_epu8(e, _mm256_avg_epu8(e, x)), corner);
+  return _mm256_blendv_epi8(out, _mm256_avg_epu8(e, _mm256_avg_epu8(s, t)), edge);
+}
+
+/*
+ * Scales eight pixels at a time, with the rules of hq2x_corner as masks.
+ */
+__attribute__((target("avx2"))) static void hq2x_row_avx2(
+    const uint32_t *above, const uint32_t *row, const uint32_t *below, const uint32_t *yuv_above,
+    const uint32_t *yuv_row, const uint32_t *yuv_below, int width, uint32_t *dst,
+    size_t dst_stride)
+{
+  const int first = MIN(1, width);
+  hq2x_span(above, row, below, yuv_above, yuv_row, yuv_below, width, 0, first, dst, dst_stride);
+
+  int x = first;
+  for (; x + 9 <= width; x += 8)
+  {
+    SCALER_LOAD_CROSS_AVX2();
+    const __m256i a = _mm256_loadu_si256((const __m256i *)(above + x - 1));
+    const __m256i c = _mm256_loadu_si256((const __m256i *)(above + x + 1));
+    const __m256i g = _mm256_loadu_si256((const __m256i *)(below + x - 1));
+    const __m256i i = _mm256_loadu_si256((const __m256i *)(below + x + 1));
+
+    const __m256i ya = _mm256_loadu_si256((const __m256i *)(yuv_above + x - 1));
+    const __m256i yb = _mm256_loadu_si256((const __m256i *)(yuv_above + x));
+    const __m256i yc = _mm256_loadu_si256((const __m256i *)(yuv_above + x + 1));
+    const __m256i yd = _mm256_loadu_si256((const __m256i *)(yuv_row + x - 1));
+    const __m256i ye = _mm256_loadu_si256((const __m256i *)(yuv_row + x));
+    const __m256i yf = _mm256_loadu_si256((const __m256i *)(yuv_row + x + 1));
+    const __m256i yg = _mm256_loadu_si256((const __m256i *)(yuv_below + x - 1));
+    const __m256i yh = _mm256_loadu_si256((const __m256i *)(yuv_below + x));
+    const __m256i yi = _mm256_loadu_si256((const __m256i *)(yuv_below + x + 1));
+
+    scaler_store2_avx2(dst + 2 * x, hq2x_corner_avx2(e, b, d, a, ye, yb, yd, ya),
+                       hq2x_corner_avx2(e, b, f, c, ye, yb, yf, yc));
+    scaler_store2_avx2(dst + dst_stride + 2 * x, hq2x_corner_avx2(e, h, d, g, ye, yh, yd, yg),
+                       hq2x_corner_avx2(e, h, f, i, ye, yh, yf, yi));
+  }
+
+  hq2x_span(above, row, below, yuv_above, yuv_row, yuv_below, width, x, width, dst, dst_stride);
+}
+#endif
+
+static void hq2x_color_space_row(const uint32_t *row, int width, uint32_t *yuv)
+{
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      hq2x_color_space_avx2(row, width, yuv);
+      break;
+#endif
+    default:
+      hq2x_color_space_scalar(row, width, yuv);
+      break;
+  }
+}
+
+static void hq2x_row(const uint32_t *above, const uint32_t *row, const uint32_t *below,
+                     const uint32_t *yuv_above, const uint32_t *yuv_row,
+                     const uint32_t *yuv_below, int width, uint32_t *dst, size_t dst_stride)
+{
+  switch (simd_level())
+  {
+#ifdef NN_SIMD_X86
+    case SIMD_AVX2:
+      hq2x_row_avx2(above, row, below, yuv_above, yuv_row, yuv_below, width, dst, dst_stride);
+      break;
+#endif
+    default:
+      hq2x_span(above, row, below, yuv_above, yuv_row, yuv_below, width, 0, width, dst,
+                dst_stride);
+      break;
+  }
+}
+
+/* Bands. */
+
+/* An image being scaled, split into bands of rows. */
+struct scaler_job
+{
+  enum scaler scaler;
+  const uint32_t *src;
+  size_t src_stride;
+  int width;
+  int height;
+  uint32_t *dst;
+  size_t dst_stride;
+  int bands;
+};
+
+/*
+ * Returns row `y` of the source image, clamped to the image.
+ */
+static inline const uint32_t *scaler_row(const struct scaler_job *job, int y)
+{
+  return job->src + MAX(0, MIN(y, job->height - 1)) * job->src_stride;
+}
+
+/*
+ * Scales the rows of the hq2x job in [first, last). The color space
+ * conversion of the rows above, at and below the current row is kept in a
+ * window of three rows.
+ */
+static void hq2x_band(const struct scaler_job *job, int first, int last)
+{
+  uint32_t *yuv = malloc(3 * job->width * sizeof *yuv);
+  if (yuv == NULL)
+  {
+    nn_quit("Could not allocate an hq2x band of width %d", job->width);
+  }
+
+  uint32_t *window[3] = {yuv, yuv + job->width, yuv + 2 * job->width};
+  hq2x_color_space_row(scaler_row(job, first - 1), job->width, window[0]);
+  hq2x_color_space_row(scaler_row(job, first), job->width, window[1]);
+  for (int y = first; y < last; ++y)
+  {
+    hq2x_color_space_row(scaler_row(job, y + 1), job->width, window[2]);
+    hq2x_row(scaler_row(job, y - 1), scaler_row(job, y), scaler_row(job, y + 1), window[0],
+             window[1], window[2], job->width, job->dst + 2 * y * job->dst_stride,
+             job->dst_stride);
+
+    uint32_t *oldest = window[0];
+    window[0] = window[1];
+    window[1] = window[2];
+    window[2] = oldest;
+  }
+
+  free(yuv);
+}
+
+static void scaler_band(void *arg, int band)
+{
+  NN_ZONE("scaler band");
+
+  const struct scaler_job *job = arg;
+  const int first = job->height * band / job->bands;
+  const int last = job->height * (band + 1) / job->bands;
+  const int factor = scaler_factor(job->scaler);
+
+  if (job->scaler == SCALER_HQ2X)
+  {
+    hq2x_band(job, first, last);
+    return;
+  }
+
+  for (int y = first; y < last; ++y)
+  {
+    const uint32_t *above = scaler_row(job, y - 1);
+    const uint32_t *row = scaler_row(job, y);
+    const uint32_t *below = scaler_row(job, y + 1);
+    uint32_t *dst = job->dst + factor * y * job->dst_stride;
+
+    switch (job->scaler)
+    {
+      case SCALER_SCALE2X:
+        scale2x_row(above, row, below, job->width, dst, job->dst_stride);
+        break;
+      case SCALER_SCALE3X:
+        scale3x_row(above, row, below, job->width, dst, job->dst_stride);
+        break;
+      default:
+        nearest_row(row, job->width, factor, dst, job->dst_stride);
+        break;
+    }
+  }
+}
+
+/* Minimum number of source rows per band. */
+#define SCALER_BAND_ROWS 8
+
+/*
+ * Scales a `width` x `height` image up by the factor of the scaler. Strides
+ * are in pixels; the destination must hold `height * factor` rows of
+ * `width * factor` pixels. Bands of rows are scaled on the given thread pool,
+ * which may be NULL.
+ */
+void scaler_run(enum scaler scaler, const uint32_t *src, size_t src_stride, int width, int height,
+                uint32_t *dst, size_t dst_stride, struct thread_pool *pool)
+{
+  NN_ZONE("scaler");
+
+  if (width <= 0 || height <= 0)
+  {
+    return;
+  }
+
+  struct scaler_job job = {scaler, src, src_stride, width, height, dst, dst_stride, 1};
+  if (pool == NULL)
+  {
+    scaler_band(&job, 0);
+    return;
+  }
+
+  job.bands = thread_pool_bands(pool, height, SCALER_BAND_ROWS);
+  thread_pool_run(pool, scaler_band, &job, job.bands);
+}
@@ -0,0 +1,58 @@
+#include <lib/std/include/simd.h>
+
+#include <stdatomic.h>
+
+static atomic_int simd_detected = -1;
+static atomic_int simd_maximum = SIMD_AVX2;
+
+/*
+ * Returns the highest level supported by the CPU.
+ */
+static enum simd_level simd_detect(void)
+{
+#ifdef NN_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return SIMD_AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.1"))
+  {
+    return SIMD_SSE4;
+  }
+#endif
+  return SIMD_SCALAR;
+}
+
+/*
+ * Returns the level kernels should use; the highest level supported by the
+ * CPU, up to the limit set by `simd_limit`.
+ */
+enum simd_level simd_level(void)
+{
+  int detected = atomic_load_explicit(&simd_detected, memory_order_relaxed);
+  if (detected < 0)
+  {
+    detected = simd_detect();
+    atomic_store_explicit(&simd_detected, detected, memory_order_relaxed);
+  }
+
+  const int maximum = atomic_load_explicit(&simd_maximum, memory_order_relaxed);
+  return detected < maximum ? detected : maximum;
+}
+
+/*
+ * Limits the level kernels use, e.g. to compare the results of all levels,
+ * or to measure the speedup of a level.
+ */
+void simd_limit(enum simd_level level)
+{
+  atomic_store_explicit(&simd_maximum, level, memory_order_relaxed);
+}
+
+const char *simd_level_to_string(enum simd_level level)
+{
+  static const char *strings[] = {[SIMD_SCALAR] = "scalar", [SIMD_SSE4] = "sse4.1",
+                                  [SIMD_AVX2] = "avx2"};
+  return strings[level];
+}
@@ -0,0 +1,185 @@
+#include <lib/std/include/thread_pool.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Runs tasks of the current job until none are left.
+ */
+static void thread_pool_work(struct thread_pool *pool, thread_pool_task_t task, void *arg,
+                             int count)
+{
+  int index;
+  while ((index = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed)) < count)
+  {
+    task(arg, index);
+  }
+}
+
+/*
+ * Body of a worker thread; waits for a job, helps running it, and reports back
+ * until the pool is destroyed.
+ */
+static void *thread_pool_worker(void *arg)
+{
+  struct thread_pool *pool = arg;
+
+  NN_ZONE_THREAD_NAME("pool worker");
+
+  /* Jobs may start before the worker does; the pool starts at generation 0. */
+  uint64_t generation = 0;
+  pthread_mutex_lock(&pool->mutex);
+  for (;;)
+  {
+    while (!pool->is_closing && pool->generation == generation)
+    {
+      pthread_cond_wait(&pool->wake, &pool->mutex);
+    }
+    if (pool->is_closing)
+    {
+      break;
+    }
+
+    generation = pool->generation;
+    const thread_pool_task_t task = pool->task;
+    void *task_arg = pool->arg;
+    const int count = pool->count;
+    pthread_mutex_unlock(&pool->mutex);
+
+    thread_pool_work(pool, task, task_arg, count);
+
+    pthread_mutex_lock(&pool->mutex);
+    if (--pool->busy == 0)
+    {
+      pthread_cond_signal(&pool->done);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+/*
+ * Starts a pool of `size` worker threads; a size of 0 gives a pool that runs
+ * all jobs on the calling thread. Returns 0 on success, or -1 in case a thread
+ * could not be started, in which case `errno` is set.
+ */
+int thread_pool_init(struct thread_pool *pool, int size)
+{
+  pool->size = 0;
+  pool->task = NULL;
+  pool->arg = NULL;
+  pool->count = 0;
+  pool->generation = 0;
+  pool->busy = 0;
+  pool->is_closing = false;
+  atomic_init(&pool->next, 0);
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  if (size > 0 && (pool->threads = malloc(size * sizeof *pool->threads)) == NULL)
+  {
+    nn_quit("Could not allocate a thread pool of %d threads", size);
+  }
+
+  for (; pool->size < size; ++pool->size)
+  {
+    int error;
+    if ((error = pthread_create(&pool->threads[pool->size], NULL, thread_pool_worker, pool)) != 0)
+    {
+      thread_pool_destroy(pool);
+      errno = error;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Stops the worker threads of the pool, and frees its resources.
+ */
+void thread_pool_destroy(struct thread_pool *pool)
+{
+  pthread_mutex_lock(&pool->mutex);
+  pool->is_closing = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (int i = 0; i < pool->size; ++i)
+  {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  if (pool->size > 0)
+  {
+    free(pool->threads);
+  }
+  pool->size = 0;
+
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->mutex);
+}
+
+/*
+ * Returns the number of worker threads that, together with the calling thread,
+ * occupy every online CPU.
+ */
+int thread_pool_default_size(void)
+{
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 1 ? cpus - 1 : 0;
+}
+
+/*
+ * Returns the number of bands to split `rows` rows into for a job on the pool:
+ * a few bands per thread, which even out the load when a thread is preempted,
+ * but no bands of fewer than `min_rows` rows, which cost more to hand out than
+ * they save. Always at least one band.
+ */
+int thread_pool_bands(const struct thread_pool *pool, int rows, int min_rows)
+{
+  return MAX(1, MIN(4 * (pool->size + 1), rows / MAX(min_rows, 1)));
+}
+
+/*
+ * Calls `task(arg, i)` for every `i` in [0, count), spread over the workers of
+ * the pool and the calling thread, and returns once all calls returned. Tasks
+ * should be of similar cost; every thread picks the next index as soon as it
+ * finished its previous one.
+ */
+void thread_pool_run(struct thread_pool *pool, thread_pool_task_t task, void *arg, int count)
+{
+  if (pool->size == 0 || count <= 1)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      task(arg, i);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->task = task;
+  pool->arg = arg;
+  pool->count = count;
+  pool->busy = pool->size;
+  atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+  ++pool->generation;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  thread_pool_work(pool, task, arg, count);
+
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->busy > 0)
+  {
+    pthread_cond_wait(&pool->done, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
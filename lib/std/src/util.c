@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 static const int MAXLINE = 120;
@@ -91,6 +92,16 @@ int nn_mkdirs(const char *path, mode_t mode)
   return ret;
 }
 
+/*
+ * Returns the current value of the monotonic clock in nanoseconds.
+ */
+timestamp_t nn_timestamp(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (timestamp_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
 /*
  * Logs a message to stderr.
  */
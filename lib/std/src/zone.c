@@ -0,0 +1,193 @@
+#include <lib/std/include/ring_buffer.h>
+#include <lib/std/include/util.h>
+#include <lib/std/include/zone.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Zones recorded by a single thread. The thread itself is the producer of the
+ * ring buffer, the zone writer is the consumer. Thread buffers are never freed,
+ * since the zone writer may still drain a buffer after its thread exited.
+ */
+struct zone_thread
+{
+  struct ring_buffer events;
+  atomic_size_t dropped;
+  unsigned id;
+  char name[32];
+  struct zone_thread *next;
+};
+
+static pthread_mutex_t zone_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct zone_thread *zone_threads;
+static unsigned zone_thread_count;
+
+static _Thread_local struct zone_thread *zone_current_thread;
+
+/*
+ * Returns the zone buffer of the calling thread, creating it on first use.
+ */
+static struct zone_thread *zone_this_thread(void)
+{
+  if (zone_current_thread)
+  {
+    return zone_current_thread;
+  }
+
+  /* The ring buffer indices require cache line alignment. */
+  struct zone_thread *thread;
+  if ((thread = aligned_alloc(64, sizeof(struct zone_thread))) == NULL)
+  {
+    nn_quit("Could not allocate zone buffer");
+  }
+  memset(thread, 0, sizeof *thread);
+  thread->events = make_ring_buffer(sizeof(struct zone_event), ZONE_EVENTS_PER_THREAD);
+  atomic_init(&thread->dropped, 0);
+
+  pthread_mutex_lock(&zone_threads_mutex);
+  thread->id = ++zone_thread_count;
+  snprintf(thread->name, sizeof thread->name, "thread %u", thread->id);
+  thread->next = zone_threads;
+  zone_threads = thread;
+  pthread_mutex_unlock(&zone_threads_mutex);
+
+  return zone_current_thread = thread;
+}
+
+/*
+ * Records the end of a zone to the buffer of the calling thread. In case the
+ * buffer is full, the zone is dropped.
+ */
+void zone_end(struct zone_scope *scope)
+{
+  const struct zone_event event = {
+      .name = scope->name, .begin = scope->begin, .end = nn_timestamp()};
+
+  struct zone_thread *thread = zone_this_thread();
+  if (ring_buffer_push(&thread->events, &event, 1) == 0)
+  {
+    atomic_fetch_add_explicit(&thread->dropped, 1, memory_order_relaxed);
+  }
+}
+
+/*
+ * Names the calling thread in the exported trace.
+ */
+void zone_thread_name(const char *name)
+{
+  struct zone_thread *thread = zone_this_thread();
+
+  pthread_mutex_lock(&zone_threads_mutex);
+  snprintf(thread->name, sizeof thread->name, "%s", name);
+  pthread_mutex_unlock(&zone_threads_mutex);
+}
+
+/*
+ * Writes a JSON string literal, escaping quotes and backslashes.
+ */
+static void zone_print_string(FILE *fp, const char *s)
+{
+  fputc('"', fp);
+  for (; *s; ++s)
+  {
+    if (*s == '"' || *s == '\\')
+    {
+      fputc('\\', fp);
+    }
+    fputc(*s, fp);
+  }
+  fputc('"', fp);
+}
+
+/*
+ * Writes a single trace event; separates it from the previous event, if any.
+ */
+static void zone_print_separator(struct zone_writer *writer)
+{
+  fputs(writer->events++ > 0 ? ",\n" : "\n", writer->fp);
+}
+
+/*
+ * Creates a Chrome trace event file. Returns 0 on success, or -1 in case the
+ * file could not be created, in which case errno is set.
+ */
+int zone_writer_open(struct zone_writer *writer, const char *file_name)
+{
+  writer->events = 0;
+  if ((writer->fp = fopen(file_name, "w")) == NULL)
+  {
+    return -1;
+  }
+
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", writer->fp);
+  return 0;
+}
+
+/*
+ * Moves all zones recorded so far by all threads to the trace file. Returns 0
+ * on success, or -1 in case of a write error.
+ */
+int zone_writer_flush(struct zone_writer *writer)
+{
+  const pid_t pid = getpid();
+
+  pthread_mutex_lock(&zone_threads_mutex);
+  struct zone_thread *threads = zone_threads;
+  pthread_mutex_unlock(&zone_threads_mutex);
+
+  struct zone_event events[256];
+  for (struct zone_thread *thread = threads; thread; thread = thread->next)
+  {
+    size_t n;
+    while ((n = ring_buffer_pop(&thread->events, events, 256)) > 0)
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        /* Complete events; timestamps and durations are in microseconds. */
+        zone_print_separator(writer);
+        fputs("{\"ph\":\"X\",\"name\":", writer->fp);
+        zone_print_string(writer->fp, events[i].name);
+        fprintf(writer->fp, ",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", pid, thread->id,
+                events[i].begin / 1000.0, (events[i].end - events[i].begin) / 1000.0);
+      }
+    }
+  }
+
+  return ferror(writer->fp) ? -1 : 0;
+}
+
+/*
+ * Flushes the remaining zones, adds the thread names and the number of dropped
+ * zones to the trace, and closes the file. Returns 0 on success, or -1 in case
+ * of a write error.
+ */
+int zone_writer_close(struct zone_writer *writer)
+{
+  zone_writer_flush(writer);
+
+  const pid_t pid = getpid();
+  size_t dropped = 0;
+
+  pthread_mutex_lock(&zone_threads_mutex);
+  for (struct zone_thread *thread = zone_threads; thread; thread = thread->next)
+  {
+    zone_print_separator(writer);
+    fprintf(writer->fp,
+            "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":",
+            pid, thread->id);
+    zone_print_string(writer->fp, thread->name);
+    fputs("}}", writer->fp);
+
+    dropped += atomic_load_explicit(&thread->dropped, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&zone_threads_mutex);
+
+  fprintf(writer->fp, "\n],\"otherData\":{\"dropped_zones\":\"%zu\"}}\n", dropped);
+
+  const bool error = ferror(writer->fp);
+  return (fclose(writer->fp) != 0 || error) ? -1 : 0;
+}
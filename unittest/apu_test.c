@@ -0,0 +1,164 @@
+#include "apu_test.h"
+
+#include <lib/nes/include/apu.h>
+#include <lib/std/include/util.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+
+/* CPU memory, of which the DMC reads samples at $c000. */
+static uint8_t memory[CPU_ADDRESS_MAX + 1];
+
+START_TEST(test_pulse)
+{
+  static struct Apu apu;
+  apu_power_on(&apu, memory, 0);
+  struct blip_buffer blip = make_blip_buffer(4096, APU_CLOCK_RATE, 44100);
+  apu.blip = &blip;
+
+  /* A 440 Hz square wave at full, constant volume. */
+  apu_write(&apu, 0x4015, 0x01);
+  apu_write(&apu, 0x4000, 0xbf);
+  apu_write(&apu, 0x4002, 0xfd);
+  apu_write(&apu, 0x4003, 0x00);
+  apu_end_frame(&apu, 29781);
+
+  int16_t samples[4096];
+  const int count = blip_read_samples(&blip, samples, 4096);
+  ck_assert_int_eq(count, 733);
+
+  /* The wave swings by at least the full weight of the channel, overshooting
+   * a little, and crosses zero about twice per period of 100 samples. */
+  int min = INT16_MAX;
+  int max = INT16_MIN;
+  int crossings = 0;
+  for (int i = 100; i < count; ++i)
+  {
+    min = MIN(min, samples[i]);
+    max = MAX(max, samples[i]);
+    crossings += (samples[i - 1] < 0) != (samples[i] < 0);
+  }
+  ck_assert_int_gt(max - min, 3500);
+  ck_assert_int_lt(max - min, 6000);
+  ck_assert_int_ge(crossings, 11);
+  ck_assert_int_le(crossings, 13);
+
+  /* Disabling the channel silences it. */
+  apu_write(&apu, 0x4015, 0x00);
+  ck_assert_int_eq(apu.pulse[0].level, 0);
+  destroy_blip_buffer(&blip);
+}
+END_TEST
+
+START_TEST(test_length_counter)
+{
+  static struct Apu apu;
+  apu_power_on(&apu, memory, 0);
+
+  /* Length counters only load when the channel is enabled. */
+  apu_write(&apu, 0x400f, 0x00);
+  ck_assert_int_eq(apu_read(&apu, 0x4015) & 0x0f, 0x00);
+  apu_write(&apu, 0x4015, 0x0f);
+  apu_write(&apu, 0x4003, 0x00);
+  apu_write(&apu, 0x4007, 0x08);
+  apu_write(&apu, 0x400b, 0x00);
+  apu_write(&apu, 0x400f, 0x00);
+  ck_assert_int_eq(apu_read(&apu, 0x4015) & 0x0f, 0x0f);
+  ck_assert_int_eq(apu.pulse[1].length, 254);
+
+  /* Half frames count down a length of 10 in five sequences, unless halted. */
+  apu_write(&apu, 0x4004, 0x20);
+  apu_run_until(&apu, 5 * 29830 - 2);
+  ck_assert_int_eq(apu.pulse[0].length, 1);
+  apu_run_until(&apu, 5 * 29830);
+  ck_assert_int_eq(apu_read(&apu, 0x4015) & 0x0f, 0x02);
+  ck_assert_int_eq(apu.pulse[1].length, 254);
+
+  /* Disabling a channel clears its length counter. */
+  apu_write(&apu, 0x4015, 0x00);
+  ck_assert_int_eq(apu_read(&apu, 0x4015) & 0x0f, 0x00);
+}
+END_TEST
+
+START_TEST(test_frame_irq)
+{
+  static struct Apu apu;
+  apu_power_on(&apu, memory, 0);
+
+  /* In four step mode, the last step of every sequence raises an IRQ. */
+  ck_assert_uint_eq(apu_next_irq(&apu), 29829);
+  apu_run_until(&apu, 29828);
+  ck_assert(!apu_irq(&apu));
+  apu_run_until(&apu, 29829);
+  ck_assert(apu_irq(&apu));
+  ck_assert_uint_eq(apu_next_irq(&apu), UINT64_MAX);
+
+  /* Reading the status acknowledges it. */
+  ck_assert_int_eq(apu_read(&apu, 0x4015) & 0x40, 0x40);
+  ck_assert(!apu_irq(&apu));
+  ck_assert_uint_eq(apu_next_irq(&apu), 29830 + 29829);
+
+  /* Writing $4017 restarts the sequence after 3 or 4 cycles. */
+  apu_run_until(&apu, 40001);
+  apu_write(&apu, 0x4017, 0x00);
+  ck_assert_uint_eq(apu_next_irq(&apu), 40001 + 4 + 29829);
+
+  /* Neither five step mode nor inhibited IRQs raise IRQs. */
+  apu_write(&apu, 0x4017, 0x80);
+  ck_assert_uint_eq(apu_next_irq(&apu), UINT64_MAX);
+  apu_write(&apu, 0x4017, 0x40);
+  ck_assert_uint_eq(apu_next_irq(&apu), UINT64_MAX);
+  apu_run_until(&apu, 200000);
+  ck_assert(!apu_irq(&apu));
+}
+END_TEST
+
+START_TEST(test_dmc)
+{
+  static struct Apu apu;
+  for (int i = 0; i < 17; ++i)
+  {
+    memory[0xc000 + i] = 0xff;
+  }
+  apu_power_on(&apu, memory, 0);
+  apu_write(&apu, 0x4017, 0x40);
+
+  /* A 17 byte sample at the highest rate, with an IRQ at its end. */
+  apu_write(&apu, 0x4010, 0x8f);
+  apu_write(&apu, 0x4012, 0x00);
+  apu_write(&apu, 0x4013, 0x01);
+  apu_write(&apu, 0x4015, 0x10);
+  ck_assert_int_eq(apu_read(&apu, 0x4015) & 0x10, 0x10);
+  ck_assert_uint_eq(apu.dma_cycles, 4);
+
+  /* The first byte was read right away; the others are read whenever the
+   * output cycle of the byte before them starts, every 8 bits. */
+  const uint64_t irq = apu_next_irq(&apu);
+  ck_assert_uint_eq(irq, (7 + 8 * 15) * 54 + 1);
+  apu_run_until(&apu, irq - 1);
+  ck_assert(!apu_irq(&apu));
+  apu_run_until(&apu, irq);
+  ck_assert(apu_irq(&apu));
+  ck_assert_uint_eq(apu.dma_cycles, 17 * 4);
+  ck_assert_int_eq(apu_read(&apu, 0x4015) & 0x90, 0x80);
+
+  /* Ones in the sample raise the output by 2 per bit, up to its maximum. */
+  ck_assert_int_eq(apu.dmc.output, 126);
+
+  /* Writing $4015 acknowledges the IRQ. */
+  apu_write(&apu, 0x4015, 0x00);
+  ck_assert(!apu_irq(&apu));
+}
+END_TEST
+
+struct TCase *make_apu_test_case(void)
+{
+  TCase *test_case = tcase_create("APU test cases");
+  tcase_add_test(test_case, test_pulse);
+  tcase_add_test(test_case, test_length_counter);
+  tcase_add_test(test_case, test_frame_irq);
+  tcase_add_test(test_case, test_dmc);
+
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef APU_TEST_H
+#define APU_TEST_H
+
+struct TCase;
+
+struct TCase *make_apu_test_case(void);
+
+#endif  // APU_TEST_H
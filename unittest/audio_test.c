@@ -0,0 +1,140 @@
+#include "audio_test.h"
+
+#include <lib/nes/include/apu.h>
+#include <lib/nes/include/audio.h>
+#include <lib/std/include/io.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Number of samples written by the tests. */
+#define AUDIO_TEST_SAMPLES 10000
+
+static int16_t samples[AUDIO_SINK_CAPACITY + 100];
+
+START_TEST(test_rate_ratio)
+{
+  /* Half full is the target, and the adjustment is limited. */
+  ck_assert_double_eq(audio_rate_ratio(0.5), 1.0);
+  ck_assert_double_eq_tol(audio_rate_ratio(0.0), 1.0 + AUDIO_MAX_RATE_DELTA, 1e-9);
+  ck_assert_double_eq_tol(audio_rate_ratio(1.0), 1.0 - AUDIO_MAX_RATE_DELTA, 1e-9);
+  ck_assert_double_eq_tol(audio_rate_ratio(2.0), 1.0 - AUDIO_MAX_RATE_DELTA, 1e-9);
+  ck_assert_double_gt(audio_rate_ratio(0.25), audio_rate_ratio(0.3));
+}
+END_TEST
+
+START_TEST(test_wav_sink)
+{
+  char file_name[32];
+  strcpy(file_name, "/tmp/nepnes_audio_XXXXXX");
+  int fd = mkstemp(file_name);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+
+  /* A sink that is not paced plays all samples pushed, however many. */
+  struct AudioSink sink;
+  ck_assert_int_eq(audio_sink_open(&sink, AUDIO_SINK_WAV, file_name, 44100, false), 0);
+  for (int i = 0; i < AUDIO_TEST_SAMPLES; ++i)
+  {
+    const int16_t sample = i * 5 - 25000;
+    ck_assert_uint_eq(audio_sink_push(&sink, &sample, 1), 1);
+  }
+  ck_assert_double_eq(audio_sink_rate_ratio(&sink), 1.0);
+  ck_assert_int_eq(audio_sink_close(&sink), 0);
+  ck_assert_uint_eq(sink.played, AUDIO_TEST_SAMPLES);
+
+  uint8_t *data;
+  size_t size;
+  ck_assert_int_eq(nn_read_all(file_name, &data, &size), 0);
+  unlink(file_name);
+
+  /* A 16-bit mono PCM file at the rate of the sink, of the size of the data. */
+  const size_t data_size = 2 * AUDIO_TEST_SAMPLES;
+  ck_assert_uint_eq(size, 44 + data_size);
+  ck_assert_mem_eq(data, "RIFF", 4);
+  ck_assert_uint_eq(data[4] | data[5] << 8 | data[6] << 16, 36 + data_size);
+  ck_assert_mem_eq(data + 8, "WAVEfmt ", 8);
+  ck_assert_uint_eq(data[20] | data[21] << 8, 1);
+  ck_assert_uint_eq(data[22] | data[23] << 8, 1);
+  ck_assert_uint_eq(data[24] | data[25] << 8 | data[26] << 16, 44100);
+  ck_assert_uint_eq(data[34] | data[35] << 8, 16);
+  ck_assert_mem_eq(data + 36, "data", 4);
+  ck_assert_uint_eq(data[40] | data[41] << 8 | data[42] << 16, data_size);
+  for (int i = 0; i < AUDIO_TEST_SAMPLES; ++i)
+  {
+    ck_assert_int_eq((int16_t)(data[44 + 2 * i] | data[45 + 2 * i] << 8), i * 5 - 25000);
+  }
+  free(data);
+}
+END_TEST
+
+START_TEST(test_paced_sink)
+{
+  struct AudioSink sink;
+  ck_assert_int_eq(audio_sink_open(&sink, AUDIO_SINK_NULL, NULL, AUDIO_SAMPLE_RATE, true), 0);
+
+  /* A full sink drops what does not fit, and asks for fewer samples. */
+  ck_assert_uint_eq(audio_sink_push(&sink, samples, AUDIO_SINK_CAPACITY + 100),
+                    AUDIO_SINK_CAPACITY);
+  ck_assert_uint_eq(sink.overrun, 100);
+  ck_assert_double_lt(audio_sink_rate_ratio(&sink), 1.0);
+
+  /* It plays in real time, and plays silence once it runs dry; a 100 ms
+   * worth of samples takes 85 ms at least. */
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  const struct timespec idle = {0, 1000 * 1000};
+  while (atomic_load(&sink.played) < AUDIO_SAMPLE_RATE / 10)
+  {
+    nanosleep(&idle, NULL);
+  }
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  const double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  ck_assert_double_gt(seconds, 0.085);
+  ck_assert_uint_gt(atomic_load(&sink.underrun), 0);
+  ck_assert_double_gt(audio_sink_rate_ratio(&sink), 1.0);
+
+  ck_assert_int_eq(audio_sink_close(&sink), 0);
+}
+END_TEST
+
+START_TEST(test_push_blip)
+{
+  struct AudioSink sink;
+  ck_assert_int_eq(audio_sink_open(&sink, AUDIO_SINK_NULL, NULL, AUDIO_SAMPLE_RATE, true), 0);
+  struct blip_buffer blip = make_blip_buffer(8192, APU_CLOCK_RATE, AUDIO_SYNTHESIS_RATE);
+  const uint64_t factor = blip.factor;
+
+  /* All samples of the frame are resampled and pushed, but for the latency of
+   * the resampler; a sink that is less than half full speeds the blip buffer
+   * up. */
+  blip_end_frame(&blip, APU_CLOCK_RATE / 40);
+  const int count = blip_samples_available(&blip);
+  ck_assert_int_ge(count, AUDIO_SYNTHESIS_RATE / 40 - 1);
+  audio_sink_push_blip(&sink, &blip, APU_CLOCK_RATE);
+  ck_assert_int_eq(blip_samples_available(&blip), 0);
+  const int expected = count * AUDIO_SAMPLE_RATE / AUDIO_SYNTHESIS_RATE;
+  ck_assert_int_le(ring_buffer_size(&sink.samples), expected);
+  ck_assert_int_ge(ring_buffer_size(&sink.samples), expected - RESAMPLER_TAPS / 2);
+  ck_assert_uint_gt(blip.factor, factor);
+
+  destroy_blip_buffer(&blip);
+  ck_assert_int_eq(audio_sink_close(&sink), 0);
+}
+END_TEST
+
+struct TCase *make_audio_test_case(void)
+{
+  TCase *test_case = tcase_create("Audio test cases");
+  tcase_add_test(test_case, test_rate_ratio);
+  tcase_add_test(test_case, test_wav_sink);
+  tcase_add_test(test_case, test_paced_sink);
+  tcase_add_test(test_case, test_push_blip);
+
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef AUDIO_TEST_H
+#define AUDIO_TEST_H
+
+struct TCase;
+
+struct TCase *make_audio_test_case(void);
+
+#endif  // AUDIO_TEST_H
@@ -0,0 +1,87 @@
+#include "blip_buffer_test.h"
+
+#include <lib/std/include/blip_buffer.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+
+START_TEST(test_end_frame)
+{
+  /* One sample every 10 clocks. */
+  struct blip_buffer blip = make_blip_buffer(1000, 480000, 48000);
+  ck_assert_int_eq(blip_samples_available(&blip), 0);
+
+  blip_end_frame(&blip, 1005);
+  ck_assert_int_eq(blip_samples_available(&blip), 100);
+  blip_end_frame(&blip, 995);
+  ck_assert_int_eq(blip_samples_available(&blip), 200);
+
+  /* Reading is limited to the available samples; with no output, samples
+   * are discarded. */
+  int16_t samples[300];
+  ck_assert_int_eq(blip_read_samples(&blip, samples, 50), 50);
+  ck_assert_int_eq(blip_read_samples(&blip, NULL, 100), 100);
+  ck_assert_int_eq(blip_read_samples(&blip, samples, 300), 50);
+  ck_assert_int_eq(blip_samples_available(&blip), 0);
+  destroy_blip_buffer(&blip);
+}
+END_TEST
+
+START_TEST(test_step)
+{
+  struct blip_buffer blip = make_blip_buffer(1000, 480000, 48000);
+
+  /* A step is centered at its position, half a sample past sample 10, plus
+   * the latency of the kernel, and settles at its amplitude right after. */
+  blip_add_delta(&blip, 105, 10000);
+  blip_end_frame(&blip, 1000);
+  int16_t samples[100];
+  ck_assert_int_eq(blip_read_samples(&blip, samples, 100), 100);
+
+  ck_assert_int_eq(samples[0], 0);
+  ck_assert_int_eq(samples[10], 0);
+  ck_assert_int_gt(samples[17], 4000);
+  ck_assert_int_lt(samples[17], 6000);
+  for (int i = 20; i < 30; ++i)
+  {
+    ck_assert_int_lt(abs(samples[i] - 9900), 250);
+  }
+
+  /* The high-pass filter lets DC decay. */
+  ck_assert_int_lt(samples[99], samples[30]);
+  ck_assert_int_gt(samples[99], 8000);
+  destroy_blip_buffer(&blip);
+}
+END_TEST
+
+START_TEST(test_clamp)
+{
+  struct blip_buffer blip = make_blip_buffer(100, 480000, 48000);
+
+  /* Samples saturate rather than wrap. */
+  blip_add_delta(&blip, 0, 20000);
+  blip_add_delta(&blip, 0, 20000);
+  blip_end_frame(&blip, 1000);
+  int16_t samples[100];
+  ck_assert_int_eq(blip_read_samples(&blip, samples, 100), 100);
+  ck_assert_int_eq(samples[20], INT16_MAX);
+
+  blip_clear(&blip);
+  ck_assert_int_eq(blip_samples_available(&blip), 0);
+  blip_end_frame(&blip, 1000);
+  ck_assert_int_eq(blip_read_samples(&blip, samples, 100), 100);
+  ck_assert_int_eq(samples[20], 0);
+  destroy_blip_buffer(&blip);
+}
+END_TEST
+
+struct TCase *make_blip_buffer_test_case(void)
+{
+  TCase *test_case = tcase_create("Blip buffer test cases");
+  tcase_add_test(test_case, test_end_frame);
+  tcase_add_test(test_case, test_step);
+  tcase_add_test(test_case, test_clamp);
+
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef BLIP_BUFFER_TEST_H
+#define BLIP_BUFFER_TEST_H
+
+struct TCase;
+
+struct TCase *make_blip_buffer_test_case(void);
+
+#endif  // BLIP_BUFFER_TEST_H
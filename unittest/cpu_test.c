@@ -0,0 +1,219 @@
+#include "cpu_test.h"
+
+#include <lib/6502/include/cpu.h>
+#include <lib/6502/include/trace.h>
+#include <lib/nes/include/mapper.h>
+#include <lib/nes/include/rom.h>
+#include <lib/std/include/io.h>
+
+#include <check.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char nestest_rom_path[] = "unittest/input/roms/nes-test-roms/other/nestest.nes";
+static const char nestest_log_path[] = "log/nestest_no_ppu.log";
+
+/* Number of times the nestest program is run to measure the CPU speed. */
+#define NESTEST_SPEED_RUNS 200
+/* Lower bound on the CPU speed; about an order of magnitude below what an
+ * optimized build achieves, so that only big regressions fail the test. */
+#define NESTEST_MIN_INSTRUCTIONS_PER_SECOND 5e6
+
+/*
+ * Initializes the CPU with the nestest ROM, in automation mode, that is, with
+ * the program counter at $C000.
+ */
+static void load_nestest(struct Cpu *cpu)
+{
+  uint8_t *rom_data;
+  size_t rom_size;
+  if (nn_read_all(nestest_rom_path, &rom_data, &rom_size) == -1)
+  {
+    ck_abort_msg("Could not open the input ROM file '%s' for reading", nestest_rom_path);
+  }
+
+  struct RomHeader header = rom_make_header(rom_data);
+  ck_assert_int_eq(header.rom_format, RF_INES);
+
+  uint8_t *prg_data;
+  size_t prg_size;
+  rom_prg_data(&header, rom_data, &prg_data, &prg_size);
+  ck_assert_int_eq(mapper_initialize_cpu(header.mapper, cpu, prg_data, prg_size), 0);
+
+  cpu_power_on(cpu);
+  cpu->PC = 0xc000;
+
+  free(rom_data);
+}
+
+/*
+ * Reads all records from the nestest reference log. Returns the number of
+ * records read.
+ */
+static size_t load_nestest_log(struct TraceRecord **records)
+{
+  FILE *fp;
+  if ((fp = fopen(nestest_log_path, "r")) == NULL)
+  {
+    ck_abort_msg("Could not open the reference log '%s' for reading", nestest_log_path);
+  }
+
+  size_t n = 0;
+  size_t capacity = 0;
+  *records = NULL;
+
+  char line[256];
+  while (fgets(line, sizeof line, fp) != NULL)
+  {
+    if (n == capacity)
+    {
+      capacity = capacity == 0 ? 16384 : 2 * capacity;
+      *records = realloc(*records, capacity * sizeof **records);
+      ck_assert_ptr_nonnull(*records);
+    }
+
+    line[strcspn(line, "\r\n")] = '\0';
+    if (trace_parse_nintendulator(line, &(*records)[n]) != 0)
+    {
+      ck_abort_msg("Could not parse line %zu of '%s'", n + 1, nestest_log_path);
+    }
+    ++n;
+  }
+
+  fclose(fp);
+  return n;
+}
+
+START_TEST(test_nestest)
+{
+  static struct Cpu cpu;
+  load_nestest(&cpu);
+
+  struct TraceRecord *expected;
+  const size_t n = load_nestest_log(&expected);
+  ck_assert_uint_gt(n, 0);
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    const struct TraceRecord actual = make_trace_record(&cpu);
+    const char *field = trace_record_compare(&expected[i], &actual, false);
+    if (field != NULL)
+    {
+      ck_abort_msg(
+          "Mismatch in %s at line %zu of '%s', PC:%04X, expected A:%02X X:%02X Y:%02X P:%02X "
+          "SP:%02X CYC:%llu, got A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu",
+          field, i + 1, nestest_log_path, expected[i].PC, expected[i].A, expected[i].X,
+          expected[i].Y, expected[i].P, expected[i].S, (unsigned long long)expected[i].cycle,
+          actual.A, actual.X, actual.Y, actual.P, actual.S, (unsigned long long)actual.cycle);
+    }
+    cpu_execute_next_instruction(&cpu);
+  }
+
+  free(expected);
+}
+END_TEST
+
+START_TEST(test_nestest_speed)
+{
+  static struct Cpu initial_cpu;
+  static struct Cpu cpu;
+  load_nestest(&initial_cpu);
+
+  struct TraceRecord *expected;
+  const size_t n = load_nestest_log(&expected);
+  free(expected);
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int run = 0; run < NESTEST_SPEED_RUNS; ++run)
+  {
+    cpu = initial_cpu;
+    for (size_t i = 0; i < n; ++i)
+    {
+      cpu_execute_next_instruction(&cpu);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  const double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  const double instructions_per_second = NESTEST_SPEED_RUNS * n / seconds;
+  printf("nestest: %.1f M instructions/s\n", instructions_per_second / 1e6);
+
+  ck_assert_msg(instructions_per_second >= NESTEST_MIN_INSTRUCTIONS_PER_SECOND,
+                "CPU too slow, %.1f M instructions/s, expected at least %.1f M",
+                instructions_per_second / 1e6, NESTEST_MIN_INSTRUCTIONS_PER_SECOND / 1e6);
+}
+END_TEST
+
+/*
+ * Powers on a CPU with empty memory, that starts at $8000 with the given
+ * opcode.
+ */
+static void power_on_with(struct Cpu *cpu, uint8_t opcode)
+{
+  memset(cpu, 0, sizeof *cpu);
+  cpu->ram[CPU_ADDRESS_RESET_VECTOR + 1] = 0x80;
+  cpu->ram[CPU_ADDRESS_IRQ_VECTOR + 1] = 0x90;
+  cpu->ram[0x8000] = opcode;
+  cpu_power_on(cpu);
+}
+
+START_TEST(test_brk)
+{
+  static struct Cpu cpu;
+  power_on_with(&cpu, 0x00);
+
+  /* Returns past the padding byte, with the B-flag pushed. */
+  cpu_execute_next_instruction(&cpu);
+  ck_assert_uint_eq(cpu.PC, 0x9000);
+  ck_assert_uint_eq(cpu.S, 0xfa);
+  ck_assert_uint_eq(cpu.ram[0x1fd], 0x80);
+  ck_assert_uint_eq(cpu.ram[0x1fc], 0x02);
+  ck_assert_uint_eq(cpu.ram[0x1fb], 0x34);
+  ck_assert(cpu.P & FLAGS_INTERRUPT_DISABLE);
+  ck_assert_uint_eq(cpu.cycle, 7 + 7);
+  ck_assert(!cpu.jammed);
+}
+END_TEST
+
+START_TEST(test_jam)
+{
+  static struct Cpu cpu;
+  power_on_with(&cpu, 0x02);
+
+  /* The CPU halts, but time passes. */
+  for (int i = 0; i < 10; ++i)
+  {
+    cpu_execute_next_instruction(&cpu);
+  }
+  ck_assert(cpu.jammed);
+  ck_assert_uint_eq(cpu.PC, 0x8000);
+  ck_assert_uint_eq(cpu.cycle, 7 + 10);
+
+  /* Interrupts are ignored, until power on. */
+  cpu.P &= ~FLAGS_INTERRUPT_DISABLE;
+  cpu_nmi(&cpu);
+  ck_assert(!cpu_irq(&cpu));
+  ck_assert_uint_eq(cpu.PC, 0x8000);
+  ck_assert_uint_eq(cpu.S, 0xfd);
+
+  cpu_power_on(&cpu);
+  ck_assert(!cpu.jammed);
+}
+END_TEST
+
+TCase *make_cpu_test_case(void)
+{
+  TCase *tc = tcase_create("CPU test cases");
+  tcase_add_test(tc, test_nestest);
+  tcase_add_test(tc, test_nestest_speed);
+  tcase_add_test(tc, test_brk);
+  tcase_add_test(tc, test_jam);
+  return tc;
+}
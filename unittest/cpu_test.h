@@ -0,0 +1,8 @@
+#ifndef CPU_TEST_H
+#define CPU_TEST_H
+
+struct TCase;
+
+struct TCase *make_cpu_test_case(void);
+
+#endif  // CPU_TEST_H
@@ -0,0 +1,95 @@
+#include "hash_test.h"
+
+#include <lib/std/include/hash.h>
+#include <lib/std/include/simd.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static int compare_hashes(const void *a, const void *b)
+{
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+START_TEST(test_known_values)
+{
+  /* Hashes are stored in reference files, hence must not change. */
+  static const uint8_t zeros[4096];
+  ck_assert_uint_eq(nn_hash64("", 0), 0x2b680a3b5e8db010ull);
+  ck_assert_uint_eq(nn_hash64("nepnes", 6), 0x0366ea2bc04699a2ull);
+  ck_assert_uint_eq(nn_hash64(zeros, sizeof zeros), 0x21fcbc24dc01ec6cull);
+}
+END_TEST
+
+START_TEST(test_simd_levels)
+{
+  /* Sizes up to a few blocks cover the short inputs, partial blocks and the
+   * overlapping last stripe; offsets cover unaligned input. */
+  enum { SIZE = 3000 };
+  static uint8_t data[SIZE + 3];
+  srand(3);
+  for (size_t i = 0; i < sizeof data; ++i)
+  {
+    data[i] = rand();
+  }
+
+  for (size_t size = 0; size <= SIZE; size += size < 300 ? 1 : 37)
+  {
+    const uint8_t *p = data + size % 4;
+    simd_limit(SIMD_SCALAR);
+    const uint64_t expected = nn_hash64(p, size);
+    const struct hash128 expected128 = nn_hash128(p, size);
+    ck_assert_uint_ne(expected128.low, expected128.high);
+    for (enum simd_level level = SIMD_SSE4; level <= SIMD_AVX2; ++level)
+    {
+      simd_limit(level);
+      ck_assert_uint_eq(nn_hash64(p, size), expected);
+      ck_assert(hash128_equal(nn_hash128(p, size), expected128));
+    }
+  }
+  simd_limit(SIMD_AVX2);
+}
+END_TEST
+
+START_TEST(test_bit_flips)
+{
+  /* Every single bit flip of an input gives a distinct hash. */
+  enum { SIZE = 1500 };
+  static uint8_t data[SIZE];
+  static uint64_t hashes[SIZE * 8 + 1];
+  for (int size = 40; size <= SIZE; size += SIZE - 40)
+  {
+    memset(data, 0, sizeof data);
+    int count = 0;
+    hashes[count++] = nn_hash64(data, size);
+    for (int bit = 0; bit < size * 8; ++bit)
+    {
+      data[bit / 8] ^= 1 << (bit % 8);
+      hashes[count++] = nn_hash64(data, size);
+      data[bit / 8] ^= 1 << (bit % 8);
+    }
+
+    qsort(hashes, count, sizeof hashes[0], compare_hashes);
+    for (int i = 1; i < count; ++i)
+    {
+      ck_assert_uint_ne(hashes[i - 1], hashes[i]);
+    }
+  }
+
+  /* Trailing zeros count. */
+  ck_assert_uint_ne(nn_hash64(data, 5), nn_hash64(data, 6));
+}
+END_TEST
+
+TCase *make_hash_test_case(void)
+{
+  TCase *test_case = tcase_create("Hash test cases");
+  tcase_add_test(test_case, test_known_values);
+  tcase_add_test(test_case, test_simd_levels);
+  tcase_add_test(test_case, test_bit_flips);
+  return test_case;
+}
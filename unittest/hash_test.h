@@ -0,0 +1,8 @@
+#ifndef HASH_TEST_H
+#define HASH_TEST_H
+
+struct TCase;
+
+struct TCase *make_hash_test_case(void);
+
+#endif  // HASH_TEST_H
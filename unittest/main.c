@@ -1,7 +1,26 @@
+#include "apu_test.h"
+#include "audio_test.h"
+#include "blip_buffer_test.h"
+#include "cpu_test.h"
 #include "da_test.h"
 #include "flat_set_test.h"
+#include "hash_test.h"
+#include "metrics_test.h"
+#include "nes_test.h"
+#include "nsf_test.h"
+#include "ntsc_test.h"
 #include "opcode_test.h"
+#include "palette_test.h"
+#include "ppu_test.h"
+#include "profiler_test.h"
+#include "resampler_test.h"
+#include "ring_buffer_test.h"
 #include "rom_test.h"
+#include "scaler_test.h"
+#include "thread_pool_test.h"
+#include "trace_test.h"
+#include "video_test.h"
+#include "zone_test.h"
 
 #include <check.h>
 
@@ -10,10 +29,29 @@
 int main(void)
 {
   Suite *suite = suite_create("nepnes test suite");
+  suite_add_tcase(suite, make_cpu_test_case());
   suite_add_tcase(suite, make_da_test_case());
   suite_add_tcase(suite, make_opcode_test_case());
+  suite_add_tcase(suite, make_profiler_test_case());
   suite_add_tcase(suite, make_rom_test_case());
+  suite_add_tcase(suite, make_nes_test_case());
+  suite_add_tcase(suite, make_ppu_test_case());
+  suite_add_tcase(suite, make_apu_test_case());
+  suite_add_tcase(suite, make_blip_buffer_test_case());
+  suite_add_tcase(suite, make_resampler_test_case());
+  suite_add_tcase(suite, make_audio_test_case());
+  suite_add_tcase(suite, make_nsf_test_case());
+  suite_add_tcase(suite, make_palette_test_case());
+  suite_add_tcase(suite, make_ntsc_test_case());
   suite_add_tcase(suite, make_flat_set_test_case());
+  suite_add_tcase(suite, make_hash_test_case());
+  suite_add_tcase(suite, make_metrics_test_case());
+  suite_add_tcase(suite, make_ring_buffer_test_case());
+  suite_add_tcase(suite, make_scaler_test_case());
+  suite_add_tcase(suite, make_thread_pool_test_case());
+  suite_add_tcase(suite, make_trace_test_case());
+  suite_add_tcase(suite, make_video_test_case());
+  suite_add_tcase(suite, make_zone_test_case());
 
   SRunner *sr = srunner_create(suite);
   srunner_set_fork_status(sr, CK_NOFORK);
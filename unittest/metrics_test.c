@@ -0,0 +1,149 @@
+#include "metrics_test.h"
+
+#include <lib/std/include/io.h>
+#include <lib/std/include/metrics.h>
+
+#include <check.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum
+{
+  METRICS_TEST_THREADS = 4,
+  METRICS_TEST_INCREMENTS = 100000
+};
+
+/*
+ * Returns the metric with the given name from a snapshot.
+ */
+static const struct metric_value *find_metric(const struct metric_value *values, int n,
+                                              const char *name)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    if (strcmp(values[i].name, name) == 0)
+    {
+      return &values[i];
+    }
+  }
+  ck_abort_msg("Metric '%s' not found", name);
+  return NULL;
+}
+
+START_TEST(test_histogram_buckets)
+{
+  /* Small values are exact. */
+  for (uint64_t value = 0; value < METRICS_HISTOGRAM_SUB_BUCKETS; ++value)
+  {
+    ck_assert_uint_eq(metrics_histogram_value(metrics_histogram_bucket(value)), value);
+  }
+
+  /* Larger values are within the relative error of their bucket, and buckets
+   * are ordered by value. */
+  unsigned previous = 0;
+  for (uint64_t value = METRICS_HISTOGRAM_SUB_BUCKETS; value < (1ull << 62); value += value / 7)
+  {
+    const unsigned bucket = metrics_histogram_bucket(value);
+    ck_assert_uint_lt(bucket, METRICS_HISTOGRAM_BUCKETS);
+    ck_assert_uint_ge(bucket, previous);
+    previous = bucket;
+
+    const uint64_t approximation = metrics_histogram_value(bucket);
+    const uint64_t error = approximation > value ? approximation - value : value - approximation;
+    ck_assert_uint_le(error, value / METRICS_HISTOGRAM_SUB_BUCKETS);
+  }
+  ck_assert_uint_eq(metrics_histogram_bucket(UINT64_MAX), METRICS_HISTOGRAM_BUCKETS - 1);
+}
+END_TEST
+
+static void *increment(void *arg)
+{
+  const metric_t counter = metrics_register("test_counter", METRIC_COUNTER);
+  const metric_t histogram = metrics_register("test_histogram", METRIC_HISTOGRAM);
+  for (int i = 0; i < METRICS_TEST_INCREMENTS; ++i)
+  {
+    metrics_add(counter, 1);
+    metrics_record(histogram, i % 100 == 99 ? 1000000 : 1000);
+  }
+  return NULL;
+}
+
+START_TEST(test_sharded_metrics)
+{
+  /* Counters and histograms are summed over the shards of all threads. */
+  pthread_t threads[METRICS_TEST_THREADS];
+  for (int i = 0; i < METRICS_TEST_THREADS; ++i)
+  {
+    ck_assert_int_eq(pthread_create(&threads[i], NULL, increment, NULL), 0);
+  }
+  for (int i = 0; i < METRICS_TEST_THREADS; ++i)
+  {
+    ck_assert_int_eq(pthread_join(threads[i], NULL), 0);
+  }
+
+  /* Registering a metric again returns the same metric. */
+  const metric_t gauge = metrics_register("test_gauge", METRIC_GAUGE);
+  ck_assert_int_eq(metrics_register("test_gauge", METRIC_GAUGE), gauge);
+  metrics_set(gauge, 2.5);
+
+  struct metric_value values[METRICS_MAX];
+  const int n = metrics_snapshot(values);
+
+  const struct metric_value *counter = find_metric(values, n, "test_counter");
+  ck_assert_uint_eq(counter->count, METRICS_TEST_THREADS * METRICS_TEST_INCREMENTS);
+
+  const struct metric_value *histogram = find_metric(values, n, "test_histogram");
+  ck_assert_uint_eq(histogram->count, METRICS_TEST_THREADS * METRICS_TEST_INCREMENTS);
+  ck_assert_uint_le(metrics_histogram_percentile(histogram, 0.5), 1000 + 1000 / 32);
+  ck_assert_uint_ge(metrics_histogram_percentile(histogram, 0.5), 1000 - 1000 / 32);
+  ck_assert_uint_ge(metrics_histogram_percentile(histogram, 0.995), 1000000 - 1000000 / 32);
+
+  ck_assert_double_eq_tol(find_metric(values, n, "test_gauge")->value, 2.5, 1e-9);
+
+  metrics_free_snapshot(values, n);
+}
+END_TEST
+
+START_TEST(test_metrics_writer)
+{
+  char file_name[] = "/tmp/nepnes_metrics_XXXXXX";
+  int fd = mkstemp(file_name);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+
+  const metric_t counter = metrics_register("test_writer_counter", METRIC_COUNTER);
+  metrics_add(counter, 42);
+
+  struct metrics_writer writer;
+  ck_assert_int_eq(metrics_writer_open(&writer, file_name, 1000), 0);
+
+  /* Polling does not write before the interval elapsed. */
+  ck_assert_int_eq(metrics_writer_poll(&writer), 0);
+  ck_assert_int_eq(metrics_writer_write(&writer), 0);
+  metrics_writer_close(&writer);
+
+  unsigned char *data;
+  size_t size;
+  ck_assert_int_eq(nn_read_all(file_name, &data, &size), 0);
+  char *text = strndup((char *)data, size);
+  ck_assert_ptr_nonnull(strstr(text, "# TYPE nepnes_test_writer_counter counter\n"));
+  ck_assert_ptr_nonnull(strstr(text, "\nnepnes_test_writer_counter 42\n"));
+  ck_assert_ptr_nonnull(strstr(text, "\nnepnes_test_writer_counter_per_second "));
+
+  free(text);
+  free(data);
+  unlink(file_name);
+}
+END_TEST
+
+TCase *make_metrics_test_case(void)
+{
+  TCase *test_case = tcase_create("metrics");
+  tcase_add_test(test_case, test_histogram_buckets);
+  tcase_add_test(test_case, test_sharded_metrics);
+  tcase_add_test(test_case, test_metrics_writer);
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef METRICS_TEST_H
+#define METRICS_TEST_H
+
+struct TCase;
+
+struct TCase *make_metrics_test_case(void);
+
+#endif  // METRICS_TEST_H
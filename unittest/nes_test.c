@@ -0,0 +1,361 @@
+#include "nes_test.h"
+
+#include <lib/nes/include/input.h>
+#include <lib/nes/include/nes.h>
+
+#include <check.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* NROM-128 image; iNES header followed by 16KB of PRG ROM. */
+static uint8_t rom[16 + 0x4000];
+
+/*
+ * Creates an NROM ROM with CHR RAM, that runs the given program at $8000, and
+ * handles NMIs at $8000 + `nmi_offset`.
+ */
+static void make_rom(const uint8_t *program, size_t size, Address nmi_offset)
+{
+  memset(rom, 0, sizeof rom);
+  memcpy(rom, "NES\x1a\x01\x00", 6);
+  memcpy(rom + 16, program, size);
+
+  /* NMI and RESET vectors. */
+  rom[16 + 0x3ffa] = nmi_offset & 0xff;
+  rom[16 + 0x3ffb] = 0x80 + (nmi_offset >> 8);
+  rom[16 + 0x3ffc] = 0x00;
+  rom[16 + 0x3ffd] = 0x80;
+}
+
+/*
+ * Creates an NROM ROM that strobes the first controller, and stores the next
+ * ten bits read from $4016 at $00-$09.
+ */
+static void make_controller_rom(void)
+{
+  static const uint8_t program[] = {
+      0xa9, 0x01,       /* LDA #$01 */
+      0x8d, 0x16, 0x40, /* STA $4016 */
+      0xa9, 0x00,       /* LDA #$00 */
+      0x8d, 0x16, 0x40, /* STA $4016 */
+      0xa2, 0x00,       /* LDX #$00 */
+      0xad, 0x16, 0x40, /* LDA $4016 */
+      0x29, 0x01,       /* AND #$01 */
+      0x95, 0x00,       /* STA $00,X */
+      0xe8,             /* INX */
+      0xe0, 0x0a,       /* CPX #$0a */
+      0xd0, 0xf4,       /* BNE $800c */
+      0x4c, 0x18, 0x80, /* JMP $8018 */
+  };
+
+  make_rom(program, sizeof program, 0);
+}
+
+START_TEST(test_controller)
+{
+  make_controller_rom();
+
+  static struct Nes nes;
+  ck_assert_int_eq(nes_load(&nes, rom, sizeof rom), 0);
+  ck_assert_int_eq(nes.cpu.PC, 0x8000);
+
+  nes.controllers[0].buttons = BUTTON_A | BUTTON_START | BUTTON_RIGHT;
+  nes_run_frame(&nes);
+  ck_assert_int_eq(nes.ppu.frame, 1);
+
+  /* Buttons are read in order A, B, Select, Start, Up, Down, Left, Right,
+   * followed by ones. */
+  const uint8_t expected[10] = {1, 0, 0, 1, 0, 0, 0, 1, 1, 1};
+  ck_assert_mem_eq(nes.cpu.ram, expected, sizeof expected);
+  nes_unload(&nes);
+}
+END_TEST
+
+START_TEST(test_frame_timing)
+{
+  make_controller_rom();
+
+  static struct Nes nes;
+  ck_assert_int_eq(nes_load(&nes, rom, sizeof rom), 0);
+
+  /* Running until a cycle within the frame does not complete the frame. */
+  nes_run_until(&nes, nes.first_cycle + 1000);
+  ck_assert_int_eq(nes.ppu.frame, 0);
+  ck_assert_uint_ge(nes.cpu.cycle, nes.first_cycle + 1000);
+
+  /* The first frame ends when VBlank starts, at dot 1 of scanline 241. */
+  nes_run_frame(&nes);
+  ck_assert_int_eq(nes.ppu.frame, 1);
+  ck_assert_uint_ge(nes.cpu.cycle * 3, PPU_VBLANK_DOT);
+  ck_assert_uint_lt(nes.cpu.cycle * 3, PPU_VBLANK_DOT + 8 * 3);
+
+  /* Without rendering, every frame lasts 262 scanlines of 341 dots. */
+  nes_run_frame(&nes);
+  ck_assert_int_eq(nes.ppu.frame, 2);
+  ck_assert_uint_ge(nes.cpu.cycle * 3, PPU_VBLANK_DOT + PPU_DOTS_PER_FRAME);
+  ck_assert_uint_lt(nes.cpu.cycle * 3, PPU_VBLANK_DOT + PPU_DOTS_PER_FRAME + 8 * 3);
+
+  nes_unload(&nes);
+
+  /* Anything that is not a NES ROM is rejected. */
+  rom[0] = 'X';
+  ck_assert_int_eq(nes_load(&nes, rom, sizeof rom), -1);
+  ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(test_nmi)
+{
+  static const uint8_t program[] = {
+      0xa9, 0x80,       /* LDA #$80 */
+      0x8d, 0x00, 0x20, /* STA $2000 */
+      0x4c, 0x05, 0x80, /* JMP $8005 */
+      0xe6, 0x10,       /* INC $10 (NMI handler) */
+      0x40,             /* RTI */
+  };
+  make_rom(program, sizeof program, 0x08);
+
+  static struct Nes nes;
+  ck_assert_int_eq(nes_load(&nes, rom, sizeof rom), 0);
+
+  /* The NMI is raised at the end of every frame, and handled in the next. */
+  for (int i = 0; i < 3; ++i)
+  {
+    nes_run_frame(&nes);
+    ck_assert_int_eq(nes.cpu.PC, 0x8008);
+    ck_assert_int_eq(nes.cpu.ram[0x10], i);
+  }
+
+  /* The NMI pushed the return address, and the flags without the B-flag. */
+  ck_assert_int_eq(nes.cpu.S, 0xfa);
+  ck_assert_int_eq(nes.cpu.ram[0x1fd], 0x80);
+  ck_assert_int_eq(nes.cpu.ram[0x1fc], 0x05);
+  ck_assert_int_eq(nes.cpu.ram[0x1fb] & 0x30, 0x20);
+  ck_assert(nes.ppu.status & PPUSTATUS_VBLANK);
+  nes_unload(&nes);
+}
+END_TEST
+
+START_TEST(test_frame_irq)
+{
+  static const uint8_t program[] = {
+      0x58,             /* CLI */
+      0x4c, 0x01, 0x80, /* JMP $8001 */
+      0xad, 0x15, 0x40, /* LDA $4015 (IRQ handler) */
+      0xe6, 0x10,       /* INC $10 */
+      0x40,             /* RTI */
+  };
+  make_rom(program, sizeof program, 0);
+  rom[16 + 0x3ffe] = 0x04;
+  rom[16 + 0x3fff] = 0x80;
+
+  static struct Nes nes;
+  ck_assert_int_eq(nes_load(&nes, rom, sizeof rom), 0);
+
+  /* The frame counter raises an IRQ at the end of every sequence of 29830
+   * cycles, which the handler acknowledges by reading $4015. */
+  const uint64_t end = nes.first_cycle + 3 * 29830 + 100;
+  while (nes.cpu.cycle < end)
+  {
+    nes_run_until(&nes, end);
+  }
+  ck_assert_int_eq(nes.cpu.ram[0x10], 3);
+  ck_assert(!apu_irq(&nes.apu));
+
+  /* The IRQ pushed the flags without the B-flag. */
+  ck_assert_int_eq(nes.cpu.ram[0x1fb] & 0x30, 0x20);
+
+  /* Inhibiting IRQs through $4017 stops them. */
+  apu_write(&nes.apu, 0x4017, 0x40);
+  const uint64_t inhibited = nes.cpu.cycle + 2 * 29830;
+  while (nes.cpu.cycle < inhibited)
+  {
+    nes_run_until(&nes, inhibited);
+  }
+  ck_assert_int_eq(nes.cpu.ram[0x10], 3);
+  nes_unload(&nes);
+}
+END_TEST
+
+/*
+ * Writes the given input script to a temporary file, and reads it.
+ */
+static int read_script(struct InputScript *script, const char *text)
+{
+  char file_name[] = "/tmp/nepnes_input_XXXXXX";
+  int fd = mkstemp(file_name);
+  ck_assert_int_ne(fd, -1);
+  ck_assert_int_eq(write(fd, text, strlen(text)), (ssize_t)strlen(text));
+  close(fd);
+
+  const int result = input_script_read(script, file_name);
+  unlink(file_name);
+  return result;
+}
+
+START_TEST(test_input_script)
+{
+  struct InputScript script;
+  ck_assert_int_eq(read_script(&script,
+                               "# frame  controller 1  controller 2\n"
+                               "\n"
+                               "10 START\n"
+                               "12 right+A  B\n"
+                               "20 .\n"),
+                   0);
+  ck_assert_int_eq(script.size, 3);
+
+  /* Buttons are held until the next scripted frame. */
+  struct Controller controllers[2] = {0};
+  input_script_apply(&script, 0, controllers);
+  ck_assert_int_eq(controllers[0].buttons, 0);
+  input_script_apply(&script, 11, controllers);
+  ck_assert_int_eq(controllers[0].buttons, BUTTON_START);
+  input_script_apply(&script, 12, controllers);
+  ck_assert_int_eq(controllers[0].buttons, BUTTON_RIGHT | BUTTON_A);
+  ck_assert_int_eq(controllers[1].buttons, BUTTON_B);
+  input_script_apply(&script, 100, controllers);
+  ck_assert_int_eq(controllers[0].buttons, 0);
+  ck_assert_int_eq(controllers[1].buttons, 0);
+  destroy_input_script(&script);
+
+  /* Unknown buttons and frames out of order are rejected. */
+  ck_assert_int_eq(read_script(&script, "0 A\n1 TURBO\n"), -1);
+  ck_assert_int_eq(errno, EINVAL);
+  ck_assert_int_eq(script.error_line, 2);
+  destroy_input_script(&script);
+
+  ck_assert_int_eq(read_script(&script, "5 A\n4 B\n"), -1);
+  ck_assert_int_eq(script.error_line, 2);
+  destroy_input_script(&script);
+}
+END_TEST
+
+START_TEST(test_jam)
+{
+  static const uint8_t program[] = {0x02}; /* JAM */
+  make_rom(program, sizeof program, 0);
+
+  static struct Nes nes;
+  ck_assert_int_eq(nes_load(&nes, rom, sizeof rom), 0);
+
+  /* The console keeps running frames, a picture of nothing. */
+  nes_run_frame(&nes);
+  nes_run_frame(&nes);
+  ck_assert_int_eq(nes.ppu.frame, 2);
+  ck_assert(nes.cpu.jammed);
+  ck_assert_uint_eq(nes.cpu.PC, 0x8000);
+  nes_unload(&nes);
+}
+END_TEST
+
+/*
+ * Runs two frames of the ROM made last, counting hardware events with the
+ * given counters. Returns the number of instructions executed, as traced.
+ */
+static uint64_t run_counted(struct NesPerf *perf)
+{
+  static struct Nes nes;
+  ck_assert_int_eq(nes_load(&nes, rom, sizeof rom), 0);
+  nes.perf = perf;
+
+  char file_name[32];
+  strcpy(file_name, "/tmp/nepnes_nes_XXXXXX");
+  int fd = mkstemp(file_name);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+  struct TraceWriter writer;
+  ck_assert_int_eq(trace_writer_open(&writer, file_name), 0);
+  nes.trace = &writer;
+
+  nes_run_frame(&nes);
+  nes_run_frame(&nes);
+  ck_assert_int_eq(trace_writer_close(&writer), 0);
+  nes_unload(&nes);
+
+  struct TraceReader reader;
+  ck_assert_int_eq(trace_reader_open(&reader, file_name), 0);
+  const uint64_t instructions = trace_reader_record_count(&reader);
+  trace_reader_close(&reader);
+  unlink(file_name);
+
+  return instructions;
+}
+
+START_TEST(test_perf_regions)
+{
+  /* Without access to the counters, events read as zero, but the regions are
+   * entered and the work is counted all the same. */
+  struct perf_counters counters;
+  const bool counting = perf_open(&counters) == 0;
+  struct NesPerf perf = make_nes_perf(&counters);
+
+  make_controller_rom();
+  const uint64_t instructions = run_counted(&perf);
+
+  /* Every batch is followed by catching the PPU up, every frame by ending the
+   * frame of the APU. */
+  ck_assert_uint_ge(perf.cpu.calls, 2);
+  ck_assert_uint_eq(perf.ppu.calls, perf.cpu.calls);
+  ck_assert_uint_eq(perf.apu.calls, 2);
+  ck_assert_uint_eq(perf.cpu.work, instructions);
+  ck_assert_uint_eq(perf.ppu.work, instructions);
+  ck_assert_uint_eq(perf.apu.work, instructions);
+  ck_assert_uint_eq(perf.frame_instructions, 0);
+
+  if (counting)
+  {
+    ck_assert_uint_gt(perf.cpu.total.values[PERF_INSTRUCTIONS], 0);
+    perf_close(&counters);
+  }
+}
+END_TEST
+
+START_TEST(test_perf_register_access)
+{
+  static const uint8_t program[] = {
+      0xad, 0x02, 0x20, /* LDA $2002 */
+      0x8d, 0x00, 0x40, /* STA $4000 */
+      0x4c, 0x00, 0x80, /* JMP $8000 */
+  };
+  make_rom(program, sizeof program, 0);
+
+  struct perf_counters counters;
+  const bool counting = perf_open(&counters) == 0;
+  struct NesPerf perf = make_nes_perf(&counters);
+  const uint64_t instructions = run_counted(&perf);
+
+  /* Catching the PPU and the APU up on every access leaves the batch for the
+   * region of the PPU or the APU, and returns to it; the work is counted once
+   * all the same. */
+  ck_assert_uint_ge(perf.ppu.calls, instructions / 3);
+  ck_assert_uint_ge(perf.apu.calls, instructions / 3);
+  ck_assert_uint_eq(perf.cpu.calls, perf.ppu.calls + perf.apu.calls - 2);
+  ck_assert_uint_eq(perf.cpu.work, instructions);
+  ck_assert_uint_eq(perf.ppu.work, instructions);
+  ck_assert_uint_eq(perf.apu.work, instructions);
+
+  if (counting)
+  {
+    perf_close(&counters);
+  }
+}
+END_TEST
+
+TCase *make_nes_test_case(void)
+{
+  TCase *test_case = tcase_create("NES test cases");
+  tcase_add_test(test_case, test_controller);
+  tcase_add_test(test_case, test_frame_timing);
+  tcase_add_test(test_case, test_nmi);
+  tcase_add_test(test_case, test_frame_irq);
+  tcase_add_test(test_case, test_input_script);
+  tcase_add_test(test_case, test_jam);
+  tcase_add_test(test_case, test_perf_regions);
+  tcase_add_test(test_case, test_perf_register_access);
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef NES_TEST_H
+#define NES_TEST_H
+
+struct TCase;
+
+struct TCase *make_nes_test_case(void);
+
+#endif  // NES_TEST_H
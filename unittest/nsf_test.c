@@ -0,0 +1,234 @@
+#include "nsf_test.h"
+
+#include <lib/nes/include/nsf.h>
+
+#include <check.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Size of the tunes made by the tests; a header, and 3 banks. */
+#define NSF_TEST_SIZE (NSF_HEADER_SIZE + 3 * NSF_BANK_SIZE)
+
+static uint8_t tune[NSF_TEST_SIZE];
+
+/* Stores the song in $00, and starts a tone on the first pulse channel. */
+static const uint8_t init_code[] = {
+    0x85, 0x00,       /* STA $00 */
+    0xa9, 0xbf,       /* LDA #$bf */
+    0x8d, 0x00, 0x40, /* STA $4000 */
+    0xa9, 0xfd,       /* LDA #$fd */
+    0x8d, 0x02, 0x40, /* STA $4002 */
+    0xa9, 0x00,       /* LDA #$00 */
+    0x8d, 0x03, 0x40, /* STA $4003 */
+    0x60,             /* RTS */
+};
+
+/* Counts the calls in $01. */
+static const uint8_t play_code[] = {
+    0xe6, 0x01, /* INC $01 */
+    0x60,       /* RTS */
+};
+
+/*
+ * Makes a tune of 3 songs loaded at $8000, that plays at 60 Hz, of which the
+ * init routine is the given code.
+ */
+static void make_tune(const uint8_t *init, size_t size)
+{
+  memset(tune, 0, sizeof tune);
+  memcpy(tune, "NESM\x1a\x01\x03\x02", 8);
+  tune[0x09] = 0x80;                   /* load */
+  tune[0x0b] = 0x80;                   /* init */
+  tune[0x0c] = 0x20, tune[0x0d] = 0x80; /* play */
+  strcpy((char *)tune + 0x0e, "Test");
+  tune[0x6e] = 0x1a, tune[0x6f] = 0x41; /* 16666 us */
+
+  memcpy(tune + NSF_HEADER_SIZE, init, size);
+  memcpy(tune + NSF_HEADER_SIZE + 0x20, play_code, sizeof play_code);
+  tune[NSF_HEADER_SIZE + NSF_BANK_SIZE] = 0x11;
+  tune[NSF_HEADER_SIZE + 2 * NSF_BANK_SIZE] = 0x22;
+}
+
+START_TEST(test_parse_header)
+{
+  make_tune(init_code, sizeof init_code);
+  struct NsfHeader header;
+  ck_assert_int_eq(nsf_parse_header(&header, tune, sizeof tune), 0);
+  ck_assert_int_eq(header.songs, 3);
+  ck_assert_int_eq(header.starting_song, 1);
+  ck_assert_uint_eq(header.load_address, 0x8000);
+  ck_assert_uint_eq(header.init_address, 0x8000);
+  ck_assert_uint_eq(header.play_address, 0x8020);
+  ck_assert_str_eq(header.name, "Test");
+  ck_assert_uint_eq(header.ntsc_speed, 16666);
+  ck_assert(!header.bank_switched);
+
+  /* Neither a truncated header, nor another format, nor a tune without
+   * songs. */
+  ck_assert_int_eq(nsf_parse_header(&header, tune, NSF_HEADER_SIZE - 1), -1);
+  ck_assert_int_eq(errno, EINVAL);
+  tune[0] = 'X';
+  ck_assert_int_eq(nsf_parse_header(&header, tune, sizeof tune), -1);
+  tune[0] = 'N';
+  tune[0x06] = 0;
+  ck_assert_int_eq(nsf_parse_header(&header, tune, sizeof tune), -1);
+}
+END_TEST
+
+START_TEST(test_init_and_play)
+{
+  make_tune(init_code, sizeof init_code);
+  struct NsfPlayer *player = malloc(sizeof *player);
+  ck_assert_int_eq(nsf_load(player, tune, sizeof tune), 0);
+  ck_assert_int_eq(nsf_start_song(player, 3), -1);
+  ck_assert_int_eq(errno, EINVAL);
+
+  /* The init routine is given the song, and the play routine is called once
+   * per period, a period apart. */
+  ck_assert_int_eq(nsf_start_song(player, 1), 0);
+  ck_assert_uint_eq(player->cpu.ram[0x00], 1);
+  ck_assert_uint_eq(player->cpu.ram[0x01], 0);
+  const uint64_t start = player->song_start;
+  for (int i = 0; i < 10; ++i)
+  {
+    ck_assert_int_eq(nsf_run_frame(player), 0);
+  }
+  ck_assert_uint_eq(player->cpu.ram[0x01], 10);
+  ck_assert_double_eq_tol(nsf_frame_rate(player), 1e6 / 16666, 1e-9);
+  const double cycles = 10 * APU_CLOCK_RATE / nsf_frame_rate(player);
+  ck_assert_uint_le(player->cpu.cycle - start, cycles + 1);
+  ck_assert_uint_ge(player->cpu.cycle - start, cycles - 1);
+
+  /* Starting another song starts afresh. */
+  ck_assert_int_eq(nsf_start_song(player, 2), 0);
+  ck_assert_uint_eq(player->cpu.ram[0x00], 2);
+  ck_assert_uint_eq(player->cpu.ram[0x01], 0);
+
+  free(player);
+}
+END_TEST
+
+START_TEST(test_bank_switching)
+{
+  /* Maps bank 2 to $9000, and copies its first byte to $02. */
+  static const uint8_t code[] = {
+      0xa9, 0x02,       /* LDA #$02 */
+      0x8d, 0xf9, 0x5f, /* STA $5ff9 */
+      0xad, 0x00, 0x90, /* LDA $9000 */
+      0x85, 0x02,       /* STA $02 */
+      0x60,             /* RTS */
+  };
+  make_tune(code, sizeof code);
+  for (int slot = 0; slot < 8; ++slot)
+  {
+    tune[0x70 + slot] = slot;
+  }
+
+  struct NsfPlayer *player = malloc(sizeof *player);
+  ck_assert_int_eq(nsf_load(player, tune, sizeof tune), 0);
+  ck_assert(player->header.bank_switched);
+  ck_assert_int_eq(nsf_start_song(player, 0), 0);
+  ck_assert_uint_eq(player->cpu.ram[0x02], 0x22);
+
+  /* Banks past the end of the data are empty. */
+  ck_assert_uint_eq(player->cpu.ram[0x8000], 0xa9);
+  ck_assert_uint_eq(player->cpu.ram[0xa000], 0x22);
+  ck_assert_uint_eq(player->cpu.ram[0xb000], 0x00);
+
+  free(player);
+}
+END_TEST
+
+START_TEST(test_init_timeout)
+{
+  static const uint8_t code[] = {0x4c, 0x00, 0x80}; /* JMP $8000 */
+  make_tune(code, sizeof code);
+
+  struct NsfPlayer *player = malloc(sizeof *player);
+  ck_assert_int_eq(nsf_load(player, tune, sizeof tune), 0);
+  ck_assert_int_eq(nsf_start_song(player, 0), -1);
+  ck_assert_int_eq(errno, ETIMEDOUT);
+
+  free(player);
+}
+END_TEST
+
+START_TEST(test_jam)
+{
+  /* Stores the song in $00, and jams. */
+  static const uint8_t code[] = {0x85, 0x00, 0x02}; /* STA $00, JAM */
+  make_tune(code, sizeof code);
+
+  struct NsfPlayer *player = malloc(sizeof *player);
+  ck_assert_int_eq(nsf_load(player, tune, sizeof tune), 0);
+  ck_assert_int_eq(nsf_start_song(player, 1), -1);
+  ck_assert_int_eq(errno, EILSEQ);
+  ck_assert_uint_eq(player->cpu.ram[0x00], 1);
+
+  /* A play routine that jams fails every period, but the periods pass. */
+  make_tune(init_code, sizeof init_code);
+  tune[NSF_HEADER_SIZE + 0x20] = 0x02;
+  ck_assert_int_eq(nsf_load(player, tune, sizeof tune), 0);
+  ck_assert_int_eq(nsf_start_song(player, 0), 0);
+  const uint64_t start = player->song_start;
+  ck_assert_int_eq(nsf_run_frame(player), -1);
+  ck_assert_int_eq(errno, EILSEQ);
+  ck_assert_int_eq(nsf_run_frame(player), -1);
+  const double cycles = 2 * APU_CLOCK_RATE / nsf_frame_rate(player);
+  ck_assert_uint_ge(player->cpu.cycle - start, cycles - 1);
+  ck_assert_uint_le(player->cpu.cycle - start, cycles + 1);
+
+  /* Starting another song starts afresh. */
+  ck_assert_int_eq(nsf_start_song(player, 0), 0);
+  ck_assert(!player->cpu.jammed);
+
+  free(player);
+}
+END_TEST
+
+START_TEST(test_audio)
+{
+  make_tune(init_code, sizeof init_code);
+  struct NsfPlayer *player = malloc(sizeof *player);
+  ck_assert_int_eq(nsf_load(player, tune, sizeof tune), 0);
+  struct blip_buffer blip = make_blip_buffer(8192, APU_CLOCK_RATE, 48000);
+  player->apu.blip = &blip;
+
+  /* The tone of the init routine plays, a frame of samples per period. */
+  ck_assert_int_eq(nsf_start_song(player, 0), 0);
+  ck_assert_ptr_eq(player->apu.blip, &blip);
+  ck_assert_int_eq(nsf_run_frame(player), 0);
+  ck_assert_int_eq(nsf_run_frame(player), 0);
+  const int count = blip_samples_available(&blip);
+  ck_assert_int_ge(count, 2 * 48000 * 16666 / 1000000 - 2);
+
+  int16_t samples[2048];
+  ck_assert_int_eq(blip_read_samples(&blip, samples, count), count);
+  int16_t low = INT16_MAX;
+  int16_t high = INT16_MIN;
+  for (int i = count / 2; i < count; ++i)
+  {
+    low = samples[i] < low ? samples[i] : low;
+    high = samples[i] > high ? samples[i] : high;
+  }
+  ck_assert_int_gt(high - low, 1000);
+
+  destroy_blip_buffer(&blip);
+  free(player);
+}
+END_TEST
+
+struct TCase *make_nsf_test_case(void)
+{
+  TCase *test_case = tcase_create("NSF test cases");
+  tcase_add_test(test_case, test_parse_header);
+  tcase_add_test(test_case, test_init_and_play);
+  tcase_add_test(test_case, test_bank_switching);
+  tcase_add_test(test_case, test_init_timeout);
+  tcase_add_test(test_case, test_jam);
+  tcase_add_test(test_case, test_audio);
+
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef NSF_TEST_H
+#define NSF_TEST_H
+
+struct TCase;
+
+struct TCase *make_nsf_test_case(void);
+
+#endif  // NSF_TEST_H
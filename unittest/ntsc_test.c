@@ -0,0 +1,150 @@
+#include "ntsc_test.h"
+
+#include <lib/nes/include/ntsc.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/simd.h>
+#include <lib/std/include/thread_pool.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+enum { FRAME_SIZE = PPU_WIDTH * PPU_HEIGHT };
+
+/*
+ * Returns the component of an RGBA pixel.
+ */
+static int component(uint32_t pixel, int c)
+{
+  return (pixel >> (8 * c)) & 0xff;
+}
+
+static void fill(uint16_t *framebuffer, uint16_t pixel)
+{
+  for (int i = 0; i < FRAME_SIZE; ++i)
+  {
+    framebuffer[i] = pixel;
+  }
+}
+
+START_TEST(test_flat_colors)
+{
+  struct NtscFilter ntsc;
+  ntsc_init(&ntsc, PIXEL_FORMAT_RGBA, NULL);
+  static uint16_t framebuffer[FRAME_SIZE];
+  static uint32_t out[FRAME_SIZE];
+
+  /* Flat areas have no fringes; apart from rounding, every pixel of every
+   * row gets the same color, at any phase. Pixels within two pixels of the
+   * left and right border miss neighbors. */
+  const uint16_t pixels[] = {0x0f, 0x30, 0x16, 0x2a, 0x12 | PPUMASK_EMPHASIZE_RED << 1};
+  for (size_t i = 0; i < sizeof pixels / sizeof pixels[0]; ++i)
+  {
+    fill(framebuffer, pixels[i]);
+    for (int phase = 0; phase < NTSC_PHASES; ++phase)
+    {
+      ntsc_filter(&ntsc, framebuffer, phase, out);
+      const uint32_t color = out[PPU_WIDTH / 2];
+      ck_assert_uint_eq(color >> 24, 0xff);
+      for (int y = 0; y < PPU_HEIGHT; y += 7)
+      {
+        for (int x = 2; x < PPU_WIDTH - 2; ++x)
+        {
+          for (int c = 0; c < 3; ++c)
+          {
+            ck_assert_int_le(abs(component(out[y * PPU_WIDTH + x], c) - component(color, c)), 1);
+          }
+        }
+      }
+    }
+  }
+
+  /* Black is black, white is white; red is mostly red. */
+  fill(framebuffer, 0x0f);
+  ntsc_filter(&ntsc, framebuffer, 0, out);
+  ck_assert_uint_eq(out[PPU_WIDTH / 2], 0xff000000u);
+  fill(framebuffer, 0x30);
+  ntsc_filter(&ntsc, framebuffer, 0, out);
+  ck_assert_uint_eq(out[PPU_WIDTH / 2], 0xffffffffu);
+  fill(framebuffer, 0x16);
+  ntsc_filter(&ntsc, framebuffer, 0, out);
+  const uint32_t red = out[PPU_WIDTH / 2];
+  ck_assert_int_gt(component(red, 0), 2 * component(red, 1));
+  ck_assert_int_gt(component(red, 0), 2 * component(red, 2));
+
+  ntsc_destroy(&ntsc);
+}
+END_TEST
+
+START_TEST(test_fringes)
+{
+  struct NtscFilter ntsc;
+  ntsc_init(&ntsc, PIXEL_FORMAT_RGBA, NULL);
+  static uint16_t framebuffer[FRAME_SIZE];
+  static uint32_t out[FRAME_SIZE];
+
+  /* A white pixel on black smears over its neighbors, with colors that
+   * depend on its phase; so it looks different on consecutive scanlines. */
+  for (int j = 0; j < FRAME_SIZE; ++j)
+  {
+    framebuffer[j] = j % PPU_WIDTH == 100 ? 0x30 : 0x0f;
+  }
+  ntsc_filter(&ntsc, framebuffer, 0, out);
+
+  ck_assert_uint_ne(out[101] & 0xffffff, 0);
+  ck_assert_uint_eq(out[104], 0xff000000u);
+  ck_assert_uint_eq(out[96], 0xff000000u);
+  ck_assert_uint_ne(out[101], out[PPU_WIDTH + 101]);
+  ck_assert_uint_eq(out[101], out[3 * PPU_WIDTH + 101]);
+
+  ntsc_destroy(&ntsc);
+}
+END_TEST
+
+START_TEST(test_simd_levels)
+{
+  static uint16_t framebuffer[FRAME_SIZE];
+  static uint32_t expected[FRAME_SIZE];
+  static uint32_t out[FRAME_SIZE];
+  srand(11);
+  for (int i = 0; i < FRAME_SIZE; ++i)
+  {
+    framebuffer[i] = rand();
+  }
+
+  struct NtscFilter ntsc;
+  ntsc_init(&ntsc, PIXEL_FORMAT_BGRA, NULL);
+  simd_limit(SIMD_SCALAR);
+  ntsc_filter(&ntsc, framebuffer, 2, expected);
+
+  for (enum simd_level level = SIMD_SSE4; level <= SIMD_AVX2; ++level)
+  {
+    simd_limit(level);
+    memset(out, 0, sizeof out);
+    ntsc_filter(&ntsc, framebuffer, 2, out);
+    ck_assert_mem_eq(out, expected, sizeof out);
+  }
+  simd_limit(SIMD_AVX2);
+  ntsc_destroy(&ntsc);
+
+  /* Bands of rows filtered on a thread pool give the same frame. */
+  struct thread_pool pool;
+  ck_assert_int_eq(thread_pool_init(&pool, 3), 0);
+  ntsc_init(&ntsc, PIXEL_FORMAT_BGRA, &pool);
+  memset(out, 0, sizeof out);
+  ntsc_filter(&ntsc, framebuffer, 2, out);
+  ck_assert_mem_eq(out, expected, sizeof out);
+  ntsc_destroy(&ntsc);
+  thread_pool_destroy(&pool);
+}
+END_TEST
+
+TCase *make_ntsc_test_case(void)
+{
+  TCase *test_case = tcase_create("NTSC test cases");
+  tcase_add_test(test_case, test_flat_colors);
+  tcase_add_test(test_case, test_fringes);
+  tcase_add_test(test_case, test_simd_levels);
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef NTSC_TEST_H
+#define NTSC_TEST_H
+
+struct TCase;
+
+struct TCase *make_ntsc_test_case(void);
+
+#endif  // NTSC_TEST_H
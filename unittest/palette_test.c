@@ -0,0 +1,77 @@
+#include "palette_test.h"
+
+#include <lib/nes/include/palette.h>
+#include <lib/nes/include/ppu.h>
+#include <lib/std/include/simd.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+START_TEST(test_pixel_formats)
+{
+  static struct Palette palette;
+  uint32_t out[2];
+  const uint16_t pixels[2] = {0x16, 0x16 | PPUMASK_EMPHASIZE_RED << 1};
+
+  palette_init(&palette, PIXEL_FORMAT_RGBA);
+  palette_convert(&palette, pixels, out, 2);
+  const uint8_t rgba[4] = {0x98, 0x22, 0x20, 0xff};
+  ck_assert_mem_eq(&out[0], rgba, 4);
+
+  /* Emphasizing red darkens green and blue. */
+  const uint8_t *emphasized = (const uint8_t *)&out[1];
+  ck_assert_int_eq(emphasized[0], 0x98);
+  ck_assert_int_lt(emphasized[1], 0x22);
+  ck_assert_int_lt(emphasized[2], 0x20);
+
+  palette_init(&palette, PIXEL_FORMAT_BGRA);
+  palette_convert(&palette, pixels, out, 1);
+  const uint8_t bgra[4] = {0x20, 0x22, 0x98, 0xff};
+  ck_assert_mem_eq(&out[0], bgra, 4);
+}
+END_TEST
+
+START_TEST(test_simd_levels)
+{
+  static struct Palette palette;
+  palette_init(&palette, PIXEL_FORMAT_RGBA);
+
+  /* An odd size covers the scalar tail of the vectorized kernels; the upper
+   * bits of a pixel are ignored. */
+  enum { SIZE = PPU_WIDTH * PPU_HEIGHT + 13 };
+  static uint16_t pixels[SIZE];
+  static uint32_t expected[SIZE];
+  static uint32_t out[SIZE];
+  srand(7);
+  for (int i = 0; i < SIZE; ++i)
+  {
+    pixels[i] = rand();
+  }
+
+  simd_limit(SIMD_SCALAR);
+  palette_convert(&palette, pixels, expected, SIZE);
+  for (int i = 0; i < SIZE; ++i)
+  {
+    ck_assert_uint_eq(expected[i], palette.colors[pixels[i] & PPU_PIXEL_MASK]);
+  }
+
+  for (enum simd_level level = SIMD_SSE4; level <= SIMD_AVX2; ++level)
+  {
+    simd_limit(level);
+    memset(out, 0, sizeof out);
+    palette_convert(&palette, pixels, out, SIZE);
+    ck_assert_mem_eq(out, expected, sizeof out);
+  }
+  simd_limit(SIMD_AVX2);
+}
+END_TEST
+
+TCase *make_palette_test_case(void)
+{
+  TCase *test_case = tcase_create("Palette test cases");
+  tcase_add_test(test_case, test_pixel_formats);
+  tcase_add_test(test_case, test_simd_levels);
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef PALETTE_TEST_H
+#define PALETTE_TEST_H
+
+struct TCase;
+
+struct TCase *make_palette_test_case(void);
+
+#endif  // PALETTE_TEST_H
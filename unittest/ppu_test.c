@@ -0,0 +1,521 @@
+#include "ppu_test.h"
+
+#include <lib/nes/include/ppu.h>
+#include <lib/nes/include/tile_cache.h>
+#include <lib/std/include/simd.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static struct Ppu ppu;
+
+/*
+ * Powers on the PPU with CHR RAM, and vertical mirroring.
+ */
+static void setup(void)
+{
+  ppu_power_off(&ppu);
+  memset(&ppu, 0, sizeof ppu);
+  ppu.chr_ram = true;
+  ppu_power_on(&ppu, MIRRORING_VERTICAL);
+}
+
+START_TEST(test_vram_access)
+{
+  setup();
+
+  /* Nametable writes through $2006/$2007, with vertical mirroring. */
+  ppu_write(&ppu, 0x2006, 0x20);
+  ppu_write(&ppu, 0x2006, 0x00);
+  ppu_write(&ppu, 0x2007, 0x11);
+  ppu_write(&ppu, 0x2007, 0x22);
+  ck_assert_int_eq(ppu_memory_read(&ppu, 0x2000), 0x11);
+  ck_assert_int_eq(ppu_memory_read(&ppu, 0x2801), 0x22);
+  ck_assert_int_eq(ppu.v, 0x2002);
+
+  /* Reads are delayed by the read buffer. */
+  ppu_write(&ppu, 0x2006, 0x28);
+  ppu_write(&ppu, 0x2006, 0x00);
+  ppu_read(&ppu, 0x2007);
+  ck_assert_int_eq(ppu_read(&ppu, 0x2007), 0x11);
+  ck_assert_int_eq(ppu_read(&ppu, 0x2007), 0x22);
+
+  /* Incrementing by 32, through a mirror of the registers. */
+  ppu_write(&ppu, 0x3ff8, PPUCTRL_INCREMENT_32);
+  ppu_write(&ppu, 0x2006, 0x20);
+  ppu_write(&ppu, 0x2006, 0x00);
+  ppu_write(&ppu, 0x2007, 0x33);
+  ppu_write(&ppu, 0x2007, 0x44);
+  ck_assert_int_eq(ppu_memory_read(&ppu, 0x2020), 0x44);
+
+  /* Palette reads are not delayed, and $3f10 mirrors $3f00. */
+  ppu_write(&ppu, 0x2000, 0);
+  ppu_write(&ppu, 0x2006, 0x3f);
+  ppu_write(&ppu, 0x2006, 0x10);
+  ppu_write(&ppu, 0x2007, 0x0f);
+  ppu_write(&ppu, 0x2006, 0x3f);
+  ppu_write(&ppu, 0x2006, 0x00);
+  ck_assert_int_eq(ppu_read(&ppu, 0x2007) & 0x3f, 0x0f);
+
+  /* CHR ROM is read-only. */
+  ppu.chr_ram = false;
+  ppu_memory_write(&ppu, 0x0010, 0xaa);
+  ck_assert_int_eq(ppu_memory_read(&ppu, 0x0010), 0x00);
+}
+END_TEST
+
+START_TEST(test_scroll_registers)
+{
+  setup();
+
+  /* The example from the nesdev wiki PPU scrolling page. */
+  ppu_write(&ppu, 0x2000, 0x00);
+  ppu_write(&ppu, 0x2005, 0x7d);
+  ck_assert_int_eq(ppu.t, 0x000f);
+  ck_assert_int_eq(ppu.x, 5);
+  ppu_write(&ppu, 0x2005, 0x5e);
+  ck_assert_int_eq(ppu.t, 0x616f);
+  ppu_write(&ppu, 0x2006, 0x3d);
+  ck_assert_int_eq(ppu.t, 0x3d6f);
+  ppu_write(&ppu, 0x2006, 0xf0);
+  ck_assert_int_eq(ppu.t, 0x3df0);
+  ck_assert_int_eq(ppu.v, 0x3df0);
+
+  /* Reading the status resets the write toggle. */
+  ppu_write(&ppu, 0x2005, 0x08);
+  ppu_read(&ppu, 0x2002);
+  ppu_write(&ppu, 0x2005, 0x10);
+  ck_assert_int_eq(ppu.t & 0x1f, 0x02);
+}
+END_TEST
+
+START_TEST(test_vblank)
+{
+  setup();
+
+  ppu_run_until(&ppu, PPU_VBLANK_DOT - 1);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_VBLANK, 0);
+  ck_assert_int_eq(ppu_next_vblank(&ppu), PPU_VBLANK_DOT);
+
+  ppu_run_until(&ppu, PPU_VBLANK_DOT);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_VBLANK, PPUSTATUS_VBLANK);
+  ck_assert_int_eq(ppu.frame, 1);
+  ck_assert(!ppu.nmi);
+  ck_assert_int_eq(ppu_next_vblank(&ppu), PPU_DOTS_PER_FRAME + PPU_VBLANK_DOT);
+
+  /* Enabling NMIs during VBlank raises an NMI. */
+  ppu_write(&ppu, 0x2000, PPUCTRL_NMI);
+  ck_assert(ppu.nmi);
+  ppu.nmi = false;
+
+  /* Reading the status clears the VBlank flag. */
+  ck_assert_int_eq(ppu_read(&ppu, 0x2002) & PPUSTATUS_VBLANK, PPUSTATUS_VBLANK);
+  ck_assert_int_eq(ppu_read(&ppu, 0x2002) & PPUSTATUS_VBLANK, 0);
+
+  /* The next VBlank raises an NMI. */
+  ppu_run_until(&ppu, PPU_DOTS_PER_FRAME + PPU_VBLANK_DOT);
+  ck_assert(ppu.nmi);
+  ck_assert_int_eq(ppu.frame, 2);
+
+  /* With rendering enabled, the odd frame is one dot shorter. */
+  ppu_write(&ppu, 0x2001, PPUMASK_BACKGROUND);
+  ck_assert_int_eq(ppu_next_vblank(&ppu), 2 * PPU_DOTS_PER_FRAME - 1 + PPU_VBLANK_DOT);
+  ppu_run_until(&ppu, 2 * PPU_DOTS_PER_FRAME - 1 + PPU_VBLANK_DOT);
+  ck_assert_int_eq(ppu.frame, 3);
+}
+END_TEST
+
+/*
+ * Fills the pattern table rows of the given tile with a single color.
+ */
+static void fill_tile(unsigned tile, uint8_t color)
+{
+  memset(ppu.chr + tile * 16, color & 1 ? 0xff : 0x00, 8);
+  memset(ppu.chr + tile * 16 + 8, color & 2 ? 0xff : 0x00, 8);
+}
+
+START_TEST(test_render)
+{
+  setup();
+
+  /* Tile 1 is opaque, except for the top left tile of the screen. */
+  fill_tile(1, 1);
+  fill_tile(2, 3);
+  memset(ppu.nametables, 1, 0x3c0);
+  ppu.nametables[0] = 0;
+
+  ppu_memory_write(&ppu, 0x3f00, 0x0f);
+  ppu_memory_write(&ppu, 0x3f01, 0x16);
+  ppu_memory_write(&ppu, 0x3f13, 0x30);
+  ppu_memory_write(&ppu, 0x3f17, 0x2a);
+
+  /* Sprite 0 in front of the background on scanlines 10-17, sprite 1
+   * behind it, sprite 2 in front of the backdrop. */
+  const uint8_t sprites[] = {9, 2, 0x00, 0, 9, 2, 0x20, 16, 0, 2, 0x01, 0};
+  memset(ppu.oam, 0xff, sizeof ppu.oam);
+  memcpy(ppu.oam, sprites, sizeof sprites);
+
+  ppu_write(&ppu, 0x2001, PPUMASK_RENDERING | PPUMASK_BACKGROUND_LEFT | PPUMASK_SPRITES_LEFT);
+
+  /* Sprite 0 hit is flagged once its scanline is rendered. */
+  ppu_run_until(&ppu, 9 * PPU_DOTS_PER_SCANLINE + 340);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_SPRITE_0_HIT, 0);
+  ppu_run_until(&ppu, PPU_VBLANK_DOT);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_SPRITE_0_HIT, PPUSTATUS_SPRITE_0_HIT);
+
+  ck_assert_int_eq(ppu.framebuffer[0], 0x0f);
+  ck_assert_int_eq(ppu.framebuffer[8], 0x16);
+  ck_assert_int_eq(ppu.framebuffer[1 * PPU_WIDTH + 0], 0x2a);
+  ck_assert_int_eq(ppu.framebuffer[1 * PPU_WIDTH + 8], 0x16);
+  ck_assert_int_eq(ppu.framebuffer[10 * PPU_WIDTH + 0], 0x30);
+  ck_assert_int_eq(ppu.framebuffer[10 * PPU_WIDTH + 16], 0x16);
+  ck_assert_int_eq(ppu.framebuffer[18 * PPU_WIDTH + 0], 0x16);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_SPRITE_OVERFLOW, 0);
+
+  /* Fine X scroll shifts the background left. */
+  ppu_write(&ppu, 0x2005, 0x04);
+  ppu_write(&ppu, 0x2005, 0x00);
+  ppu_run_until(&ppu, 2 * PPU_DOTS_PER_FRAME);
+  ppu_run_until(&ppu, 2 * PPU_DOTS_PER_FRAME + PPU_VBLANK_DOT);
+  ck_assert_int_eq(ppu.framebuffer[3], 0x0f);
+  ck_assert_int_eq(ppu.framebuffer[4], 0x16);
+
+  /* More than eight sprites on a scanline overflow. */
+  for (int i = 0; i < 9; ++i)
+  {
+    ppu.oam[i * 4] = 100;
+  }
+  ppu_run_until(&ppu, 3 * PPU_DOTS_PER_FRAME + PPU_VBLANK_DOT);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_SPRITE_OVERFLOW, PPUSTATUS_SPRITE_OVERFLOW);
+}
+END_TEST
+
+START_TEST(test_vblank_race)
+{
+  setup();
+  ppu_set_accuracy(&ppu, PPU_ACCURACY_DOT);
+  ppu_write(&ppu, 0x2000, PPUCTRL_NMI);
+
+  /* Reading the status one dot before VBlank suppresses the flag and NMI. */
+  ppu_run_until(&ppu, PPU_VBLANK_DOT - 1);
+  ck_assert_int_eq(ppu_read(&ppu, 0x2002) & PPUSTATUS_VBLANK, 0);
+  ppu_run_until(&ppu, PPU_VBLANK_DOT + 10);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_VBLANK, 0);
+  ck_assert(!ppu.nmi);
+  ck_assert_int_eq(ppu.frame, 1);
+
+  /* Reading it as VBlank starts returns the flag, but suppresses the NMI. */
+  ppu_run_until(&ppu, PPU_DOTS_PER_FRAME + PPU_VBLANK_DOT);
+  ck_assert(ppu.nmi);
+  ck_assert_int_eq(ppu_read(&ppu, 0x2002) & PPUSTATUS_VBLANK, PPUSTATUS_VBLANK);
+  ck_assert(!ppu.nmi);
+}
+END_TEST
+
+/*
+ * Fills the PPU memory with a random scene, and enables rendering.
+ */
+static void make_random_scene(struct Ppu *p, unsigned seed)
+{
+  srand(seed);
+  for (size_t i = 0; i < sizeof p->chr; ++i)
+  {
+    p->chr[i] = rand();
+  }
+  for (size_t i = 0; i < sizeof p->nametables; ++i)
+  {
+    p->nametables[i] = rand();
+  }
+  for (Address i = 0; i < 32; ++i)
+  {
+    ppu_memory_write(p, 0x3f00 + i, rand());
+  }
+  for (size_t i = 0; i < sizeof p->oam; ++i)
+  {
+    p->oam[i] = rand();
+  }
+
+  ppu_write(p, 0x2000, PPUCTRL_BACKGROUND_TABLE);
+  ppu_write(p, 0x2005, 0x2b);
+  ppu_write(p, 0x2005, 0x11);
+  ppu_write(p, 0x2001, PPUMASK_RENDERING | PPUMASK_SPRITES_LEFT);
+}
+
+START_TEST(test_dot_render)
+{
+  static struct Ppu dot_ppu;
+
+  setup();
+  make_random_scene(&ppu, 1);
+  memset(&dot_ppu, 0, sizeof dot_ppu);
+  dot_ppu.chr_ram = true;
+  ppu_power_on(&dot_ppu, MIRRORING_VERTICAL);
+  make_random_scene(&dot_ppu, 1);
+  ppu_set_accuracy(&dot_ppu, PPU_ACCURACY_DOT);
+
+  /* Without mid-frame changes, both renderers draw the same picture. */
+  for (int frame = 0; frame < 2; ++frame)
+  {
+    ppu_run_until(&ppu, ppu_next_vblank(&ppu));
+    ppu_run_until(&dot_ppu, ppu_next_vblank(&dot_ppu));
+  }
+  ck_assert_int_eq(dot_ppu.dot, ppu.dot);
+  ck_assert_int_eq(dot_ppu.status, ppu.status);
+  ck_assert_int_eq(memcmp(dot_ppu.framebuffer, ppu.framebuffer, sizeof ppu.framebuffer), 0);
+
+  /* Switching renderers mid-frame keeps the timing. */
+  ppu_run_until(&dot_ppu, dot_ppu.dot + 1000);
+  ppu_set_accuracy(&dot_ppu, PPU_ACCURACY_SCANLINE);
+  ppu_run_until(&dot_ppu, ppu_next_vblank(&dot_ppu));
+  ppu_run_until(&ppu, ppu_next_vblank(&ppu));
+  ck_assert_int_eq(dot_ppu.dot, ppu.dot);
+  ck_assert_int_eq(dot_ppu.frame, 3);
+
+  ppu_power_off(&dot_ppu);
+}
+END_TEST
+
+/*
+ * Runs a frame of a random scene with sprites crowding the top of the screen,
+ * at the given SIMD level.
+ */
+static void render_crowded_scene(struct Ppu *p, unsigned seed, enum simd_level level)
+{
+  simd_limit(level);
+  memset(p, 0, sizeof *p);
+  p->chr_ram = true;
+  ppu_power_on(p, MIRRORING_VERTICAL);
+  make_random_scene(p, seed);
+  for (int i = 0; i < 64; ++i)
+  {
+    p->oam[i * 4] %= 48;
+  }
+  if (seed & 1)
+  {
+    ppu_write(p, 0x2000, PPUCTRL_SPRITE_8X16);
+  }
+  ppu_run_until(p, ppu_next_vblank(p));
+  simd_limit(SIMD_AVX2);
+}
+
+START_TEST(test_sprite_simd)
+{
+  static struct Ppu simd_ppu;
+
+  setup();
+  for (unsigned seed = 0; seed < 4; ++seed)
+  {
+    ppu_power_off(&ppu);
+    render_crowded_scene(&ppu, seed, SIMD_SCALAR);
+    for (enum simd_level level = SIMD_SSE4; level <= SIMD_AVX2; ++level)
+    {
+      render_crowded_scene(&simd_ppu, seed, level);
+      ck_assert_int_eq(simd_ppu.status, ppu.status);
+      ck_assert_int_eq(memcmp(simd_ppu.framebuffer, ppu.framebuffer, sizeof ppu.framebuffer), 0);
+      ppu_power_off(&simd_ppu);
+    }
+  }
+}
+END_TEST
+
+/*
+ * Returns whether sprite evaluation flags an overflow in the given OAM, with
+ * the given renderer.
+ */
+static bool sprite_overflow(const uint8_t *oam, enum PpuAccuracy accuracy)
+{
+  setup();
+  ppu_set_accuracy(&ppu, accuracy);
+  memcpy(ppu.oam, oam, sizeof ppu.oam);
+  ppu_write(&ppu, 0x2001, PPUMASK_RENDERING);
+  ppu_run_until(&ppu, PPU_VBLANK_DOT);
+  return ppu.status & PPUSTATUS_SPRITE_OVERFLOW;
+}
+
+START_TEST(test_sprite_overflow)
+{
+  uint8_t oam[256];
+  for (enum PpuAccuracy accuracy = PPU_ACCURACY_SCANLINE; accuracy <= PPU_ACCURACY_DOT; ++accuracy)
+  {
+    /* Eight sprites on a scanline do not overflow. */
+    memset(oam, 0xff, sizeof oam);
+    for (int i = 0; i < 8; ++i)
+    {
+      oam[i * 4] = 100;
+    }
+    ck_assert(!sprite_overflow(oam, accuracy));
+
+    /* After eight sprites, a missing sprite makes evaluation compare the tile
+     * index of the next sprite as its Y coordinate. */
+    oam[9 * 4 + 1] = 100;
+    ck_assert(sprite_overflow(oam, accuracy));
+
+    /* Hence a ninth sprite may go unnoticed. */
+    oam[9 * 4 + 1] = 0xff;
+    oam[9 * 4] = 100;
+    ck_assert(!sprite_overflow(oam, accuracy));
+
+    /* Unless it directly follows the eighth. */
+    oam[8 * 4] = 100;
+    ck_assert(sprite_overflow(oam, accuracy));
+  }
+}
+END_TEST
+
+START_TEST(test_skip_render)
+{
+  static struct Ppu skip_ppu;
+  static const uint16_t blank[PPU_WIDTH * PPU_HEIGHT];
+  const uint8_t sprite_flags = PPUSTATUS_SPRITE_OVERFLOW | PPUSTATUS_SPRITE_0_HIT;
+
+  for (enum PpuAccuracy accuracy = PPU_ACCURACY_SCANLINE; accuracy <= PPU_ACCURACY_DOT; ++accuracy)
+  {
+    uint8_t flags = 0;
+    for (unsigned seed = 0; seed < 4; ++seed)
+    {
+      struct Ppu *ppus[] = {&ppu, &skip_ppu};
+      for (int i = 0; i < 2; ++i)
+      {
+        ppu_power_off(ppus[i]);
+        memset(ppus[i], 0, sizeof *ppus[i]);
+        ppus[i]->chr_ram = true;
+        ppu_power_on(ppus[i], MIRRORING_VERTICAL);
+        make_random_scene(ppus[i], seed);
+        for (int sprite = 0; sprite < 64; ++sprite)
+        {
+          ppus[i]->oam[sprite * 4] %= 48;
+        }
+        ppu_set_accuracy(ppus[i], accuracy);
+      }
+      skip_ppu.skip_render = true;
+
+      /* The status flags change at the same scanline, or dot. */
+      const uint64_t step = accuracy == PPU_ACCURACY_DOT ? 1 : PPU_DOTS_PER_SCANLINE;
+      for (uint64_t dot = 0; dot < PPU_DOTS_PER_FRAME; dot += step)
+      {
+        ppu_run_until(&ppu, dot);
+        ppu_run_until(&skip_ppu, dot);
+        ck_assert_int_eq(skip_ppu.status, ppu.status);
+        ck_assert_int_eq(skip_ppu.v, ppu.v);
+        ck_assert_int_eq(skip_ppu.a12_fall, ppu.a12_fall);
+        flags |= ppu.status;
+      }
+      ck_assert_int_eq(memcmp(skip_ppu.framebuffer, blank, sizeof blank), 0);
+
+      /* Rendering resumes with the next frame. */
+      skip_ppu.skip_render = false;
+      ppu_run_until(&ppu, ppu_next_vblank(&ppu));
+      ppu_run_until(&skip_ppu, ppu_next_vblank(&skip_ppu));
+      ck_assert_int_eq(memcmp(skip_ppu.framebuffer, ppu.framebuffer, sizeof ppu.framebuffer), 0);
+      ppu_power_off(&skip_ppu);
+    }
+    ck_assert_int_eq(flags & sprite_flags, sprite_flags);
+  }
+}
+END_TEST
+
+START_TEST(test_sprite_0_hit_dot)
+{
+  setup();
+  ppu_set_accuracy(&ppu, PPU_ACCURACY_DOT);
+
+  fill_tile(1, 1);
+  memset(ppu.nametables, 1, 0x3c0);
+  memset(ppu.oam, 0xff, sizeof ppu.oam);
+  const uint8_t sprite[] = {9, 1, 0x00, 20};
+  memcpy(ppu.oam, sprite, sizeof sprite);
+  ppu_write(&ppu, 0x2001, PPUMASK_RENDERING);
+
+  /* The hit is flagged at the dot that outputs the leftmost pixel of the
+   * sprite on scanline 10. */
+  const uint64_t dot = 10 * PPU_DOTS_PER_SCANLINE + 21;
+  ppu_run_until(&ppu, dot - 1);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_SPRITE_0_HIT, 0);
+  ppu_run_until(&ppu, dot);
+  ck_assert_int_eq(ppu.status & PPUSTATUS_SPRITE_0_HIT, PPUSTATUS_SPRITE_0_HIT);
+}
+END_TEST
+
+START_TEST(test_tile_cache)
+{
+  setup();
+
+  /* Pixels are decoded in all flip orientations. */
+  ppu.chr[16 + 2] = 0x80;
+  ppu.chr[16 + 8 + 2] = 0x81;
+  const uint8_t *row = tile_cache_row(ppu.tiles, ppu.chr, 1, 0, 2);
+  ck_assert_int_eq(row[0], 3);
+  ck_assert_int_eq(row[7], 2);
+  ck_assert_int_eq(tile_cache_row(ppu.tiles, ppu.chr, 1, 1, 2)[0], 2);
+  ck_assert_int_eq(tile_cache_row(ppu.tiles, ppu.chr, 1, 2, 5)[0], 3);
+  ck_assert_int_eq(tile_cache_row(ppu.tiles, ppu.chr, 1, 3, 5)[7], 3);
+
+  /* Writes to CHR RAM decode the tile again. */
+  ppu_memory_write(&ppu, 16 + 2, 0x01);
+  ck_assert_int_eq(tile_cache_row(ppu.tiles, ppu.chr, 1, 0, 2)[0], 2);
+  ck_assert_int_eq(tile_cache_row(ppu.tiles, ppu.chr, 1, 0, 2)[7], 3);
+
+  /* Caches of CHR ROM are shared by content. */
+  struct TileCache *a = tile_cache_share(ppu.chr);
+  struct TileCache *b = tile_cache_share(ppu.chr);
+  ppu.chr[0] = 0xff;
+  struct TileCache *c = tile_cache_share(ppu.chr);
+  ck_assert_ptr_eq(a, b);
+  ck_assert_ptr_ne(a, c);
+  ck_assert_int_eq(tile_cache_row(a, NULL, 1, 0, 2)[7], 3);
+  ck_assert_int_eq(tile_cache_row(c, NULL, 0, 0, 0)[0], 1);
+  tile_cache_release(a);
+  tile_cache_release(b);
+  tile_cache_release(c);
+}
+END_TEST
+
+static int a12_rises;
+
+static void count_a12_rise(void *context, uint64_t low_dots)
+{
+  ++a12_rises;
+}
+
+START_TEST(test_a12)
+{
+  setup();
+  ppu_set_accuracy(&ppu, PPU_ACCURACY_DOT);
+  ppu.a12_rise = count_a12_rise;
+
+  /* With the background at $0000 and sprites at $1000, A12 rises once per
+   * rendered scanline, when the sprite patterns are fetched. */
+  ppu_write(&ppu, 0x2000, PPUCTRL_SPRITE_TABLE);
+  ppu_write(&ppu, 0x2001, PPUMASK_RENDERING);
+  ppu_run_until(&ppu, ppu_next_vblank(&ppu));
+  a12_rises = 0;
+  ppu_run_until(&ppu, ppu_next_vblank(&ppu));
+  ck_assert_int_eq(a12_rises, PPU_HEIGHT + 1);
+
+  /* Setting the VRAM address drives A12 as well. */
+  a12_rises = 0;
+  ppu_write(&ppu, 0x2006, 0x10);
+  ppu_write(&ppu, 0x2006, 0x00);
+  ck_assert_int_eq(a12_rises, 1);
+}
+END_TEST
+
+TCase *make_ppu_test_case(void)
+{
+  TCase *test_case = tcase_create("PPU test cases");
+  tcase_add_test(test_case, test_vram_access);
+  tcase_add_test(test_case, test_scroll_registers);
+  tcase_add_test(test_case, test_vblank);
+  tcase_add_test(test_case, test_render);
+  tcase_add_test(test_case, test_vblank_race);
+  tcase_add_test(test_case, test_dot_render);
+  tcase_add_test(test_case, test_sprite_0_hit_dot);
+  tcase_add_test(test_case, test_a12);
+  tcase_add_test(test_case, test_tile_cache);
+  tcase_add_test(test_case, test_sprite_simd);
+  tcase_add_test(test_case, test_sprite_overflow);
+  tcase_add_test(test_case, test_skip_render);
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef PPU_TEST_H
+#define PPU_TEST_H
+
+struct TCase;
+
+struct TCase *make_ppu_test_case(void);
+
+#endif  // PPU_TEST_H
@@ -0,0 +1,163 @@
+#include "profiler_test.h"
+
+#include <lib/6502/include/profiler.h>
+
+#include <check.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Counters per bank of the profiler. */
+#define PROFILER_TEST_BANK_SIZE (CPU_ADDRESS_MAX + 1)
+
+/* The state of the CPU after each recorded instruction; only the program
+ * counter and the stack pointer matter to the profiler. */
+static struct Cpu cpu;
+
+/*
+ * Records an instruction of the given address, after which the CPU continues
+ * at `next` with stack pointer `S`.
+ */
+static void record(struct Profiler *profiler, Address pc, uint8_t opcode, unsigned cycles,
+                   Address next, uint8_t S)
+{
+  cpu.PC = next;
+  cpu.S = S;
+  profiler_record(profiler, &cpu, pc, opcode, cycles);
+}
+
+/*
+ * Records a main loop at $8000 that calls the routine at $9000, which calls
+ * the routine at $a000 twice; once returning normally, once discarding its
+ * return address and returning to the main loop directly. In between, the
+ * routine at $9000 jumps through an RTS jump table.
+ */
+static void record_calls(struct Profiler *profiler)
+{
+  record(profiler, 0x8000, 0x20, 6, 0x9000, 0xfb); /* JSR $9000 */
+  record(profiler, 0x9000, 0xa9, 2, 0x9002, 0xfb); /* LDA #$00 */
+  record(profiler, 0x9002, 0x20, 6, 0xa000, 0xf9); /* JSR $a000 */
+  record(profiler, 0xa000, 0xea, 2, 0xa001, 0xf9); /* NOP */
+  record(profiler, 0xa001, 0x60, 6, 0x9005, 0xfb); /* RTS */
+  ck_assert_int_eq(profiler->depth, 1);
+
+  /* Pushes an address, and returns to it, which returns from nothing. */
+  record(profiler, 0x9005, 0x48, 3, 0x9006, 0xfa); /* PHA */
+  record(profiler, 0x9006, 0x48, 3, 0x9007, 0xf9); /* PHA */
+  record(profiler, 0x9007, 0x60, 6, 0x9010, 0xfb); /* RTS */
+  ck_assert_int_eq(profiler->depth, 1);
+
+  /* Pulls its own return address, hence returns from both routines. */
+  record(profiler, 0x9010, 0x20, 6, 0xa000, 0xf9); /* JSR $a000 */
+  record(profiler, 0xa000, 0x68, 4, 0xa001, 0xfa); /* PLA */
+  record(profiler, 0xa001, 0x68, 4, 0xa002, 0xfb); /* PLA */
+  record(profiler, 0xa002, 0x60, 6, 0x8003, 0xfd); /* RTS */
+  ck_assert_int_eq(profiler->depth, 0);
+
+  record(profiler, 0x8003, 0xea, 2, 0x8004, 0xfd); /* NOP */
+}
+
+START_TEST(test_counts)
+{
+  struct Profiler profiler = make_profiler(2);
+
+  /* Code of different banks at the same address counts separately. */
+  profiler_map_bank(&profiler, 0x8000, 0x4000, 1);
+  record(&profiler, 0x8000, 0xa9, 2, 0x8002, 0xfd); /* LDA #$00 */
+  record(&profiler, 0x8000, 0xa9, 2, 0x8002, 0xfd); /* LDA #$00 */
+  profiler_map_bank(&profiler, 0x8000, 0x4000, 0);
+  record(&profiler, 0x8000, 0xa9, 2, 0x8002, 0xfd); /* LDA #$00 */
+  record(&profiler, 0xc000, 0xad, 4, 0xc003, 0xfd); /* LDA $0300 */
+
+  ck_assert_uint_eq(profiler.executions[PROFILER_TEST_BANK_SIZE + 0x8000], 2);
+  ck_assert_uint_eq(profiler.cycles[PROFILER_TEST_BANK_SIZE + 0x8000], 4);
+  ck_assert_uint_eq(profiler.executions[0x8000], 1);
+  ck_assert_uint_eq(profiler.cycles[0x8000], 2);
+  ck_assert_uint_eq(profiler.executions[0xc000], 1);
+  ck_assert_uint_eq(profiler.cycles[0xc000], 4);
+
+  ck_assert_uint_eq(profiler.opcode_executions[0xa9], 3);
+  ck_assert_uint_eq(profiler.opcode_cycles[0xa9], 6);
+  ck_assert_uint_eq(profiler.opcode_executions[0xad], 1);
+  ck_assert_uint_eq(profiler.opcode_cycles[0xad], 4);
+
+  /* All of it is outside of any call. */
+  ck_assert_uint_eq(profiler.nodes_size, 1);
+  ck_assert_uint_eq(profiler.nodes[0].cycles, 10);
+
+  profiler_clear(&profiler);
+  ck_assert_uint_eq(profiler.executions[PROFILER_TEST_BANK_SIZE + 0x8000], 0);
+  ck_assert_uint_eq(profiler.opcode_executions[0xa9], 0);
+  ck_assert_uint_eq(profiler.nodes[0].cycles, 0);
+
+  destroy_profiler(&profiler);
+}
+END_TEST
+
+START_TEST(test_call_stack)
+{
+  struct Profiler profiler = make_profiler(1);
+  record_calls(&profiler);
+
+  /* Cycles of instructions count toward the routine they are executed in,
+   * calls toward the routine called. */
+  ck_assert_uint_eq(profiler.nodes_size, 3);
+  ck_assert_uint_eq(profiler.nodes[0].cycles, 8);
+
+  const struct ProfilerNode *outer = &profiler.nodes[profiler.nodes[0].first_child];
+  ck_assert_uint_eq(outer->routine, 0x9000);
+  ck_assert_uint_eq(outer->calls, 1);
+  ck_assert_uint_eq(outer->cycles, 26);
+  ck_assert_uint_eq(outer->next_sibling, 0);
+
+  const struct ProfilerNode *inner = &profiler.nodes[outer->first_child];
+  ck_assert_uint_eq(inner->routine, 0xa000);
+  ck_assert_uint_eq(inner->calls, 2);
+  ck_assert_uint_eq(inner->cycles, 22);
+  ck_assert_uint_eq(inner->first_child, 0);
+
+  destroy_profiler(&profiler);
+}
+END_TEST
+
+START_TEST(test_reports)
+{
+  struct Profiler profiler = make_profiler(1);
+  record_calls(&profiler);
+
+  char *buffer;
+  size_t size;
+  FILE *fp = open_memstream(&buffer, &size);
+  ck_assert_int_eq(profiler_write_folded(&profiler, fp), 0);
+  fclose(fp);
+  ck_assert_str_eq(buffer,
+                   "reset 8\n"
+                   "reset;9000 26\n"
+                   "reset;9000;A000 22\n");
+  free(buffer);
+
+  /* Routines by inclusive cycles, the routine at $9000 including the one at
+   * $a000. */
+  fp = open_memstream(&buffer, &size);
+  ck_assert_int_eq(profiler_write_report(&profiler, fp, NULL, 0), 0);
+  fclose(fp);
+  ck_assert_ptr_nonnull(strstr(buffer, "; instructions executed: 13\n"));
+  ck_assert_ptr_nonnull(strstr(buffer, "; cycles:                56\n"));
+  ck_assert_ptr_nonnull(strstr(buffer, "  9000                    1               48"));
+  ck_assert_ptr_nonnull(strstr(buffer, "  A000                    2               22"));
+  free(buffer);
+
+  destroy_profiler(&profiler);
+}
+END_TEST
+
+struct TCase *make_profiler_test_case(void)
+{
+  TCase *test_case = tcase_create("Profiler test cases");
+  tcase_add_test(test_case, test_counts);
+  tcase_add_test(test_case, test_call_stack);
+  tcase_add_test(test_case, test_reports);
+
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef PROFILER_TEST_H
+#define PROFILER_TEST_H
+
+struct TCase;
+
+struct TCase *make_profiler_test_case(void);
+
+#endif  // PROFILER_TEST_H
@@ -0,0 +1,175 @@
+#include "resampler_test.h"
+
+#include <lib/std/include/resampler.h>
+#include <lib/std/include/simd.h>
+#include <lib/std/include/util.h>
+
+#include <check.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of input samples of the test signals. */
+#define RESAMPLER_TEST_SAMPLES 19200
+
+/*
+ * Resamples the given input in blocks of the given size, and returns the
+ * number of output samples.
+ */
+static int resample(struct resampler *resampler, const int16_t *in, int count, int block,
+                    int16_t *out)
+{
+  int written = 0;
+  int read = 0;
+  while (written < count)
+  {
+    written += resampler_write(resampler, in + written, MIN(block, count - written));
+    read += resampler_read(resampler, out + read, RESAMPLER_TEST_SAMPLES - read);
+  }
+  return read;
+}
+
+/*
+ * Returns the largest magnitude of the given samples, past the latency of the
+ * resampler.
+ */
+static int peak(const int16_t *samples, int count)
+{
+  int result = 0;
+  for (int i = RESAMPLER_TAPS; i < count; ++i)
+  {
+    result = MAX(result, abs(samples[i]));
+  }
+  return result;
+}
+
+static void sine(int16_t *samples, int count, double frequency, int sample_rate)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    samples[i] = lround(16000 * sin(2 * M_PI * frequency * i / sample_rate));
+  }
+}
+
+START_TEST(test_identity)
+{
+  static int16_t in[RESAMPLER_TEST_SAMPLES];
+  static int16_t out[RESAMPLER_TEST_SAMPLES];
+  srand(3);
+  for (int i = 0; i < RESAMPLER_TEST_SAMPLES; ++i)
+  {
+    in[i] = rand();
+  }
+
+  /* Equal rates pass samples through unchanged, delayed by the latency. */
+  struct resampler resampler = make_resampler(48000, 48000);
+  const int count = resample(&resampler, in, RESAMPLER_TEST_SAMPLES, 1000, out);
+  ck_assert_int_eq(count, RESAMPLER_TEST_SAMPLES - RESAMPLER_TAPS / 2);
+  ck_assert_mem_eq(out, in, count * sizeof *out);
+  destroy_resampler(&resampler);
+}
+END_TEST
+
+START_TEST(test_ratio)
+{
+  static int16_t in[RESAMPLER_TEST_SAMPLES];
+  static int16_t out[RESAMPLER_TEST_SAMPLES];
+  for (int i = 0; i < RESAMPLER_TEST_SAMPLES; ++i)
+  {
+    in[i] = 10000;
+  }
+
+  /* A fifth of a second at 96 kHz is a fifth of a second at 44.1 kHz, but for
+   * the latency, whatever the size of the blocks; DC passes unchanged. */
+  struct resampler resampler = make_resampler(96000, 44100);
+  ck_assert_int_eq(resampler.phases, 147);
+  ck_assert_int_eq(resampler.step, 320);
+  const int blocks[] = {1, 7, 1600, RESAMPLER_BLOCK};
+  for (size_t i = 0; i < sizeof blocks / sizeof *blocks; ++i)
+  {
+    resampler_clear(&resampler);
+    const int count = resample(&resampler, in, RESAMPLER_TEST_SAMPLES, blocks[i], out);
+    ck_assert_int_le(count, 8820);
+    ck_assert_int_ge(count, 8820 - RESAMPLER_TAPS / 2 * 44100 / 96000 - 1);
+    for (int j = RESAMPLER_TAPS; j < count; ++j)
+    {
+      ck_assert_int_eq(out[j], 10000);
+    }
+  }
+  destroy_resampler(&resampler);
+
+  /* Ratios with too many phases are approximated. */
+  resampler = make_resampler(1789773, 48000);
+  ck_assert_int_eq(resampler.phases, RESAMPLER_MAX_PHASES);
+  ck_assert_int_eq(resampler.step, 9545);
+  destroy_resampler(&resampler);
+}
+END_TEST
+
+START_TEST(test_band_limit)
+{
+  static int16_t in[RESAMPLER_TEST_SAMPLES];
+  static int16_t out[RESAMPLER_TEST_SAMPLES];
+  struct resampler resampler = make_resampler(96000, 48000);
+
+  /* Tones below 20 kHz pass, tones above the Nyquist frequency of the output
+   * are removed rather than aliased. */
+  sine(in, RESAMPLER_TEST_SAMPLES, 1000, 96000);
+  int count = resample(&resampler, in, RESAMPLER_TEST_SAMPLES, 1600, out);
+  ck_assert_int_ge(peak(out, count), 15900);
+  ck_assert_int_le(peak(out, count), 16100);
+
+  resampler_clear(&resampler);
+  sine(in, RESAMPLER_TEST_SAMPLES, 19000, 96000);
+  count = resample(&resampler, in, RESAMPLER_TEST_SAMPLES, 1600, out);
+  ck_assert_int_ge(peak(out, count), 15000);
+
+  resampler_clear(&resampler);
+  sine(in, RESAMPLER_TEST_SAMPLES, 30000, 96000);
+  count = resample(&resampler, in, RESAMPLER_TEST_SAMPLES, 1600, out);
+  ck_assert_int_le(peak(out, count), 16);
+
+  destroy_resampler(&resampler);
+}
+END_TEST
+
+START_TEST(test_simd_levels)
+{
+  static int16_t in[RESAMPLER_TEST_SAMPLES];
+  static int16_t expected[RESAMPLER_TEST_SAMPLES];
+  static int16_t out[RESAMPLER_TEST_SAMPLES];
+  srand(5);
+  for (int i = 0; i < RESAMPLER_TEST_SAMPLES; ++i)
+  {
+    in[i] = rand();
+  }
+
+  /* Full scale noise saturates some samples. */
+  struct resampler resampler = make_resampler(96000, 44100);
+  simd_limit(SIMD_SCALAR);
+  const int count = resample(&resampler, in, RESAMPLER_TEST_SAMPLES, 1600, expected);
+
+  for (enum simd_level level = SIMD_SSE4; level <= SIMD_AVX2; ++level)
+  {
+    simd_limit(level);
+    resampler_clear(&resampler);
+    memset(out, 0, sizeof out);
+    ck_assert_int_eq(resample(&resampler, in, RESAMPLER_TEST_SAMPLES, 1600, out), count);
+    ck_assert_mem_eq(out, expected, sizeof out);
+  }
+  simd_limit(SIMD_AVX2);
+
+  destroy_resampler(&resampler);
+}
+END_TEST
+
+TCase *make_resampler_test_case(void)
+{
+  TCase *test_case = tcase_create("Resampler test cases");
+  tcase_add_test(test_case, test_identity);
+  tcase_add_test(test_case, test_ratio);
+  tcase_add_test(test_case, test_band_limit);
+  tcase_add_test(test_case, test_simd_levels);
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef RESAMPLER_TEST_H
+#define RESAMPLER_TEST_H
+
+struct TCase;
+
+struct TCase *make_resampler_test_case(void);
+
+#endif  // RESAMPLER_TEST_H
@@ -0,0 +1,171 @@
+#include "ring_buffer_test.h"
+
+#include <lib/std/include/ring_buffer.h>
+
+#include <check.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+START_TEST(test_make_ring_buffer)
+{
+  /* Capacity is rounded up to the next power of two. */
+  struct ring_buffer rb = make_ring_buffer(sizeof(int), 5);
+  ck_assert_int_eq(rb.capacity, 8);
+  ck_assert_int_eq(ring_buffer_size(&rb), 0);
+  destroy_ring_buffer(&rb);
+}
+END_TEST
+
+START_TEST(test_push_pop)
+{
+  struct ring_buffer rb = make_ring_buffer(sizeof(int), 4);
+
+  /* Pushing more elements than fit only pushes until the buffer is full. */
+  const int in[] = {1, 2, 3, 4, 5};
+  ck_assert_int_eq(ring_buffer_push(&rb, in, 5), 4);
+  ck_assert_int_eq(ring_buffer_size(&rb), 4);
+  ck_assert_int_eq(ring_buffer_push(&rb, in, 1), 0);
+
+  /* Elements are popped in the order they were pushed. */
+  int out[5] = {0};
+  ck_assert_int_eq(ring_buffer_pop(&rb, out, 2), 2);
+  ck_assert_int_eq(out[0], 1);
+  ck_assert_int_eq(out[1], 2);
+
+  /* Pushing now wraps around the end of the buffer. */
+  ck_assert_int_eq(ring_buffer_push(&rb, in + 4, 1), 1);
+  ck_assert_int_eq(ring_buffer_pop(&rb, out, 5), 3);
+  ck_assert_int_eq(out[0], 3);
+  ck_assert_int_eq(out[1], 4);
+  ck_assert_int_eq(out[2], 5);
+
+  /* Popping an empty buffer pops nothing. */
+  ck_assert_int_eq(ring_buffer_pop(&rb, out, 1), 0);
+  ck_assert_int_eq(ring_buffer_size(&rb), 0);
+
+  destroy_ring_buffer(&rb);
+}
+END_TEST
+
+enum
+{
+  CONCURRENT_ELEMENTS = 1 << 20
+};
+
+static void *produce(void *arg)
+{
+  struct ring_buffer *rb = arg;
+  for (unsigned i = 0; i < CONCURRENT_ELEMENTS;)
+  {
+    unsigned batch[7];
+    for (unsigned j = 0; j < 7; ++j)
+    {
+      batch[j] = i + j;
+    }
+    const size_t n =
+        ring_buffer_push(rb, batch, i + 7 <= CONCURRENT_ELEMENTS ? 7 : CONCURRENT_ELEMENTS - i);
+    if (n == 0)
+    {
+      sched_yield();
+    }
+    i += n;
+  }
+  return NULL;
+}
+
+START_TEST(test_concurrent_push_pop)
+{
+  struct ring_buffer rb = make_ring_buffer(sizeof(unsigned), 64);
+
+  pthread_t producer;
+  ck_assert_int_eq(pthread_create(&producer, NULL, produce, &rb), 0);
+
+  /* All elements arrive exactly once, and in order. */
+  unsigned expected = 0;
+  while (expected < CONCURRENT_ELEMENTS)
+  {
+    unsigned batch[5];
+    const size_t n = ring_buffer_pop(&rb, batch, 5);
+    if (n == 0)
+    {
+      sched_yield();
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+      ck_assert_uint_eq(batch[i], expected++);
+    }
+  }
+
+  pthread_join(producer, NULL);
+  ck_assert_int_eq(ring_buffer_size(&rb), 0);
+
+  destroy_ring_buffer(&rb);
+}
+END_TEST
+
+struct drain_state
+{
+  unsigned expected;
+  bool in_order;
+};
+
+static size_t consume(struct ring_buffer *rb, void *arg)
+{
+  struct drain_state *state = arg;
+
+  unsigned batch[5];
+  const size_t n = ring_buffer_pop(rb, batch, 5);
+  for (size_t i = 0; i < n; ++i)
+  {
+    state->in_order &= batch[i] == state->expected++;
+  }
+  return n;
+}
+
+struct drain_job
+{
+  struct ring_buffer *rb;
+  atomic_bool *is_closing;
+  struct drain_state state;
+};
+
+static void *drain(void *arg)
+{
+  struct drain_job *job = arg;
+  ring_buffer_drain(job->rb, job->is_closing, consume, &job->state);
+  return NULL;
+}
+
+START_TEST(test_drain)
+{
+  struct ring_buffer rb = make_ring_buffer(sizeof(unsigned), 64);
+  atomic_bool is_closing;
+  atomic_init(&is_closing, false);
+
+  struct drain_job job = {&rb, &is_closing, {0, true}};
+  pthread_t consumer;
+  ck_assert_int_eq(pthread_create(&consumer, NULL, drain, &job), 0);
+
+  /* Elements pushed right before closing are drained as well. */
+  produce(&rb);
+  atomic_store(&is_closing, true);
+
+  pthread_join(consumer, NULL);
+  ck_assert(job.state.in_order);
+  ck_assert_uint_eq(job.state.expected, CONCURRENT_ELEMENTS);
+  ck_assert_int_eq(ring_buffer_size(&rb), 0);
+
+  destroy_ring_buffer(&rb);
+}
+END_TEST
+
+TCase *make_ring_buffer_test_case(void)
+{
+  TCase *tc = tcase_create("Ring buffer test cases");
+  tcase_add_test(tc, test_make_ring_buffer);
+  tcase_add_test(tc, test_push_pop);
+  tcase_add_test(tc, test_concurrent_push_pop);
+  tcase_add_test(tc, test_drain);
+  return tc;
+}
@@ -0,0 +1,8 @@
+#ifndef RING_BUFFER_TEST_H
+#define RING_BUFFER_TEST_H
+
+struct TCase;
+
+struct TCase *make_ring_buffer_test_case(void);
+
+#endif  // RING_BUFFER_TEST_H
@@ -0,0 +1,161 @@
+#include "scaler_test.h"
+
+#include <lib/std/include/scaler.h>
+#include <lib/std/include/simd.h>
+#include <lib/std/include/thread_pool.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BLACK 0xff000000u
+#define WHITE 0xffffffffu
+
+/*
+ * A diagonal edge between white at the top left and black at the bottom
+ * right; the center pixel is black, with white above and to its left.
+ */
+static const uint32_t diagonal[3 * 3] = {
+    WHITE, WHITE, BLACK,  //
+    WHITE, BLACK, BLACK,  //
+    BLACK, BLACK, BLACK,  //
+};
+
+START_TEST(test_nearest)
+{
+  const uint32_t src[2 * 3] = {1, 2, 3, 4, 5, 6};
+  for (enum scaler scaler = SCALER_NEAREST2X; scaler <= SCALER_NEAREST4X; ++scaler)
+  {
+    const int factor = scaler_factor(scaler);
+    uint32_t dst[2 * 4 * 3 * 4];
+    scaler_run(scaler, src, 3, 3, 2, dst, 3 * factor, NULL);
+    for (int y = 0; y < 2 * factor; ++y)
+    {
+      for (int x = 0; x < 3 * factor; ++x)
+      {
+        ck_assert_uint_eq(dst[y * 3 * factor + x], src[y / factor * 3 + x / factor]);
+      }
+    }
+  }
+}
+END_TEST
+
+START_TEST(test_scale2x)
+{
+  uint32_t dst[6 * 6];
+  scaler_run(SCALER_SCALE2X, diagonal, 3, 3, 3, dst, 6, NULL);
+
+  /* Only the corner of the center pixel towards the edge turns white. */
+  ck_assert_uint_eq(dst[2 * 6 + 2], WHITE);
+  ck_assert_uint_eq(dst[2 * 6 + 3], BLACK);
+  ck_assert_uint_eq(dst[3 * 6 + 2], BLACK);
+  ck_assert_uint_eq(dst[3 * 6 + 3], BLACK);
+
+  /* The bottom right is flat. */
+  ck_assert_uint_eq(dst[5 * 6 + 5], BLACK);
+}
+END_TEST
+
+START_TEST(test_scale3x)
+{
+  uint32_t dst[9 * 9];
+  scaler_run(SCALER_SCALE3X, diagonal, 3, 3, 3, dst, 9, NULL);
+
+  ck_assert_uint_eq(dst[3 * 9 + 3], WHITE);
+  for (int i = 1; i < 9; ++i)
+  {
+    ck_assert_uint_eq(dst[(3 + i / 3) * 9 + 3 + i % 3], BLACK);
+  }
+}
+END_TEST
+
+START_TEST(test_hq2x)
+{
+  uint32_t dst[6 * 6];
+
+  /* Flat images stay flat. */
+  const uint32_t flat[3 * 3] = {0xff2040a0, 0xff2040a0, 0xff2040a0, 0xff2040a0, 0xff2040a0,
+                                0xff2040a0, 0xff2040a0, 0xff2040a0, 0xff2040a0};
+  scaler_run(SCALER_HQ2X, flat, 3, 3, 3, dst, 6, NULL);
+  for (int i = 0; i < 6 * 6; ++i)
+  {
+    ck_assert_uint_eq(dst[i], 0xff2040a0);
+  }
+
+  /* Edges are blended rather than copied. */
+  scaler_run(SCALER_HQ2X, diagonal, 3, 3, 3, dst, 6, NULL);
+  ck_assert_uint_eq(dst[2 * 6 + 2], 0xff808080);
+  ck_assert_uint_eq(dst[3 * 6 + 3], BLACK);
+}
+END_TEST
+
+START_TEST(test_simd_levels)
+{
+  /* Odd sizes leave tails for the scalar code, and a few colors give plenty
+   * of edges. */
+  enum { WIDTH = 45, HEIGHT = 37, STRIDE = 48, MAX_FACTOR = 4 };
+  static const uint32_t colors[] = {0xff000000, 0xff0f0f0f, 0xff2038ec, 0xfffcfcfc};
+  static uint32_t src[HEIGHT * STRIDE];
+  static uint32_t expected[HEIGHT * MAX_FACTOR * (WIDTH * MAX_FACTOR + 1)];
+  static uint32_t dst[HEIGHT * MAX_FACTOR * (WIDTH * MAX_FACTOR + 1)];
+  srand(5);
+  for (int i = 0; i < HEIGHT * STRIDE; ++i)
+  {
+    src[i] = colors[rand() % 4];
+  }
+
+  struct thread_pool pool;
+  ck_assert_int_eq(thread_pool_init(&pool, 3), 0);
+
+  for (enum scaler scaler = SCALER_NEAREST2X; scaler <= SCALER_HQ2X; ++scaler)
+  {
+    const size_t dst_stride = WIDTH * scaler_factor(scaler) + 1;
+    memset(expected, 0, sizeof expected);
+    simd_limit(SIMD_SCALAR);
+    scaler_run(scaler, src, STRIDE, WIDTH, HEIGHT, expected, dst_stride, NULL);
+
+    for (enum simd_level level = SIMD_SSE4; level <= SIMD_AVX2; ++level)
+    {
+      simd_limit(level);
+      memset(dst, 0, sizeof dst);
+      scaler_run(scaler, src, STRIDE, WIDTH, HEIGHT, dst, dst_stride, NULL);
+      ck_assert_mem_eq(dst, expected, sizeof dst);
+    }
+
+    /* Bands of rows scaled on a thread pool give the same image. */
+    memset(dst, 0, sizeof dst);
+    scaler_run(scaler, src, STRIDE, WIDTH, HEIGHT, dst, dst_stride, &pool);
+    ck_assert_mem_eq(dst, expected, sizeof dst);
+  }
+
+  thread_pool_destroy(&pool);
+}
+END_TEST
+
+START_TEST(test_from_string)
+{
+  enum scaler scaler;
+  ck_assert_int_eq(scaler_from_string("scale3x", &scaler), 0);
+  ck_assert_int_eq(scaler, SCALER_SCALE3X);
+  ck_assert_int_eq(scaler_from_string("1", &scaler), 0);
+  ck_assert_int_eq(scaler, SCALER_NONE);
+  ck_assert_int_eq(scaler_from_string("4", &scaler), 0);
+  ck_assert_int_eq(scaler, SCALER_NEAREST4X);
+  ck_assert_int_eq(scaler_from_string("5", &scaler), -1);
+  ck_assert_int_eq(scaler_from_string("hq3x", &scaler), -1);
+  ck_assert_str_eq(scaler_to_string(SCALER_HQ2X), "hq2x");
+}
+END_TEST
+
+TCase *make_scaler_test_case(void)
+{
+  TCase *test_case = tcase_create("Scaler test cases");
+  tcase_add_test(test_case, test_nearest);
+  tcase_add_test(test_case, test_scale2x);
+  tcase_add_test(test_case, test_scale3x);
+  tcase_add_test(test_case, test_hq2x);
+  tcase_add_test(test_case, test_simd_levels);
+  tcase_add_test(test_case, test_from_string);
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef SCALER_TEST_H
+#define SCALER_TEST_H
+
+struct TCase;
+
+struct TCase *make_scaler_test_case(void);
+
+#endif  // SCALER_TEST_H
@@ -0,0 +1,74 @@
+#include "thread_pool_test.h"
+
+#include <lib/std/include/thread_pool.h>
+
+#include <check.h>
+
+#include <stdatomic.h>
+
+enum { TASKS = 1000 };
+
+static atomic_int runs[TASKS];
+
+static void count_run(void *arg, int index)
+{
+  atomic_fetch_add(&runs[index], 1);
+  atomic_fetch_add((atomic_int *)arg, index);
+}
+
+START_TEST(test_run)
+{
+  /* Without workers, and with more workers than there are CPUs. */
+  for (int size = 0; size <= 4; size += 4)
+  {
+    struct thread_pool pool;
+    ck_assert_int_eq(thread_pool_init(&pool, size), 0);
+
+    /* Consecutive jobs reuse the workers; every task runs exactly once. */
+    for (int job = 0; job < 50; ++job)
+    {
+      for (int i = 0; i < TASKS; ++i)
+      {
+        atomic_init(&runs[i], 0);
+      }
+      atomic_int sum;
+      atomic_init(&sum, 0);
+
+      const int count = job % 2 ? TASKS : job;
+      thread_pool_run(&pool, count_run, &sum, count);
+      for (int i = 0; i < TASKS; ++i)
+      {
+        ck_assert_int_eq(atomic_load(&runs[i]), i < count);
+      }
+      ck_assert_int_eq(atomic_load(&sum), count * (count - 1) / 2);
+    }
+
+    thread_pool_destroy(&pool);
+  }
+}
+END_TEST
+
+START_TEST(test_bands)
+{
+  struct thread_pool pool;
+  ck_assert_int_eq(thread_pool_init(&pool, 3), 0);
+
+  /* A few bands per thread, unless bands would get smaller than asked for. */
+  ck_assert_int_eq(thread_pool_bands(&pool, 240, 1), 16);
+  ck_assert_int_eq(thread_pool_bands(&pool, 240, 8), 16);
+  ck_assert_int_eq(thread_pool_bands(&pool, 80, 8), 10);
+  ck_assert_int_eq(thread_pool_bands(&pool, 10, 1), 10);
+  ck_assert_int_eq(thread_pool_bands(&pool, 4, 8), 1);
+  ck_assert_int_eq(thread_pool_bands(&pool, 0, 0), 1);
+
+  thread_pool_destroy(&pool);
+}
+END_TEST
+
+TCase *make_thread_pool_test_case(void)
+{
+  TCase *test_case = tcase_create("Thread pool test cases");
+  tcase_add_test(test_case, test_run);
+  tcase_add_test(test_case, test_bands);
+  return test_case;
+}
@@ -0,0 +1,8 @@
+#ifndef THREAD_POOL_TEST_H
+#define THREAD_POOL_TEST_H
+
+struct TCase;
+
+struct TCase *make_thread_pool_test_case(void);
+
+#endif  // THREAD_POOL_TEST_H
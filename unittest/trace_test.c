@@ -0,0 +1,234 @@
+#include "trace_test.h"
+
+#include <lib/6502/include/trace.h>
+#include <lib/nes/include/nes.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Spans a few chunks, with the last one partially filled. */
+#define TRACE_TEST_RECORDS 100000
+/* A frame starts every this many records. */
+#define TRACE_TEST_FRAME 1000
+
+/*
+ * Creates a synthetic record: every instruction takes 3 cycles, the program
+ * counter cycles through a small loop, and every 50000-th record stores A to
+ * $0300.
+ */
+static struct TraceRecord make_test_record(size_t i)
+{
+  struct TraceRecord record = {0};
+  record.cycle = 7 + 3 * i;
+  record.PC = 0xc000 + (i % 64) * 2;
+  record.A = i & 0xff;
+  if (i % 50000 == 49999)
+  {
+    /* STA $0300 */
+    record.opcode[0] = 0x8d;
+    record.opcode[1] = 0x00;
+    record.opcode[2] = 0x03;
+    record.address = 0x0300;
+  }
+  else
+  {
+    /* LDA #$00 */
+    record.opcode[0] = 0xa9;
+  }
+  if (i % TRACE_TEST_FRAME == 0 && i > 0)
+  {
+    record.flags = TRACE_RECORD_FRAME_START;
+  }
+  return record;
+}
+
+static char trace_file_name[32];
+
+static void write_test_trace(void)
+{
+  strcpy(trace_file_name, "/tmp/nepnes_trace_XXXXXX");
+  int fd = mkstemp(trace_file_name);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+
+  struct TraceWriter writer;
+  ck_assert_int_eq(trace_writer_open(&writer, trace_file_name), 0);
+  for (size_t i = 0; i < TRACE_TEST_RECORDS; ++i)
+  {
+    struct TraceRecord record = make_test_record(i);
+    trace_writer_push(&writer, &record);
+  }
+  ck_assert_int_eq(trace_writer_close(&writer), 0);
+}
+
+static void check_sequential_read(void)
+{
+  struct TraceReader reader;
+  ck_assert_int_eq(trace_reader_open(&reader, trace_file_name), 0);
+  ck_assert_uint_eq(trace_reader_record_count(&reader), TRACE_TEST_RECORDS);
+
+  static struct TraceRecord records[777];
+  size_t i = 0;
+  size_t n;
+  while ((n = trace_reader_read(&reader, records, 777)) > 0)
+  {
+    for (size_t j = 0; j < n; ++j, ++i)
+    {
+      const struct TraceRecord expected = make_test_record(i);
+      ck_assert_mem_eq(&records[j], &expected, sizeof expected);
+    }
+  }
+  ck_assert_uint_eq(i, TRACE_TEST_RECORDS);
+
+  trace_reader_close(&reader);
+}
+
+START_TEST(test_trace_read)
+{
+  write_test_trace();
+  check_sequential_read();
+  unlink(trace_file_name);
+}
+END_TEST
+
+START_TEST(test_trace_rebuild_index)
+{
+  write_test_trace();
+
+  /* Drop the index and footer at the end of the file, the reader should scan
+   * the chunks instead. */
+  struct TraceReader reader;
+  ck_assert_int_eq(trace_reader_open(&reader, trace_file_name), 0);
+  const struct TraceChunkInfo *last = &reader.chunks[reader.chunk_count - 1];
+  const off_t size = last->offset + last->compressed_size;
+  trace_reader_close(&reader);
+  ck_assert_int_eq(truncate(trace_file_name, size), 0);
+
+  check_sequential_read();
+  unlink(trace_file_name);
+}
+END_TEST
+
+START_TEST(test_trace_find_cycle)
+{
+  write_test_trace();
+
+  struct TraceReader reader;
+  ck_assert_int_eq(trace_reader_open(&reader, trace_file_name), 0);
+
+  struct TraceRecord record;
+  ck_assert_int_eq(trace_reader_find_cycle(&reader, 0, &record), 0);
+
+  /* In the middle of instruction 77777. */
+  ck_assert_int_eq(trace_reader_find_cycle(&reader, 7 + 3 * 77777 + 2, &record), 1);
+  ck_assert_uint_eq(record.cycle, 7 + 3 * 77777);
+  ck_assert_int_eq(reader.chunks_loaded, 1);
+
+  ck_assert_int_eq(trace_reader_find_frame(&reader, 0, &record), 1);
+  ck_assert_uint_eq(record.cycle, 7);
+  ck_assert_int_eq(trace_reader_find_frame(&reader, 42, &record), 1);
+  ck_assert_uint_eq(record.cycle, 7 + 3 * 42 * TRACE_TEST_FRAME);
+  ck_assert_int_eq(trace_reader_find_frame(&reader, TRACE_TEST_RECORDS / TRACE_TEST_FRAME, &record),
+                   0);
+
+  trace_reader_close(&reader);
+  unlink(trace_file_name);
+}
+END_TEST
+
+START_TEST(test_trace_find_address)
+{
+  write_test_trace();
+
+  struct TraceReader reader;
+  ck_assert_int_eq(trace_reader_open(&reader, trace_file_name), 0);
+
+  struct TraceRecord record;
+  ck_assert_int_eq(trace_reader_next_pc(&reader, 0xc010, &record), 1);
+  ck_assert_uint_eq(record.cycle, 7 + 3 * 8);
+  ck_assert_int_eq(trace_reader_next_pc(&reader, 0xc010, &record), 1);
+  ck_assert_uint_eq(record.cycle, 7 + 3 * 72);
+
+  /* Never executed, all chunks are skipped using their bloom filter. */
+  reader.chunk = 0;
+  reader.record = 0;
+  reader.chunks_loaded = 0;
+  ck_assert_int_eq(trace_reader_next_pc(&reader, 0xc001, &record), 0);
+  ck_assert_int_eq(reader.chunks_loaded, 0);
+
+  reader.chunk = 0;
+  reader.record = 0;
+  ck_assert_int_eq(trace_reader_next_write(&reader, 0x0300, &record), 1);
+  ck_assert_uint_eq(record.cycle, 7 + 3 * 49999);
+  ck_assert_int_eq(trace_reader_next_write(&reader, 0x0300, &record), 1);
+  ck_assert_uint_eq(record.cycle, 7 + 3 * 99999);
+  ck_assert_int_eq(trace_reader_next_write(&reader, 0x0300, &record), 0);
+
+  trace_reader_close(&reader);
+  unlink(trace_file_name);
+}
+END_TEST
+
+START_TEST(test_trace_nes_frames)
+{
+  /* NROM-128 image that loops at $8000. */
+  static uint8_t rom[16 + 0x4000];
+  memcpy(rom, "NES\x1a\x01\x00", 6);
+  memcpy(rom + 16, "\x4c\x00\x80", 3); /* JMP $8000 */
+  rom[16 + 0x3ffd] = 0x80;
+
+  strcpy(trace_file_name, "/tmp/nepnes_trace_XXXXXX");
+  int fd = mkstemp(trace_file_name);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+
+  static struct Nes nes;
+  ck_assert_int_eq(nes_load(&nes, rom, sizeof rom), 0);
+  struct TraceWriter writer;
+  ck_assert_int_eq(trace_writer_open(&writer, trace_file_name), 0);
+  nes.trace = &writer;
+
+  /* The cycle at which each frame starts, as counted by the PPU. */
+  uint64_t starts[4] = {nes.cpu.cycle};
+  for (int frame = 1; frame < 4; ++frame)
+  {
+    nes_run_frame(&nes);
+    ck_assert_uint_eq(nes.ppu.frame, frame);
+    starts[frame] = nes.cpu.cycle;
+  }
+  nes_run_frame(&nes);
+  ck_assert_int_eq(trace_writer_close(&writer), 0);
+  nes.trace = NULL;
+  nes_unload(&nes);
+
+  /* Power on starts frame 0 without a mark, hence frame N starts at the N-th
+   * marked record. */
+  struct TraceReader reader;
+  ck_assert_int_eq(trace_reader_open(&reader, trace_file_name), 0);
+  struct TraceRecord record;
+  ck_assert_int_eq(trace_reader_read(&reader, &record, 1), 1);
+  ck_assert_uint_eq(record.flags & TRACE_RECORD_FRAME_START, 0);
+  for (int frame = 0; frame < 4; ++frame)
+  {
+    ck_assert_int_eq(trace_reader_find_frame(&reader, frame, &record), 1);
+    ck_assert_uint_eq(record.cycle, starts[frame]);
+  }
+
+  trace_reader_close(&reader);
+  unlink(trace_file_name);
+}
+END_TEST
+
+TCase *make_trace_test_case(void)
+{
+  TCase *tc = tcase_create("Trace test cases");
+  tcase_add_test(tc, test_trace_read);
+  tcase_add_test(tc, test_trace_rebuild_index);
+  tcase_add_test(tc, test_trace_find_cycle);
+  tcase_add_test(tc, test_trace_find_address);
+  tcase_add_test(tc, test_trace_nes_frames);
+  return tc;
+}
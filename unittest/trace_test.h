@@ -0,0 +1,8 @@
+#ifndef TRACE_TEST_H
+#define TRACE_TEST_H
+
+struct TCase;
+
+struct TCase *make_trace_test_case(void);
+
+#endif  // TRACE_TEST_H
@@ -0,0 +1,125 @@
+#include "video_test.h"
+
+#include <lib/nes/include/video.h>
+#include <lib/std/include/io.h>
+
+#include <check.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Number of frames written by the tests. */
+#define VIDEO_TEST_FRAMES 3
+
+static char video_file_name[32];
+static uint16_t framebuffer[PPU_HEIGHT * PPU_WIDTH];
+
+/*
+ * Writes frames with black pixels in even columns and white pixels in odd
+ * columns, apart from a red pixel at the top left of the given layout, and
+ * reads the file back.
+ */
+static void write_test_video(enum VideoFormat format, const struct VideoLayout *layout,
+                             uint8_t **data, size_t *size)
+{
+  strcpy(video_file_name, "/tmp/nepnes_video_XXXXXX");
+  int fd = mkstemp(video_file_name);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+
+  for (int i = 0; i < PPU_HEIGHT * PPU_WIDTH; ++i)
+  {
+    framebuffer[i] = i % 2 ? 0x30 : 0x0f;
+  }
+  framebuffer[layout->y * PPU_WIDTH + layout->x] = 0x16;
+
+  struct VideoWriter writer;
+  ck_assert_int_eq(video_writer_open(&writer, video_file_name, format, layout), 0);
+  for (int frame = 0; frame < VIDEO_TEST_FRAMES; ++frame)
+  {
+    video_writer_push(&writer, framebuffer);
+  }
+  ck_assert_int_eq(video_writer_close(&writer), 0);
+
+  ck_assert_int_eq(nn_read_all(video_file_name, data, size), 0);
+  unlink(video_file_name);
+}
+
+START_TEST(test_y4m)
+{
+  const struct VideoLayout layout = {9, 16, 32, 24, SCALER_NEAREST2X};
+  uint8_t *data;
+  size_t size;
+  write_test_video(VIDEO_FORMAT_Y4M, &layout, &data, &size);
+
+  const char header[] = "YUV4MPEG2 W64 H48 F" VIDEO_FRAME_RATE " Ip A1:1 C444\n";
+  const size_t plane = 64 * 48;
+  const size_t frame_size = strlen("FRAME\n") + 3 * plane;
+  ck_assert_uint_eq(size, strlen(header) + VIDEO_TEST_FRAMES * frame_size);
+  ck_assert_mem_eq(data, header, strlen(header));
+
+  /* Black is Y'CbCr 16, 128, 128 in limited range; every pixel is scaled to
+   * 2x2. The crop starts at an odd, white column. */
+  const uint8_t *frame = data + strlen(header) + (VIDEO_TEST_FRAMES - 1) * frame_size;
+  ck_assert_mem_eq(frame, "FRAME\n", 6);
+  const uint8_t *y = frame + 6;
+  const uint8_t *cb = y + plane;
+  const uint8_t *cr = cb + plane;
+  ck_assert_uint_eq(y[2 * 64 + 0], 220);
+  ck_assert_uint_eq(y[3 * 64 + 1], 220);
+  ck_assert_uint_eq(y[47 * 64 + 2], 16);
+  ck_assert_uint_eq(cb[47 * 64 + 3], 128);
+  ck_assert_uint_eq(cr[46 * 64 + 3], 128);
+
+  /* Red has a high Cr. */
+  ck_assert_uint_eq(cr[0], cr[65]);
+  ck_assert_uint_gt(cr[0], 160);
+
+  free(data);
+}
+END_TEST
+
+START_TEST(test_ppm)
+{
+  const struct VideoLayout layout = {0, 0, PPU_WIDTH, PPU_HEIGHT, SCALER_NONE};
+  uint8_t *data;
+  size_t size;
+  write_test_video(VIDEO_FORMAT_PPM, &layout, &data, &size);
+
+  const char header[] = "P6\n256 240\n255\n";
+  const size_t frame_size = strlen(header) + PPU_WIDTH * PPU_HEIGHT * 3;
+  ck_assert_uint_eq(size, VIDEO_TEST_FRAMES * frame_size);
+
+  const uint8_t *frame = data + frame_size;
+  ck_assert_mem_eq(frame, header, strlen(header));
+  const uint8_t red[3] = {0x98, 0x22, 0x20};
+  ck_assert_mem_eq(frame + strlen(header), red, 3);
+  const uint8_t white[3] = {0xec, 0xee, 0xec};
+  ck_assert_mem_eq(frame + strlen(header) + 3, white, 3);
+
+  free(data);
+}
+END_TEST
+
+START_TEST(test_layout)
+{
+  const struct VideoLayout full = {0, 0, PPU_WIDTH, PPU_HEIGHT, SCALER_NONE};
+  ck_assert(video_layout_valid(&full));
+  const struct VideoLayout outside = {1, 0, PPU_WIDTH, PPU_HEIGHT, SCALER_NONE};
+  ck_assert(!video_layout_valid(&outside));
+  const struct VideoLayout empty = {0, 0, 0, PPU_HEIGHT, SCALER_NONE};
+  ck_assert(!video_layout_valid(&empty));
+  const struct VideoLayout unknown = {0, 0, PPU_WIDTH, PPU_HEIGHT, SCALER_HQ2X + 1};
+  ck_assert(!video_layout_valid(&unknown));
+}
+END_TEST
+
+TCase *make_video_test_case(void)
+{
+  TCase *test_case = tcase_create("Video test cases");
+  tcase_add_test(test_case, test_y4m);
+  tcase_add_test(test_case, test_ppm);
+  tcase_add_test(test_case, test_layout);
+  return test_case;
+}
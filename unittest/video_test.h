@@ -0,0 +1,8 @@
+#ifndef VIDEO_TEST_H
+#define VIDEO_TEST_H
+
+struct TCase;
+
+struct TCase *make_video_test_case(void);
+
+#endif  // VIDEO_TEST_H
@@ -0,0 +1,141 @@
+#include "zone_test.h"
+
+#include <lib/std/include/io.h>
+#include <lib/std/include/zone.h>
+
+#include <check.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum
+{
+  ZONE_TEST_ZONES = 1000
+};
+
+static char zone_file_name[] = "/tmp/nepnes_zone_XXXXXX";
+
+/*
+ * Records the given number of nested zones on the calling thread.
+ */
+static void record_zones(int n)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    struct zone_scope outer = zone_begin("outer \"zone\"");
+    struct zone_scope inner = zone_begin("inner zone");
+    zone_end(&inner);
+    zone_end(&outer);
+  }
+}
+
+static void *record_zones_thread(void *arg)
+{
+  zone_thread_name("test thread");
+  record_zones(ZONE_TEST_ZONES);
+  return NULL;
+}
+
+/*
+ * Returns the number of occurrences of `needle` in `s`.
+ */
+static int count(const char *s, const char *needle)
+{
+  int n = 0;
+  while ((s = strstr(s, needle)) != NULL)
+  {
+    ++n;
+    s += strlen(needle);
+  }
+  return n;
+}
+
+/*
+ * Reads the zone file written by the test into a null-terminated string.
+ */
+static char *read_zone_file(void)
+{
+  unsigned char *data;
+  size_t size;
+  ck_assert_int_eq(nn_read_all(zone_file_name, &data, &size), 0);
+
+  char *s = malloc(size + 1);
+  memcpy(s, data, size);
+  s[size] = '\0';
+  free(data);
+
+  return s;
+}
+
+START_TEST(test_chrome_trace)
+{
+  strcpy(zone_file_name, "/tmp/nepnes_zone_XXXXXX");
+  int fd = mkstemp(zone_file_name);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+
+  struct zone_writer writer;
+  ck_assert_int_eq(zone_writer_open(&writer, zone_file_name), 0);
+
+  /* Zones of the main thread and another thread, the latter recorded
+   * concurrently with flushing the writer. */
+  pthread_t thread;
+  ck_assert_int_eq(pthread_create(&thread, NULL, record_zones_thread, NULL), 0);
+  record_zones(ZONE_TEST_ZONES);
+  ck_assert_int_eq(zone_writer_flush(&writer), 0);
+  ck_assert_int_eq(pthread_join(thread, NULL), 0);
+  ck_assert_int_eq(zone_writer_close(&writer), 0);
+
+  char *trace = read_zone_file();
+  ck_assert_int_eq(count(trace, "\"name\":\"outer \\\"zone\\\"\""), 2 * ZONE_TEST_ZONES);
+  ck_assert_int_eq(count(trace, "\"name\":\"inner zone\""), 2 * ZONE_TEST_ZONES);
+  ck_assert_int_eq(count(trace, "\"args\":{\"name\":\"test thread\"}"), 1);
+
+  /* The trace is a single JSON object. */
+  ck_assert_int_eq(trace[0], '{');
+  ck_assert_ptr_nonnull(strstr(trace, "\n],\"otherData\":{\"dropped_zones\":"));
+  ck_assert_int_eq(trace[strlen(trace) - 2], '}');
+
+  free(trace);
+  unlink(zone_file_name);
+}
+END_TEST
+
+START_TEST(test_dropped_zones)
+{
+  strcpy(zone_file_name, "/tmp/nepnes_zone_XXXXXX");
+  int fd = mkstemp(zone_file_name);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+
+  /* A thread that records more zones than fit in its buffer, without the
+   * writer draining it, drops the remaining zones. */
+  struct zone_writer writer;
+  ck_assert_int_eq(zone_writer_open(&writer, zone_file_name), 0);
+  pthread_t thread;
+  ck_assert_int_eq(pthread_create(&thread, NULL, record_zones_thread, NULL), 0);
+  ck_assert_int_eq(pthread_join(thread, NULL), 0);
+  record_zones(ZONE_EVENTS_PER_THREAD);
+  ck_assert_int_eq(zone_writer_close(&writer), 0);
+
+  char *trace = read_zone_file();
+  ck_assert_int_eq(count(trace, "\"name\":\"inner zone\""),
+                   ZONE_TEST_ZONES + ZONE_EVENTS_PER_THREAD / 2);
+  char expected[64];
+  snprintf(expected, sizeof expected, "\"dropped_zones\":\"%d\"", ZONE_EVENTS_PER_THREAD);
+  ck_assert_ptr_nonnull(strstr(trace, expected));
+
+  free(trace);
+  unlink(zone_file_name);
+}
+END_TEST
+
+TCase *make_zone_test_case(void)
+{
+  TCase *test_case = tcase_create("zone");
+  tcase_add_test(test_case, test_chrome_trace);
+  tcase_add_test(test_case, test_dropped_zones);
+  return test_case;
+}
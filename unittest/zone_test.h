@@ -0,0 +1,8 @@
+#ifndef ZONE_TEST_H
+#define ZONE_TEST_H
+
+struct TCase;
+
+struct TCase *make_zone_test_case(void);
+
+#endif  // ZONE_TEST_H